@@ -0,0 +1,185 @@
+#ifndef HEALTHCAREMANAGEMENTSYSTEM_AGGREGATOR_H
+#define HEALTHCAREMANAGEMENTSYSTEM_AGGREGATOR_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cctype>
+
+using namespace std;
+
+// Compares two column values, ordering all-digit values (IDs) numerically and everything else lexically.
+// Returns a negative number, zero or a positive number like string::compare.
+static int compareColumnValues(const string &a, const string &b) {
+    bool aNumeric = !a.empty() && all_of(a.begin(), a.end(), ::isdigit);
+    bool bNumeric = !b.empty() && all_of(b.begin(), b.end(), ::isdigit);
+    if (aNumeric && bNumeric) {
+        // Skip leading zeros so that "01" and "1" compare equal, then compare by length first
+        size_t aStart = min(a.find_first_not_of('0'), a.size());
+        size_t bStart = min(b.find_first_not_of('0'), b.size());
+        size_t aLength = a.size() - aStart, bLength = b.size() - bStart;
+        if (aLength != bLength) {
+            return aLength < bLength ? -1 : 1;
+        }
+        return a.compare(aStart, aLength, b, bStart, bLength);
+    }
+    return a.compare(b);
+}
+
+// Aggregate functions supported by the query language
+enum class AggregateFunction {
+    None,  // Plain column, must appear in GROUP BY
+    Count, // COUNT(*) or COUNT(column)
+    Min,   // MIN(column)
+    Max    // MAX(column)
+};
+
+// A single item of a SELECT list: either a plain column or an aggregate over a column
+class SelectItem {
+public:
+    AggregateFunction function; // Aggregate to apply, or None for a plain column
+    string column;              // Column name, or "*" for COUNT(*)
+
+    SelectItem(AggregateFunction function, const string &column) : function(function), column(column) {}
+
+    // Heading used when printing the item, e.g. "COUNT(*)" or "MIN(date)"
+    string label() const {
+        switch (function) {
+            case AggregateFunction::Count:
+                return "COUNT(" + column + ")";
+            case AggregateFunction::Min:
+                return "MIN(" + column + ")";
+            case AggregateFunction::Max:
+                return "MAX(" + column + ")";
+            default:
+                return column;
+        }
+    }
+};
+
+// Running state of the aggregates of one group
+class AggregateState {
+public:
+    long long count = 0; // Number of rows folded into the group
+    string min;          // Smallest value seen so far
+    string max;          // Largest value seen so far
+};
+
+// Streaming hash aggregate: rows are fed one at a time and folded into per-group states,
+// so memory grows with the number of groups and not with the number of rows scanned.
+class HashAggregate {
+private:
+    vector<int> groupColumnIndexes;             // Positions of the GROUP BY columns in an input row
+    vector<SelectItem> items;                   // SELECT list in output order
+    vector<int> itemColumnIndexes;              // Position of each item's column in an input row (-1 for "*")
+    unordered_map<string, size_t> groupSlots;   // Group key -> slot in groupValues/states
+    vector<vector<string>> groupValues;         // GROUP BY values of each group
+    vector<vector<AggregateState>> states;      // Aggregate states of each group, one per select item
+    string keyBuffer;                           // Reused buffer for building group keys
+
+    // Find the position of a column in the schema, or -1 if it is not present
+    static int columnIndex(const vector<string> &schema, const string &column) {
+        for (size_t i = 0; i < schema.size(); ++i) {
+            if (schema[i] == column) return i;
+        }
+        return -1;
+    }
+
+public:
+    // Build an aggregate over rows laid out as `schema`, grouped by the `groupBy` columns.
+    // Columns are expected to be validated by the caller.
+    HashAggregate(const vector<string> &schema, const vector<string> &groupBy, const vector<SelectItem> &items)
+            : items(items) {
+        for (const string &column : groupBy) {
+            groupColumnIndexes.push_back(columnIndex(schema, column));
+        }
+        for (const SelectItem &item : items) {
+            itemColumnIndexes.push_back(columnIndex(schema, item.column));
+        }
+    }
+
+    // Fold one input row into its group
+    void consume(const vector<string> &row) {
+        // Build the group key from the GROUP BY values, separated by a unit separator
+        keyBuffer.clear();
+        for (int index : groupColumnIndexes) {
+            keyBuffer += row[index];
+            keyBuffer += '\x1f';
+        }
+
+        auto slot = groupSlots.find(keyBuffer);
+        size_t position;
+        if (slot == groupSlots.end()) {
+            // First row of a new group: remember its GROUP BY values and start fresh states
+            position = groupValues.size();
+            groupSlots.emplace(keyBuffer, position);
+            vector<string> values;
+            for (int index : groupColumnIndexes) {
+                values.push_back(row[index]);
+            }
+            groupValues.push_back(std::move(values));
+            states.emplace_back(items.size());
+        } else {
+            position = slot->second;
+        }
+
+        vector<AggregateState> &groupStates = states[position];
+        for (size_t i = 0; i < items.size(); ++i) {
+            AggregateState &state = groupStates[i];
+            const string *value = itemColumnIndexes[i] == -1 ? nullptr : &row[itemColumnIndexes[i]];
+            if (state.count == 0 && value != nullptr) {
+                state.min = state.max = *value;
+            } else if (value != nullptr) {
+                if (compareColumnValues(*value, state.min) < 0) state.min = *value;
+                if (compareColumnValues(*value, state.max) > 0) state.max = *value;
+            }
+            state.count++;
+        }
+    }
+
+    // Produce one output row per group, with values in SELECT list order
+    vector<vector<string>> results() const {
+        vector<vector<string>> rows;
+
+        // Without GROUP BY an empty input still yields a single row (COUNT(*) = 0)
+        if (groupColumnIndexes.empty() && groupValues.empty()) {
+            vector<string> row;
+            for (const SelectItem &item : items) {
+                row.push_back(item.function == AggregateFunction::Count ? "0" : "");
+            }
+            rows.push_back(row);
+            return rows;
+        }
+
+        for (size_t position = 0; position < groupValues.size(); ++position) {
+            vector<string> row;
+            for (size_t i = 0; i < items.size(); ++i) {
+                const AggregateState &state = states[position][i];
+                switch (items[i].function) {
+                    case AggregateFunction::Count:
+                        row.push_back(to_string(state.count));
+                        break;
+                    case AggregateFunction::Min:
+                        row.push_back(state.min);
+                        break;
+                    case AggregateFunction::Max:
+                        row.push_back(state.max);
+                        break;
+                    default:
+                        // Plain columns are GROUP BY columns; take the value from the group
+                        for (size_t g = 0; g < groupColumnIndexes.size(); ++g) {
+                            if (groupColumnIndexes[g] == itemColumnIndexes[i]) {
+                                row.push_back(groupValues[position][g]);
+                                break;
+                            }
+                        }
+                }
+            }
+            rows.push_back(std::move(row));
+        }
+        return rows;
+    }
+};
+
+#endif //HEALTHCAREMANAGEMENTSYSTEM_AGGREGATOR_H
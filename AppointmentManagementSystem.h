@@ -5,6 +5,16 @@
 #include "AvailList.h"
 #include "PrimaryIndex.h"
 #include "SecondaryIndex.h"
+#include "ParallelScan.h"
+#include "BatchReader.h"
+#include "TableChange.h"
+#include "VersionStore.h"
+#include "ShardLayout.h"
+#include "IndexRebuild.h"
+#include "AppointmentSchedule.h"
+#include "MonthPartitions.h"
+#include <shared_mutex>
+#include <mutex>
 
 using namespace std;
 
@@ -30,57 +40,159 @@ public:
 // and secondary indexing techniques.
 class AppointmentManagementSystem {
 private:
-    PrimaryIndex &doctorPrimaryIndex;  // Reference to shared doctor primary index.
-    PrimaryIndex appointmentPrimaryIndex;  // Manages primary index for appointment IDs.
-    AvailList appointmentAvailList;        // Manages available space in the file.
-    SecondaryIndex appointmentSecondaryIndex; // Manages secondary index for appointments.
+    DoctorManagementSystem &doctorSystem;  // Doctors that appointments refer to.
+    bool monthPartitioned;                 // Month partitions (MonthPartitions.h) instead of hash shards.
+    atomic<shared_ptr<TableShards>> layout;// Appointments partitioned by a hash of their ID, or by the
+                                           // month of their date; each shard has its own file, indexes,
+                                           // avail list and versions. Adding a month partition publishes
+                                           // a new vector; partitions are never removed while running.
+    mutex layoutMutex;                     // Serializes adding month partitions.
+    bool autoPersist = true;               // Setting of setAutoPersist, for partitions added later.
+
+    // Concurrency: every shard has its own tableMutex. Readers hold it shared and run in parallel;
+    // add, update and delete hold it exclusively, so writes to different shards run in parallel.
+    // Doctor locks come first: adding an appointment holds its doctor's shard shared (so the
+    // doctor cannot be deleted meanwhile), and deleting a doctor locks the appointment shards to
+    // apply its ON DELETE action. No doctor lock is ever requested while a shard lock is held.
+    // Full-table reports (scanAppointments, printAllAppointments) hold the locks only to open
+    // snapshots and then read without them, so they never stall bookings. Two shard locks are
+    // always taken together with scoped_lock. Every operation works on the layout vector that was
+    // current when it started; a month partition added meanwhile only holds newer records.
+    // Sealed month partitions are read-only: their records are kept when a doctor is deleted with
+    // CASCADE, and they take no part in the schedule, since nothing can be booked in them.
+    // Bookings: appointments with a time ("YYYY-MM-DD HH:MM-HH:MM") are also kept in `schedule`,
+    // updated by the record functions below. A booking checks the doctor's schedule for overlaps
+    // and writes its record while holding the doctor's booking stripe, taken after the doctor's
+    // lock and before any shard lock.
+    AppointmentSchedule schedule;  // Timed appointments per doctor.
+    BookingLocks bookingLocks;     // Serializes the conflict check and write of bookings per doctor.
+    mutex idMutex;           // Protects largestId.
+    int largestId = -1;      // Largest appointment ID handed out over all shards (-1 until loaded).
+    mutex listenerMutex;                                    // Protects changeListeners.
+    vector<pair<int, TableChangeListener>> changeListeners; // Observers notified after every mutation.
+    int nextListenerId = 0;                                 // Handle given to the next observer.
+
+    // Notifies the observers that an appointment record was added, changed or deleted.
+    void notifyChange(const TableChange &change) {
+        lock_guard<mutex> lock(listenerMutex);
+        for (const auto &listener : changeListeners) {
+            listener.second(change);
+        }
+    }
 
-public:
-    // Constructor: Initializes file names for indexes and the availability list.
-    AppointmentManagementSystem(PrimaryIndex &sharedDoctorPrimaryIndex)
-            : doctorPrimaryIndex(sharedDoctorPrimaryIndex) {
-        // Initialize the file names for the primary index, avail list, and secondary index
-        appointmentPrimaryIndex.setPrimaryIndexFileName("AppointmentPrimaryIndex.txt");
-        appointmentAvailList.setAvailListFileName("AppointmentAvailList.txt");
-        appointmentSecondaryIndex.setSecondaryIndexAndLabelIdListFileNames(
-                "AppointmentSecondaryIndex.txt", "AppointmentLabelIdList.txt");
+    // The current layout.
+    shared_ptr<TableShards> currentShards() const {
+        return layout.load();
+    }
+
+    // Position in `shards` of the shard that holds (or, for hash shards, will hold) an appointment
+    // ID. Month partitions are probed newest first; a partition that does not hold the ID is
+    // usually rejected by its Bloom filter. An ID that no partition holds maps to the last one.
+    size_t shardIndexOf(const TableShards &shards, const string &id) const {
+        if (!monthPartitioned) return shardOfKey(id, shards.size());
+        for (size_t index = shards.size(); index-- > 0;) {
+            if (shards[index]->primaryIndex.binarySearchPrimaryIndex(id) != -1) return index;
+        }
+        return shards.size() - 1;
     }
 
-    // Provides access to the primary index for appointments.
-    PrimaryIndex &getAppointmentPrimaryIndex() {
-        return appointmentPrimaryIndex;
+    // Shard that holds (or will hold) an appointment ID. Shards outlive every layout vector.
+    TableShard &shardFor(const string &id) const {
+        shared_ptr<TableShards> shards = currentShards();
+        return *(*shards)[shardIndexOf(*shards, id)];
     }
 
-    // Provides access to the secondary index for appointments.
-    SecondaryIndex &getAppointmentSecondaryIndex() {
-        return appointmentSecondaryIndex;
+    // Month partition of `month` if it exists.
+    TableShard *findPartition(const string &month) const {
+        shared_ptr<TableShards> shards = currentShards();
+        for (const auto &shard : *shards) {
+            if (shard->partition == month) return shard.get();
+        }
+        return nullptr;
     }
 
-    // Adds a new appointment to the system.
-    void addAppointment(Appointment &appointment) {
-        // Validate that the doctor exists in the doctor index
-        if (doctorPrimaryIndex.binarySearchPrimaryIndex(appointment.doctorID) == -1) {
-            cout << "Error: Doctor ID " << appointment.doctorID
-                 << " does not exist. Cannot add appointment.\n";
-            return;
+    // Month partition of `month`, created if it does not exist yet (the undated partition if its
+    // files cannot be created).
+    TableShard &partitionFor(const string &month) {
+        if (TableShard *partition = findPartition(month)) return *partition;
+        lock_guard<mutex> lock(layoutMutex);
+        if (TableShard *partition = findPartition(month)) return *partition;
+
+        shared_ptr<TableShards> shards = currentShards();
+        shared_ptr<TableShard> partition = openMonthPartition(month, appointmentFileNames);
+        if (partition == nullptr) return *findPartition(undatedPartition);
+        partition->primaryIndex.setAutoPersist(autoPersist);
+        partition->availList.setAutoPersist(autoPersist);
+        partition->secondaryIndex.setAutoPersist(autoPersist);
+        auto grown = make_shared<TableShards>(*shards);
+        auto position = lower_bound(grown->begin(), grown->end(), month,
+                                    [](const shared_ptr<TableShard> &shard, const string &month) {
+                                        return shard->partition < month;
+                                    });
+        grown->insert(position, partition);
+        layout.store(grown);
+        return *partition;
+    }
+
+    // Shard a new record goes to: by the hash of its ID, or the partition of its date's month.
+    TableShard &shardForNew(const string &id, const string &date) {
+        return monthPartitioned ? partitionFor(monthOfDate(date)) : shardFor(id);
+    }
+
+    // The shards of a layout that can hold dates from `fromDate` to `toDate` (either may be empty
+    // for no bound): the month partitions of that range plus the undated one, or all hash shards.
+    // Archived partitions among them are decompressed. Other partitions are not opened at all.
+    TableShards shardsForDates(const TableShards &shards, const string &fromDate, const string &toDate) const {
+        string fromMonth = monthOfDate(fromDate), toMonth = monthOfDate(toDate);
+        TableShards selected;
+        for (const auto &shard : shards) {
+            if (monthPartitioned && shard->partition != undatedPartition &&
+                ((fromMonth != undatedPartition && shard->partition < fromMonth) ||
+                 (toMonth != undatedPartition && shard->partition > toMonth))) {
+                continue;
+            }
+            thawPartition(*shard);
+            selected.push_back(shard);
         }
+        return selected;
+    }
 
-        // Generate a new unique ID for the appointment
-        appointment.id = appointmentPrimaryIndex.getNewId();
+    // Every shard of the current layout, with archived partitions decompressed, for full scans.
+    TableShards readableShards() const {
+        return shardsForDates(*currentShards(), "", "");
+    }
 
+    // Generates a new unique ID, one past the largest ID of all shards.
+    string newAppointmentId() {
+        lock_guard<mutex> lock(idMutex);
+        if (largestId < 0) {
+            largestId = 0;
+            for (const auto &shard : *currentShards()) {
+                largestId = max(largestId, shard->primaryIndex.getLargestId());
+            }
+        }
+        int newId = ++largestId;
+        return (newId < 10) ? "0" + to_string(newId) : to_string(newId); // Ensure two-digit IDs
+    }
+
+    // Writes an appointment record to the best fitting free slot, or at the end of the data file,
+    // without indexing it; returns its offset, or -1 if it could not be written. The caller holds
+    // the shard's lock exclusively.
+    int writeAppointmentRecord(TableShard &shard, const Appointment &appointment) {
         // Open the appointments file for reading and writing
-        fstream file("appointments.txt", ios::in | ios::out);
+        fstream file(shard.dataFileName, ios::in | ios::out);
         if (!file.is_open()) {
-            cerr << "Error: Could not open appointments.txt\n";
-            return;
+            cerr << "Error: Could not open " << shard.dataFileName << "\n";
+            return -1;
         }
+        countStat(StatCounter::FileOpens);
 
         // Calculate the size of the new appointment record
         int recordSize = appointment.id.size() + appointment.date.size() +
                          appointment.doctorID.size() + 4;
 
         // Attempt to find a suitable space in the availability list
-        AvailListNode *availableNode = appointmentAvailList.bestFit(recordSize);
+        AvailListNode *availableNode = shard.availList.bestFit(recordSize);
 
         string newRecord;
         int offset; // Offset where the record will be written
@@ -99,15 +211,17 @@ public:
             } else {
                 cerr << "Error: Record size exceeds available space.\n";
                 file.close();
-                return;
+                return -1;
             }
 
             newRecord += '\n';
             file.write(newRecord.c_str(), availableNode->size);
             offset = availableNode->offset;
+            countStat(StatCounter::Seeks, 2);
+            countStat(StatCounter::BytesWritten, 1 + availableNode->size);
 
             // Remove the node from the availability list
-            appointmentAvailList.remove(availableNode);
+            shard.availList.remove(availableNode);
         } else {
             // If no suitable space is available, append the record to the end of the file
             newRecord += " |";
@@ -120,38 +234,174 @@ public:
             file.seekp(0, ios::end);
             offset = static_cast<int>(file.tellp());
             file.write(newRecord.c_str(), newRecord.size());
+            countStat(StatCounter::Seeks);
+            countStat(StatCounter::BytesWritten, newRecord.size());
         }
+        file.close();
+        return offset;
+    }
 
-        cout << "Appointment with ID " << stoi(appointment.id) << " has been added.\n";
+    // Reports why a change was refused: to `error` if given, else as a confirmation (to the
+    // console unless redirected). Returns false.
+    static bool refuse(string *error, const string &reason) {
+        if (error != nullptr) *error = reason;
+        else confirm("Error: " + reason);
+        return false;
+    }
 
-        file.close();
+    // Writes a new appointment record with an already assigned ID and indexes it; the caller
+    // holds the shard's lock exclusively. Returns false if the data file could not be written.
+    bool addAppointmentRecord(TableShard &shard, Appointment &appointment) {
+        int offset = writeAppointmentRecord(shard, appointment);
+        if (offset == -1) return false;
+
+        countStat(StatCounter::AppointmentAdds);
+        confirm("Appointment with ID " + to_string(stoi(appointment.id)) + " has been added.");
 
         // Update indexes
-        appointmentPrimaryIndex.addPrimaryNode(appointment.id, offset);
-        appointmentSecondaryIndex.addPrimaryKeyToSecondaryNode(appointment.doctorID, appointment.id);
+        shard.primaryIndex.addPrimaryNode(appointment.id, offset);
+        shard.secondaryIndex.addPrimaryKeyToSecondaryNode(appointment.doctorID, appointment.id);
+        scheduleAppointment(appointment.id, appointment.date, appointment.doctorID);
+        notifyChange({"appointments", {{"id", appointment.id}, {"date", appointment.date},
+                                       {"doctorid", appointment.doctorID}}});
+        return true;
+    }
+
+    // Adds an appointment to its doctor's schedule if its date has a time. The doctor ID of a
+    // record may carry padding from older in-place date updates, which is dropped.
+    void scheduleAppointment(const string &id, const string &date, string doctorID) {
+        TimeInterval interval;
+        if (!parseAppointmentTime(date, interval)) return;
+        doctorID.erase(remove(doctorID.begin(), doctorID.end(), '-'), doctorID.end());
+        schedule.add(doctorID, id, interval);
+    }
+
+    // Removes an appointment from its doctor's schedule (no-op for untimed dates)
+    void unscheduleAppointment(const string &id, const string &date, string doctorID) {
+        TimeInterval interval;
+        if (!parseAppointmentTime(date, interval)) return;
+        doctorID.erase(remove(doctorID.begin(), doctorID.end(), '-'), doctorID.end());
+        schedule.remove(doctorID, id, interval);
+    }
+
+    // Fills the schedule from the appointment records of every shard except sealed partitions.
+    void loadSchedule() {
+        schedule.clear();
+        TableShards unsealed;
+        for (const auto &shard : *currentShards()) {
+            if (!shard->sealed) unsealed.push_back(shard);
+        }
+        vector<ScanMatch> timed = scanShards(unsealed, [](string_view *fields, int fieldCount) {
+            TimeInterval interval;
+            return fieldCount >= 5 && parseAppointmentTime(string(fields[3]), interval);
+        });
+        string_view fields[5];
+        for (const ScanMatch &match : timed) {
+            splitRecordFields(match.line, fields, 5);
+            scheduleAppointment(string(fields[2]), string(fields[3]), string(fields[4]));
+        }
     }
 
-    // Function to update an appointment's date
-    void updateAppointmentDate(const string &appointmentID, string &newDate) {
+    // Marks an appointment record as deleted and unindexes it; the caller holds the shard's lock
+    // exclusively. The deleted record's fields are stored in `deleted` if given.
+    void deleteAppointmentRecord(TableShard &shard, const string &id, Appointment *deleted = nullptr) {
+        // Locate the appointment in the primary index using its ID
+        int offset = shard.primaryIndex.binarySearchPrimaryIndex(id);
+        if (offset == -1) {
+            // If the appointment ID is not found, display an error message and exit
+            confirm("Appointment with ID " + id + " not found.");
+            return;
+        }
+
+        // Open the appointments file for reading and writing
+        fstream appointmentFile(shard.dataFileName, ios::in | ios::out);
+        if (!appointmentFile.is_open()) {
+            cerr << "Error opening file: " << shard.dataFileName << "\n";
+            return;
+        }
+
+        // Navigate to the location of the record in the file and read its content
+        appointmentFile.seekg(offset, ios::beg);
+        string line;
+        getline(appointmentFile, line); // Read the full record
+
+        // Keep the old version for open snapshots, then mark the record as deleted by
+        // writing '*' to the status field
+        shard.versions.preserve(id, line);
+        appointmentFile.seekp(offset, ios::beg);
+        appointmentFile.put('*');
+        countStat(StatCounter::FileOpens);
+        countStat(StatCounter::Seeks, 2);
+        countStat(StatCounter::BytesRead, line.size() + 1);
+        countStat(StatCounter::BytesWritten, 1);
+        countStat(StatCounter::AppointmentDeletes);
+
+        // Parse the record fields
+        istringstream recordStream(line);
+        string status, recordLen, record_id, date, doctorID;
+
+        getline(recordStream, status, '|');       // Read the status field
+        getline(recordStream, recordLen, '|');   // Read the record length
+        getline(recordStream, record_id, '|');   // Read the appointment ID
+        getline(recordStream, date, '|');        // Read the appointment date
+        getline(recordStream, doctorID, '|');    // Read the doctor ID
+
+        // Convert the record length from string to an integer
+        int lengthIndicator = stoi(recordLen);
+
+        // Display a confirmation message
+        confirm("Appointment with ID " + to_string(stoi(id)) + " has been marked as deleted.");
+
+        // Close the file after marking the record
+        appointmentFile.close();
+
+        // Add the space of the deleted record to the availability list
+        AvailListNode *newNode = new AvailListNode(offset, lengthIndicator);
+        shard.availList.insert(newNode);
+
+        // Remove the appointment from the primary and secondary indexes
+        shard.primaryIndex.removePrimaryNode(id);
+        shard.secondaryIndex.removePrimaryKeyFromSecondaryNode(doctorID, id);
+        unscheduleAppointment(id, date, doctorID);
+        notifyChange({"appointments", {{"id", id}, {"date", date}, {"doctorid", doctorID}}});
+        if (deleted != nullptr) {
+            deleted->id = record_id;
+            deleted->date = date;
+            deleted->doctorID = doctorID;
+        }
+    }
+
+    // Changes an appointment's date. The caller holds exclusively the lock of `shard`, which holds
+    // the appointment, and of `target`, the shard the new date belongs in: the same shard unless
+    // the appointments are partitioned by month. The record is changed in place if the new date
+    // fits in its slot and stays in its partition. Otherwise it is written to `target` under the
+    // same ID and its old slot goes to the availability list, so the ID stays valid. Returns false
+    // if the ID is not indexed or a data file could not be opened. The previous date is stored in
+    // `oldDateOut` if given.
+    bool redateAppointmentRecord(TableShard &shard, TableShard &target, const string &appointmentID,
+                                 const string &newDate, string *oldDateOut = nullptr) {
         // Find the appointment's record offset in the primary index
-        int offset = appointmentPrimaryIndex.binarySearchPrimaryIndex(appointmentID);
+        int offset = shard.primaryIndex.binarySearchPrimaryIndex(appointmentID);
 
         if (offset == -1) {
             cerr << "Error: Appointment ID not found in primary index.\n";
-            return;
+            return false;
         }
 
         // Open the appointments file for reading and updating
-        fstream appointmentFile("appointments.txt", ios::in | ios::out | ios::binary);
+        fstream appointmentFile(shard.dataFileName, ios::in | ios::out | ios::binary);
         if (!appointmentFile.is_open()) {
-            cerr << "Error: Could not open appointments.txt file.\n";
-            return;
+            cerr << "Error: Could not open " << shard.dataFileName << " file.\n";
+            return false;
         }
 
         // Move to the record's offset and read its content
         appointmentFile.seekg(offset, ios::beg);
         string line;
         getline(appointmentFile, line);
+        countStat(StatCounter::FileOpens);
+        countStat(StatCounter::Seeks);
+        countStat(StatCounter::BytesRead, line.size() + 1);
 
         // Parse the record
         istringstream recordStream(line);
@@ -164,113 +414,594 @@ public:
 
         // Calculate the new record size
         int newSize = newDate.size() + id.size() + doctorID.size() + 4; // 4 is for the separators
-
-        if (newSize <= stoi(recordLen)) {
-            // Update the appointment date directly if it fits in the same space
+        if (newSize > stoi(recordLen) || &target != &shard) {
+            // Write the moved record first; until it is indexed, readers still find the old one
+            Appointment moved;
+            moved.id = id;
+            moved.date = newDate;
+            moved.doctorID = doctorID;
+            int newOffset = writeAppointmentRecord(target, moved);
+            if (newOffset == -1) return false;
+
+            // Keep the old version for open snapshots, then free the old slot
+            shard.versions.preserve(id, line);
+            appointmentFile.seekp(offset, ios::beg);
+            appointmentFile.put('*');
+            appointmentFile.close();
+            countStat(StatCounter::Seeks);
+            countStat(StatCounter::BytesWritten, 1);
+            shard.availList.insert(new AvailListNode(offset, stoi(recordLen)));
+            if (&target == &shard) {
+                shard.primaryIndex.updatePrimaryNodeOffset(id, newOffset);
+            } else {
+                // Index the record in its new partition before unindexing it in the old one, so
+                // a lock-free lookup finds it in one of them at every moment
+                target.primaryIndex.addPrimaryNode(id, newOffset);
+                target.secondaryIndex.addPrimaryKeyToSecondaryNode(doctorID, id);
+                shard.primaryIndex.removePrimaryNode(id);
+                shard.secondaryIndex.removePrimaryKeyFromSecondaryNode(doctorID, id);
+            }
+        } else {
+            // Update the appointment date directly, keeping the old version for open snapshots
+            shard.versions.preserve(id, line);
             appointmentFile.seekp(offset + status.size() + 1 + recordLen.size() + 1 + id.size() + 1, ios::beg);
-            appointmentFile << newDate << '|';
+            appointmentFile << newDate << '|' << doctorID << '|';  // The doctor ID moves with the date
 
             // Add padding if necessary
             int excess = stoi(recordLen) - newSize;
             for (int i = 0; i < excess; ++i) {
                 appointmentFile << '-';
             }
-        } else {
-            // If the new date is too long, delete the old appointment and add a new one
-            deleteAppointment(id);  // Delete the existing appointment
+            appointmentFile.close();
+            countStat(StatCounter::Seeks);
+            countStat(StatCounter::BytesWritten, newDate.size() + doctorID.size() + 2 + excess);
+        }
+        countStat(StatCounter::AppointmentUpdates);
+        unscheduleAppointment(id, oldDate, doctorID);
+        scheduleAppointment(id, newDate, doctorID);
+        notifyChange({"appointments", {{"id", id}, {"date", oldDate}, {"date", newDate}, {"doctorid", doctorID}}});
+        if (oldDateOut != nullptr) *oldDateOut = oldDate;
+        return true;
+    }
 
-            Appointment newAppointment;
-            newAppointment.id = appointmentPrimaryIndex.getNewId();
-            newAppointment.date = newDate;
-            newAppointment.doctorID = doctorID;
-            addAppointment(newAppointment);  // Re-add the new appointment
+    // Shard that an appointment of `shard` moves to when its date changes to `newDate`: the
+    // partition of the new month (created if needed), or the shard itself.
+    TableShard &redateTarget(TableShard &shard, const string &newDate) {
+        return monthPartitioned ? partitionFor(monthOfDate(newDate)) : shard;
+    }
 
-            cout << "Appointment date updated successfully.\n";
-            appointmentFile.close();
-            return;
+public:
+    // Constructor: Opens the appointment shards or month partitions of the current layout and loads
+    // their indexes. Registers the appointments with the doctor system as the records that refer
+    // to doctors.
+    AppointmentManagementSystem(DoctorManagementSystem &doctorSys)
+            : doctorSystem(doctorSys), monthPartitioned(monthPartitionedLayout()),
+              layout(make_shared<TableShards>(monthPartitioned ? openMonthPartitions(appointmentFileNames)
+                                                               : openTableShards(appointmentFileNames))) {
+        doctorSystem.setReferences({[this](const string &doctorID) { return searchAppointmentsByDoctorID(doctorID); },
+                                    [this](const string &doctorID) { deleteAppointmentsOfDoctor(doctorID); },
+                                    [this](const string &doctorID) {
+                                        return countSealedAppointmentsOfDoctor(doctorID);
+                                    }});
+        loadSchedule();
+    }
+
+    ~AppointmentManagementSystem() {
+        doctorSystem.setReferences({});
+        for (const auto &shard : *currentShards()) {
+            dropThawedCopy(*shard);
         }
+    }
 
-        cout << "Appointment date updated successfully.\n";
-        appointmentFile.close();
+    // Number of shards or month partitions the appointments are partitioned into.
+    size_t shardCount() const {
+        return currentShards()->size();
     }
 
-    // Deletes an appointment by marking it as deleted in the file,
-    void deleteAppointment(const string &id) {
-        // Locate the appointment in the primary index using its ID
-        int offset = appointmentPrimaryIndex.binarySearchPrimaryIndex(id);
-        if (offset == -1) {
-            // If the appointment ID is not found, display an error message and exit
-            cout << "Appointment with ID " << id << " not found.\n";
-            return;
+    // Every shard or month partition of the current layout, archived ones left as they are, for
+    // whole-table maintenance such as the memory budget.
+    TableShards allShards() const {
+        return *currentShards();
+    }
+
+    // Why appointment `id` (if given) cannot be changed or deleted, or an appointment cannot be
+    // added or moved to `date` (if given): a sealed month partition. Empty if it can.
+    string sealedError(const string &id, const string &date) const {
+        if (!monthPartitioned) return "";
+        TableShard *partition = id.empty() ? nullptr : &shardFor(id);
+        if (partition != nullptr && partition->sealed && partition->primaryIndex.binarySearchPrimaryIndex(id) != -1) {
+            return "Appointments of " + partition->partition + " are sealed and cannot be changed.";
         }
+        partition = date.empty() ? nullptr : findPartition(monthOfDate(date));
+        if (partition != nullptr && partition->sealed) {
+            return "Appointments of " + partition->partition + " are sealed and cannot be changed.";
+        }
+        return "";
+    }
 
-        // Open the appointments file for reading and writing
-        fstream appointmentFile("appointments.txt", ios::in | ios::out);
-        if (!appointmentFile.is_open()) {
-            cerr << "Error opening file: appointments.txt\n";
-            return;
+    // Checks whether an appointment ID exists. Lock-free: the primary index is read without tableMutex.
+    bool appointmentExists(const string &id) const {
+        return shardFor(id).primaryIndex.binarySearchPrimaryIndex(id) != -1;
+    }
+
+    // Number of appointments.
+    size_t countAppointments() const {
+        size_t count = 0;
+        for (const auto &shard : *currentShards()) {
+            count += shard->primaryIndex.size();
         }
+        return count;
+    }
 
-        // Navigate to the location of the record in the file
-        appointmentFile.seekp(offset, ios::beg);
+    // Enables or disables writing the index files after every operation; when disabled, call flush().
+    void setAutoPersist(bool enabled) {
+        lock_guard<mutex> layoutLock(layoutMutex);
+        autoPersist = enabled;
+        for (auto &shard : *currentShards()) {
+            unique_lock<shared_mutex> lock(shard->tableMutex);
+            shard->primaryIndex.setAutoPersist(enabled);
+            shard->availList.setAutoPersist(enabled);
+            shard->secondaryIndex.setAutoPersist(enabled);
+        }
+    }
 
-        // Mark the record as deleted by writing '*' to the status field
-        appointmentFile.put('*');
+    // Registers an observer that is called after every add, update and delete; returns its handle.
+    int addChangeListener(TableChangeListener listener) {
+        lock_guard<mutex> lock(listenerMutex);
+        changeListeners.emplace_back(nextListenerId, std::move(listener));
+        return nextListenerId++;
+    }
 
-        // Return to the beginning of the record to read its content
-        appointmentFile.seekg(-1, ios::cur);
-        string line;
-        getline(appointmentFile, line); // Read the full record
+    // Unregisters an observer by the handle addChangeListener returned.
+    void removeChangeListener(int listenerId) {
+        lock_guard<mutex> lock(listenerMutex);
+        changeListeners.erase(remove_if(changeListeners.begin(), changeListeners.end(),
+                                        [listenerId](const auto &listener) { return listener.first == listenerId; }),
+                              changeListeners.end());
+    }
 
-        // Parse the record fields
-        istringstream recordStream(line);
-        string status, recordLen, record_id, date, doctorID;
+    // Writes pending index changes to their files.
+    void flush() {
+        for (auto &shard : *currentShards()) {
+            unique_lock<shared_mutex> lock(shard->tableMutex);
+            shard->primaryIndex.flush();
+            shard->availList.flush();
+            shard->secondaryIndex.flush();
+        }
+    }
 
-        getline(recordStream, status, '|');       // Read the status field
-        getline(recordStream, recordLen, '|');   // Read the record length
-        getline(recordStream, record_id, '|');   // Read the appointment ID
-        getline(recordStream, date, '|');        // Read the appointment date
-        getline(recordStream, doctorID, '|');    // Read the doctor ID
+    // Seals the month partitions before `month` ("YYYY-MM"), archiving them if `archive` is set;
+    // returns how many partitions were sealed or archived now. Each partition is locked
+    // exclusively while it is sealed. Meant for the offline --seal-months mode, with no snapshot open.
+    size_t sealPartitionsBefore(const string &month, bool archive) {
+        size_t changed = 0;
+        if (!monthPartitioned) return changed;
+        for (auto &shard : *currentShards()) {
+            if (shard->partition == undatedPartition || shard->partition >= month) continue;
+            if (shard->sealed && (!archive || shard->archived)) continue;
+            unique_lock<shared_mutex> lock(shard->tableMutex);
+            if (sealPartition(*shard, archive)) {
+                ++changed;
+            } else {
+                cerr << "Error sealing partition: " << shard->partition << "\n";
+            }
+        }
+        return changed;
+    }
 
-        // Convert the record length from string to an integer
-        int lengthIndicator = stoi(recordLen);
+    // Adds a new appointment to the system. Returns false if it was not added; why goes to
+    // `error` if given, else to the console. The checks run under the locks that keep them
+    // valid until the record is in.
+    bool addAppointment(Appointment &appointment, string *error = nullptr) {
+        LatencyTimer timer(TimedOperation::AddAppointment);
+        // Validate that the doctor exists, and keep it from being deleted until the appointment is
+        // in (the doctor's lock is taken before our own)
+        shared_lock<shared_mutex> doctorLock = doctorSystem.lockDoctorShared(appointment.doctorID);
+        if (!doctorSystem.doctorExists(appointment.doctorID)) {
+            return refuse(error, "Doctor ID " + appointment.doctorID + " does not exist. Cannot add appointment.");
+        }
 
-        // Display a confirmation message
-        cout << "Appointment with ID " << stoi(id) << " has been marked as deleted.\n";
+        // Reject a time that overlaps one of the doctor's appointments; the stripe keeps a
+        // concurrent booking for the doctor from passing the same check before this one is in
+        unique_lock<mutex> bookingLock = bookingLocks.lock(appointment.doctorID);
+        string conflict = bookingConflict(appointment.doctorID, appointment.date);
+        if (conflict.empty()) conflict = sealedError("", appointment.date);
+        if (!conflict.empty()) return refuse(error, conflict);
+
+        // Generate a new unique ID for the appointment; it decides the shard (or the date decides
+        // the month partition)
+        appointment.id = newAppointmentId();
+        TableShard &shard = shardForNew(appointment.id, appointment.date);
+        unique_lock<shared_mutex> lock(shard.tableMutex);
+        if (!addAppointmentRecord(shard, appointment)) return refuse(error, "Appointment could not be added.");
+        return true;
+    }
 
-        // Close the file after marking the record
-        appointmentFile.close();
+    // Function to update an appointment's date. Returns false if the appointment does not exist,
+    // the new time overlaps another appointment of its doctor or its partition is sealed; why
+    // goes to `error` if given, else to the console.
+    bool updateAppointmentDate(const string &appointmentID, const string &newDate, string *error = nullptr) {
+        LatencyTimer timer(TimedOperation::UpdateAppointmentDate);
+        // The doctor decides the booking stripe; an appointment's doctor never changes
+        Appointment current;
+        if (!readAppointment(appointmentID, current)) {
+            return refuse(error, "Appointment with ID " + appointmentID + " not found.");
+        }
+        unique_lock<mutex> bookingLock = bookingLocks.lock(current.doctorID);
+        string conflict = bookingConflict(current.doctorID, newDate, appointmentID);
+        if (conflict.empty()) conflict = sealedError(appointmentID, newDate);
+        if (!conflict.empty()) return refuse(error, conflict);
+
+        // A record that moves to another month partition needs both partitions' locks, taken at
+        // once; each touched index is persisted once for the whole change
+        TableShard &shard = shardFor(appointmentID);
+        TableShard &target = redateTarget(shard, newDate);
+        bool updated;
+        if (&shard == &target) {
+            unique_lock<shared_mutex> lock(shard.tableMutex);
+            ShardChangeGroup group(shard);
+            updated = redateAppointmentRecord(shard, target, appointmentID, newDate);
+        } else {
+            scoped_lock locks(shard.tableMutex, target.tableMutex);
+            ShardChangeGroup sourceGroup(shard), targetGroup(target);
+            updated = redateAppointmentRecord(shard, target, appointmentID, newDate);
+        }
+        if (!updated) return refuse(error, "Appointment date could not be updated.");
+        confirm("Appointment date updated successfully.");
+        return true;
+    }
 
-        // Add the space of the deleted record to the availability list
-        AvailListNode *newNode = new AvailListNode(offset, lengthIndicator);
-        appointmentAvailList.insert(newNode);
+    // Why `date` cannot be booked for a doctor, or an empty string if it can: an untimed date, or
+    // a time that overlaps none of the doctor's appointments other than `ignoredId`. Checked in
+    // O(log n + k) on the doctor's schedule.
+    string bookingConflict(const string &doctorID, const string &date, const string &ignoredId = "") const {
+        TimeInterval interval;
+        if (!parseAppointmentTime(date, interval)) return "";
+        vector<pair<string, TimeInterval>> conflicts = schedule.conflicts(doctorID, interval, ignoredId);
+        if (conflicts.empty()) return "";
+        return bookingConflictMessage(doctorID, conflicts.front().first, conflicts.front().second);
+    }
 
-        // Remove the appointment from the primary and secondary indexes
-        appointmentPrimaryIndex.removePrimaryNode(id);
-        appointmentSecondaryIndex.removePrimaryKeyFromSecondaryNode(doctorID, id);
+    // The doctor's appointments overlapping `interval`, except `ignoredId`, as (ID, interval).
+    vector<pair<string, TimeInterval>> conflictingAppointments(const string &doctorID, const TimeInterval &interval,
+                                                               const string &ignoredId = "") const {
+        return schedule.conflicts(doctorID, interval, ignoredId);
+    }
+
+    // The gaps between a doctor's timed appointments inside `window`, e.g. one day.
+    vector<TimeInterval> freeSlots(const string &doctorID, const TimeInterval &window) const {
+        return schedule.freeSlots(doctorID, window);
+    }
+
+    // Deletes an appointment by marking it as deleted in the file. Returns false if it was not
+    // deleted; why goes to `error` if given, else to the console.
+    bool deleteAppointment(const string &id, string *error = nullptr) {
+        LatencyTimer timer(TimedOperation::DeleteAppointment);
+        string sealed = sealedError(id, "");
+        if (!sealed.empty()) return refuse(error, sealed);
+        TableShard &shard = shardFor(id);
+        unique_lock<shared_mutex> lock(shard.tableMutex);
+        if (shard.primaryIndex.binarySearchPrimaryIndex(id) == -1) {
+            return refuse(error, "Appointment with ID " + id + " not found.");
+        }
+        Appointment deleted;
+        deleteAppointmentRecord(shard, id, &deleted);
+        if (deleted.id.empty()) return refuse(error, "Appointment could not be deleted.");
+        return true;
+    }
+
+    // Transactions (Transaction.h) stage their changes and apply them all at once while holding
+    // this lock: every appointment shard locked exclusively, with each index persisted once when
+    // the lock is released. Take the doctor system's lock first. The *Locked functions below may
+    // only be called while it is held.
+    unique_ptr<TableWriteLock> lockForWrite() {
+        return make_unique<TableWriteLock>(*currentShards());
+    }
+
+    // The booking stripes of the doctors a transaction books or moves appointments for: taken
+    // after the doctor system's lock and before lockForWrite, they keep the transaction's conflict
+    // checks valid until its changes are applied.
+    vector<unique_lock<mutex>> lockBookings(const set<string> &doctorIDs) {
+        return bookingLocks.lock(doctorIDs);
+    }
+
+    // Hands out an appointment ID now for a record a transaction adds later; an ID of an aborted
+    // transaction is not reused.
+    string reserveAppointmentId() {
+        return newAppointmentId();
+    }
+
+    // Adds an appointment whose ID was reserved with reserveAppointmentId, or re-adds a deleted
+    // one under its old ID; the transaction has checked its doctor (lockForWrite held). Returns
+    // false if the record could not be written.
+    bool addAppointmentLocked(Appointment &appointment) {
+        return addAppointmentRecord(shardForNew(appointment.id, appointment.date), appointment);
+    }
+
+    // Updates an appointment's date; the appointment keeps its ID (lockForWrite held, and
+    // preparePartitions called for the new date). The previous date is stored in `oldDate` if
+    // given. Returns false if the date was not updated.
+    bool updateAppointmentDateLocked(const string &appointmentID, const string &newDate, string *oldDate = nullptr) {
+        TableShard &shard = shardFor(appointmentID);
+        if (!redateAppointmentRecord(shard, redateTarget(shard, newDate), appointmentID, newDate, oldDate)) {
+            return false;
+        }
+        confirm("Appointment date updated successfully.");
+        return true;
+    }
+
+    // Creates the month partitions that appointments with `dates` go to. A transaction calls it
+    // before lockForWrite, which locks only the partitions that exist.
+    void preparePartitions(const vector<string> &dates) {
+        if (!monthPartitioned) return;
+        for (const string &date : dates) {
+            partitionFor(monthOfDate(date));
+        }
+    }
+
+    // Deletes an appointment (lockForWrite held). The deleted record is stored in `deleted` if
+    // given. Returns false if the appointment was not deleted.
+    bool deleteAppointmentLocked(const string &id, Appointment *deleted = nullptr) {
+        Appointment record;
+        deleteAppointmentRecord(shardFor(id), id, &record);
+        if (deleted != nullptr) *deleted = record;
+        return !record.id.empty();
+    }
+
+    // Deletes every appointment of a doctor in one batch: all shards are locked and each index
+    // structure is persisted once. Used by the doctor system's ON DELETE CASCADE.
+    void deleteAppointmentsOfDoctor(const string &doctorID) {
+        unique_ptr<TableWriteLock> lock = lockForWrite();
+        deleteAppointmentsOfDoctorLocked(doctorID);
+    }
+
+    // IDs of a doctor's appointments, found through the secondary index posting lists
+    // (lockForWrite held).
+    vector<string> appointmentsOfDoctorLocked(const string &doctorID) {
+        vector<string> appointmentIds;
+        for (auto &shard : *currentShards()) {
+            vector<string> shardIds = shard->secondaryIndex.getPrimaryKeysBySecondaryKey(doctorID);
+            appointmentIds.insert(appointmentIds.end(), shardIds.begin(), shardIds.end());
+        }
+        return appointmentIds;
+    }
+
+    // Number of a doctor's appointments in sealed month partitions. They are history that no longer
+    // changes, so ON DELETE CASCADE cannot delete them and the doctor must be kept. `locked`:
+    // lockForWrite is held, so the shards are read without taking their tableMutex.
+    size_t countSealedAppointmentsOfDoctor(const string &doctorID, bool locked = false) {
+        size_t count = 0;
+        for (auto &shard : *currentShards()) {
+            if (!shard->sealed) continue;
+            shared_lock<shared_mutex> lock(shard->tableMutex, defer_lock);
+            if (!locked) lock.lock();
+            count += shard->secondaryIndex.getPrimaryKeysBySecondaryKey(doctorID).size();
+        }
+        return count;
+    }
+
+    // Deletes every appointment of a doctor (lockForWrite held). The deleted records are appended
+    // to `deleted` if given. Returns false if one of them could not be deleted, including one in a
+    // sealed month partition (callers refuse such deletes first: countSealedAppointmentsOfDoctor).
+    bool deleteAppointmentsOfDoctorLocked(const string &doctorID, vector<Appointment> *deleted = nullptr) {
+        bool allDeleted = true;
+        for (auto &shard : *currentShards()) {
+            if (shard->sealed) {
+                if (!shard->secondaryIndex.getPrimaryKeysBySecondaryKey(doctorID).empty()) allDeleted = false;
+                continue;
+            }
+            for (const string &id : shard->secondaryIndex.getPrimaryKeysBySecondaryKey(doctorID)) {
+                Appointment record;
+                deleteAppointmentRecord(*shard, id, &record);
+                if (record.id.empty()) allDeleted = false;
+                else if (deleted != nullptr) deleted->push_back(record);
+            }
+        }
+        return allDeleted;
     }
 
     // Searches for appointments associated with a specific doctor ID
     vector<string> searchAppointmentsByDoctorID(const string &doctorID) {
-        // Use the secondary index to find all appointments associated with the doctor ID
-        vector<string> appointmentIds = appointmentSecondaryIndex.getPrimaryKeysBySecondaryKey(doctorID);
+        LatencyTimer timer(TimedOperation::SearchAppointmentsByDoctorID);
+        // Use the secondary indexes to find all appointments associated with the doctor ID
+        vector<string> appointmentIds;
+        shared_ptr<TableShards> shards = currentShards();
+        for (auto &shard : *shards) {
+            shared_lock<shared_mutex> lock(shard->tableMutex);
+            vector<string> shardIds = shard->secondaryIndex.getPrimaryKeysBySecondaryKey(doctorID);
+            appointmentIds.insert(appointmentIds.end(), shardIds.begin(), shardIds.end());
+        }
+        if (shards->size() > 1) sort(appointmentIds.begin(), appointmentIds.end());
         return appointmentIds; // Return the list of appointment IDs
     }
 
+    // Counts the appointments of a doctor from the secondary index posting lists,
+    // without reading the appointments files
+    int countAppointmentsByDoctorID(const string &doctorID) {
+        int count = 0;
+        for (auto &shard : *currentShards()) {
+            shared_lock<shared_mutex> lock(shard->tableMutex);
+            count += shard->secondaryIndex.countPrimaryKeysBySecondaryKey(doctorID);
+        }
+        return count;
+    }
+
+    // Reads an appointment record by ID; returns false if the ID is not indexed.
+    bool readAppointment(const string &id, Appointment &appointment) {
+        LatencyTimer timer(TimedOperation::ReadAppointment);
+        TableShard &shard = shardFor(id);
+        thawPartition(shard);
+        shared_lock<shared_mutex> lock(shard.tableMutex);
+        int offset = shard.primaryIndex.binarySearchPrimaryIndex(id);
+        if (offset == -1) {
+            return false;
+        }
+
+        ifstream file(shard.dataFileName, ios::in);
+        if (!file.is_open()) {
+            cerr << "Error opening file: " << shard.dataFileName << "\n";
+            return false;
+        }
+
+        // Navigate to the offset and parse the record
+        file.seekg(offset, ios::beg);
+        string line;
+        getline(file, line);
+        countStat(StatCounter::FileOpens);
+        countStat(StatCounter::Seeks);
+        countStat(StatCounter::BytesRead, line.size() + 1);
+        countStat(StatCounter::AppointmentReads);
+        istringstream recordStream(line);
+        string status, length;
+        getline(recordStream, status, '|');               // Read status field
+        getline(recordStream, length, '|');               // Read length field
+        getline(recordStream, appointment.id, '|');       // Read appointment ID
+        getline(recordStream, appointment.date, '|');     // Read date field
+        getline(recordStream, appointment.doctorID, '|'); // Read doctor ID
+        return true;
+    }
+
+    // Reads several appointment records with one batch of I/O per shard. The result is in the order
+    // of `ids`; appointments that are not indexed come back with an empty ID.
+    vector<Appointment> readAppointments(const vector<string> &ids) {
+        LatencyTimer timer(TimedOperation::ReadAppointments);
+        vector<Appointment> appointments(ids.size());
+        vector<int> offsets;
+        vector<string> lines;
+        TableShards shards = readableShards();
+        if (!readShardRecordLines(shards, ids, offsets, lines,
+                                  [&](const string &id) { return shardIndexOf(shards, id); })) {
+            cerr << "Error opening file: appointments.txt\n";
+        }
+        string_view fields[5];
+        for (size_t i = 0; i < lines.size(); ++i) {
+            if (splitRecordFields(lines[i], fields, 5) < 5) continue;
+            Appointment &appointment = appointments[i];
+            appointment.id = fields[2];
+            appointment.date = fields[3];
+            appointment.doctorID = fields[4];
+        }
+        return appointments;
+    }
+
+    // Rebuilds the appointment indexes and free lists from the data files, reporting how the loaded
+    // ones differed. Each shard is locked exclusively while it is rebuilt.
+    RebuildReport rebuildIndexes() {
+        TableShards shards = readableShards();
+        function<string(string_view *)> partitionOf;
+        if (monthPartitioned) {
+            // A record belongs to the partition of its date's month (padding is not part of it)
+            partitionOf = [](string_view *fields) {
+                string_view date = fields[3];
+                return monthOfDate(date.substr(0, date.find_last_not_of('-') + 1));
+            };
+        }
+        RebuildReport report = rebuildTableIndexes(shards, "appointments", [](string_view *fields) {
+            // Fields: status, length, ID, date, doctor ID. Older in-place date updates padded over
+            // the start of the doctor ID, so padding is dropped from it.
+            string doctorID(fields[4]);
+            doctorID.erase(remove(doctorID.begin(), doctorID.end(), '-'), doctorID.end());
+            return doctorID;
+        }, partitionOf);
+        {
+            lock_guard<mutex> lock(idMutex);
+            largestId = -1;  // Recomputed from the rebuilt primary indexes
+        }
+        loadSchedule();
+        TableChange change{"appointments", {}};
+        change.wholeTable = true;
+        notifyChange(change);
+        return report;
+    }
+
+    // Opens a consistent point-in-time view of the appointments of a single-shard layout; reads
+    // through it take no lock. Use scanAppointments for any layout.
+    unique_ptr<TableSnapshot> openSnapshot() {
+        return currentShards()->front()->openSnapshot();
+    }
+
+    // Number of old record versions currently kept for open snapshots.
+    size_t savedVersionCount() const {
+        size_t count = 0;
+        for (const auto &shard : *currentShards()) {
+            count += shard->versions.savedVersions();
+        }
+        return count;
+    }
+
+    // Streams every active appointment record, in file order, to a visitor. The records come
+    // from one snapshot per shard, so concurrent updates and deletes neither tear nor mix into
+    // the scan; several shards are merged in primary-key order. Stops when the visitor
+    // returns false.
+    void scanAppointments(const function<bool(const Appointment &)> &visitor) {
+        LatencyTimer timer(TimedOperation::ScanAppointments);
+        Appointment appointment;
+        TableShards shards = readableShards();
+        forEachShardRecord(shards, [&](const string &line) {
+            istringstream recordStream(line);
+            string status, length;
+            getline(recordStream, status, '|');               // Read status field
+            getline(recordStream, length, '|');               // Read length field
+            getline(recordStream, appointment.id, '|');       // Read appointment ID
+            getline(recordStream, appointment.date, '|');     // Read date field
+            getline(recordStream, appointment.doctorID, '|'); // Read doctor ID
+
+            return visitor(appointment);
+        });
+    }
+
+    // Writes the fields of an appointment selected by `choice` as one result row:
+    // 0 = all fields, 1 = ID, 2 = date, 3 = doctor ID, anything else = multi-line details block.
+    void writeAppointmentRow(ResultSink &sink, string_view appointmentID, string_view date,
+                             string_view doctorID, int choice, string_view idLabel = "Appointment ID") {
+        bool block = choice < 0 || choice > 3;
+        sink.beginRow(block ? "Appointment Details:" : "");
+        if (choice != 2 && choice != 3) sink.idField(block ? "ID" : idLabel, appointmentID);
+        if (choice != 1 && choice != 3) sink.field("Date", date);
+        if (choice != 1 && choice != 2) sink.idField("Doctor ID", doctorID);
+        sink.endRow();
+    }
+
+    // Row of an appointment looked up by ID: as writeAppointmentRow, except that the details
+    // block shows the stored ID as is ("07"), as printAppointmentById always has.
+    void writeAppointmentByIdRow(ResultSink &sink, string_view appointmentID, string_view date,
+                                 string_view doctorID, int choice) {
+        if (choice >= 0 && choice <= 3) {
+            writeAppointmentRow(sink, appointmentID, date, doctorID, choice);
+            return;
+        }
+        sink.beginRow("Appointment Details:");
+        sink.field("ID", appointmentID);
+        sink.field("Date", date);
+        sink.idField("Doctor ID", doctorID);
+        sink.endRow();
+    }
+
     // Prints details of an appointment based on its ID.
     void printAppointmentById(const string &id, int choice) {
+        ResultSink sink;
+        printAppointmentById(id, choice, sink);
+    }
+
+    // Writes details of an appointment based on its ID to a result sink.
+    void printAppointmentById(const string &id, int choice, ResultSink &sink) {
+        LatencyTimer timer(TimedOperation::PrintAppointmentById);
+        TableShard &shard = shardFor(id);
+        thawPartition(shard);
+        shared_lock<shared_mutex> lock(shard.tableMutex);
+
         // Locate the appointment using its primary index
-        int offset = appointmentPrimaryIndex.binarySearchPrimaryIndex(id);
+        int offset = shard.primaryIndex.binarySearchPrimaryIndex(id);
         if (offset == -1) {
             // If the ID is not found, display an error message and exit
-            cout << "Appointment not found. The ID \"" << id << "\" is invalid.\n";
+            sink.message("Appointment not found. The ID \"" + id + "\" is invalid.");
             return;
         }
 
         // Open the appointments file for reading
-        fstream file("appointments.txt", ios::in);
+        fstream file(shard.dataFileName, ios::in);
         if (!file.is_open()) {
-            cout << "Error opening file: appointments.txt\n";
+            sink.message("Error opening file: appointments.txt");
             return;
         }
 
@@ -278,10 +1009,14 @@ public:
         file.seekg(offset, ios::beg);
         string line;
         getline(file, line);  // Read the complete record as a string
+        countStat(StatCounter::FileOpens);
+        countStat(StatCounter::Seeks);
+        countStat(StatCounter::BytesRead, line.size() + 1);
+        countStat(StatCounter::AppointmentReads);
 
         if (line.empty()) {
             // Handle the case where the record at the offset is empty
-            cout << "Error: Empty record at offset " << offset << ".\n";
+            sink.message("Error: Empty record at offset " + to_string(offset) + ".");
             file.close();
             return;
         }
@@ -298,152 +1033,122 @@ public:
 
         file.close();
 
-        // Remove any padding characters ('-') from the date field
-        string tempDate;
-        for (char c : date) {
-            if (c != '-') {
-                tempDate += c;
-            }
-        }
-        date = tempDate;
+        // Remove any padding characters ('-') from the end of the date field; hyphens inside the
+        // date ("2025-03-01 09:00-09:30") are part of it
+        date.erase(date.find_last_not_of('-') + 1);
 
         // Output the appointment details based on the user's choice
-        switch (choice) {
-            case 0:  // Print all appointment information
-                cout << "Appointment ID: " << stoi(appointmentID)
-                     << " | Date: " << date
-                     << " | Doctor ID: " << stoi(doctorID) << '\n';
-                break;
-            case 1:  // Print only the Appointment ID
-                cout << "Appointment ID: " << stoi(appointmentID) << '\n';
-                break;
-            case 2:  // Print only the Date
-                cout << "Date: " << date << '\n';
-                break;
-            case 3:  // Print only the Doctor ID
-                cout << "Doctor ID: " << stoi(doctorID) << '\n';
-                break;
-            default:  // Default to printing all information
-                cout << "Appointment Details:\n"
-                     << "  ID: " << appointmentID << '\n'
-                     << "  Date: " << date << '\n'
-                     << "  Doctor ID: " << stoi(doctorID) << '\n';
-                break;
-        }
+        writeAppointmentByIdRow(sink, appointmentID, date, doctorID, choice);
     }
 
-    // Prints all appointments matching a specific date.
-    void printAppointmentByDate(const string &dateComp, int choice) {
-        // Retrieve the primary index nodes in memory
-        const vector<PrimaryIndexNode>& primaryIndexNodes = appointmentPrimaryIndex.getPrimaryIndexNodes();
-
-        // Open the appointments file for reading
-        ifstream appointments("appointments.txt", ios::in);
-        if (!appointments) {
-            cerr << "Error opening appointments file.\n";
+    // Writes the details of several appointments, in the order of `ids`, to a result sink. Same
+    // output as printAppointmentById per ID, but all offsets are resolved first and the records
+    // are fetched in one batch of reads per shard (a busy doctor's appointments in one I/O wave).
+    void printAppointmentsByIds(const vector<string> &ids, int choice, ResultSink &sink) {
+        vector<int> offsets;
+        vector<string> lines;
+        TableShards shards = readableShards();
+        if (!readShardRecordLines(shards, ids, offsets, lines,
+                                  [&](const string &id) { return shardIndexOf(shards, id); })) {
+            sink.message("Error opening file: appointments.txt");
             return;
         }
 
-        // Loop through each node in the primary index
-        for (const auto &node : primaryIndexNodes) {
-            // Seek the corresponding record in the appointments file
-            appointments.seekg(node.offset, ios::beg);
-
-            string appointmentLine;
-            getline(appointments, appointmentLine); // Read the record line
-            istringstream recordStream(appointmentLine);
-
-            // Extract appointment details
-            string status, len, appId, date, doctorId;
-            getline(recordStream, status, '|');   // Read status field
-            getline(recordStream, len, '|');     // Read length field
-            getline(recordStream, appId, '|');   // Read appointment ID
-            getline(recordStream, date, '|');    // Read date field
-            getline(recordStream, doctorId, '|'); // Read doctor ID
-
-            // Match and display records that match the specified date
-            if (date == dateComp) {
-                switch (choice) {
-                    case 0:  // Print all appointment details
-                        cout << "Appointment ID: " << stoi(appId)
-                             << " | Date: " << date
-                             << " | Doctor ID: " << stoi(doctorId) << '\n';
-                        break;
-                    case 1:  // Print only the Appointment ID
-                        cout << "Appointment ID: " << stoi(appId) << '\n';
-                        break;
-                    case 2:  // Print only the Date
-                        cout << "Date: " << date << '\n';
-                        break;
-                    case 3:  // Print only the Doctor ID
-                        cout << "Doctor ID: " << stoi(doctorId) << '\n';
-                        break;
-                    default:  // Default to printing all details
-                        cout << "Appointment Details:\n"
-                             << "  ID: " << stoi(appId) << '\n'
-                             << "  Date: " << date << '\n'
-                             << "  Doctor ID: " << stoi(doctorId) << '\n';
-                }
+        string_view fields[5];
+        for (size_t i = 0; i < ids.size(); ++i) {
+            if (offsets[i] == -1) {
+                sink.message("Appointment not found. The ID \"" + ids[i] + "\" is invalid.");
+                continue;
             }
+            const string &line = lines[i];
+            if (line.empty()) {
+                sink.message("Error: Empty record at offset " + to_string(offsets[i]) + ".");
+                continue;
+            }
+            splitRecordFields(line, fields, 5);
+
+            // Remove any padding characters ('-') from the end of the date field
+            string date(fields[3]);
+            date.erase(date.find_last_not_of('-') + 1);
+            writeAppointmentByIdRow(sink, fields[2], date, fields[4], choice);
         }
+    }
 
-        // Close the appointments file
-        appointments.close();
+    // Prints all appointments matching a specific date.
+    void printAppointmentByDate(const string &dateComp, int choice) {
+        ResultSink sink;
+        printAppointmentByDate(dateComp, choice, sink);
     }
 
-    // Prints all appointments stored in the file.
-    void printAllAppointments(int choice) {
-        // Open the appointments file for reading
-        ifstream file("appointments.txt", ios::in);
-        if (!file) {
-            cerr << "Error opening appointments file.\n";
-            return;
+    // Writes all appointments matching a specific date to a result sink.
+    void printAppointmentByDate(const string &dateComp, int choice, ResultSink &sink) {
+        LatencyTimer timer(TimedOperation::PrintAppointmentByDate);
+        // Filter the appointments files in parallel chunks; matches come back in primary-key order.
+        // With month partitions only the partition of the date's month (and the undated one) is read.
+        TableShards shards = shardsForDates(*currentShards(), dateComp, dateComp);
+        vector<ScanMatch> matches = scanShards(shards, [&dateComp](string_view *fields, int fieldCount) {
+            return fieldCount >= 5 && fields[3] == dateComp;  // Fields: status, length, ID, date, doctor ID
+        });
+
+        // Output the matching records
+        string_view fields[5];
+        for (const ScanMatch &match : matches) {
+            splitRecordFields(match.line, fields, 5);
+            writeAppointmentRow(sink, fields[2], fields[3], fields[4], choice);
         }
+    }
 
-        string line;
-        // Iterate through all records in the file
-        while (getline(file, line)) {
-            // Skip records marked as deleted
-            if (line[0] != '*') {
-                istringstream recordStream(line);
-                string status, length, appointmentID, date, doctorID;
-
-                // Parse the record fields
-                getline(recordStream, status, '|');       // Read status field
-                getline(recordStream, length, '|');      // Read length field
-                getline(recordStream, appointmentID, '|'); // Read appointment ID
-                getline(recordStream, date, '|');        // Read date field
-                getline(recordStream, doctorID, '|');    // Read doctor ID
-
-                // Remove padding characters from the date
-                date.erase(remove(date.begin(), date.end(), '-'), date.end());
-
-                // Output appointment details based on the user's choice
-                switch (choice) {
-                    case 0:  // Print all appointment details
-                        cout << "ID: " << stoi(appointmentID)
-                             << " | Date: " << date
-                             << " | Doctor ID: " << stoi(doctorID) << '\n';
-                        break;
-                    case 1:  // Print only the Appointment ID
-                        cout << "ID: " << stoi(appointmentID) << '\n';
-                        break;
-                    case 2:  // Print only the Date
-                        cout << "Date: " << date << '\n';
-                        break;
-                    case 3:  // Print only the Doctor ID
-                        cout << "Doctor ID: " << stoi(doctorID) << '\n';
-                        break;
-                    default:  // Default to printing all details
-                        cout << "ID: " << stoi(appointmentID)
-                             << " | Date: " << date
-                             << " | Doctor ID: " << stoi(doctorID) << '\n';
-                }
-            }
+    // Writes the appointments whose date lies between `fromDate` and `toDate` to a result sink.
+    // Dates compare as text, and a date matches `toDate` by its prefix: "2025-03-31" includes
+    // "2025-03-31 16:00-16:30". Only the month partitions of the range are read.
+    void printAppointmentsByDateRange(const string &fromDate, const string &toDate, int choice, ResultSink &sink) {
+        LatencyTimer timer(TimedOperation::PrintAppointmentsByDateRange);
+        TableShards shards = shardsForDates(*currentShards(), fromDate, toDate);
+        vector<ScanMatch> matches = scanShards(shards, [&](string_view *fields, int fieldCount) {
+            if (fieldCount < 5) return false;
+            string_view date = fields[3];
+            date = date.substr(0, date.find_last_not_of('-') + 1);  // Without padding
+            return date >= fromDate && date.substr(0, toDate.size()) <= toDate;
+        });
+
+        string_view fields[5];
+        for (const ScanMatch &match : matches) {
+            splitRecordFields(match.line, fields, 5);
+            string date(fields[3]);
+            date.erase(date.find_last_not_of('-') + 1);
+            writeAppointmentRow(sink, fields[2], date, fields[4], choice);
         }
+    }
 
-        // Close the appointments file
-        file.close();
+    // Prints all appointments stored in the file.
+    void printAllAppointments(int choice) {
+        ResultSink sink;
+        printAllAppointments(choice, sink);
+    }
+
+    // Writes all appointments stored in the file to a result sink, as of one snapshot.
+    void printAllAppointments(int choice, ResultSink &sink) {
+        LatencyTimer timer(TimedOperation::PrintAllAppointments);
+        // Iterate through all records of the snapshots (deleted ones are skipped)
+        TableShards shards = readableShards();
+        forEachShardRecord(shards, [&](const string &line) {
+            istringstream recordStream(line);
+            string status, length, appointmentID, date, doctorID;
+
+            // Parse the record fields
+            getline(recordStream, status, '|');       // Read status field
+            getline(recordStream, length, '|');      // Read length field
+            getline(recordStream, appointmentID, '|'); // Read appointment ID
+            getline(recordStream, date, '|');        // Read date field
+            getline(recordStream, doctorID, '|');    // Read doctor ID
+
+            // Remove padding characters from the end of the date
+            date.erase(date.find_last_not_of('-') + 1);
+
+            // Output appointment details based on the user's choice (all details by default)
+            writeAppointmentRow(sink, appointmentID, date, doctorID, (choice >= 0 && choice <= 3) ? choice : 0, "ID");
+            return true;
+        });
     }
 
 };
@@ -0,0 +1,247 @@
+#ifndef HEALTHCAREMANAGEMENTSYSTEM_APPOINTMENTSCHEDULE_H
+#define HEALTHCAREMANAGEMENTSYSTEM_APPOINTMENTSCHEDULE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <mutex>
+#include <cstdio>
+#include <functional>
+
+using namespace std;
+
+// Appointment times and per-doctor schedules.
+//
+// An appointment's date is free text. A date of the form "YYYY-MM-DD HH:MM-HH:MM" also gives
+// the appointment a time interval on that day; such appointments are kept in an in-memory
+// schedule per doctor, ordered by start time, so double-booking checks and free-slot queries
+// touch only the appointments near the requested time instead of the doctor's whole posting list.
+// Appointments with other dates take part in none of this.
+
+// A half-open interval [start, end) in minutes since 1970-01-01 00:00
+class TimeInterval {
+public:
+    long long start = 0;
+    long long end = 0;
+
+    bool overlaps(const TimeInterval &other) const {
+        return start < other.end && other.start < end;
+    }
+};
+
+// Days since 1970-01-01 of a civil date (proleptic Gregorian calendar)
+static long long daysFromCivil(int year, int month, int day) {
+    year -= month <= 2;
+    long long era = (year >= 0 ? year : year - 399) / 400;
+    long long yearOfEra = year - era * 400;
+    long long dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    long long dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+// Parse "YYYY-MM-DD"; returns false if the text is not a valid date
+static bool parseDay(const string &text, long long &day) {
+    int year, month, dayOfMonth, consumed = 0;
+    if (sscanf(text.c_str(), "%4d-%2d-%2d%n", &year, &month, &dayOfMonth, &consumed) != 3 ||
+        consumed != static_cast<int>(text.size())) {
+        return false;
+    }
+    static const int daysInMonth[] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    if (month < 1 || month > 12 || dayOfMonth < 1 || dayOfMonth > daysInMonth[month - 1]) return false;
+    if (month == 2 && dayOfMonth == 29 && !(year % 4 == 0 && (year % 100 != 0 || year % 400 == 0))) return false;
+    day = daysFromCivil(year, month, dayOfMonth);
+    return true;
+}
+
+// Parse an appointment date "YYYY-MM-DD HH:MM-HH:MM" (end up to 24:00, after the start);
+// returns false for any other date
+static bool parseAppointmentTime(const string &date, TimeInterval &interval) {
+    size_t space = date.find(' ');
+    long long day;
+    if (space == string::npos || !parseDay(date.substr(0, space), day)) return false;
+
+    int startHour, startMinute, endHour, endMinute, consumed = 0;
+    string times = date.substr(space + 1);
+    if (sscanf(times.c_str(), "%2d:%2d-%2d:%2d%n", &startHour, &startMinute, &endHour, &endMinute, &consumed) != 4 ||
+        consumed != static_cast<int>(times.size())) {
+        return false;
+    }
+    int start = startHour * 60 + startMinute, end = endHour * 60 + endMinute;
+    if (startHour < 0 || startHour > 23 || startMinute < 0 || startMinute > 59 || endHour < 0 ||
+        endMinute < 0 || endMinute > 59 || end > 24 * 60 || end <= start) {
+        return false;
+    }
+    interval.start = day * 24 * 60 + start;
+    interval.end = day * 24 * 60 + end;
+    return true;
+}
+
+// "YYYY-MM-DD" of a day since 1970-01-01 (inverse of daysFromCivil)
+static string formatDay(long long days) {
+    days += 719468;
+    long long era = (days >= 0 ? days : days - 146096) / 146097;
+    long long dayOfEra = days - era * 146097;
+    long long yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    long long dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    long long monthIndex = (5 * dayOfYear + 2) / 153;
+    long long day = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+    long long month = monthIndex < 10 ? monthIndex + 3 : monthIndex - 9;
+    long long year = yearOfEra + era * 400 + (month <= 2);
+    char text[64];
+    snprintf(text, sizeof(text), "%04lld-%02lld-%02lld", year, month, day);
+    return text;
+}
+
+// "HH:MM" of a time in minutes since 1970-01-01 ("24:00" for the end of a day)
+static string formatTimeOfDay(long long minutes, bool endOfDay = false) {
+    long long ofDay = ((minutes % 1440) + 1440) % 1440;
+    if (endOfDay && ofDay == 0) ofDay = 1440;
+    char text[8];
+    snprintf(text, sizeof(text), "%02lld:%02lld", ofDay / 60, ofDay % 60);
+    return text;
+}
+
+// "HH:MM-HH:MM" of an interval within one day
+static string formatTimeRange(const TimeInterval &interval) {
+    return formatTimeOfDay(interval.start) + "-" + formatTimeOfDay(interval.end, true);
+}
+
+// Why a booking is rejected: the doctor already has `appointmentId` at `booked`
+static string bookingConflictMessage(const string &doctorId, const string &appointmentId,
+                                     const TimeInterval &booked) {
+    long long day = booked.start >= 0 ? booked.start / 1440 : (booked.start - 1439) / 1440;
+    return "Doctor ID " + doctorId + " is already booked on " + formatDay(day) + " " + formatTimeRange(booked) +
+           " (appointment " + to_string(stoi(appointmentId)) + "). Cannot book an overlapping appointment.";
+}
+
+// The timed appointments of one doctor, ordered by start time
+class DoctorSchedule {
+private:
+    map<pair<long long, string>, long long> intervals; // (start, appointment ID) -> end
+    multiset<long long> durations;                     // Durations, for the longest one
+
+public:
+    bool empty() const {
+        return intervals.empty();
+    }
+
+    void add(const string &appointmentId, const TimeInterval &interval) {
+        if (intervals.emplace(make_pair(interval.start, appointmentId), interval.end).second) {
+            durations.insert(interval.end - interval.start);
+        }
+    }
+
+    void remove(const string &appointmentId, const TimeInterval &interval) {
+        auto it = intervals.find(make_pair(interval.start, appointmentId));
+        if (it == intervals.end()) return;
+        durations.erase(durations.find(it->second - it->first.first));
+        intervals.erase(it);
+    }
+
+    // Visit the appointments overlapping `interval`, in start order. Only appointments that start
+    // less than the longest duration before `interval` are looked at: O(log n + k).
+    void forEachOverlap(const TimeInterval &interval,
+                        const function<void(const string &appointmentId, const TimeInterval &)> &visitor) const {
+        if (intervals.empty()) return;
+        long long longest = *durations.rbegin();
+        for (auto it = intervals.lower_bound(make_pair(interval.start - longest, string()));
+             it != intervals.end() && it->first.first < interval.end; ++it) {
+            TimeInterval booked{it->first.first, it->second};
+            if (booked.overlaps(interval)) visitor(it->first.second, booked);
+        }
+    }
+
+    // The gaps between appointments inside `window`
+    vector<TimeInterval> freeSlots(const TimeInterval &window) const {
+        vector<TimeInterval> slots;
+        long long free = window.start;
+        forEachOverlap(window, [&](const string &, const TimeInterval &booked) {
+            if (booked.start > free) slots.push_back({free, booked.start});
+            free = max(free, booked.end);
+        });
+        if (free < window.end) slots.push_back({free, window.end});
+        return slots;
+    }
+};
+
+// The schedules of all doctors. Thread-safe; every call holds scheduleMutex briefly.
+class AppointmentSchedule {
+private:
+    mutable mutex scheduleMutex;
+    unordered_map<string, DoctorSchedule> doctors;  // Doctor ID -> schedule
+
+public:
+    void add(const string &doctorId, const string &appointmentId, const TimeInterval &interval) {
+        lock_guard<mutex> lock(scheduleMutex);
+        doctors[doctorId].add(appointmentId, interval);
+    }
+
+    void remove(const string &doctorId, const string &appointmentId, const TimeInterval &interval) {
+        lock_guard<mutex> lock(scheduleMutex);
+        auto it = doctors.find(doctorId);
+        if (it == doctors.end()) return;
+        it->second.remove(appointmentId, interval);
+        if (it->second.empty()) doctors.erase(it);
+    }
+
+    void clear() {
+        lock_guard<mutex> lock(scheduleMutex);
+        doctors.clear();
+    }
+
+    // The doctor's appointments overlapping `interval`, except `ignoredId`, as (ID, interval)
+    vector<pair<string, TimeInterval>> conflicts(const string &doctorId, const TimeInterval &interval,
+                                                 const string &ignoredId = "") const {
+        vector<pair<string, TimeInterval>> found;
+        lock_guard<mutex> lock(scheduleMutex);
+        auto it = doctors.find(doctorId);
+        if (it == doctors.end()) return found;
+        it->second.forEachOverlap(interval, [&](const string &appointmentId, const TimeInterval &booked) {
+            if (appointmentId != ignoredId) found.emplace_back(appointmentId, booked);
+        });
+        return found;
+    }
+
+    // The doctor's free time inside `window`
+    vector<TimeInterval> freeSlots(const string &doctorId, const TimeInterval &window) const {
+        lock_guard<mutex> lock(scheduleMutex);
+        auto it = doctors.find(doctorId);
+        if (it == doctors.end()) return {window};
+        return it->second.freeSlots(window);
+    }
+};
+
+// Serializes bookings per doctor: a conflict check and the write that follows it run under the
+// doctor's stripe, so two bookings for one doctor cannot both pass the check. Doctors hash to a
+// fixed set of stripes; bookings for doctors on different stripes run in parallel.
+class BookingLocks {
+private:
+    static const size_t stripeCount = 64;
+    mutex stripes[stripeCount];
+
+    static size_t stripeOf(const string &doctorId) {
+        return hash<string>()(doctorId) % stripeCount;
+    }
+
+public:
+    unique_lock<mutex> lock(const string &doctorId) {
+        return unique_lock<mutex>(stripes[stripeOf(doctorId)]);
+    }
+
+    // The stripes of several doctors, in stripe order so that two callers cannot deadlock
+    vector<unique_lock<mutex>> lock(const set<string> &doctorIds) {
+        set<size_t> stripeIndexes;
+        for (const string &doctorId : doctorIds) {
+            stripeIndexes.insert(stripeOf(doctorId));
+        }
+        vector<unique_lock<mutex>> locks;
+        for (size_t index : stripeIndexes) {
+            locks.emplace_back(stripes[index]);
+        }
+        return locks;
+    }
+};
+
+#endif //HEALTHCAREMANAGEMENTSYSTEM_APPOINTMENTSCHEDULE_H
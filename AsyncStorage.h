@@ -0,0 +1,163 @@
+#ifndef HEALTHCAREMANAGEMENTSYSTEM_ASYNCSTORAGE_H
+#define HEALTHCAREMANAGEMENTSYSTEM_ASYNCSTORAGE_H
+
+#include <string>
+#include <vector>
+#include <optional>
+#include "DoctorManagementSystem.h"
+#include "AppointmentManagementSystem.h"
+#include "AsyncTask.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+// Process-wide executor for blocking storage I/O issued by async callers. It is separate from
+// sharedThreadPool(): operations such as printAppointmentByDate wait on the shared pool, and
+// running them on it could exhaust its workers.
+inline ThreadPool &storageIoPool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+// Coroutine API over the doctor and appointment systems. Every operation returns a Task that,
+// when awaited, suspends the caller, runs the (blocking) file access on the I/O executor and
+// resumes the caller there with the result. Callers therefore never block their own thread:
+// an event loop can keep thousands of lookups in flight on a handful of threads, and whenAll
+// runs a batch concurrently (readDoctors/readAppointments fetch theirs as one batch read).
+// Checks answered from the lock-free primary indexes complete without leaving the caller's thread.
+//
+// Arguments are taken by value because a task may run after the caller's temporaries are gone.
+// The underlying systems are thread-safe, so sync and async callers can be mixed freely.
+class AsyncStorage {
+private:
+    DoctorManagementSystem &doctorSystem;
+    AppointmentManagementSystem &appointmentSystem;
+    ThreadPool &executor; // Runs the blocking part of every operation
+
+public:
+    AsyncStorage(DoctorManagementSystem &doctorSys, AppointmentManagementSystem &appointmentSys,
+                 ThreadPool &executor = storageIoPool())
+            : doctorSystem(doctorSys), appointmentSystem(appointmentSys), executor(executor) {}
+
+    // Whether a doctor ID exists (index only, completes inline)
+    Task<bool> doctorExists(string id) {
+        co_return doctorSystem.doctorExists(id);
+    }
+
+    // Whether an appointment ID exists (index only, completes inline)
+    Task<bool> appointmentExists(string id) {
+        co_return appointmentSystem.appointmentExists(id);
+    }
+
+    // Read a doctor record; empty if the ID is not indexed
+    Task<optional<Doctor>> readDoctor(string id) {
+        if (!doctorSystem.doctorExists(id)) co_return nullopt;  // Misses need no I/O
+        co_await resumeOn(executor);
+        Doctor doctor;
+        if (!doctorSystem.readDoctor(id, doctor)) co_return nullopt;
+        co_return doctor;
+    }
+
+    // Read an appointment record; empty if the ID is not indexed
+    Task<optional<Appointment>> readAppointment(string id) {
+        if (!appointmentSystem.appointmentExists(id)) co_return nullopt;
+        co_await resumeOn(executor);
+        Appointment appointment;
+        if (!appointmentSystem.readAppointment(id, appointment)) co_return nullopt;
+        co_return appointment;
+    }
+
+    // Read several doctors as one batch of I/O; results are in the order of `ids`
+    Task<vector<optional<Doctor>>> readDoctors(vector<string> ids) {
+        co_await resumeOn(executor);
+        vector<optional<Doctor>> results;
+        results.reserve(ids.size());
+        for (Doctor &doctor : doctorSystem.readDoctors(ids)) {
+            results.push_back(doctor.id.empty() ? nullopt : optional<Doctor>(std::move(doctor)));
+        }
+        co_return results;
+    }
+
+    // Read several appointments as one batch of I/O; results are in the order of `ids`
+    Task<vector<optional<Appointment>>> readAppointments(vector<string> ids) {
+        co_await resumeOn(executor);
+        vector<optional<Appointment>> results;
+        results.reserve(ids.size());
+        for (Appointment &appointment : appointmentSystem.readAppointments(ids)) {
+            results.push_back(appointment.id.empty() ? nullopt : optional<Appointment>(std::move(appointment)));
+        }
+        co_return results;
+    }
+
+    // IDs of the doctors with a given name
+    Task<vector<string>> searchDoctorsByName(string name) {
+        co_await resumeOn(executor);
+        co_return doctorSystem.searchDoctorsByName(name);
+    }
+
+    // IDs of the appointments of a doctor
+    Task<vector<string>> searchAppointmentsByDoctorID(string doctorID) {
+        co_await resumeOn(executor);
+        co_return appointmentSystem.searchAppointmentsByDoctorID(doctorID);
+    }
+
+    // Add a doctor; returns the new ID
+    Task<string> addDoctor(Doctor doctor) {
+        co_await resumeOn(executor);
+        doctorSystem.addDoctor(doctor);
+        co_return doctor.id;
+    }
+
+    // Add an appointment; returns the new ID, or an empty string if it was not added (its doctor
+    // does not exist, its time overlaps another appointment of the doctor, ...)
+    Task<string> addAppointment(Appointment appointment) {
+        co_await resumeOn(executor);
+        if (!appointmentSystem.addAppointment(appointment)) co_return "";
+        co_return appointment.id;
+    }
+
+    // Rename a doctor; false if the ID does not exist
+    Task<bool> updateDoctorName(string id, string newName) {
+        if (!doctorSystem.doctorExists(id)) co_return false;
+        co_await resumeOn(executor);
+        co_return doctorSystem.updateDoctorName(id, newName);
+    }
+
+    // Change an appointment's date; false if the ID does not exist or the new time overlaps
+    // another appointment of its doctor
+    Task<bool> updateAppointmentDate(string id, string newDate) {
+        if (!appointmentSystem.appointmentExists(id)) co_return false;
+        co_await resumeOn(executor);
+        co_return appointmentSystem.updateAppointmentDate(id, newDate);
+    }
+
+    // Delete a doctor; false if the ID does not exist or ON DELETE RESTRICT kept the doctor
+    Task<bool> deleteDoctor(string id) {
+        if (!doctorSystem.doctorExists(id)) co_return false;
+        co_await resumeOn(executor);
+        co_return doctorSystem.deleteDoctor(id);
+    }
+
+    // Delete an appointment; false if the ID does not exist
+    Task<bool> deleteAppointment(string id) {
+        if (!appointmentSystem.appointmentExists(id)) co_return false;
+        co_await resumeOn(executor);
+        co_return appointmentSystem.deleteAppointment(id);
+    }
+
+    // Write a doctor's details to `sink` as printDoctorById does (0 = all fields); the sink must
+    // outlive the task
+    Task<void> printDoctorById(string id, int choice, ResultSink &sink) {
+        co_await resumeOn(executor);
+        doctorSystem.printDoctorById(id, choice, sink);
+    }
+
+    // Write an appointment's details to `sink` as printAppointmentById does (0 = all fields); the
+    // sink must outlive the task
+    Task<void> printAppointmentById(string id, int choice, ResultSink &sink) {
+        co_await resumeOn(executor);
+        appointmentSystem.printAppointmentById(id, choice, sink);
+    }
+};
+
+#endif //HEALTHCAREMANAGEMENTSYSTEM_ASYNCSTORAGE_H
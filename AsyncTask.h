@@ -0,0 +1,262 @@
+#ifndef HEALTHCAREMANAGEMENTSYSTEM_ASYNCTASK_H
+#define HEALTHCAREMANAGEMENTSYSTEM_ASYNCTASK_H
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <utility>
+#include "ThreadPool.h"
+
+using namespace std;
+
+// Minimal C++20 coroutine support for the async storage API:
+//   Task<T>      - lazy coroutine producing a T; starts when awaited and resumes its awaiter
+//                  when it finishes (symmetric transfer, so long chains do not grow the stack)
+//   resumeOn()   - awaitable that moves the coroutine onto a thread pool
+//   whenAll()    - runs many tasks concurrently and waits for all of them
+//   syncWait()   - blocks a plain thread until a task finishes (the bridge from synchronous code)
+
+template<typename T>
+class Task;
+
+// Promise parts shared by Task<T> and Task<void>
+class TaskPromiseBase {
+public:
+    coroutine_handle<> continuation = noop_coroutine(); // Coroutine awaiting this task
+    exception_ptr exception;                             // Exception that escaped the body
+
+    // On completion, transfer control to the awaiting coroutine
+    class FinalAwaiter {
+    public:
+        bool await_ready() noexcept { return false; }
+
+        template<typename Promise>
+        coroutine_handle<> await_suspend(coroutine_handle<Promise> finished) noexcept {
+            return finished.promise().continuation;
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    suspend_always initial_suspend() noexcept { return {}; }
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    void unhandled_exception() { exception = current_exception(); }
+};
+
+template<typename T>
+class TaskPromise : public TaskPromiseBase {
+public:
+    optional<T> value; // Result set by co_return
+
+    Task<T> get_return_object();
+    void return_value(T result) { value.emplace(std::move(result)); }
+
+    T result() {
+        if (exception) rethrow_exception(exception);
+        return std::move(*value);
+    }
+};
+
+template<>
+class TaskPromise<void> : public TaskPromiseBase {
+public:
+    Task<void> get_return_object();
+    void return_void() {}
+
+    void result() {
+        if (exception) rethrow_exception(exception);
+    }
+};
+
+// Lazily started coroutine returning T. Owns its frame; await it exactly once.
+template<typename T = void>
+class Task {
+public:
+    using promise_type = TaskPromise<T>;
+
+private:
+    coroutine_handle<promise_type> handle;
+
+public:
+    explicit Task(coroutine_handle<promise_type> handle) : handle(handle) {}
+    Task(Task &&other) noexcept : handle(exchange(other.handle, nullptr)) {}
+    Task &operator=(Task &&other) noexcept {
+        if (this != &other) {
+            if (handle) handle.destroy();
+            handle = exchange(other.handle, nullptr);
+        }
+        return *this;
+    }
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+
+    ~Task() {
+        if (handle) handle.destroy();
+    }
+
+    bool await_ready() const noexcept { return !handle || handle.done(); }
+
+    // Start the task; it resumes `awaiting` when it finishes
+    coroutine_handle<> await_suspend(coroutine_handle<> awaiting) noexcept {
+        handle.promise().continuation = awaiting;
+        return handle;
+    }
+
+    T await_resume() { return handle.promise().result(); }
+};
+
+template<typename T>
+Task<T> TaskPromise<T>::get_return_object() {
+    return Task<T>(coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() {
+    return Task<void>(coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+// Eagerly started coroutine that nobody awaits; frees itself when done. Used internally to
+// drive tasks from whenAll and syncWait.
+class DetachedTask {
+public:
+    class promise_type {
+    public:
+        DetachedTask get_return_object() { return {}; }
+        suspend_never initial_suspend() noexcept { return {}; }
+        suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { terminate(); }  // Callers catch inside the body
+    };
+};
+
+// Awaitable that resumes the coroutine on a worker of `pool`
+class ResumeOnPool {
+private:
+    ThreadPool &pool;
+
+public:
+    explicit ResumeOnPool(ThreadPool &pool) : pool(pool) {}
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(coroutine_handle<> suspended) { pool.post([suspended] { suspended.resume(); }); }
+    void await_resume() const noexcept {}
+};
+
+inline ResumeOnPool resumeOn(ThreadPool &pool) {
+    return ResumeOnPool(pool);
+}
+
+// Shared state of one whenAll call
+template<typename T>
+class WhenAllState {
+public:
+    vector<optional<T>> results;    // Result of each task, by position
+    exception_ptr exception;        // First exception thrown by a task
+    mutex exceptionMutex;           // Protects exception
+    atomic<size_t> remaining{0};    // Tasks still running, plus one for the awaiter itself
+    coroutine_handle<> continuation; // Coroutine waiting in whenAll
+};
+
+// Run one whenAll task and resume the waiter after the last one
+template<typename T>
+DetachedTask runWhenAllTask(Task<T> &task, WhenAllState<T> &state, size_t position) {
+    try {
+        state.results[position].emplace(co_await task);
+    } catch (...) {
+        lock_guard<mutex> lock(state.exceptionMutex);
+        if (!state.exception) state.exception = current_exception();
+    }
+    if (state.remaining.fetch_sub(1) == 1) state.continuation.resume();
+}
+
+// Awaitable starting every task of a whenAll call
+template<typename T>
+class WhenAllAwaiter {
+private:
+    vector<Task<T>> &tasks;
+    WhenAllState<T> &state;
+
+public:
+    WhenAllAwaiter(vector<Task<T>> &tasks, WhenAllState<T> &state) : tasks(tasks), state(state) {}
+
+    bool await_ready() const noexcept { return tasks.empty(); }
+
+    // Start all tasks; stay suspended unless they all finished synchronously
+    bool await_suspend(coroutine_handle<> awaiting) {
+        state.continuation = awaiting;
+        state.remaining = tasks.size() + 1;
+        for (size_t i = 0; i < tasks.size(); ++i) {
+            runWhenAllTask(tasks[i], state, i);
+        }
+        return state.remaining.fetch_sub(1) != 1;
+    }
+
+    void await_resume() const noexcept {}
+};
+
+// Run all tasks concurrently (each one runs until its first suspension on the caller's thread)
+// and return their results in order. The first exception, if any, is rethrown.
+template<typename T>
+Task<vector<T>> whenAll(vector<Task<T>> tasks) {
+    WhenAllState<T> state;
+    state.results.resize(tasks.size());
+    co_await WhenAllAwaiter<T>(tasks, state);
+    if (state.exception) rethrow_exception(state.exception);
+
+    vector<T> results;
+    results.reserve(tasks.size());
+    for (optional<T> &result : state.results) {
+        results.push_back(std::move(*result));
+    }
+    co_return results;
+}
+
+// Shared state of one syncWait call
+template<typename T>
+class SyncWaitState {
+public:
+    mutex doneMutex;
+    condition_variable doneSignal;
+    bool done = false;
+    optional<T> value;
+    exception_ptr exception;
+};
+
+template<typename T>
+DetachedTask runSyncWaitTask(Task<T> &task, SyncWaitState<T> &state) {
+    try {
+        state.value.emplace(co_await task);
+    } catch (...) {
+        state.exception = current_exception();
+    }
+    // Signal while holding the lock: the waiter cannot return (and destroy the state) before
+    lock_guard<mutex> lock(state.doneMutex);
+    state.done = true;
+    state.doneSignal.notify_one();
+}
+
+// Block the calling thread until `task` finishes and return its result
+template<typename T>
+T syncWait(Task<T> task) {
+    SyncWaitState<T> state;
+    runSyncWaitTask(task, state);
+    unique_lock<mutex> lock(state.doneMutex);
+    state.doneSignal.wait(lock, [&state] { return state.done; });
+    if (state.exception) rethrow_exception(state.exception);
+    return std::move(*state.value);
+}
+
+// syncWait for tasks without a result
+inline Task<bool> completeVoidTask(Task<void> task) {
+    co_await task;
+    co_return true;
+}
+
+inline void syncWait(Task<void> task) {
+    syncWait(completeVoidTask(std::move(task)));
+}
+
+#endif //HEALTHCAREMANAGEMENTSYSTEM_ASYNCTASK_H
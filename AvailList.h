@@ -7,6 +7,11 @@
 #include <string>
 #include <cctype>
 #include <algorithm>
+#include <vector>
+#include <functional>
+#include "DurableFile.h"
+#include "StorageStats.h"
+#include "MemoryAccounting.h"
 
 using namespace std;
 
@@ -21,11 +26,81 @@ public:
     AvailListNode(int offset, int size) : offset(offset), size(size), next(nullptr) {}
 };
 
-// Class representing the list of available memory blocks
+// Class representing the list of available memory blocks. Only writers (holding the table lock
+// exclusively) use it, so when evicted to stay within the memory budget it is simply read back
+// from its file on the next use.
 class AvailList {
 private:
     string availListFileName;  // Filename of the available memory list file
+    string dataFileName;       // Data file the free slots are in; synced before each write
     AvailListNode *header;     // Head node of the linked list
+    bool autoPersist = true;   // Whether every change is written to the file immediately
+    bool dirty = false;        // Whether the in-memory list has unwritten changes
+    PersistSchedule persistSchedule; // When changes are due to be written under the durability policy
+    bool grouping = false;           // Whether changes are collected into one change group
+    bool groupChanged = false;       // Whether the open change group changed the list
+    size_t nodeCount = 0;            // Nodes in the list
+    bool resident = true;            // Whether the list is in memory
+    atomic<unsigned long long> lastUsed{memoryBudget().tick.load()}; // Memory budget tick of the last use
+
+    // Read an evicted list back from its file before using it
+    void ensureResident() {
+        markUsed(lastUsed);
+        if (resident) return;
+        resident = true;
+        readEvictedNodes();
+        countStat(StatCounter::IndexPageIns);
+    }
+
+    // Read an evicted list back from its file. The file holds the list exactly as it was
+    // evicted, already in order, so the nodes are appended as read, keeping the order of
+    // slots of equal size.
+    void readEvictedNodes() {
+        ifstream availListFile(availListFileName);
+        if (!availListFile.is_open()) {
+            cerr << "Error opening file: " << availListFileName << endl;
+            return;
+        }
+        AvailListNode *tail = nullptr;
+        string line;
+        while (getline(availListFile, line)) {
+            istringstream stream(line);
+            string offset, size;
+            getline(stream, offset, '|');
+            getline(stream, size, '|');
+            AvailListNode *newNode;
+            try {
+                newNode = new AvailListNode(stoi(offset), stoi(size));
+            } catch (const exception &) {
+                cerr << "Warning: skipping malformed line in " << availListFileName << ": " << line << "\n";
+                continue;
+            }
+            (tail == nullptr ? header : tail->next) = newNode;
+            tail = newNode;
+            nodeCount++;
+        }
+    }
+
+    // Free every node
+    void clearNodes() {
+        while (header) {
+            AvailListNode *temp = header;
+            header = header->next;
+            delete temp;
+        }
+        nodeCount = 0;
+    }
+
+    // Record a change and write it out when the durability policy says so, unless persistence
+    // is deferred or a change group is open
+    void persistChange() {
+        dirty = true;
+        if (grouping) {
+            groupChanged = true;
+        } else if (autoPersist && persistSchedule.changeIsDue()) {
+            updateAvailListFile();
+        }
+    }
 
 public:
     // Constructor initializes an empty list (header is nullptr)
@@ -37,8 +112,75 @@ public:
         loadAvailListInMemory();
     }
 
+    // Set the data file the free slots are in
+    void setDataFileName(const string &fileName) {
+        dataFileName = fileName;
+    }
+
+    // Enable or disable writing the list file after every change; when disabled, call flush()
+    void setAutoPersist(bool enabled) {
+        autoPersist = enabled;
+    }
+
+    // Collect the following changes into one change group: they are persisted together, once,
+    // by endChangeGroup(), and count as a single change for the durability policy
+    void beginChangeGroup() {
+        grouping = true;
+    }
+
+    // Close the change group and persist its changes if the durability policy says so
+    void endChangeGroup() {
+        grouping = false;
+        if (groupChanged && autoPersist && persistSchedule.changeIsDue()) {
+            updateAvailListFile();
+        }
+        groupChanged = false;
+    }
+
+    // Write pending changes to the list file
+    void flush() {
+        if (dirty) {
+            updateAvailListFile();
+        }
+    }
+
+    // Drop the list from memory after writing pending changes to the file. Returns false if the
+    // list is not resident or empty, a change group is open or the write failed.
+    bool evict() {
+        if (!resident || header == nullptr || grouping) return false;
+        if (dirty) {
+            updateAvailListFile();
+            if (dirty) return false;
+        }
+        clearNodes();
+        resident = false;
+        countStat(StatCounter::IndexEvictions);
+        return true;
+    }
+
+    // Estimated heap bytes of the list while resident
+    size_t memoryBytes() const {
+        return resident ? nodeCount * (sizeof(AvailListNode) + allocationOverhead) : 0;
+    }
+
+    bool isResident() const {
+        return resident;
+    }
+
+    // Memory budget tick of the last use
+    unsigned long long lastUsedTick() const {
+        return lastUsed.load(memory_order_relaxed);
+    }
+
+    // Number of free slots while resident
+    size_t entryCount() const {
+        return resident ? nodeCount : 0;
+    }
+
     // Insert a new node in the available list in sorted order by size
     void insert(AvailListNode *newNode) {
+        ensureResident();
+        nodeCount++;
         if (header == nullptr) { // If the list is empty, set the new node as the head
             header = newNode;
         } else { // Insert in sorted order
@@ -46,10 +188,13 @@ public:
             AvailListNode *curr = header;
 
             // Traverse to find the correct position to insert the new node
+            unsigned long long steps = 0;
             while (curr != nullptr && curr->size < newNode->size) {
                 prev = curr;
                 curr = curr->next;
+                steps++;
             }
+            countStat(StatCounter::AvailListSteps, steps);
 
             // If inserting at the beginning
             if (prev == nullptr) {
@@ -60,11 +205,12 @@ public:
                 newNode->next = curr;
             }
         }
-        updateAvailListFile();  // Update the file after insertion
+        persistChange();  // Update the file after insertion
     }
 
     // Remove a node from the available list
     void remove(AvailListNode *nodeToRemove) {
+        ensureResident();
         if (header == nullptr || nodeToRemove == nullptr) {
             return; // List is empty or invalid node
         }
@@ -73,7 +219,8 @@ public:
         if (header == nodeToRemove) {
             header = header->next;
             delete nodeToRemove;
-            updateAvailListFile();  // Update the file after removal
+            nodeCount--;
+            persistChange();  // Update the file after removal
             return;
         }
 
@@ -82,25 +229,62 @@ public:
         AvailListNode *curr = header;
 
         // Traverse the list to find the node to remove
+        unsigned long long steps = 0;
         while (curr != nullptr && curr != nodeToRemove) {
             prev = curr;
             curr = curr->next;
+            steps++;
         }
+        countStat(StatCounter::AvailListSteps, steps);
 
         // If the node is found, remove it
         if (curr == nodeToRemove) {
             prev->next = curr->next;
             delete curr;
-            updateAvailListFile();  // Update the file after removal
+            nodeCount--;
+            persistChange();  // Update the file after removal
+        }
+    }
+
+    // Replace the whole list with `slots` (offset, size), e.g. rebuilt from the data file. Written
+    // by the next flush, or at once if changes are persisted immediately.
+    void replaceAll(vector<pair<int, int>> slots) {
+        clearNodes();
+        resident = true;
+        // Link the nodes in size order directly instead of inserting them one by one
+        stable_sort(slots.begin(), slots.end(), [](const pair<int, int> &a, const pair<int, int> &b) {
+            return a.second < b.second;
+        });
+        for (auto slot = slots.rbegin(); slot != slots.rend(); ++slot) {
+            AvailListNode *node = new AvailListNode(slot->first, slot->second);
+            node->next = header;
+            header = node;
+        }
+        nodeCount = slots.size();
+        dirty = true;
+        if (autoPersist) {
+            updateAvailListFile();
+        }
+    }
+
+    // Visit every free slot (offset, size) in list order
+    void forEachNode(const function<void(int offset, int size)> &visitor) {
+        ensureResident();
+        for (AvailListNode *curr = header; curr != nullptr; curr = curr->next) {
+            visitor(curr->offset, curr->size);
         }
     }
 
     // Find the best fit node for a given size (a node with a size >= newSize)
     AvailListNode *bestFit(int newSize) {
+        ensureResident();
         AvailListNode *curr = header;
+        unsigned long long steps = 0;
         while (curr != nullptr && curr->size < newSize) {
             curr = curr->next;  // Move to the next node if current size is smaller
+            steps++;
         }
+        countStat(StatCounter::AvailListSteps, steps);
         return curr;  // Return the first node that fits
     }
 
@@ -116,6 +300,10 @@ public:
             return; // Return early if the file is empty
         }
 
+        // Insert without rewriting the file we are reading from
+        bool wasAutoPersist = autoPersist;
+        autoPersist = false;
+
         string line;
         while (getline(availListFile, line)) {
             istringstream stream(line);
@@ -123,38 +311,46 @@ public:
             getline(stream, offset, '|');
             getline(stream, size, '|');
 
-            AvailListNode *newNode = new AvailListNode(stoi(offset), stoi(size));
+            AvailListNode *newNode;
+            try {
+                newNode = new AvailListNode(stoi(offset), stoi(size));
+            } catch (const exception &) {
+                // A damaged line is skipped; an index rebuild from the data file restores the slot
+                cerr << "Warning: skipping malformed line in " << availListFileName << ": " << line << "\n";
+                continue;
+            }
             insert(newNode);  // Insert the node into the list
         }
+
+        autoPersist = wasAutoPersist;
+        dirty = false;  // The file already holds the loaded nodes
     }
 
-    // Update the available list file with the current in-memory data
+    // Update the available list file with the current in-memory data, replacing it atomically
     void updateAvailListFile() {
-        // Open the file in output mode (overwrites the file)
-        fstream availFile(availListFileName, ios::out);
-
-        if (!availFile.is_open()) {
-            cerr << "Error opening file: " << availListFileName << endl;
-            return;
-        }
-
+        ensureResident();
+        if (!syncDataFile(dataFileName)) return;  // Stays dirty; the next persist retries
+        ostringstream availFile;
         AvailListNode *curr = header;
 
-        // Traverse through the list and write each node's data to the file
+        // Traverse through the list and write each node's data
         while (curr != nullptr) {
             availFile << curr->offset << "|" << curr->size << '\n';  // Write offset and size
             curr = curr->next;
         }
-        availFile.close();  // Close the file after writing
+        string contents = availFile.str();
+        if (!replaceFileAtomically(availListFileName, contents)) {
+            return;  // Stays dirty; the next persist retries
+        }
+        countStat(StatCounter::IndexRewrites);
+        countStat(StatCounter::BytesWritten, contents.size());
+        dirty = false;
+        persistSchedule.persisted();
     }
 
     // Destructor to clean up the allocated memory
     ~AvailList() {
-        while (header) {
-            AvailListNode *temp = header;
-            header = header->next;
-            delete temp;  // Delete each node
-        }
+        clearNodes();
     }
 };
 
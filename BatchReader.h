@@ -0,0 +1,345 @@
+#ifndef HEALTHCAREMANAGEMENTSYSTEM_BATCHREADER_H
+#define HEALTHCAREMANAGEMENTSYSTEM_BATCHREADER_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include "StorageStats.h"
+
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define HCMS_HAVE_IO_URING 1
+#else
+#define HCMS_HAVE_IO_URING 0
+#endif
+
+using namespace std;
+
+// Batched reads of many records of one data file ("multi-get").
+//
+// Looking up N records one by one costs N opens, seeks and reads. BatchReader takes all the
+// record offsets at once, sorts them, merges offsets that lie close together into one larger
+// read, and submits every read of the batch in a single io_uring submission (one wave of I/O,
+// one system call for all of it). When io_uring is unavailable at build time or refused at run
+// time (old kernel, seccomp), the same merged reads are issued with pread.
+
+// One merged read: a byte range of the file covering one or more records
+class BatchReadRange {
+public:
+    off_t offset = 0;  // First byte of the range
+    size_t length = 0; // Bytes requested
+    string data;       // Bytes read (shorter than `length` at the end of the file)
+    bool failed = false;
+};
+
+#if HCMS_HAVE_IO_URING
+// A small io_uring instance driven through the raw system calls (no liburing dependency).
+// One per thread; it only ever has one batch in flight.
+class IoUringQueue {
+private:
+    int ringFd = -1;
+    unsigned entries = 0;
+    void *sqRing = MAP_FAILED, *cqRing = MAP_FAILED;
+    size_t sqRingSize = 0, cqRingSize = 0;
+    io_uring_sqe *sqes = static_cast<io_uring_sqe *>(MAP_FAILED);
+    size_t sqesSize = 0;
+    unsigned *sqTail = nullptr, *sqMask = nullptr, *sqArray = nullptr;
+    unsigned *cqHead = nullptr, *cqTail = nullptr, *cqMask = nullptr;
+    io_uring_cqe *cqes = nullptr;
+    vector<string> abandoned;  // Buffers of reads that may still complete after an error
+
+    void release() {
+        if (sqes != MAP_FAILED) munmap(sqes, sqesSize);
+        if (cqRing != MAP_FAILED && cqRing != sqRing) munmap(cqRing, cqRingSize);
+        if (sqRing != MAP_FAILED) munmap(sqRing, sqRingSize);
+        if (ringFd != -1) close(ringFd);
+        ringFd = -1;
+        sqRing = cqRing = MAP_FAILED;
+        sqes = static_cast<io_uring_sqe *>(MAP_FAILED);
+    }
+
+    // Take the completions available for the batch of ranges starting at `first`, marking them
+    // in `done`; sets `rejected` if the kernel does not know IORING_OP_READ. Returns how many.
+    unsigned reap(vector<BatchReadRange> &ranges, size_t first, vector<bool> &done, bool &rejected) {
+        unsigned head = atomic_ref<unsigned>(*cqHead).load(memory_order_relaxed);
+        unsigned available = atomic_ref<unsigned>(*cqTail).load(memory_order_acquire);
+        unsigned reaped = 0;
+        for (; head != available; ++head, ++reaped) {
+            const io_uring_cqe &cqe = cqes[head & *cqMask];
+            BatchReadRange &range = ranges[cqe.user_data];
+            done[cqe.user_data - first] = true;
+            if (cqe.res == -EINVAL || cqe.res == -EOPNOTSUPP) {
+                rejected = true;
+            } else if (cqe.res < 0) {
+                range.failed = true;
+                range.data.clear();
+            } else {
+                range.data.resize(cqe.res);
+            }
+        }
+        atomic_ref<unsigned>(*cqHead).store(head, memory_order_release);
+        return reaped;
+    }
+
+    // Give up on the ring after an error. The batch's reads still in flight are waited for, so
+    // none completes into a buffer the pread fallback reuses; closing the ring then drops the
+    // queued reads it never submitted. If even the wait fails, the unfinished reads' buffers are
+    // kept (until the thread exits) and the ranges get fresh ones.
+    void abandon(vector<BatchReadRange> &ranges, size_t first, vector<bool> &done, unsigned inFlight) {
+        bool rejected = false;
+        while (inFlight > 0) {
+            long result = syscall(__NR_io_uring_enter, ringFd, 0, inFlight, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (result < 0 && errno != EINTR) break;
+            inFlight -= min(inFlight, reap(ranges, first, done, rejected));
+        }
+        if (inFlight > 0) {
+            for (size_t i = 0; i < done.size(); ++i) {
+                if (!done[i]) abandoned.push_back(std::move(ranges[first + i].data));
+            }
+        }
+        release();
+    }
+
+public:
+    explicit IoUringQueue(unsigned requestedEntries = 128) {
+        io_uring_params params{};
+        ringFd = static_cast<int>(syscall(__NR_io_uring_setup, requestedEntries, &params));
+        if (ringFd < 0) {
+            ringFd = -1;
+            return;
+        }
+        entries = params.sq_entries;
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMap) sqRingSize = cqRingSize = max(sqRingSize, cqRingSize);
+
+        sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+        cqRing = singleMap ? sqRing : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                           ringFd, IORING_OFF_CQ_RING);
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe *>(mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                                 ringFd, IORING_OFF_SQES));
+        if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqes == MAP_FAILED) {
+            release();
+            return;
+        }
+
+        char *sq = static_cast<char *>(sqRing);
+        char *cq = static_cast<char *>(cqRing);
+        sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+        sqMask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+        cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+        cqMask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+    }
+
+    ~IoUringQueue() {
+        release();
+    }
+
+    IoUringQueue(const IoUringQueue &) = delete;
+    IoUringQueue &operator=(const IoUringQueue &) = delete;
+
+    bool usable() const {
+        return ringFd != -1;
+    }
+
+    // Read every range of `fd`, up to `entries` submissions per io_uring_enter call. Returns
+    // false if io_uring_enter failed or the kernel rejected the read operation itself; the ring
+    // is then closed once no read is in flight, and the caller uses pread. Individual failed
+    // ranges are marked failed.
+    bool readRanges(int fd, vector<BatchReadRange> &ranges) {
+        for (size_t first = 0; first < ranges.size(); first += entries) {
+            unsigned count = static_cast<unsigned>(min<size_t>(entries, ranges.size() - first));
+
+            // Queue the reads
+            unsigned tail = atomic_ref<unsigned>(*sqTail).load(memory_order_relaxed);
+            for (unsigned i = 0; i < count; ++i) {
+                BatchReadRange &range = ranges[first + i];
+                range.data.resize(range.length);
+                unsigned index = tail & *sqMask;
+                io_uring_sqe &sqe = sqes[index];
+                memset(&sqe, 0, sizeof(sqe));
+                sqe.opcode = IORING_OP_READ;
+                sqe.fd = fd;
+                sqe.addr = reinterpret_cast<unsigned long long>(range.data.data());
+                sqe.len = static_cast<unsigned>(range.length);  // At most BatchReader's range cap
+                sqe.off = range.offset;
+                sqe.user_data = first + i;
+                sqArray[index] = index;
+                tail++;
+            }
+            atomic_ref<unsigned>(*sqTail).store(tail, memory_order_release);
+
+            // Submit them all and wait for all completions
+            vector<bool> done(count, false);
+            unsigned submitted = 0, completed = 0;
+            bool rejected = false;
+            while (completed < count && !rejected) {
+                long result = syscall(__NR_io_uring_enter, ringFd, count - submitted, count - completed,
+                                      IORING_ENTER_GETEVENTS, nullptr, 0);
+                if (result < 0 && errno == EINTR) continue;
+                if (result < 0) break;
+                submitted += static_cast<unsigned>(result);
+                completed += reap(ranges, first, done, rejected);
+            }
+            if (completed < count) {
+                abandon(ranges, first, done, submitted - completed);
+                return false;
+            }
+            if (rejected) {
+                release();
+                return false;
+            }
+        }
+        return true;
+    }
+};
+#endif
+
+class BatchReader {
+private:
+    // Bytes read past a record offset; longer records are finished with an extra read
+    static const size_t recordPeek = 256;
+    // Offsets closer than this are read as one range
+    static const size_t mergeDistance = 16 * 1024;
+    // ... as long as the range stays within this many bytes, which bounds the buffer of one read
+    static const size_t maxRangeLength = 1024 * 1024;
+    // Below this many ranges a submission costs more than it saves
+    static const size_t minRingBatch = 4;
+
+    // Whether io_uring failed at run time in this process (then pread is used from now on)
+    static atomic<bool> &ioUringDisabled() {
+        static atomic<bool> disabled{false};
+        return disabled;
+    }
+
+    // Read one range with pread, retrying short reads until the end of the file
+    static void preadRange(int fd, BatchReadRange &range) {
+        range.data.resize(range.length);
+        size_t done = 0;
+        while (done < range.length) {
+            ssize_t result = pread(fd, range.data.data() + done, range.length - done, range.offset + done);
+            if (result < 0 && errno == EINTR) continue;
+            if (result < 0) {
+                range.failed = true;
+                break;
+            }
+            if (result == 0) break;  // End of file
+            done += result;
+        }
+        range.data.resize(done);
+    }
+
+    // Read the line starting at `offset` with pread, for records longer than recordPeek
+    static string preadLine(int fd, off_t offset) {
+        string line;
+        char chunk[1024];
+        while (true) {
+            ssize_t result = pread(fd, chunk, sizeof(chunk), offset + line.size());
+            if (result < 0 && errno == EINTR) continue;
+            if (result <= 0) return line;
+            char *newline = static_cast<char *>(memchr(chunk, '\n', result));
+            line.append(chunk, newline ? newline - chunk : result);
+            if (newline) return line;
+        }
+    }
+
+    // Issue all ranges, as one io_uring batch when possible
+    static void readRanges(int fd, vector<BatchReadRange> &ranges) {
+#if HCMS_HAVE_IO_URING
+        if (ranges.size() >= minRingBatch && !ioUringDisabled().load(memory_order_relaxed)) {
+            static thread_local IoUringQueue queue;
+            if (queue.usable() && queue.readRanges(fd, ranges)) {
+                for (BatchReadRange &range : ranges) {
+                    // Finish short reads that stopped before the end of the file
+                    if (!range.failed && range.data.size() < range.length) {
+                        BatchReadRange rest;
+                        rest.offset = range.offset + range.data.size();
+                        rest.length = range.length - range.data.size();
+                        preadRange(fd, rest);
+                        range.data += rest.data;
+                    }
+                }
+                return;
+            }
+            ioUringDisabled() = true;
+        }
+#endif
+        for (BatchReadRange &range : ranges) {
+            range.failed = false;
+            preadRange(fd, range);
+        }
+    }
+
+public:
+    // Whether this build can use io_uring (it may still fall back to pread at run time)
+    static bool ioUringCompiledIn() {
+        return HCMS_HAVE_IO_URING;
+    }
+
+    // Read the record lines (without '\n') starting at each of `offsets` in `fileName`.
+    // lines[i] belongs to offsets[i]; a record that could not be read yields an empty line.
+    // Returns false if the file could not be opened.
+    static bool readLines(const string &fileName, const vector<int> &offsets, vector<string> &lines) {
+        lines.assign(offsets.size(), "");
+        if (offsets.empty()) return true;
+        int fd = open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1) return false;
+
+        // Sort the requests by offset and merge neighbours into ranges
+        vector<size_t> order(offsets.size());
+        for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+        sort(order.begin(), order.end(), [&offsets](size_t a, size_t b) { return offsets[a] < offsets[b]; });
+
+        vector<BatchReadRange> ranges;
+        vector<size_t> rangeOf(offsets.size());
+        for (size_t i : order) {
+            off_t offset = offsets[i];
+            if (ranges.empty() || offset - (ranges.back().offset + off_t(ranges.back().length)) > off_t(mergeDistance) ||
+                offset + off_t(recordPeek) - ranges.back().offset > off_t(maxRangeLength)) {
+                ranges.emplace_back();
+                ranges.back().offset = offset;
+            }
+            BatchReadRange &range = ranges.back();
+            range.length = max<size_t>(range.length, offset - range.offset + recordPeek);
+            rangeOf[i] = ranges.size() - 1;
+        }
+
+        readRanges(fd, ranges);
+        countStat(StatCounter::FileOpens);
+        countStat(StatCounter::Seeks, ranges.size());  // One positioned read per range
+        for (const BatchReadRange &range : ranges) {
+            countStat(StatCounter::BytesRead, range.data.size());
+        }
+
+        // Cut every record line out of its range
+        for (size_t i = 0; i < offsets.size(); ++i) {
+            const BatchReadRange &range = ranges[rangeOf[i]];
+            size_t start = offsets[i] - range.offset;
+            if (range.failed || start >= range.data.size()) continue;
+            size_t newline = range.data.find('\n', start);
+            if (newline != string::npos) {
+                lines[i] = range.data.substr(start, newline - start);
+            } else if (range.data.size() == range.length) {
+                lines[i] = preadLine(fd, offsets[i]);  // Longer than the peek window
+            } else {
+                lines[i] = range.data.substr(start);   // Last line of a file without a final '\n'
+            }
+        }
+        close(fd);
+        return true;
+    }
+};
+
+#endif //HEALTHCAREMANAGEMENTSYSTEM_BATCHREADER_H
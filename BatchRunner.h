@@ -0,0 +1,153 @@
+#ifndef HEALTHCAREMANAGEMENTSYSTEM_BATCHRUNNER_H
+#define HEALTHCAREMANAGEMENTSYSTEM_BATCHRUNNER_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include "DoctorManagementSystem.h"
+#include "AppointmentManagementSystem.h"
+#include "QueryHandler.h"
+#include "ResultSink.h"
+#include "TextAndStats.h"
+#include "StatementExecutor.h"
+
+using namespace std;
+
+// A statement read from a batch script, with its line number for error messages
+class BatchStatement {
+public:
+    size_t lineNumber; // Line of the script the statement came from
+    string text;       // Statement text, trimmed
+};
+
+// Accumulated execution time of one kind of statement
+class StatementTiming {
+public:
+    size_t count = 0;          // Statements executed
+    long long totalMicros = 0; // Total time spent
+    long long maxMicros = 0;   // Slowest single statement
+};
+
+// Runs commands and SQL-like queries from a script without any prompts.
+//
+// One statement per line (see StatementExecutor for the grammar); blank lines and lines
+// starting with '#' are ignored.
+//
+// Index files are written once at the end of the run (or at FLUSH) instead of after every
+// statement. Reading and parsing the script is pipelined with execution on a reader thread.
+class BatchRunner {
+private:
+    DoctorManagementSystem &doctorSystem;
+    AppointmentManagementSystem &appointmentSystem;
+    StatementExecutor executor;
+    map<string, StatementTiming> timings; // Timing per statement kind, e.g. "ADD DOCTOR"
+    size_t failedStatements = 0;          // Statements that could not be parsed or executed
+    const size_t pipelineDepth = 1024;    // Statements the reader may queue ahead of execution
+
+public:
+    BatchRunner(DoctorManagementSystem &doctorSys, AppointmentManagementSystem &appointmentSys,
+                QueryHandler &queryHandler)
+            : doctorSystem(doctorSys), appointmentSystem(appointmentSys),
+              executor(doctorSys, appointmentSys, queryHandler) {}
+
+    // Runs every statement of `input` and returns the number of failed statements.
+    // A timing summary is written to stderr at the end.
+    size_t run(istream &input, OutputFormat format = OutputFormat::Table) {
+        // Defer index persistence to a single flush at the end of the run
+        doctorSystem.setAutoPersist(false);
+        appointmentSystem.setAutoPersist(false);
+
+        // Reader stage: read and trim lines ahead of execution, through a bounded queue
+        mutex queueMutex;
+        condition_variable queueChanged;
+        deque<BatchStatement> pending;
+        bool inputDone = false;
+        thread reader([&] {
+            string line;
+            size_t lineNumber = 0;
+            while (getline(input, line)) {
+                lineNumber++;
+                trimBlanks(line);
+                if (line.empty() || line[0] == '#') continue;
+
+                unique_lock<mutex> lock(queueMutex);
+                queueChanged.wait(lock, [&] { return pending.size() < pipelineDepth; });
+                pending.push_back({lineNumber, std::move(line)});
+                queueChanged.notify_all();
+            }
+            lock_guard<mutex> lock(queueMutex);
+            inputDone = true;
+            queueChanged.notify_all();
+        });
+
+        // Execution stage: run statements in order as they arrive
+        ResultSink sink(format);
+        auto runStart = chrono::steady_clock::now();
+        size_t executed = 0;
+        while (true) {
+            BatchStatement statement;
+            {
+                unique_lock<mutex> lock(queueMutex);
+                queueChanged.wait(lock, [&] { return inputDone || !pending.empty(); });
+                if (pending.empty()) break;
+                statement = std::move(pending.front());
+                pending.pop_front();
+                queueChanged.notify_all();
+            }
+
+            string kind;
+            auto start = chrono::steady_clock::now();
+            bool ok = executor.execute(statement.text, sink, kind);
+            sink.flush();  // Keep results in order with messages printed by the management systems
+            long long micros = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+
+            StatementTiming &timing = timings[kind];
+            timing.count++;
+            timing.totalMicros += micros;
+            timing.maxMicros = max(timing.maxMicros, micros);
+            executed++;
+            if (!ok) {
+                failedStatements++;
+                cerr << "Line " << statement.lineNumber << ": statement failed: " << statement.text << "\n";
+            }
+        }
+        reader.join();
+
+        // Single index flush for the whole run
+        auto flushStart = chrono::steady_clock::now();
+        doctorSystem.flush();
+        appointmentSystem.flush();
+        doctorSystem.setAutoPersist(true);
+        appointmentSystem.setAutoPersist(true);
+        auto runEnd = chrono::steady_clock::now();
+
+        double seconds = chrono::duration<double>(runEnd - runStart).count();
+        long long flushMicros = chrono::duration_cast<chrono::microseconds>(runEnd - flushStart).count();
+        printSummary(executed, seconds, flushMicros);
+        return failedStatements;
+    }
+
+    // Writes the per-statement-kind timing summary to stderr
+    void printSummary(size_t executed, double seconds, long long flushMicros) {
+        cerr << "Batch summary: " << executed << " statements in " << fixed << setprecision(3) << seconds << " s ("
+             << setprecision(0) << (seconds > 0 ? executed / seconds : 0.0) << " statements/s), "
+             << failedStatements << " failed, final index flush " << flushMicros << " us\n";
+        for (const auto &entry : timings) {
+            const StatementTiming &timing = entry.second;
+            cerr << "  " << left << setw(20) << entry.first << right
+                 << " count " << setw(8) << timing.count
+                 << "  avg " << setw(8) << setprecision(1) << static_cast<double>(timing.totalMicros) / timing.count
+                 << " us  max " << setw(8) << timing.maxMicros << " us\n";
+        }
+        cerr.unsetf(ios::floatfield);
+        cerr << setprecision(6);
+    }
+};
+
+#endif //HEALTHCAREMANAGEMENTSYSTEM_BATCHRUNNER_H
@@ -0,0 +1,160 @@
+#ifndef HEALTHCAREMANAGEMENTSYSTEM_BLOOMFILTER_H
+#define HEALTHCAREMANAGEMENTSYSTEM_BLOOMFILTER_H
+
+#include <string>
+#include <string_view>
+#include <sstream>
+#include <fstream>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include "DurableFile.h"
+
+using namespace std;
+
+// 64-bit FNV-1a hash of a byte string. It does not depend on the standard library
+// implementation, so its values may be stored on disk (shard placement, filter files).
+static uint64_t fnv1aHash(string_view bytes) {
+    uint64_t hash = 14695981039346656037ull;
+    for (char ch : bytes) {
+        hash = (hash ^ static_cast<unsigned char>(ch)) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// Bloom filter over the keys of an index, checked before a lookup so that a key that is not
+// indexed is rejected without searching.
+//
+// The filter is blocked: all probes of a key fall into one 64-byte block, so a check costs a
+// single cache miss. With 10 bits per key and 7 probes about 1% of absent keys pass. Bits are
+// atomic words, so lock-free readers may check while the writer adds keys. Keys cannot be
+// removed; a removed key only raises the false positive rate until the filter is rebuilt, which
+// the index does once more keys were added than the filter was sized for.
+//
+// A filter is saved next to its index file, together with a hash of the index file's contents;
+// it is used at load time only if that hash matches, and rebuilt from the index otherwise.
+class BloomFilter {
+private:
+    static const int probes = 7;            // Bits set per key
+    static const size_t bitsPerKey = 10;    // Filter size per key of capacity
+    static const size_t wordsPerBlock = 8;  // 512-bit blocks, one cache line
+
+    size_t blockCount;                      // Number of blocks
+    size_t capacity;                        // Keys the filter is sized for
+    size_t addedKeys = 0;                   // Keys added since the filter was built (writer only)
+    unique_ptr<atomic<uint64_t>[]> words;   // blockCount * wordsPerBlock bits words
+
+    // splitmix64 finalizer: spreads the FNV hash over all 64 bits
+    static uint64_t mix(uint64_t hash) {
+        hash ^= hash >> 30;
+        hash *= 0xbf58476d1ce4e5b9ull;
+        hash ^= hash >> 27;
+        hash *= 0x94d049bb133111ebull;
+        return hash ^ (hash >> 31);
+    }
+
+    // First word of the key's block; `probeBits` receives 7 x 9 bits selecting the bits in it
+    size_t blockOf(string_view key, uint64_t &probeBits) const {
+        uint64_t hash = mix(fnv1aHash(key));
+        probeBits = mix(hash);
+        size_t block = static_cast<size_t>((static_cast<unsigned __int128>(hash) * blockCount) >> 64);
+        return block * wordsPerBlock;
+    }
+
+    BloomFilter(size_t blockCount, size_t capacity)
+            : blockCount(blockCount), capacity(capacity),
+              words(new atomic<uint64_t>[blockCount * wordsPerBlock]) {
+        for (size_t i = 0; i < blockCount * wordsPerBlock; ++i) {
+            words[i].store(0, memory_order_relaxed);
+        }
+    }
+
+public:
+    // An empty filter sized for twice `expectedKeys`, so that it takes as many adds again
+    // before it has to be rebuilt
+    explicit BloomFilter(size_t expectedKeys)
+            : BloomFilter((max<size_t>(expectedKeys * 2, 512) * bitsPerKey + 511) / 512, max<size_t>(expectedKeys * 2, 512)) {}
+
+    BloomFilter(const BloomFilter &) = delete;
+    BloomFilter &operator=(const BloomFilter &) = delete;
+
+    // Add a key (one writer at a time; concurrent checks are safe)
+    void add(string_view key) {
+        uint64_t probeBits;
+        size_t first = blockOf(key, probeBits);
+        for (int i = 0; i < probes; ++i, probeBits >>= 9) {
+            unsigned bit = probeBits & 511;
+            words[first + bit / 64].fetch_or(1ull << (bit % 64), memory_order_relaxed);
+        }
+        addedKeys++;
+    }
+
+    // False if the key was never added; true if it may have been
+    bool mayContain(string_view key) const {
+        uint64_t probeBits;
+        size_t first = blockOf(key, probeBits);
+        for (int i = 0; i < probes; ++i, probeBits >>= 9) {
+            unsigned bit = probeBits & 511;
+            if (!(words[first + bit / 64].load(memory_order_relaxed) & (1ull << (bit % 64)))) return false;
+        }
+        return true;
+    }
+
+    // Bytes of the filter's bit array
+    size_t byteSize() const {
+        return blockCount * wordsPerBlock * sizeof(uint64_t);
+    }
+
+    // Whether more keys were added than the filter is sized for
+    bool needsRebuild() const {
+        return addedKeys > capacity;
+    }
+
+    // Write the filter to `fileName`, tagged with the hash of the index contents it describes.
+    // The write is not synced: a filter lost or left stale by a crash is rebuilt at load.
+    bool save(const string &fileName, uint64_t contentsHash) const {
+        ostringstream contents;
+        contents << "bloom " << blockCount << ' ' << capacity << ' ' << addedKeys << ' ' << contentsHash << '\n';
+        for (size_t i = 0; i < blockCount * wordsPerBlock; ++i) {
+            uint64_t word = words[i].load(memory_order_relaxed);
+            contents.write(reinterpret_cast<const char *>(&word), sizeof(word));
+        }
+        return replaceFileAtomically(fileName, contents.str(), false);
+    }
+
+    // Read a filter saved for index contents with hash `contentsHash`; nullptr if the file is
+    // missing, damaged or describes other contents
+    static unique_ptr<BloomFilter> load(const string &fileName, uint64_t contentsHash) {
+        ifstream file(fileName, ios::in | ios::binary);
+        string magic;
+        size_t blocks = 0, capacity = 0, added = 0;
+        uint64_t savedHash = 0;
+        if (!(file >> magic >> blocks >> capacity >> added >> savedHash) || magic != "bloom" ||
+            savedHash != contentsHash || blocks == 0 || blocks > (size_t(1) << 32) || file.get() != '\n') {
+            return nullptr;
+        }
+        unique_ptr<BloomFilter> filter(new BloomFilter(blocks, capacity));
+        filter->addedKeys = added;
+        for (size_t i = 0; i < blocks * wordsPerBlock; ++i) {
+            uint64_t word;
+            if (!file.read(reinterpret_cast<char *>(&word), sizeof(word))) return nullptr;
+            filter->words[i].store(word, memory_order_relaxed);
+        }
+        return filter;
+    }
+};
+
+// File a filter of the index in `indexFileName` is saved to ("DoctorPrimaryIndex.txt" ->
+// "DoctorPrimaryIndex.filter")
+static string filterFileName(const string &indexFileName) {
+    const string extension = ".txt";
+    if (indexFileName.size() > extension.size() &&
+        indexFileName.compare(indexFileName.size() - extension.size(), extension.size(), extension) == 0) {
+        return indexFileName.substr(0, indexFileName.size() - extension.size()) + ".filter";
+    }
+    return indexFileName + ".filter";
+}
+
+#endif //HEALTHCAREMANAGEMENTSYSTEM_BLOOMFILTER_H
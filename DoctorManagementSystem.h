@@ -4,6 +4,18 @@
 #include "PrimaryIndex.h"
 #include "SecondaryIndex.h"
 #include "AvailList.h"
+#include "TableChange.h"
+#include "VersionStore.h"
+#include "ResultSink.h"
+#include "ParallelScan.h"
+#include "BatchReader.h"
+#include "ShardLayout.h"
+#include "IndexRebuild.h"
+#include "StorageStats.h"
+#include "LatencyHistograms.h"
+#include <shared_mutex>
+#include <mutex>
+#include <functional>
 
 using namespace std;
 
@@ -26,38 +38,87 @@ public:
             : id(id), name(name), address(address) {}
 };
 
+// What deleting a doctor does to the appointments that refer to it (ON DELETE ...)
+enum class ReferentialAction {
+    NoAction,  // The appointments are left as they are
+    Restrict,  // A doctor with appointments cannot be deleted
+    Cascade    // The doctor's appointments are deleted with it (refused if some are in sealed partitions)
+};
+
+// Parse "no-action", "restrict" or "cascade"; returns false if the text is not an action
+inline bool parseReferentialAction(const string &text, ReferentialAction &action) {
+    if (text == "no-action") action = ReferentialAction::NoAction;
+    else if (text == "restrict") action = ReferentialAction::Restrict;
+    else if (text == "cascade") action = ReferentialAction::Cascade;
+    else return false;
+    return true;
+}
+
+// Records of another table that refer to doctors by ID. The appointment system registers them,
+// since the doctor system cannot see it. Called with the doctor's shard locked exclusively.
+class DoctorReferences {
+public:
+    function<vector<string>(const string &doctorId)> find;  // IDs of the records referring to a doctor
+    function<void(const string &doctorId)> deleteAll;       // Delete them in one batch
+    function<size_t(const string &doctorId)> countSealed;   // How many of them can no longer be deleted
+};
 
 class DoctorManagementSystem {
 private:
-    // Objects for managing primary and secondary indices and an availability list
-    PrimaryIndex doctorPrimaryIndex;
-    SecondaryIndex doctorSecondaryIndex;
-    AvailList doctorAvailList;
-
-public:
-    // Constructor to set file names for indices and availability list
-    DoctorManagementSystem() {
-        doctorPrimaryIndex.setPrimaryIndexFileName("DoctorPrimaryIndex.txt");
-        doctorSecondaryIndex.setSecondaryIndexAndLabelIdListFileNames("DoctorSecondaryIndex.txt",
-                                                                      "DoctorLabelIdList.txt");
-        doctorAvailList.setAvailListFileName("DoctorAvailList.txt");
+    // The doctors, partitioned by a hash of their ID (a single shard in the classic layout). Each
+    // shard has its own data file, primary and secondary index, availability list and versions.
+    TableShards shards;
+
+    // Concurrency: every shard has its own tableMutex. Readers (lookups, searches, prints) hold it
+    // shared and run in parallel; add, update and delete hold it exclusively. A shard's file and
+    // index structures are only touched under its lock, so writes to different shards run in
+    // parallel. Full-table reports (scanDoctors, printAllDoctors) hold it only to open a snapshot
+    // and then read without it. When two shard locks are needed they are taken together with
+    // scoped_lock, which avoids lock-order deadlocks.
+    mutex idMutex;           // Protects largestId
+    int largestId = -1;      // Largest doctor ID handed out over all shards (-1 until loaded)
+    mutex listenerMutex;                                    // Protects changeListeners
+    vector<pair<int, TableChangeListener>> changeListeners; // Observers notified after every mutation
+    int nextListenerId = 0;                                 // Handle given to the next observer
+    ReferentialAction onDelete = ReferentialAction::NoAction; // Effect of a delete on the appointments
+    DoctorReferences references;                            // The appointments referring to doctors
+
+    // Notify the observers that a doctor record was added, changed or deleted
+    void notifyChange(const TableChange &change) {
+        lock_guard<mutex> lock(listenerMutex);
+        for (const auto &listener : changeListeners) {
+            listener.second(change);
+        }
     }
 
-    // Getter for the primary index
-    PrimaryIndex &getDoctorPrimaryIndex() {
-        return doctorPrimaryIndex;
+    // Shard that holds (or will hold) a doctor ID
+    TableShard &shardFor(const string &id) const {
+        return *shards[shardOfKey(id, shards.size())];
     }
 
-    // Function to add a new doctor record
-    void addDoctor(Doctor &doctor) {
-        // Generate a new unique ID for the doctor
-        doctor.id = doctorPrimaryIndex.getNewId();
+    // Generate a new unique ID, one past the largest ID of all shards
+    string newDoctorId() {
+        lock_guard<mutex> lock(idMutex);
+        if (largestId < 0) {
+            largestId = 0;
+            for (const auto &shard : shards) {
+                largestId = max(largestId, shard->primaryIndex.getLargestId());
+            }
+        }
+        int newId = ++largestId;
+        return (newId < 10) ? "0" + to_string(newId) : to_string(newId); // Ensure two-digit IDs
+    }
 
-        fstream file("doctors.txt", ios::in | ios::out);
+    // Write a doctor record to the best fitting free slot, or at the end of the data file, without
+    // indexing it; returns its offset, or -1 if the file could not be opened. The caller holds the
+    // shard's lock exclusively.
+    int writeDoctorRecord(TableShard &shard, const Doctor &doctor) {
+        fstream file(shard.dataFileName, ios::in | ios::out);
         if (!file.is_open()) {
-            cerr << "Error opening file: doctors.txt" << endl;
-            return;
+            cerr << "Error opening file: " << shard.dataFileName << endl;
+            return -1;
         }
+        countStat(StatCounter::FileOpens);
 
         // Calculate the length of the record to be stored
         int lengthIndicator = static_cast<int>(doctor.id.size()) +
@@ -65,7 +126,7 @@ public:
                               static_cast<int>(doctor.address.size()) + 4;
 
         // Find the best fit for the record in the availability list
-        AvailListNode *node = doctorAvailList.bestFit(lengthIndicator);
+        AvailListNode *node = shard.availList.bestFit(lengthIndicator);
 
         string newRecord = "";
         int offset;
@@ -87,8 +148,10 @@ public:
             newRecord += '\n';
             file.write(newRecord.c_str(), node->size);
             offset = node->offset;
+            countStat(StatCounter::Seeks, 2);
+            countStat(StatCounter::BytesWritten, 1 + node->size);
 
-            doctorAvailList.remove(node); // Remove the node from the availability list
+            shard.availList.remove(node); // Remove the node from the availability list
         } else {
             // Append a new record at the end if no suitable space is found
             newRecord += " |";
@@ -100,36 +163,117 @@ public:
             file.seekp(0, ios::end);
             offset = static_cast<int>(file.tellp());
             file.write(newRecord.c_str(), newRecord.size());
+            countStat(StatCounter::Seeks);
+            countStat(StatCounter::BytesWritten, newRecord.size());
         }
+        file.close();
+        return offset;
+    }
 
-        cout << "Doctor " << doctor.name << " is added with ID " << stoi(doctor.id) << endl;
+    // Write a new doctor record with an already assigned ID and index it; the caller holds the
+    // shard's lock exclusively. Returns false if the data file could not be written.
+    bool addDoctorRecord(TableShard &shard, Doctor &doctor) {
+        int offset = writeDoctorRecord(shard, doctor);
+        if (offset == -1) return false;
 
-        file.close();
+        countStat(StatCounter::DoctorAdds);
+        confirm("Doctor " + doctor.name + " is added with ID " + to_string(stoi(doctor.id)));
 
         // Update the indices with the new record information
-        doctorPrimaryIndex.addPrimaryNode(doctor.id, offset);
-        doctorSecondaryIndex.addPrimaryKeyToSecondaryNode(doctor.name, doctor.id);
+        shard.primaryIndex.addPrimaryNode(doctor.id, offset);
+        shard.secondaryIndex.addPrimaryKeyToSecondaryNode(doctor.name, doctor.id);
+        notifyChange({"doctors", {{"id", doctor.id}, {"name", doctor.name}, {"address", doctor.address}}});
+        return true;
+    }
+
+    // Mark a doctor record as deleted and unindex it; the caller holds the shard's lock
+    // exclusively. The deleted record's fields are stored in `deleted` if given.
+    void deleteDoctorRecord(TableShard &shard, const string &id, Doctor *deleted = nullptr) {
+        // Find the record's offset in the primary index
+        int offset = shard.primaryIndex.binarySearchPrimaryIndex(id);
+        if (offset == -1) {
+            confirm("Doctor with ID " + id + " not found.");
+            return;
+        }
+
+        fstream doctorFile(shard.dataFileName, ios::in | ios::out);
+        if (!doctorFile.is_open()) {
+            cerr << "Error opening file: " << shard.dataFileName << "\n";
+            return;
+        }
+
+        // Read the record, keep the old version for open snapshots and mark the record as
+        // deleted by replacing its status byte
+        doctorFile.seekg(offset, ios::beg);
+        string line;
+        getline(doctorFile, line);
+        shard.versions.preserve(id, line);
+        doctorFile.seekp(offset, ios::beg);
+        doctorFile.put('*');
+        doctorFile.close();  // The mark is in the file before the indexes are persisted
+        countStat(StatCounter::FileOpens);
+        countStat(StatCounter::Seeks, 2);
+        countStat(StatCounter::BytesRead, line.size() + 1);
+        countStat(StatCounter::BytesWritten, 1);
+        countStat(StatCounter::DoctorDeletes);
+
+        // Parse the record
+        istringstream recordStream(line);
+        string status, recordLen, record_id, name, address;
+        getline(recordStream, status, '|');
+        getline(recordStream, recordLen, '|');
+        getline(recordStream, record_id, '|');
+        getline(recordStream, name, '|');
+        getline(recordStream, address, '|');
+
+        // Get the record's length and add it to the availability list
+        int lengthIndicator = stoi(recordLen);
+        AvailListNode *newNode = new AvailListNode(offset, lengthIndicator);
+        shard.availList.insert(newNode);
+
+        // Remove the doctor from the indices
+        shard.primaryIndex.removePrimaryNode(id);
+        shard.secondaryIndex.removePrimaryKeyFromSecondaryNode(name, id);
+        notifyChange({"doctors", {{"id", id}, {"name", name}, {"address", address}}});
+        if (deleted != nullptr) *deleted = Doctor(record_id, name, address);
+
+        confirm("Doctor with ID " + to_string(stoi(id)) + " has been marked as deleted.");
+    }
+
+    // Reports why a change was refused: to `error` if given, else as a confirmation (to the
+    // console unless redirected). Returns false.
+    static bool refuse(string *error, const string &reason) {
+        if (error != nullptr) *error = reason;
+        else confirm(reason);
+        return false;
     }
 
-    // Function to update a doctor's name
-    void updateDoctorName(const string &id, string &newName) {
+    // Rename a doctor; the caller holds the shard's lock exclusively. The record is changed in
+    // place if the new name fits in its slot. Otherwise it is written to a new slot under the same
+    // ID and its old slot goes to the availability list, so references to the ID stay valid.
+    // Returns false if the ID is not indexed or the data file could not be opened. The previous
+    // name is stored in `oldName` if given.
+    bool renameDoctorRecord(TableShard &shard, const string &id, const string &newName, string *oldName = nullptr) {
         // Find the doctor's record offset in the primary index
-        int offset = doctorPrimaryIndex.binarySearchPrimaryIndex(id);
+        int offset = shard.primaryIndex.binarySearchPrimaryIndex(id);
 
         if (offset == -1) {
             cerr << "Error: Doctor ID not found in primary index.\n";
-            return;
+            return false;
         }
-        fstream doctorFile("doctors.txt", ios::in | ios::out);
+        fstream doctorFile(shard.dataFileName, ios::in | ios::out);
         if (!doctorFile.is_open()) {
-            cerr << "Error: Could not open doctors.txt file.\n";
-            return;
+            cerr << "Error: Could not open " << shard.dataFileName << " file.\n";
+            return false;
         }
 
         // Move to the record's offset and read its content
         doctorFile.seekg(offset, ios::beg);
         string line;
         getline(doctorFile, line);
+        countStat(StatCounter::FileOpens);
+        countStat(StatCounter::Seeks);
+        countStat(StatCounter::BytesRead, line.size() + 1);
 
         // Parse the record
         istringstream recordStream(line);
@@ -142,13 +286,27 @@ public:
 
         // Calculate the new record size
         int newSize = newName.size() + record_id.size() + address.size() + 4;
+        if (newSize > stoi(recordLen)) {
+            // Write the renamed record elsewhere first; until the index points at it, readers
+            // still find the old record
+            int newOffset = writeDoctorRecord(shard, Doctor(record_id, newName, address));
+            if (newOffset == -1) return false;
+
+            // Keep the old version for open snapshots, then free the old slot
+            shard.versions.preserve(id, line);
+            doctorFile.seekp(offset, ios::beg);
+            doctorFile.put('*');
+            doctorFile.close();
+            countStat(StatCounter::Seeks);
+            countStat(StatCounter::BytesWritten, 1);
+            shard.availList.insert(new AvailListNode(offset, stoi(recordLen)));
+            shard.primaryIndex.updatePrimaryNodeOffset(id, newOffset);
+        } else {
+            // Update the record directly, keeping the old version for open snapshots
+            shard.versions.preserve(id, line);
 
-        if (newSize <= stoi(recordLen)) {
-            // Update the record directly if it fits in the same space
-            doctorSecondaryIndex.removePrimaryKeyFromSecondaryNode(name, id);
-            doctorSecondaryIndex.addPrimaryKeyToSecondaryNode(newName, id);
-
-            doctorFile.seekp(offset + 8, ios::beg);
+            // The name starts after " |LL|<id>|"; IDs have two or more digits
+            doctorFile.seekp(offset + status.size() + 1 + recordLen.size() + 1 + record_id.size() + 1, ios::beg);
             doctorFile << newName << '|' << address << '|';
 
             // Add padding if there's excess space
@@ -156,86 +314,370 @@ public:
             for (int i = 0; i < excess; ++i) {
                 doctorFile << '-';
             }
-        } else {
-            // Delete the current record and add a new one if space is insufficient
-            deleteDoctor(record_id);
-            Doctor doctor;
-            doctor.id = doctorPrimaryIndex.getNewId();
-            doctor.name = newName;
-            doctor.address = address;
-            addDoctor(doctor);
+            doctorFile.close();
+            countStat(StatCounter::Seeks);
+            countStat(StatCounter::BytesWritten, newName.size() + address.size() + 2 + excess);
         }
-        cout << "Doctor's name updated successfully.\n";
 
-        doctorFile.close();
+        shard.secondaryIndex.removePrimaryKeyFromSecondaryNode(name, id);
+        shard.secondaryIndex.addPrimaryKeyToSecondaryNode(newName, id);
+        countStat(StatCounter::DoctorUpdates);
+        notifyChange({"doctors", {{"id", id}, {"name", name}, {"name", newName}, {"address", address}}});
+        if (oldName != nullptr) *oldName = name;
+        return true;
     }
 
-    // Function to delete a doctor's record
-    void deleteDoctor(const string &id) {
-        // Find the record's offset in the primary index
-        int offset = doctorPrimaryIndex.binarySearchPrimaryIndex(id);
-        if (offset == -1) {
-            cout << "Doctor with ID " << id << " not found.\n";
-            return;
+public:
+    // Constructor to open the doctor shards of the current layout and load their indices
+    DoctorManagementSystem() : shards(openTableShards(doctorFileNames)) {}
+
+    // Number of shards the doctors are partitioned into
+    size_t shardCount() const {
+        return shards.size();
+    }
+
+    // Every shard, for whole-table maintenance such as the memory budget
+    TableShards allShards() const {
+        return shards;
+    }
+
+    // Check whether a doctor ID exists. Lock-free: the primary index is read without tableMutex.
+    bool doctorExists(const string &id) const {
+        return shardFor(id).primaryIndex.binarySearchPrimaryIndex(id) != -1;
+    }
+
+    // Lock a doctor's shard shared: the doctor cannot be deleted until the lock is released. The
+    // appointment system holds it while it books an appointment for the doctor.
+    shared_lock<shared_mutex> lockDoctorShared(const string &id) const {
+        return shared_lock<shared_mutex>(shardFor(id).tableMutex);
+    }
+
+    // Number of doctors
+    size_t countDoctors() const {
+        size_t count = 0;
+        for (const auto &shard : shards) {
+            count += shard->primaryIndex.size();
         }
+        return count;
+    }
 
-        fstream doctorFile("doctors.txt", ios::in | ios::out);
-        if (!doctorFile.is_open()) {
-            cerr << "Error opening file: doctors.txt\n";
-            return;
+    // Enable or disable writing the index files after every operation; when disabled, call flush()
+    void setAutoPersist(bool enabled) {
+        for (auto &shard : shards) {
+            unique_lock<shared_mutex> lock(shard->tableMutex);
+            shard->primaryIndex.setAutoPersist(enabled);
+            shard->secondaryIndex.setAutoPersist(enabled);
+            shard->availList.setAutoPersist(enabled);
         }
+    }
 
-        // Mark the record as deleted by replacing its status byte
-        doctorFile.seekp(offset, ios::beg);
-        doctorFile.put('*');
+    // Register an observer that is called after every add, update and delete; returns its handle
+    int addChangeListener(TableChangeListener listener) {
+        lock_guard<mutex> lock(listenerMutex);
+        changeListeners.emplace_back(nextListenerId, std::move(listener));
+        return nextListenerId++;
+    }
 
-        doctorFile.seekg(-1, ios::cur);
-        string line;
-        getline(doctorFile, line);
+    // Unregister an observer by the handle addChangeListener returned
+    void removeChangeListener(int listenerId) {
+        lock_guard<mutex> lock(listenerMutex);
+        changeListeners.erase(remove_if(changeListeners.begin(), changeListeners.end(),
+                                        [listenerId](const auto &listener) { return listener.first == listenerId; }),
+                              changeListeners.end());
+    }
 
-        // Parse the record
-        istringstream recordStream(line);
-        string status, recordLen, record_id, name, address;
-        getline(recordStream, status, '|');
-        getline(recordStream, recordLen, '|');
-        getline(recordStream, record_id, '|');
-        getline(recordStream, name, '|');
-        getline(recordStream, address, '|');
+    // Write pending index changes to their files
+    void flush() {
+        for (auto &shard : shards) {
+            unique_lock<shared_mutex> lock(shard->tableMutex);
+            shard->primaryIndex.flush();
+            shard->secondaryIndex.flush();
+            shard->availList.flush();
+        }
+    }
 
-        // Get the record's length and add it to the availability list
-        int lengthIndicator = stoi(recordLen);
-        AvailListNode *newNode = new AvailListNode(offset, lengthIndicator);
-        doctorAvailList.insert(newNode);
+    // Function to add a new doctor record
+    void addDoctor(Doctor &doctor) {
+        LatencyTimer timer(TimedOperation::AddDoctor);
+        // Generate a new unique ID for the doctor; it decides the shard
+        doctor.id = newDoctorId();
+        TableShard &shard = shardFor(doctor.id);
+        unique_lock<shared_mutex> lock(shard.tableMutex);
+        addDoctorRecord(shard, doctor);
+    }
 
-        // Remove the doctor from the indices
-        doctorPrimaryIndex.removePrimaryNode(id);
-        doctorSecondaryIndex.removePrimaryKeyFromSecondaryNode(name, id);
+    // Function to update a doctor's name. Returns false if the doctor was not renamed; why goes
+    // to `error` if given, else to the console.
+    bool updateDoctorName(const string &id, string &newName, string *error = nullptr) {
+        LatencyTimer timer(TimedOperation::UpdateDoctorName);
+        TableShard &shard = shardFor(id);
+        unique_lock<shared_mutex> lock(shard.tableMutex);
+        if (shard.primaryIndex.binarySearchPrimaryIndex(id) == -1) {
+            return refuse(error, "Doctor with ID " + id + " not found.");
+        }
+        bool renamed;
+        {
+            // The secondary index entry is removed and re-added, and a moved record changes the
+            // primary index and the availability list too; persist each structure once
+            ShardChangeGroup group(shard);
+            renamed = renameDoctorRecord(shard, id, newName);
+        }
+        if (!renamed) return refuse(error, "Doctor's name could not be updated.");
+        confirm("Doctor's name updated successfully.");
+        return true;
+    }
 
-        cout << "Doctor with ID " << stoi(id) << " has been marked as deleted.\n";
+    // Set what deleting a doctor does to its appointments; set it at startup
+    void setOnDelete(ReferentialAction action) {
+        onDelete = action;
+    }
+
+    ReferentialAction onDeleteAction() const {
+        return onDelete;
+    }
 
-        doctorFile.close();
+    // Register the records that refer to doctors (done by the appointment system)
+    void setReferences(DoctorReferences doctorReferences) {
+        references = std::move(doctorReferences);
+    }
+
+    // Function to delete a doctor's record, applying the ON DELETE action to its appointments.
+    // Returns false if the doctor was not deleted; why goes to `error` if given, else to the
+    // console. The appointments are looked up and deleted while the doctor's shard is locked, so
+    // no appointment can be booked for it meanwhile.
+    bool deleteDoctor(const string &id, string *error = nullptr) {
+        LatencyTimer timer(TimedOperation::DeleteDoctor);
+        TableShard &shard = shardFor(id);
+        unique_lock<shared_mutex> lock(shard.tableMutex);
+        if (shard.primaryIndex.binarySearchPrimaryIndex(id) == -1) {
+            return refuse(error, "Doctor with ID " + id + " not found.");
+        }
+        bool checkReferences = onDelete != ReferentialAction::NoAction && references.find;
+        if (checkReferences && onDelete == ReferentialAction::Restrict) {
+            size_t dependents = references.find(id).size();
+            if (dependents > 0) {
+                return refuse(error, "Doctor with ID " + to_string(stoi(id)) + " has " + to_string(dependents) +
+                                     " appointment(s) and cannot be deleted.");
+            }
+        }
+
+        if (checkReferences && onDelete == ReferentialAction::Cascade && references.countSealed) {
+            size_t sealed = references.countSealed(id);
+            if (sealed > 0) {
+                return refuse(error, "Doctor with ID " + to_string(stoi(id)) + " has " + to_string(sealed) +
+                                     " appointment(s) in sealed partitions and cannot be deleted.");
+            }
+        }
+
+        Doctor deleted;
+        deleteDoctorRecord(shard, id, &deleted);
+        if (deleted.id.empty()) return false;
+        if (checkReferences && onDelete == ReferentialAction::Cascade) {
+            references.deleteAll(id);
+        }
+        return true;
     }
 
-    // Function to search for doctors by their name using the secondary index
+    // Transactions (Transaction.h) stage their changes and apply them all at once while holding
+    // this lock: every doctor shard locked exclusively, with each index persisted once when the
+    // lock is released. The *Locked functions below may only be called while it is held.
+    unique_ptr<TableWriteLock> lockForWrite() {
+        return make_unique<TableWriteLock>(shards);
+    }
+
+    // Hand out a doctor ID now for a record a transaction adds later; an ID of an aborted
+    // transaction is not reused
+    string reserveDoctorId() {
+        return newDoctorId();
+    }
+
+    // Add a doctor whose ID was reserved with reserveDoctorId, or re-add a deleted one under its
+    // old ID (lockForWrite held). Returns false if the record could not be written.
+    bool addDoctorLocked(Doctor &doctor) {
+        return addDoctorRecord(shardFor(doctor.id), doctor);
+    }
+
+    // Update a doctor's name; the doctor keeps its ID (lockForWrite held). The previous name is
+    // stored in `oldName` if given. Returns false if the doctor was not renamed.
+    bool updateDoctorNameLocked(const string &id, const string &newName, string *oldName = nullptr) {
+        if (!renameDoctorRecord(shardFor(id), id, newName, oldName)) return false;
+        confirm("Doctor's name updated successfully.");
+        return true;
+    }
+
+    // Delete a doctor without applying the ON DELETE action, which the transaction applies itself
+    // (lockForWrite held). The deleted record is stored in `deleted` if given. Returns false if
+    // the doctor was not deleted.
+    bool deleteDoctorLocked(const string &id, Doctor *deleted = nullptr) {
+        Doctor record;
+        deleteDoctorRecord(shardFor(id), id, &record);
+        if (deleted != nullptr) *deleted = record;
+        return !record.id.empty();
+    }
+
+    // Function to search for doctors by their name using the secondary indexes of all shards
     vector<string> searchDoctorsByName(const string &name) {
+        LatencyTimer timer(TimedOperation::SearchDoctorsByName);
         // Retrieve a list of doctor IDs associated with the given name
-        vector<string> doctorIds = doctorSecondaryIndex.getPrimaryKeysBySecondaryKey(name);
+        vector<string> doctorIds;
+        for (auto &shard : shards) {
+            shared_lock<shared_mutex> lock(shard->tableMutex);
+            vector<string> shardIds = shard->secondaryIndex.getPrimaryKeysBySecondaryKey(name);
+            doctorIds.insert(doctorIds.end(), shardIds.begin(), shardIds.end());
+        }
+        if (shards.size() > 1) sort(doctorIds.begin(), doctorIds.end());
         return doctorIds;
     }
 
+    // Function to count doctors with a given name from the secondary indexes alone
+    int countDoctorsByName(const string &name) {
+        int count = 0;
+        for (auto &shard : shards) {
+            shared_lock<shared_mutex> lock(shard->tableMutex);
+            count += shard->secondaryIndex.countPrimaryKeysBySecondaryKey(name);
+        }
+        return count;
+    }
+
+    // Function to read a doctor's record by ID; returns false if the ID is not indexed
+    bool readDoctor(const string &id, Doctor &doctor) {
+        LatencyTimer timer(TimedOperation::ReadDoctor);
+        TableShard &shard = shardFor(id);
+        shared_lock<shared_mutex> lock(shard.tableMutex);
+        int offset = shard.primaryIndex.binarySearchPrimaryIndex(id);
+        if (offset == -1) {
+            return false;
+        }
+
+        ifstream file(shard.dataFileName, ios::in);
+        if (!file.is_open()) {
+            cerr << "Error opening file: " << shard.dataFileName << "\n";
+            return false;
+        }
+
+        // Move to the record's offset and parse it
+        file.seekg(offset, ios::beg);
+        string line;
+        getline(file, line);
+        countStat(StatCounter::FileOpens);
+        countStat(StatCounter::Seeks);
+        countStat(StatCounter::BytesRead, line.size() + 1);
+        countStat(StatCounter::DoctorReads);
+        istringstream recordStream(line);
+        string status, length;
+        getline(recordStream, status, '|');
+        getline(recordStream, length, '|');
+        getline(recordStream, doctor.id, '|');
+        getline(recordStream, doctor.name, '|');
+        getline(recordStream, doctor.address, '|');
+        return true;
+    }
+
+    // Function to read several doctors' records with one batch of I/O per shard. The result is in
+    // the order of `ids`; doctors that are not indexed come back with an empty ID.
+    vector<Doctor> readDoctors(const vector<string> &ids) {
+        LatencyTimer timer(TimedOperation::ReadDoctors);
+        vector<Doctor> doctors(ids.size());
+        vector<int> offsets;
+        vector<string> lines;
+        if (!readShardRecordLines(shards, ids, offsets, lines)) {
+            cerr << "Error opening file: doctors.txt\n";
+        }
+        string_view fields[5];
+        for (size_t i = 0; i < lines.size(); ++i) {
+            if (splitRecordFields(lines[i], fields, 5) < 5) continue;
+            Doctor &doctor = doctors[i];
+            doctor.id = fields[2];
+            doctor.name = fields[3];
+            doctor.address = fields[4];
+        }
+        return doctors;
+    }
+
+    // Function to rebuild the doctor indexes and free lists from the data files, reporting how the
+    // loaded ones differed. Each shard is locked exclusively while it is rebuilt.
+    RebuildReport rebuildIndexes() {
+        RebuildReport report = rebuildTableIndexes(shards, "doctors", [](string_view *fields) {
+            return string(fields[3]);  // Fields: status, length, ID, name, address
+        });
+        {
+            lock_guard<mutex> lock(idMutex);
+            largestId = -1;  // Recomputed from the rebuilt primary indexes
+        }
+        TableChange change{"doctors", {}};
+        change.wholeTable = true;
+        notifyChange(change);
+        return report;
+    }
+
+    // Function to open a consistent point-in-time view of the doctors of a single-shard layout;
+    // reads through it take no lock. Use scanDoctors for any layout.
+    unique_ptr<TableSnapshot> openSnapshot() {
+        return shards.front()->openSnapshot();
+    }
+
+    // Number of old record versions currently kept for open snapshots
+    size_t savedVersionCount() const {
+        size_t count = 0;
+        for (const auto &shard : shards) {
+            count += shard->versions.savedVersions();
+        }
+        return count;
+    }
+
+    // Function to stream every active doctor record, in file order, to a visitor, as of one
+    // snapshot (per shard; several shards are merged in primary-key order). Stops when the
+    // visitor returns false.
+    void scanDoctors(const function<bool(const Doctor &)> &visitor) {
+        LatencyTimer timer(TimedOperation::ScanDoctors);
+        Doctor doctor;
+        forEachShardRecord(shards, [&](const string &line) {
+            // Parse the record into its components
+            istringstream recordStream(line);
+            string status, len;
+            getline(recordStream, status, '|');
+            getline(recordStream, len, '|');
+            getline(recordStream, doctor.id, '|');
+            getline(recordStream, doctor.name, '|');
+            getline(recordStream, doctor.address, '|');
+
+            return visitor(doctor);
+        });
+    }
+
+    // Function to write the fields of a doctor selected by `choice` as one result row:
+    // 0 = all fields, 1 = ID, 2 = name, 3 = address, anything else = multi-line info block
+    void writeDoctorRow(ResultSink &sink, string_view id, string_view name, string_view address, int choice) {
+        sink.beginRow(choice < 0 || choice > 3 ? "Doctor's info:" : "");
+        if (choice != 2 && choice != 3) sink.idField("ID", id);
+        if (choice != 1 && choice != 3) sink.field("Name", name);
+        if (choice != 1 && choice != 2) sink.field("Address", address);
+        sink.endRow();
+    }
+
     // Function to print a doctor's details by their ID
     void printDoctorById(const string &id, int choice) {
+        ResultSink sink;
+        printDoctorById(id, choice, sink);
+    }
+
+    // Function to write a doctor's details by their ID to a result sink
+    void printDoctorById(const string &id, int choice, ResultSink &sink) {
+        LatencyTimer timer(TimedOperation::PrintDoctorById);
+        TableShard &shard = shardFor(id);
+        shared_lock<shared_mutex> lock(shard.tableMutex);
+
         // Find the record offset for the given doctor ID using the primary index
-        int offset = doctorPrimaryIndex.binarySearchPrimaryIndex(id);
+        int offset = shard.primaryIndex.binarySearchPrimaryIndex(id);
         if (offset == -1) {
-            cout << "Doctor not found. The ID \"" << id << "\" is invalid.\n";
+            sink.message("Doctor not found. The ID \"" + id + "\" is invalid.");
             return;
         }
 
         // Open the doctors' file to retrieve the record
-        fstream file("doctors.txt", ios::in);
+        fstream file(shard.dataFileName, ios::in);
         if (!file.is_open()) {
-            cout << "Error opening file.\n";
+            sink.message("Error opening file.");
             return;
         }
 
@@ -243,9 +685,13 @@ public:
         file.seekg(offset, ios::beg);
         string line;
         getline(file, line);
+        countStat(StatCounter::FileOpens);
+        countStat(StatCounter::Seeks);
+        countStat(StatCounter::BytesRead, line.size() + 1);
+        countStat(StatCounter::DoctorReads);
 
         if (line.empty()) {
-            cout << "Error: Empty record at offset " << offset << ".\n";
+            sink.message("Error: Empty record at offset " + to_string(offset) + ".");
             return;
         }
 
@@ -267,126 +713,88 @@ public:
         }
         name = temp;
 
-        // Print the requested information based on the choice parameter
-        if (choice == 0) {
-            cout << "ID: " << stoi(record_id) << " | Name: " << name << " | Address: " << address << '\n';
-        } else if (choice == 1) {
-            cout << "ID: " << stoi(record_id) << '\n';
-        } else if (choice == 2) {
-            cout << "Name: " << name << '\n';
-        } else if (choice == 3) {
-            cout << "Address: " << address << '\n';
-        } else {
-            cout << "Doctor's info:\n"
-                 << "  ID: " << stoi(record_id) << '\n'
-                 << "  Name: " << name << '\n'
-                 << "  Address: " << address << '\n';
-        }
+        // Write the requested information based on the choice parameter
+        writeDoctorRow(sink, record_id, name, address, choice);
     }
 
-    // Function to print doctors whose address matches a given value
-    void printDoctorByAddress(const string &address, int choice) {
-        // Retrieve all primary index nodes
-        const vector<PrimaryIndexNode>& primaryIndexNodes = doctorPrimaryIndex.getPrimaryIndexNodes();
-
-        // Open the doctors' file for reading
-        ifstream doctorsFile("doctors.txt", ios::in);
-        if (!doctorsFile.is_open()) {
-            cerr << "Error opening doctor file.\n";
+    // Function to write the details of several doctors, in the order of `ids`, to a result sink.
+    // Same output as printDoctorById per ID, but all offsets are resolved first and the records
+    // are fetched in one batch of reads per shard.
+    void printDoctorsByIds(const vector<string> &ids, int choice, ResultSink &sink) {
+        vector<int> offsets;
+        vector<string> lines;
+        if (!readShardRecordLines(shards, ids, offsets, lines)) {
+            sink.message("Error opening file.");
             return;
         }
 
-        // Iterate through all primary index nodes to find matching records
-        for (const PrimaryIndexNode& node : primaryIndexNodes) {
-            int offset = node.offset;
+        string_view fields[5];
+        for (size_t i = 0; i < ids.size(); ++i) {
+            if (offsets[i] == -1) {
+                sink.message("Doctor not found. The ID \"" + ids[i] + "\" is invalid.");
+                continue;
+            }
+            if (lines[i].empty()) {
+                sink.message("Error: Empty record at offset " + to_string(offsets[i]) + ".");
+                continue;
+            }
+            splitRecordFields(lines[i], fields, 5);
 
-            // Move to the offset and read the record
-            doctorsFile.seekg(offset, ios::beg);
-            string line;
-            getline(doctorsFile, line);
+            // Remove padding characters ('-') from the name
+            string name(fields[3]);
+            name.erase(remove(name.begin(), name.end(), '-'), name.end());
+            writeDoctorRow(sink, fields[2], name, fields[4], choice);
+        }
+    }
 
-            // Skip deleted records or empty lines
-            if (line.empty() || line[0] == '*') continue;
+    // Function to print doctors whose address matches a given value
+    void printDoctorByAddress(const string &address, int choice) {
+        ResultSink sink;
+        printDoctorByAddress(address, choice, sink);
+    }
 
-            // Parse the record into its components
-            istringstream recordStream(line);
-            string status, len, id, name, recAddress;
-            getline(recordStream, status, '|');
-            getline(recordStream, len, '|');
-            getline(recordStream, id, '|');
-            getline(recordStream, name, '|');
-            getline(recordStream, recAddress, '|');
-
-            // If the record's address matches the given address, print the information
-            if (recAddress == address) {
-                if (choice == 0) {
-                    cout << "ID: " << stoi(id) << " | Name: " << name << " | Address: " << address << '\n';
-                } else if (choice == 1) {
-                    cout << "ID: " << stoi(id) << '\n';
-                } else if (choice == 2) {
-                    cout << "Name: " << name << '\n';
-                } else if (choice == 3) {
-                    cout << "Address: " << address << '\n';
-                } else {
-                    cout << "Doctor's info:\n"
-                         << "  ID: " << stoi(id) << '\n'
-                         << "  Name: " << name << '\n'
-                         << "  Address: " << address << '\n';
-                }
-            }
+    // Function to write doctors whose address matches a given value to a result sink
+    void printDoctorByAddress(const string &address, int choice, ResultSink &sink) {
+        LatencyTimer timer(TimedOperation::PrintDoctorByAddress);
+        // Filter the doctors' files in parallel chunks; matches come back in primary-key order
+        vector<ScanMatch> matches = scanShards(shards, [&address](string_view *fields, int fieldCount) {
+            return fieldCount >= 5 && fields[4] == address;  // Fields: status, length, ID, name, address
+        });
+
+        // Write the information of every matching record
+        string_view fields[5];
+        for (const ScanMatch &match : matches) {
+            splitRecordFields(match.line, fields, 5);
+            writeDoctorRow(sink, fields[2], fields[3], fields[4], choice);
         }
-
-        doctorsFile.close();
     }
 
     // Function to print all doctors' records
     void printAllDoctors(int choice) {
-        // Open the doctors' file and the primary index file
-        ifstream doctors("doctors.txt", ios::in);
-        ifstream primaryIndexFile("DoctorPrimaryIndex.txt", ios::in);
-        if (!doctors) {
-            cerr << "Error opening doctor file.\n";
-            return;
-        }
-        if (!primaryIndexFile) {
-            cerr << "Error opening primary index file.\n";
-            return;
-        }
-
-        // Read each record from the primary index and print corresponding details
-        string line1, status, len, id, offset, name, address;
-        while (getline(primaryIndexFile, line1)) {
-            istringstream recordStream1(line1);
-            getline(recordStream1, id, '|');
-            getline(recordStream1, offset, '|');
+        ResultSink sink;
+        printAllDoctors(choice, sink);
+    }
 
-            // Read the record from the doctors' file
-            doctors.seekg(stoi(offset), ios::beg);
-            string line2;
-            getline(doctors, line2);
-            istringstream recordStream2(line2);
+    // Function to write all doctors' records to a result sink, as of one snapshot
+    void printAllDoctors(int choice, ResultSink &sink) {
+        LatencyTimer timer(TimedOperation::PrintAllDoctors);
+        // Walk the records of the snapshot in primary-key order; it comes from the in-memory
+        // primary index, which is current even while index persistence is deferred
+        string status, len, id, name, address;
+        forEachShardRecord(shards, [&](const string &line) {
+            istringstream recordStream(line);
 
             // Parse the record
-            getline(recordStream2, status, '|');
-            getline(recordStream2, len, '|');
-            getline(recordStream2, id, '|');
-            getline(recordStream2, name, '|');
-            getline(recordStream2, address, '|');
-
-            // Print the requested information based on the choice parameter
-            if (choice == 0) {
-                cout << "ID: " << stoi(id) << " | Name: " << name << " | Address: " << address << '\n';
-            } else if (choice == 1) {
-                cout << "ID: " << stoi(id) << '\n';
-            } else if (choice == 2) {
-                cout << "Name: " << name << '\n';
-            } else if (choice == 3) {
-                cout << "Address: " << address << '\n';
-            }
-        }
+            getline(recordStream, status, '|');
+            getline(recordStream, len, '|');
+            getline(recordStream, id, '|');
+            getline(recordStream, name, '|');
+            getline(recordStream, address, '|');
 
-        doctors.close();
-        primaryIndexFile.close();
+            // Write the requested information based on the choice parameter
+            writeDoctorRow(sink, id, name, address, choice);
+            return true;
+        }, false);
     }
 
 };
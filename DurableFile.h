@@ -0,0 +1,188 @@
+#ifndef HEALTHCAREMANAGEMENTSYSTEM_DURABLEFILE_H
+#define HEALTHCAREMANAGEMENTSYSTEM_DURABLEFILE_H
+
+#include <string>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <iostream>
+#include <cerrno>
+#include <cstring>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Crash-safe persistence of the index files.
+//
+// An index file is never rewritten in place: its new contents go to "<name>.tmp", which is
+// fsynced and then renamed over the old file, and the directory is fsynced so the rename itself
+// survives a crash. A crash therefore leaves either the old or the new file, never a truncated
+// one. The index files point into a data file, so the data file is fsynced before any of them
+// is replaced: an index on disk never refers to a record, or frees a slot, that a crash could
+// still lose. How often a changed structure is persisted is set by the process-wide durability policy:
+// after every change (the default), after every N changes, or at most every T milliseconds.
+// Between persists the files lag behind the data files, exactly as with deferred persistence.
+
+// When changed index structures are written to their files
+class DurabilityPolicy {
+public:
+    enum Mode {
+        EveryOperation,   // Persist after every change
+        EveryNOperations, // Persist after every `operations` changes
+        EveryInterval     // Persist a change once `intervalMs` passed since the last persist
+    };
+
+    Mode mode = EveryOperation;
+    int operations = 1;    // N of EveryNOperations
+    int intervalMs = 0;    // T of EveryInterval
+
+    // Parse "op", "ops:<N>" or "ms:<T>"; returns false if the text is not a valid policy
+    static bool parse(const string &text, DurabilityPolicy &policy) {
+        DurabilityPolicy parsed;
+        try {
+            if (text == "op") {
+                parsed.mode = EveryOperation;
+            } else if (text.rfind("ops:", 0) == 0) {
+                parsed.mode = EveryNOperations;
+                parsed.operations = stoi(text.substr(4));
+                if (parsed.operations < 1) return false;
+            } else if (text.rfind("ms:", 0) == 0) {
+                parsed.mode = EveryInterval;
+                parsed.intervalMs = stoi(text.substr(3));
+                if (parsed.intervalMs < 1) return false;
+            } else {
+                return false;
+            }
+        } catch (const exception &) {
+            return false;
+        }
+        policy = parsed;
+        return true;
+    }
+};
+
+// Process-wide durability policy; set it at startup, before the management systems are created
+static DurabilityPolicy &durabilityPolicy() {
+    static DurabilityPolicy policy;
+    return policy;
+}
+
+// Decides, change by change, when one index structure is due to be persisted under the
+// durability policy. Used under the lock that protects the structure.
+class PersistSchedule {
+private:
+    int pendingChanges = 0;                      // Changes since the last persist
+    chrono::steady_clock::time_point lastPersist = chrono::steady_clock::now();
+
+public:
+    // Record a change; returns true if the structure should be written now
+    bool changeIsDue() {
+        ++pendingChanges;
+        const DurabilityPolicy &policy = durabilityPolicy();
+        switch (policy.mode) {
+            case DurabilityPolicy::EveryNOperations:
+                return pendingChanges >= policy.operations;
+            case DurabilityPolicy::EveryInterval:
+                return chrono::steady_clock::now() - lastPersist >= chrono::milliseconds(policy.intervalMs);
+            default:
+                return true;
+        }
+    }
+
+    // Record that the structure was written
+    void persisted() {
+        pendingChanges = 0;
+        lastPersist = chrono::steady_clock::now();
+    }
+};
+
+// fsync the directory holding `fileName`, so a rename into it is durable
+static bool syncParentDirectory(const string &fileName) {
+    size_t slash = fileName.find_last_of('/');
+    string directory = slash == string::npos ? "." : (slash == 0 ? "/" : fileName.substr(0, slash));
+    int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) return false;
+    bool synced = ::fsync(fd) == 0;
+    ::close(fd);
+    return synced;
+}
+
+// fsync the data file an index file points into, before the index file is replaced. Nothing to
+// do for a structure without a data file (empty name) or a data file that does not exist.
+static bool syncDataFile(const string &fileName) {
+    if (fileName.empty()) return true;
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) return errno == ENOENT;
+    bool synced = ::fsync(fd) == 0;
+    if (!synced) cerr << "Error syncing file: " << fileName << " (" << strerror(errno) << ")\n";
+    ::close(fd);
+    return synced;
+}
+
+// Replace `fileName` with `contents` atomically: write a temporary file, fsync it, rename it over
+// the old file and fsync the directory. On failure the old file is left untouched. Without
+// `durable` the fsyncs are skipped, for files that are only a cache of others.
+static bool replaceFileAtomically(const string &fileName, const string &contents, bool durable = true) {
+    string temporaryName = fileName + ".tmp";
+    int fd = ::open(temporaryName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        cerr << "Error opening file: " << temporaryName << " (" << strerror(errno) << ")\n";
+        return false;
+    }
+
+    size_t written = 0;
+    while (written < contents.size()) {
+        ssize_t count = ::write(fd, contents.data() + written, contents.size() - written);
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) break;
+        written += count;
+    }
+    bool complete = written == contents.size() && (!durable || ::fsync(fd) == 0);
+    ::close(fd);
+    if (!complete || ::rename(temporaryName.c_str(), fileName.c_str()) != 0) {
+        cerr << "Error writing file: " << fileName << " (" << strerror(errno) << ")\n";
+        ::unlink(temporaryName.c_str());
+        return false;
+    }
+    if (durable) syncParentDirectory(fileName);
+    return true;
+}
+
+// Background thread that calls `flush` every `interval`. With the EveryInterval policy it bounds
+// how long a change stays unpersisted when no further change comes to trigger the write.
+class PeriodicFlusher {
+private:
+    mutex stopMutex;
+    condition_variable stopSignal;
+    bool stopping = false;
+    thread worker;
+
+public:
+    PeriodicFlusher(chrono::milliseconds interval, function<void()> flush)
+            : worker([this, interval, flush = std::move(flush)] {
+        unique_lock<mutex> lock(stopMutex);
+        while (!stopSignal.wait_for(lock, interval, [this] { return stopping; })) {
+            lock.unlock();
+            flush();
+            lock.lock();
+        }
+    }) {}
+
+    PeriodicFlusher(const PeriodicFlusher &) = delete;
+    PeriodicFlusher &operator=(const PeriodicFlusher &) = delete;
+
+    ~PeriodicFlusher() {
+        {
+            lock_guard<mutex> lock(stopMutex);
+            stopping = true;
+        }
+        stopSignal.notify_one();
+        worker.join();
+    }
+};
+
+#endif //HEALTHCAREMANAGEMENTSYSTEM_DURABLEFILE_H
@@ -0,0 +1,171 @@
+#ifndef HEALTHCAREMANAGEMENTSYSTEM_EPOCHRECLAMATION_H
+#define HEALTHCAREMANAGEMENTSYSTEM_EPOCHRECLAMATION_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <vector>
+#include <utility>
+
+using namespace std;
+
+// Epoch-based reclamation for data that lock-free readers may still be looking at.
+//
+// A reader enters a critical section with an EpochGuard, which announces the global epoch it
+// started in. A writer that unlinks an object (e.g. replaces an index version) retires it
+// instead of deleting it; the object is tagged with the epoch it was retired in and freed once
+// every reader that was active at that time has left its critical section. Readers never lock:
+// entering and leaving are two stores to the thread's own announcement slot.
+
+const uint64_t idleEpoch = numeric_limits<uint64_t>::max(); // Announcement of a thread outside any guard
+
+// Announcement slot of one thread. Slots are never freed, only handed to the next thread.
+class EpochRecord {
+public:
+    alignas(64) atomic<uint64_t> epoch{idleEpoch}; // Epoch the thread entered its guard in
+    atomic<bool> inUse{false};                     // Whether a live thread owns the slot
+    EpochRecord *next = nullptr;                   // Next slot in the domain's list
+};
+
+class EpochDomain {
+private:
+    atomic<uint64_t> globalEpoch{0};               // Advanced on every retirement
+    atomic<EpochRecord *> records{nullptr};        // Push-only list of announcement slots
+    mutex retireMutex;                             // Protects retired
+    vector<pair<uint64_t, function<void()>>> retired; // Deleters waiting for their grace period
+    size_t retiredSinceReclaim = 0;                // Retirements since the last reclaim pass
+
+    // Oldest epoch still announced by an active reader (idleEpoch if none)
+    uint64_t oldestActiveEpoch() const {
+        uint64_t oldest = idleEpoch;
+        for (EpochRecord *record = records.load(); record != nullptr; record = record->next) {
+            oldest = min(oldest, record->epoch.load());
+        }
+        return oldest;
+    }
+
+public:
+    EpochDomain() = default;
+    EpochDomain(const EpochDomain &) = delete;
+    EpochDomain &operator=(const EpochDomain &) = delete;
+
+    ~EpochDomain() {
+        for (auto &entry : retired) entry.second();
+        EpochRecord *record = records.load();
+        while (record != nullptr) {
+            EpochRecord *next = record->next;
+            delete record;
+            record = next;
+        }
+    }
+
+    // Current global epoch
+    uint64_t currentEpoch() const {
+        return globalEpoch.load();
+    }
+
+    // Take a free announcement slot for the calling thread, adding one if all are taken
+    EpochRecord *acquireRecord() {
+        for (EpochRecord *record = records.load(); record != nullptr; record = record->next) {
+            bool expected = false;
+            if (!record->inUse.load() && record->inUse.compare_exchange_strong(expected, true)) return record;
+        }
+        EpochRecord *record = new EpochRecord();
+        record->inUse = true;
+        record->next = records.load();
+        while (!records.compare_exchange_weak(record->next, record)) {}
+        return record;
+    }
+
+    // Give a slot back when its thread exits
+    void releaseRecord(EpochRecord *record) {
+        record->epoch.store(idleEpoch);
+        record->inUse.store(false);
+    }
+
+    // Hand over an unlinked object; `deleter` runs once no reader can still reach it
+    void retire(function<void()> deleter) {
+        lock_guard<mutex> lock(retireMutex);
+        uint64_t epoch = globalEpoch.fetch_add(1);  // Readers announcing a later epoch cannot see it
+        retired.emplace_back(epoch, std::move(deleter));
+        if (++retiredSinceReclaim >= 32) reclaimLocked();
+    }
+
+    // Free every retired object whose grace period is over
+    void reclaim() {
+        lock_guard<mutex> lock(retireMutex);
+        reclaimLocked();
+    }
+
+    // Number of retired objects not yet freed
+    size_t pendingCount() {
+        lock_guard<mutex> lock(retireMutex);
+        return retired.size();
+    }
+
+private:
+    // reclaim() with retireMutex held
+    void reclaimLocked() {
+        retiredSinceReclaim = 0;
+        uint64_t oldest = oldestActiveEpoch();
+        size_t kept = 0;
+        for (auto &entry : retired) {
+            if (entry.first < oldest) {
+                entry.second();  // Every active reader started after the object was unlinked
+            } else {
+                retired[kept++] = std::move(entry);
+            }
+        }
+        retired.resize(kept);
+    }
+};
+
+// Process-wide reclamation domain shared by the lock-free indexes. It is never destroyed: the
+// thread_local states of pool threads give their slots back when those threads exit, which can
+// be after the destructors of function-local statics have run.
+static EpochDomain &epochDomain() {
+    static EpochDomain &domain = *new EpochDomain;
+    return domain;
+}
+
+// Per-thread slot ownership and guard nesting depth
+class ThreadEpochState {
+public:
+    EpochRecord *record = nullptr; // Slot of this thread, taken on first use
+    int depth = 0;                 // Nesting depth of EpochGuards
+
+    ~ThreadEpochState() {
+        if (record != nullptr) epochDomain().releaseRecord(record);
+    }
+};
+
+// RAII read-side critical section: objects retired after it starts stay valid until it ends.
+// Guards nest; only the outermost one announces an epoch.
+class EpochGuard {
+private:
+    ThreadEpochState &state;
+
+    static ThreadEpochState &threadState() {
+        static thread_local ThreadEpochState threadState;
+        return threadState;
+    }
+
+public:
+    EpochGuard() : state(threadState()) {
+        if (state.depth++ == 0) {
+            if (state.record == nullptr) state.record = epochDomain().acquireRecord();
+            state.record->epoch.store(epochDomain().currentEpoch());  // seq_cst: visible before the reads that follow
+        }
+    }
+
+    ~EpochGuard() {
+        if (--state.depth == 0) state.record->epoch.store(idleEpoch, memory_order_release);
+    }
+
+    EpochGuard(const EpochGuard &) = delete;
+    EpochGuard &operator=(const EpochGuard &) = delete;
+};
+
+#endif //HEALTHCAREMANAGEMENTSYSTEM_EPOCHRECLAMATION_H
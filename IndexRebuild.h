@@ -0,0 +1,182 @@
+#ifndef HEALTHCAREMANAGEMENTSYSTEM_INDEXREBUILD_H
+#define HEALTHCAREMANAGEMENTSYSTEM_INDEXREBUILD_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <set>
+#include <chrono>
+#include <functional>
+#include <shared_mutex>
+#include <fstream>
+#include "ShardLayout.h"
+#include "ParallelScan.h"
+
+using namespace std;
+
+// Rebuilding the index structures of a table from its data files.
+//
+// The data file is the source of truth: every active record yields a primary index entry and a
+// secondary index entry, every deleted ('*') record a free slot. A shard is scanned with the
+// parallel chunked scan, so the scan runs on all cores, and the rebuilt structures replace the
+// loaded ones and are written atomically. The structures loaded before are compared with the
+// rebuilt ones and every difference is reported.
+
+// Differences found while rebuilding the indexes of one table
+class RebuildReport {
+public:
+    string table;                         // "doctors" or "appointments"
+    size_t records = 0;                   // Active records found in the data files
+    size_t deletedRecords = 0;            // Deleted records (free slots) found in the data files
+    long long elapsedMicros = 0;          // Time spent scanning and rebuilding
+    map<string, vector<string>> discrepancies; // Kind of difference -> the keys or slots affected
+
+    void add(const string &kind, const string &item) {
+        discrepancies[kind].push_back(item);
+    }
+
+    size_t discrepancyCount() const {
+        size_t count = 0;
+        for (const auto &entry : discrepancies) count += entry.second.size();
+        return count;
+    }
+
+    // Human-readable summary: a header line, then one line per kind of difference with examples
+    vector<string> lines(size_t examples = 5) const {
+        vector<string> result;
+        result.push_back(table + ": rebuilt from " + to_string(records) + " records and " +
+                         to_string(deletedRecords) + " free slots in " + to_string(elapsedMicros / 1000) + " ms, " +
+                         to_string(discrepancyCount()) + " discrepancies");
+        for (const auto &entry : discrepancies) {
+            string line = "  " + entry.first + ": " + to_string(entry.second.size()) + " (";
+            for (size_t i = 0; i < entry.second.size() && i < examples; ++i) {
+                line += (i > 0 ? ", " : "") + entry.second[i];
+            }
+            line += entry.second.size() > examples ? ", ...)" : ")";
+            result.push_back(line);
+        }
+        return result;
+    }
+};
+
+// Rebuild the primary index, secondary index and free list of shard `shardIndex` of `shards` from
+// its data file and add the differences to `report`. `secondaryKeyOf` extracts the secondary key
+// from a record's fields (status, length, id, ...); `partitionOf`, for month partitions, the
+// partition a record belongs in. Takes the shard's lock exclusively; the scan's chunks run on the
+// shared thread pool, so do not call this from a pool task.
+static void rebuildShardIndexes(TableShards &shards, size_t shardIndex,
+                                const function<string(string_view *fields)> &secondaryKeyOf, RebuildReport &report,
+                                const function<string(string_view *fields)> &partitionOf = nullptr) {
+    TableShard &shard = *shards[shardIndex];
+    unique_lock<shared_mutex> lock(shard.tableMutex);
+    if (!ifstream(shard.dataFileName).is_open()) {
+        // Without its data file the shard's indexes are left as they are
+        report.add("data file missing", shard.dataFileName);
+        return;
+    }
+
+    // Every line of the data file, deleted ones included, ordered by primary key
+    vector<ScanMatch> records = ParallelScan(shard.dataFileName).run(
+            [](string_view *, int) { return true; }, true);
+
+    vector<PrimaryIndexNode> primaryNodes;
+    vector<pair<string, string>> secondaryEntries;
+    vector<pair<int, int>> freeSlots;
+    string_view fields[8];
+    for (const ScanMatch &record : records) {
+        int fieldCount = splitRecordFields(record.line, fields, 8);
+        int length = -1;
+        try {
+            length = stoi(string(fields[1]));
+        } catch (const exception &) {}
+        if (fieldCount < 5 || length < 0) {
+            report.add("malformed record", "offset " + to_string(record.offset));
+            continue;
+        }
+
+        if (fields[0] == "*") {
+            freeSlots.emplace_back(static_cast<int>(record.offset), length);
+            report.deletedRecords++;
+            continue;
+        }
+        if (!primaryNodes.empty() && primaryNodes.back().primaryKey == record.primaryKey) {
+            // Records are sorted by key, so duplicates are adjacent; the first one is kept
+            report.add("duplicate record", record.primaryKey + " at offset " + to_string(record.offset));
+            continue;
+        }
+        if (partitionOf ? partitionOf(fields) != shard.partition
+                        : shardOfKey(record.primaryKey, shards.size()) != shardIndex) {
+            report.add(partitionOf ? "record in wrong partition" : "record in wrong shard", record.primaryKey);
+        }
+        primaryNodes.emplace_back(record.primaryKey, static_cast<int>(record.offset));
+        secondaryEntries.emplace_back(secondaryKeyOf(fields), record.primaryKey);
+        report.records++;
+    }
+
+    // Compare the loaded primary index with the rebuilt one
+    map<string, int> rebuiltOffsets;
+    for (const PrimaryIndexNode &node : primaryNodes) rebuiltOffsets.emplace(node.primaryKey, node.offset);
+    set<string> indexedKeys;
+    shard.primaryIndex.forEach([&](const string &primaryKey, int offset) {
+        indexedKeys.insert(primaryKey);
+        auto rebuilt = rebuiltOffsets.find(primaryKey);
+        if (rebuilt == rebuiltOffsets.end()) {
+            report.add("primary key without record", primaryKey);
+        } else if (rebuilt->second != offset) {
+            report.add("wrong record offset", primaryKey);
+        }
+        return true;
+    });
+    for (const PrimaryIndexNode &node : primaryNodes) {
+        if (!indexedKeys.count(node.primaryKey)) report.add("primary key missing from index", node.primaryKey);
+    }
+
+    // Compare the loaded secondary index with the rebuilt one
+    set<pair<string, string>> rebuiltEntries(secondaryEntries.begin(), secondaryEntries.end());
+    set<pair<string, string>> indexedEntries;
+    shard.secondaryIndex.forEachEntry([&](const string &secondaryKey, const string &primaryKey) {
+        indexedEntries.emplace(secondaryKey, primaryKey);
+    });
+    for (const auto &entry : indexedEntries) {
+        if (!rebuiltEntries.count(entry)) report.add("secondary entry without record", entry.first + " -> " + entry.second);
+    }
+    for (const auto &entry : rebuiltEntries) {
+        if (!indexedEntries.count(entry)) report.add("secondary entry missing", entry.first + " -> " + entry.second);
+    }
+
+    // Compare the loaded free list with the rebuilt one
+    set<pair<int, int>> rebuiltSlots(freeSlots.begin(), freeSlots.end());
+    set<pair<int, int>> listedSlots;
+    shard.availList.forEachNode([&](int offset, int size) { listedSlots.emplace(offset, size); });
+    for (const auto &slot : listedSlots) {
+        if (!rebuiltSlots.count(slot)) report.add("free slot not free", "offset " + to_string(slot.first));
+    }
+    for (const auto &slot : rebuiltSlots) {
+        if (!listedSlots.count(slot)) report.add("free slot missing", "offset " + to_string(slot.first));
+    }
+
+    // Install the rebuilt structures and write them out
+    shard.primaryIndex.replaceAll(std::move(primaryNodes));
+    shard.secondaryIndex.replaceAll(std::move(secondaryEntries));
+    shard.availList.replaceAll(std::move(freeSlots));
+    shard.primaryIndex.flush();
+    shard.secondaryIndex.flush();
+    shard.availList.flush();
+}
+
+// Rebuild every shard of a table, one after the other (each scan already uses all cores)
+static RebuildReport rebuildTableIndexes(TableShards &shards, const string &table,
+                                         const function<string(string_view *fields)> &secondaryKeyOf,
+                                         const function<string(string_view *fields)> &partitionOf = nullptr) {
+    RebuildReport report;
+    report.table = table;
+    auto start = chrono::steady_clock::now();
+    for (size_t index = 0; index < shards.size(); ++index) {
+        rebuildShardIndexes(shards, index, secondaryKeyOf, report, partitionOf);
+    }
+    report.elapsedMicros = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+    return report;
+}
+
+#endif //HEALTHCAREMANAGEMENTSYSTEM_INDEXREBUILD_H
@@ -0,0 +1,273 @@
+#ifndef HEALTHCAREMANAGEMENTSYSTEM_LATENCYHISTOGRAMS_H
+#define HEALTHCAREMANAGEMENTSYSTEM_LATENCYHISTOGRAMS_H
+
+#include <string>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <bit>
+#include <algorithm>
+#include "ResultSink.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#include <cpuid.h>
+#endif
+
+using namespace std;
+
+// Latency histograms of the public operations, for percentile latencies (SHOW LATENCY).
+//
+// Each operation has an HDR-style histogram: values below 64 ns have a bucket per nanosecond,
+// larger ones fall in 32 buckets per power of two, so a reported percentile is within 1/32 (3%)
+// above the true value, up to 2^40 ns (18 minutes; longer latencies count as that). Recording
+// is lock-free: one relaxed atomic add on the value's bucket and one on the sum, plus a
+// compare-and-swap when a new maximum is seen. The histograms are always on.
+//
+// RESET LATENCY zeroes them; values recorded while a reset runs may be kept or dropped.
+//
+// Timestamps come from LatencyClock: the time-stamp counter (rdtsc) where it is invariant, at
+// about half the cost of steady_clock::now(), converted with a rate calibrated once against
+// steady_clock; steady_clock elsewhere. CLOCK_MONOTONIC_COARSE would be cheaper still, but it
+// only advances every few milliseconds, so nearly every operation would record 0 ns.
+
+// What is timed: the management systems' public operations and the query paths
+enum class TimedOperation {
+    AddDoctor,
+    UpdateDoctorName,
+    DeleteDoctor,
+    ReadDoctor,
+    ReadDoctors,
+    SearchDoctorsByName,
+    PrintDoctorById,
+    PrintDoctorByAddress,
+    PrintAllDoctors,
+    ScanDoctors,
+    AddAppointment,
+    UpdateAppointmentDate,
+    DeleteAppointment,
+    ReadAppointment,
+    ReadAppointments,
+    SearchAppointmentsByDoctorID,
+    PrintAppointmentById,
+    PrintAppointmentByDate,
+    PrintAppointmentsByDateRange,
+    PrintAllAppointments,
+    ScanAppointments,
+    QueryCached,                // SELECT answered from the result cache
+    QueryAggregate,             // SELECT with aggregates or GROUP BY
+    QuerySorted,                // SELECT with ORDER BY, LIMIT or OFFSET
+    QueryDoctors,               // SELECT * FROM doctors without a condition
+    QueryDoctorById,
+    QueryDoctorByName,
+    QueryDoctorByAddress,
+    QueryAppointments,          // SELECT * FROM appointments without a condition
+    QueryAppointmentById,
+    QueryAppointmentByDoctorId,
+    QueryAppointmentByDate,
+    QueryAppointmentByDateRange,
+    QueryOther,                 // SELECT rejected after parsing (unknown table or condition)
+    Count                       // Number of timed operations
+};
+
+const size_t timedOperationCount = static_cast<size_t>(TimedOperation::Count);
+
+// Name of each timed operation, in enum order
+static const array<const char *, timedOperationCount> timedOperationNames = {
+    "addDoctor", "updateDoctorName", "deleteDoctor", "readDoctor", "readDoctors", "searchDoctorsByName",
+    "printDoctorById", "printDoctorByAddress", "printAllDoctors", "scanDoctors",
+    "addAppointment", "updateAppointmentDate", "deleteAppointment", "readAppointment", "readAppointments",
+    "searchAppointmentsByDoctorID", "printAppointmentById", "printAppointmentByDate",
+    "printAppointmentsByDateRange", "printAllAppointments", "scanAppointments",
+    "query cached", "query aggregate", "query sorted", "query doctors", "query doctor by id",
+    "query doctor by name", "query doctor by address", "query appointments", "query appointment by id",
+    "query appointment by doctor id", "query appointment by date", "query appointment by date range",
+    "query other",
+};
+
+// Latency distribution of one operation, in nanoseconds
+class LatencyHistogram {
+public:
+    static constexpr int subBucketBits = 5;
+    static constexpr unsigned long long subBucketCount = 1ULL << subBucketBits;
+    static constexpr unsigned long long maxValue = (1ULL << 40) - 1;
+    static constexpr size_t bucketCount = (40 - subBucketBits + 1) * subBucketCount;
+
+private:
+    array<atomic<unsigned long long>, bucketCount> counts{};
+    atomic<unsigned long long> sum{0};
+    atomic<unsigned long long> max{0};
+
+public:
+    // Bucket of a value: exact below 2 * subBucketCount, then subBucketCount per power of two
+    static size_t bucketOf(unsigned long long value) {
+        value = std::min(value, maxValue);
+        if (value < 2 * subBucketCount) return value;
+        int shift = bit_width(value) - 1 - subBucketBits;
+        return (shift + 1) * subBucketCount + ((value >> shift) - subBucketCount);
+    }
+
+    // Highest value that falls in a bucket
+    static unsigned long long bucketHighest(size_t bucket) {
+        if (bucket < 2 * subBucketCount) return bucket;
+        int shift = static_cast<int>(bucket / subBucketCount) - 1;
+        unsigned long long lowest = (subBucketCount + bucket % subBucketCount) << shift;
+        return lowest + (1ULL << shift) - 1;
+    }
+
+    void record(unsigned long long nanoseconds) {
+        counts[bucketOf(nanoseconds)].fetch_add(1, memory_order_relaxed);
+        sum.fetch_add(nanoseconds, memory_order_relaxed);
+        unsigned long long seen = max.load(memory_order_relaxed);
+        while (nanoseconds > seen && !max.compare_exchange_weak(seen, nanoseconds, memory_order_relaxed)) {
+        }
+    }
+
+    void reset() {
+        for (atomic<unsigned long long> &count : counts) {
+            count.store(0, memory_order_relaxed);
+        }
+        sum.store(0, memory_order_relaxed);
+        max.store(0, memory_order_relaxed);
+    }
+
+    // Percentiles and totals of a copy of the histogram, so they agree with each other
+    class Summary {
+    public:
+        array<unsigned long long, bucketCount> counts{};
+        unsigned long long count = 0;
+        unsigned long long sum = 0;
+        unsigned long long max = 0;
+
+        // The p-th percentile (0-100): the highest value of the bucket holding that rank,
+        // capped at the maximum
+        unsigned long long percentile(double p) const {
+            if (count == 0) return 0;
+            unsigned long long rank = std::max<unsigned long long>(1, static_cast<unsigned long long>(p / 100 * count + 0.5));
+            unsigned long long seen = 0;
+            for (size_t bucket = 0; bucket < bucketCount; ++bucket) {
+                seen += counts[bucket];
+                if (seen >= rank) return std::min(bucketHighest(bucket), max);
+            }
+            return max;
+        }
+    };
+
+    Summary summary() const {
+        Summary result;
+        for (size_t bucket = 0; bucket < bucketCount; ++bucket) {
+            result.counts[bucket] = counts[bucket].load(memory_order_relaxed);
+            result.count += result.counts[bucket];
+        }
+        result.sum = sum.load(memory_order_relaxed);
+        result.max = max.load(memory_order_relaxed);
+        return result;
+    }
+};
+
+// Process-wide histogram of each timed operation
+static array<LatencyHistogram, timedOperationCount> &latencyHistograms() {
+    static array<LatencyHistogram, timedOperationCount> histograms;
+    return histograms;
+}
+
+// Timestamps of LatencyTimer, in ticks: time-stamp counter cycles with an invariant TSC,
+// steady_clock nanoseconds otherwise
+class LatencyClock {
+private:
+    class Calibration {
+    public:
+        bool useTsc = false;
+        double nanosecondsPerTick = 1;
+    };
+
+    // Checks for an invariant TSC (same rate in every core and power state) and measures its
+    // rate over 2 ms of steady_clock time. Runs once, at the first timestamp.
+    static Calibration calibrate() {
+        Calibration calibration;
+#if defined(__x86_64__) || defined(__i386__)
+        unsigned int eax, ebx, ecx, edx;
+        if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) || !(edx & (1u << 8))) return calibration;
+        chrono::steady_clock::time_point wallStart = chrono::steady_clock::now();
+        unsigned long long tscStart = __rdtsc();
+        chrono::steady_clock::time_point wallEnd;
+        do {
+            wallEnd = chrono::steady_clock::now();
+        } while (wallEnd - wallStart < chrono::milliseconds(2));
+        unsigned long long tscEnd = __rdtsc();
+        if (tscEnd <= tscStart) return calibration;
+        calibration.useTsc = true;
+        calibration.nanosecondsPerTick = chrono::duration<double, nano>(wallEnd - wallStart).count() /
+                                         static_cast<double>(tscEnd - tscStart);
+#endif
+        return calibration;
+    }
+
+    static const Calibration &calibration() {
+        static const Calibration calibration = calibrate();
+        return calibration;
+    }
+
+public:
+    static unsigned long long now() {
+#if defined(__x86_64__) || defined(__i386__)
+        if (calibration().useTsc) return __rdtsc();
+#endif
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Nanoseconds from timestamp `start` to `end`; 0 if `end` is earlier
+    static unsigned long long nanosecondsBetween(unsigned long long start, unsigned long long end) {
+        if (end <= start) return 0;
+        return static_cast<unsigned long long>(static_cast<double>(end - start) * calibration().nanosecondsPerTick);
+    }
+};
+
+// Record one call of an operation that started at LatencyClock timestamp `start`
+inline void recordLatency(TimedOperation operation, unsigned long long start) {
+    unsigned long long elapsed = LatencyClock::nanosecondsBetween(start, LatencyClock::now());
+    latencyHistograms()[static_cast<size_t>(operation)].record(elapsed);
+}
+
+// Times the enclosing scope as one call of an operation
+class LatencyTimer {
+private:
+    TimedOperation operation;
+    unsigned long long start;
+
+public:
+    explicit LatencyTimer(TimedOperation operation)
+            : operation(operation), start(LatencyClock::now()) {}
+
+    LatencyTimer(const LatencyTimer &) = delete;
+    LatencyTimer &operator=(const LatencyTimer &) = delete;
+
+    ~LatencyTimer() {
+        recordLatency(operation, start);
+    }
+};
+
+inline void resetLatencyHistograms() {
+    for (LatencyHistogram &histogram : latencyHistograms()) {
+        histogram.reset();
+    }
+}
+
+// One row per operation with recorded calls: count, mean and percentiles in nanoseconds
+inline void writeLatencyHistograms(ResultSink &sink) {
+    for (size_t i = 0; i < timedOperationCount; ++i) {
+        LatencyHistogram::Summary summary = latencyHistograms()[i].summary();
+        if (summary.count == 0) continue;
+        sink.beginRow();
+        sink.field("Operation", timedOperationNames[i]);
+        sink.numberField("Count", summary.count);
+        sink.numberField("Mean ns", summary.sum / summary.count);
+        sink.numberField("P50 ns", summary.percentile(50));
+        sink.numberField("P90 ns", summary.percentile(90));
+        sink.numberField("P99 ns", summary.percentile(99));
+        sink.numberField("P999 ns", summary.percentile(99.9));
+        sink.numberField("Max ns", summary.max);
+        sink.endRow();
+    }
+}
+
+#endif //HEALTHCAREMANAGEMENTSYSTEM_LATENCYHISTOGRAMS_H
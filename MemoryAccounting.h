@@ -0,0 +1,67 @@
+#ifndef HEALTHCAREMANAGEMENTSYSTEM_MEMORYACCOUNTING_H
+#define HEALTHCAREMANAGEMENTSYSTEM_MEMORYACCOUNTING_H
+
+#include <string>
+#include <atomic>
+#include <cctype>
+
+using namespace std;
+
+// Memory accounting of the in-memory index structures and the process-wide memory budget.
+//
+// Every PrimaryIndex, SecondaryIndex and AvailList estimates the heap bytes it holds (kept up to
+// date as it changes, so asking is cheap) and can be evicted: its pending changes are written to
+// its files, which then serve as its disk-backed pages, and its contents are dropped from memory.
+// The next operation that needs an evicted structure reads it back from its files (pages it in).
+// The Bloom filters stay resident, so looking up an absent key never pages an index in.
+//
+// With a budget set (--memory-budget), MemoryGovernor.h evicts the structures that were used
+// least recently whenever the resident indexes exceed it. Recency is counted in ticks of the
+// budget: structures stamp the current tick when used, and every enforcement pass starts a new one.
+
+// Process-wide memory budget of the indexes
+class MemoryBudget {
+public:
+    atomic<size_t> limitBytes{0};          // Budget of the resident indexes; 0 for none
+    atomic<unsigned long long> tick{1};    // Current recency tick
+
+    // Parse a byte count with an optional k, m or g suffix (powers of 1024), e.g. "512m";
+    // returns false if the text is not a valid size
+    static bool parse(const string &text, size_t &bytes) {
+        size_t digits = 0;
+        while (digits < text.size() && isdigit(static_cast<unsigned char>(text[digits]))) digits++;
+        if (digits == 0 || digits > 15) return false;
+        string suffix = text.substr(digits);
+        for (char &ch : suffix) ch = static_cast<char>(tolower(ch));
+        size_t unit = 1;
+        if (suffix == "k" || suffix == "kb") unit = size_t(1) << 10;
+        else if (suffix == "m" || suffix == "mb") unit = size_t(1) << 20;
+        else if (suffix == "g" || suffix == "gb") unit = size_t(1) << 30;
+        else if (!suffix.empty() && suffix != "b") return false;
+        bytes = stoull(text.substr(0, digits)) * unit;
+        return true;
+    }
+};
+
+// Process-wide memory budget; set it at startup
+static MemoryBudget &memoryBudget() {
+    static MemoryBudget budget;
+    return budget;
+}
+
+// Stamp a structure's last use with the current tick. The store is skipped when the stamp is
+// current, so a structure used by many threads is not written on every use.
+static inline void markUsed(atomic<unsigned long long> &lastUsed) {
+    unsigned long long tick = memoryBudget().tick.load(memory_order_relaxed);
+    if (lastUsed.load(memory_order_relaxed) != tick) lastUsed.store(tick, memory_order_relaxed);
+}
+
+// Estimated bytes of one heap allocation beyond what was asked for (allocator header and rounding)
+const size_t allocationOverhead = 16;
+
+// Heap bytes held by a string; short strings live in the object itself
+static inline size_t stringHeapBytes(const string &str) {
+    return str.capacity() > string().capacity() ? str.capacity() + 1 + allocationOverhead : 0;
+}
+
+#endif //HEALTHCAREMANAGEMENTSYSTEM_MEMORYACCOUNTING_H
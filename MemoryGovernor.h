@@ -0,0 +1,159 @@
+#ifndef HEALTHCAREMANAGEMENTSYSTEM_MEMORYGOVERNOR_H
+#define HEALTHCAREMANAGEMENTSYSTEM_MEMORYGOVERNOR_H
+
+#include <string>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <iostream>
+#include <shared_mutex>
+#include "MemoryAccounting.h"
+#include "DoctorManagementSystem.h"
+#include "AppointmentManagementSystem.h"
+
+using namespace std;
+
+// Keeping the resident indexes within the memory budget (MemoryAccounting.h).
+//
+// The unit of eviction is one structure of one shard or month partition: its primary index, its
+// secondary index or its free list. An enforcement pass measures every structure; if the resident
+// total exceeds the budget it evicts the least recently used ones until the total is back under
+// 90% of the budget, so that the next passes have room before evicting again. Structures used
+// since the previous pass are never evicted, and neither is a shard whose lock is busy: the pass
+// only tries the lock, so it never stalls reads or writes, and the next pass tries again.
+
+enum class IndexStructureKind {
+    PrimaryIndex,
+    SecondaryIndex,
+    AvailList
+};
+
+static const array<const char *, 3> indexStructureNames = {"primary index", "secondary index", "avail list"};
+
+// Memory held by one index structure of one shard
+class IndexMemory {
+public:
+    string table;                     // "doctors" or "appointments"
+    string shard;                     // Shard number, or the month partition
+    IndexStructureKind kind;
+    shared_ptr<TableShard> owner;
+    size_t entries = 0;               // Keys, or free slots; 0 while evicted, except primary keys
+    size_t bytes = 0;                 // Estimated heap bytes
+    bool resident = true;
+    unsigned long long lastUsed = 0;  // Memory budget tick of the last use
+};
+
+class MemoryGovernor {
+private:
+    DoctorManagementSystem &doctorSystem;
+    AppointmentManagementSystem &appointmentSystem;
+    int passesOverBudget = 0;         // Consecutive passes that ended over the budget
+
+    static void measureShard(const string &table, const string &label, const shared_ptr<TableShard> &shard,
+                             vector<IndexMemory> &result) {
+        shared_lock<shared_mutex> lock(shard->tableMutex);
+        IndexMemory primary{table, label, IndexStructureKind::PrimaryIndex, shard};
+        primary.entries = shard->primaryIndex.size();
+        primary.bytes = shard->primaryIndex.memoryBytes();
+        primary.resident = shard->primaryIndex.isResident();
+        primary.lastUsed = shard->primaryIndex.lastUsedTick();
+        result.push_back(primary);
+
+        IndexMemory secondary{table, label, IndexStructureKind::SecondaryIndex, shard};
+        secondary.entries = shard->secondaryIndex.entryCount();
+        secondary.bytes = shard->secondaryIndex.memoryBytes();
+        secondary.resident = shard->secondaryIndex.isResident();
+        secondary.lastUsed = shard->secondaryIndex.lastUsedTick();
+        result.push_back(secondary);
+
+        IndexMemory availList{table, label, IndexStructureKind::AvailList, shard};
+        availList.entries = shard->availList.entryCount();
+        availList.bytes = shard->availList.memoryBytes();
+        availList.resident = shard->availList.isResident();
+        availList.lastUsed = shard->availList.lastUsedTick();
+        result.push_back(availList);
+    }
+
+    // Evict one structure if its shard's lock is free. Returns the bytes released.
+    static size_t evict(const IndexMemory &structure) {
+        unique_lock<shared_mutex> lock(structure.owner->tableMutex, try_to_lock);
+        if (!lock.owns_lock()) return 0;
+        size_t before, after;
+        switch (structure.kind) {
+            case IndexStructureKind::PrimaryIndex:
+                before = structure.owner->primaryIndex.memoryBytes();
+                if (!structure.owner->primaryIndex.evict()) return 0;
+                after = structure.owner->primaryIndex.memoryBytes();
+                break;
+            case IndexStructureKind::SecondaryIndex:
+                before = structure.owner->secondaryIndex.memoryBytes();
+                if (!structure.owner->secondaryIndex.evict()) return 0;
+                after = structure.owner->secondaryIndex.memoryBytes();
+                break;
+            default:
+                before = structure.owner->availList.memoryBytes();
+                if (!structure.owner->availList.evict()) return 0;
+                after = structure.owner->availList.memoryBytes();
+                break;
+        }
+        return before > after ? before - after : 0;
+    }
+
+public:
+    MemoryGovernor(DoctorManagementSystem &doctorSystem, AppointmentManagementSystem &appointmentSystem)
+            : doctorSystem(doctorSystem), appointmentSystem(appointmentSystem) {}
+
+    // Memory of every index structure, doctors first, shard by shard
+    vector<IndexMemory> usage() const {
+        vector<IndexMemory> result;
+        TableShards doctorShards = doctorSystem.allShards();
+        for (size_t i = 0; i < doctorShards.size(); ++i) {
+            measureShard("doctors", to_string(i), doctorShards[i], result);
+        }
+        TableShards appointmentShards = appointmentSystem.allShards();
+        for (size_t i = 0; i < appointmentShards.size(); ++i) {
+            const string &partition = appointmentShards[i]->partition;
+            measureShard("appointments", partition.empty() ? to_string(i) : partition, appointmentShards[i], result);
+        }
+        return result;
+    }
+
+    // One enforcement pass: starts a new recency tick and, if the indexes exceed the budget,
+    // evicts the least recently used structures not used since the previous pass. Returns the
+    // bytes released.
+    size_t enforce() {
+        unsigned long long tick = memoryBudget().tick.fetch_add(1);
+        size_t limit = memoryBudget().limitBytes.load();
+        if (limit == 0) return 0;
+
+        vector<IndexMemory> structures = usage();
+        size_t total = 0;
+        for (const IndexMemory &structure : structures) total += structure.bytes;
+        if (total <= limit) {
+            passesOverBudget = 0;
+            return 0;
+        }
+
+        // Coldest first; the Bloom filters stay, so an evicted structure still counts a little
+        stable_sort(structures.begin(), structures.end(), [](const IndexMemory &a, const IndexMemory &b) {
+            return a.lastUsed < b.lastUsed;
+        });
+        size_t target = limit / 10 * 9, released = 0;
+        for (const IndexMemory &structure : structures) {
+            if (total - released <= target) break;
+            if (!structure.resident || structure.lastUsed >= tick) continue;
+            released += evict(structure);
+        }
+
+        // Structures stay warm for a pass after their last use, so only warn when the budget has
+        // not been met for a few passes in a row; once per stretch over the budget
+        passesOverBudget = total - released > limit ? passesOverBudget + 1 : 0;
+        if (passesOverBudget == 3) {
+            cerr << "Warning: the indexes hold about " << (total - released) / 1024 << " KiB, over the "
+                 << limit / 1024 << " KiB memory budget; the structures in use cannot be evicted.\n";
+        }
+        return released;
+    }
+};
+
+#endif //HEALTHCAREMANAGEMENTSYSTEM_MEMORYGOVERNOR_H
@@ -0,0 +1,245 @@
+#ifndef HEALTHCAREMANAGEMENTSYSTEM_MONTHPARTITIONS_H
+#define HEALTHCAREMANAGEMENTSYSTEM_MONTHPARTITIONS_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+#include <chrono>
+#include <ctime>
+#include <cstdio>
+#include <zlib.h>
+#include "ShardLayout.h"
+#include "DurableFile.h"
+
+using namespace std;
+
+// Month-partitioned appointment storage.
+//
+// With partitions.conf ("month") in the data directory, appointments are not hash-sharded: every
+// month of appointment dates has a directory month-YYYY-MM/ with its own appointment data, index
+// and avail list files, and appointments whose date does not start with a month go to
+// month-undated/. Bookings for the coming weeks then write and persist only the small files of
+// their month instead of indexes that hold years of history, and a date query reads only the
+// partitions its dates can fall into. Partitions are created when the first appointment of their
+// month is added; doctors keep the layout of shards.conf.
+//
+// A partition of a past month can be sealed (--seal-months): it becomes read-only, which is
+// recorded by a SEALED file in its directory. A sealed partition can also be archived: its data
+// file is replaced by a zlib-compressed copy (appointments.txt.z). The indexes of an archived
+// partition are loaded as usual, so lookups by ID and doctor still work; the data file is
+// decompressed when a read first needs it, and the decompressed copy is removed at exit.
+
+const char *const partitionConfigFileName = "partitions.conf"; // Holds "month" for the month layout
+const char *const sealedMarkerFileName = "SEALED";             // Present in sealed partitions
+const char *const archiveExtension = ".z";                     // Compressed data file of an archive
+static const string undatedPartition = "undated";              // Dates that do not start with a month
+
+// Whether the data directory uses the month-partitioned appointment layout
+static bool monthPartitionedLayout() {
+    ifstream config(partitionConfigFileName);
+    string kind;
+    return config >> kind && kind == "month";
+}
+
+// Partition of an appointment date: "YYYY-MM" if the date starts with a valid year and month
+// ("2025-03", "2025-03-01", "2025-03-01 09:00-09:30"), "undated" otherwise
+static string monthOfDate(string_view date) {
+    auto digits = [&](size_t from, size_t count) {
+        for (size_t i = from; i < from + count; ++i) {
+            if (i >= date.size() || date[i] < '0' || date[i] > '9') return false;
+        }
+        return true;
+    };
+    if (!digits(0, 4) || date.size() < 7 || date[4] != '-' || !digits(5, 2)) return undatedPartition;
+    int month = (date[5] - '0') * 10 + (date[6] - '0');
+    if (month < 1 || month > 12 || (date.size() > 7 && date[7] != '-' && date[7] != ' ')) return undatedPartition;
+    return string(date.substr(0, 7));
+}
+
+// Directory of a month partition ("month-2025-03/")
+static string monthPartitionDirectory(const string &month) {
+    return "month-" + month + "/";
+}
+
+// Create the (empty) files of a month partition, keeping files that already exist
+static bool createMonthPartitionFiles(const string &month, const TableFileNames &names) {
+    string directory = monthPartitionDirectory(month);
+    error_code error;
+    filesystem::create_directories(directory, error);
+    if (error) {
+        cerr << "Error creating directory: " << directory << "\n";
+        return false;
+    }
+    for (const string *fileName : {&names.data, &names.primaryIndex, &names.secondaryIndex,
+                                   &names.labelIdList, &names.availList}) {
+        if (!filesystem::exists(directory + *fileName + archiveExtension)) {
+            ofstream(directory + *fileName, ios::app).close();  // Create without truncating
+        }
+    }
+    return true;
+}
+
+// Open a month partition and load its indexes; nullptr if its files cannot be created
+static shared_ptr<TableShard> openMonthPartition(const string &month, const TableFileNames &names) {
+    if (!createMonthPartitionFiles(month, names)) return nullptr;
+    string directory = monthPartitionDirectory(month);
+    auto partition = make_shared<TableShard>(directory, names);
+    partition->partition = month;
+    partition->sealed = filesystem::exists(directory + sealedMarkerFileName);
+    if (partition->sealed && filesystem::exists(partition->dataFileName + archiveExtension)) {
+        // A data file next to the archive is a decompressed copy left by a crash, or the original
+        // of an archive whose last step was interrupted; the archive holds the same records
+        error_code error;
+        filesystem::remove(partition->dataFileName, error);
+        partition->archived = true;
+    }
+    return partition;
+}
+
+// Open every month partition of the data directory, ordered by month ("undated" last)
+static TableShards openMonthPartitions(const TableFileNames &names) {
+    vector<string> months;
+    error_code error;
+    for (const auto &entry : filesystem::directory_iterator(".", error)) {
+        string name = entry.path().filename().string();
+        if (entry.is_directory() && name.rfind("month-", 0) == 0) months.push_back(name.substr(6));
+    }
+    if (find(months.begin(), months.end(), undatedPartition) == months.end()) months.push_back(undatedPartition);
+    sort(months.begin(), months.end());
+
+    TableShards partitions;
+    for (const string &month : months) {
+        if (shared_ptr<TableShard> partition = openMonthPartition(month, names)) partitions.push_back(partition);
+    }
+    return partitions;
+}
+
+// Switch an empty data directory to month-partitioned appointments. Refuses to run over
+// appointment records of the current layout, which would become invisible.
+inline bool initializeMonthPartitions() {
+    if (monthPartitionedLayout()) {
+        cerr << "Error: " << partitionConfigFileName << " already exists.\n";
+        return false;
+    }
+    size_t shardCount = loadShardCount();
+    for (size_t index = 0; index < shardCount; ++index) {
+        string dataFile = shardDirectory(index, shardCount) + appointmentFileNames.data;
+        error_code error;
+        if (filesystem::exists(dataFile) && filesystem::file_size(dataFile, error) > 0) {
+            cerr << "Error: " << dataFile << " holds records; partition an empty data directory.\n";
+            return false;
+        }
+    }
+    if (!createMonthPartitionFiles(undatedPartition, appointmentFileNames)) return false;
+    // Written last: a crash before this point leaves the current layout in effect
+    return replaceFileAtomically(partitionConfigFileName, "month\n");
+}
+
+// Compress `source` into `target` (zlib, gzip format), replacing `target` atomically and durably
+static bool compressFile(const string &source, const string &target) {
+    ifstream input(source, ios::in | ios::binary);
+    string temporaryName = target + ".tmp";
+    int fd = ::open(temporaryName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (!input.is_open() || fd < 0) {
+        cerr << "Error compressing file: " << source << "\n";
+        if (fd >= 0) ::close(fd);
+        return false;
+    }
+    gzFile output = gzdopen(::dup(fd), "wb6");
+    bool complete = output != nullptr;
+    vector<char> buffer(1 << 16);
+    while (complete && input) {
+        input.read(buffer.data(), buffer.size());
+        if (input.gcount() > 0) complete = gzwrite(output, buffer.data(), input.gcount()) == input.gcount();
+    }
+    if (output != nullptr) complete = gzclose(output) == Z_OK && complete;
+    complete = complete && ::fsync(fd) == 0;
+    ::close(fd);
+    if (!complete || ::rename(temporaryName.c_str(), target.c_str()) != 0) {
+        cerr << "Error writing file: " << target << "\n";
+        ::unlink(temporaryName.c_str());
+        return false;
+    }
+    syncParentDirectory(target);
+    return true;
+}
+
+// Decompress `source` (written by compressFile) into `target`, replacing it atomically
+static bool decompressFile(const string &source, const string &target) {
+    gzFile input = gzopen(source.c_str(), "rb");
+    string temporaryName = target + ".tmp";
+    ofstream output(temporaryName, ios::out | ios::binary | ios::trunc);
+    if (input == nullptr || !output.is_open()) {
+        cerr << "Error decompressing file: " << source << "\n";
+        if (input != nullptr) gzclose(input);
+        return false;
+    }
+    vector<char> buffer(1 << 16);
+    int count;
+    while ((count = gzread(input, buffer.data(), buffer.size())) > 0) {
+        output.write(buffer.data(), count);
+    }
+    bool complete = count == 0 && gzclose(input) == Z_OK && output.flush();
+    output.close();
+    if (!complete || ::rename(temporaryName.c_str(), target.c_str()) != 0) {
+        cerr << "Error decompressing file: " << source << "\n";
+        ::unlink(temporaryName.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Make the data file of an archived partition readable: the first call decompresses the archive,
+// later calls return at once. Call before taking the partition's lock.
+static void thawPartition(TableShard &partition) {
+    if (!partition.archived) return;
+    call_once(partition.thawOnce, [&partition] {
+        decompressFile(partition.dataFileName + archiveExtension, partition.dataFileName);
+    });
+}
+
+// Remove the decompressed data file of an archived partition (at exit)
+static void dropThawedCopy(TableShard &partition) {
+    if (!partition.archived) return;
+    error_code error;
+    filesystem::remove(partition.dataFileName, error);
+}
+
+// Seal a partition, and archive it if `archive` is set; the caller holds its lock exclusively and
+// no snapshot of it is open. Its indexes are written out first, since a sealed partition is not
+// written again.
+static bool sealPartition(TableShard &partition, bool archive) {
+    partition.primaryIndex.flush();
+    partition.secondaryIndex.flush();
+    partition.availList.flush();
+    string directory = monthPartitionDirectory(partition.partition);
+    if (!partition.sealed) {
+        if (!replaceFileAtomically(directory + sealedMarkerFileName, "sealed\n")) return false;
+        partition.sealed = true;
+    }
+    if (archive && !partition.archived) {
+        if (!compressFile(partition.dataFileName, partition.dataFileName + archiveExtension)) return false;
+        partition.archived = true;
+        error_code error;
+        filesystem::remove(partition.dataFileName, error);
+    }
+    return true;
+}
+
+// Month `monthsBack` months before the current one, as "YYYY-MM"
+inline string monthsBeforeNow(int monthsBack) {
+    time_t now = chrono::system_clock::to_time_t(chrono::system_clock::now());
+    tm local{};
+    localtime_r(&now, &local);
+    int months = (local.tm_year + 1900) * 12 + local.tm_mon - monthsBack;
+    char text[32];
+    snprintf(text, sizeof(text), "%04d-%02d", months / 12, months % 12 + 1);
+    return text;
+}
+
+#endif //HEALTHCAREMANAGEMENTSYSTEM_MONTHPARTITIONS_H
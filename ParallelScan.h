@@ -0,0 +1,153 @@
+#ifndef HEALTHCAREMANAGEMENTSYSTEM_PARALLELSCAN_H
+#define HEALTHCAREMANAGEMENTSYSTEM_PARALLELSCAN_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <functional>
+#include "ThreadPool.h"
+#include "StorageStats.h"
+
+using namespace std;
+
+// Splits a data-file record line ("status|length|field|field|...|") into its '|' separated fields
+// without copying; returns the number of fields found (at most `maxFields`)
+static int splitRecordFields(string_view line, string_view *fields, int maxFields) {
+    int count = 0;
+    size_t start = 0;
+    while (count < maxFields) {
+        size_t bar = line.find('|', start);
+        if (bar == string_view::npos) {
+            if (start < line.size()) fields[count++] = line.substr(start);
+            break;
+        }
+        fields[count++] = line.substr(start, bar - start);
+        start = bar + 1;
+    }
+    return count;
+}
+
+// A record line that passed a scan filter, with the primary key it is ordered by
+class ScanMatch {
+public:
+    string primaryKey; // Primary key of the record (third field)
+    string line;       // Full record line
+    long long offset;  // Byte offset of the record in the data file
+};
+
+// Parallel scan operator over a data file. The file is split into byte ranges aligned to record
+// boundaries; each range is read with one large read and filtered on the thread pool, and the
+// matches are merged back into primary-key order. Small files are scanned on the calling thread.
+class ParallelScan {
+private:
+    string fileName;     // Data file to scan
+    ThreadPool &pool;    // Pool executing the chunks
+    size_t minChunkSize; // Files smaller than two chunks are scanned without the pool
+
+    // Scan the records that start inside [start, end) and collect the ones accepted by `filter`
+    vector<ScanMatch> scanChunk(long long start, long long end, const function<bool(string_view *, int)> &filter,
+                                bool includeDeleted) {
+        vector<ScanMatch> matches;
+        ifstream file(fileName, ios::in | ios::binary);
+        if (!file.is_open()) {
+            cerr << "Error opening file: " << fileName << "\n";
+            return matches;
+        }
+
+        // Read one byte before the range so that we can tell whether a record starts at `start`
+        long long readFrom = start > 0 ? start - 1 : 0;
+        string buffer(end - readFrom, '\0');
+        file.seekg(readFrom, ios::beg);
+        file.read(buffer.data(), buffer.size());
+        buffer.resize(file.gcount());
+
+        // The last record may continue past the end of the range; finish reading it
+        if (!buffer.empty() && buffer.back() != '\n') {
+            string rest;
+            file.clear();
+            if (getline(file, rest)) {
+                buffer += rest;
+                buffer += '\n';
+            }
+        }
+        countStat(StatCounter::FileOpens);
+        countStat(StatCounter::Seeks);
+        countStat(StatCounter::BytesRead, buffer.size());
+
+        size_t position = 0;
+        if (start > 0) {
+            // Skip the tail of a record that started in the previous range
+            size_t newline = buffer.find('\n');
+            position = newline == string::npos ? buffer.size() : newline + 1;
+        }
+
+        string_view fields[8];
+        while (position < buffer.size()) {
+            size_t newline = buffer.find('\n', position);
+            if (newline == string::npos) newline = buffer.size();
+            string_view line(buffer.data() + position, newline - position);
+            long long offset = readFrom + static_cast<long long>(position);
+            position = newline + 1;
+
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            if (line.empty() || (line[0] == '*' && !includeDeleted)) continue;  // Skip deleted records
+
+            int fieldCount = splitRecordFields(line, fields, 8);
+            if (fieldCount >= 3 && filter(fields, fieldCount)) {
+                matches.push_back({string(fields[2]), string(line), offset});
+            }
+        }
+        return matches;
+    }
+
+public:
+    ParallelScan(const string &fileName, ThreadPool &pool = sharedThreadPool(), size_t minChunkSize = 1 << 20)
+            : fileName(fileName), pool(pool), minChunkSize(max<size_t>(minChunkSize, 1)) {}
+
+    // Return every active record accepted by `filter`, ordered by primary key.
+    // The filter receives the record's fields (status, length, id, ...) and may run on several threads.
+    // With `includeDeleted`, deleted records (status "*") are passed to the filter as well.
+    vector<ScanMatch> run(const function<bool(string_view *fields, int fieldCount)> &filter,
+                          bool includeDeleted = false) {
+        ifstream file(fileName, ios::in | ios::binary | ios::ate);
+        if (!file.is_open()) {
+            cerr << "Error opening file: " << fileName << "\n";
+            return {};
+        }
+        long long fileSize = file.tellg();
+        file.close();
+
+        // Use a few chunks per worker so that uneven chunks still balance out
+        long long chunkCount = min<long long>(pool.size() * 4, fileSize / static_cast<long long>(minChunkSize));
+        vector<ScanMatch> matches;
+        if (chunkCount <= 1) {
+            matches = scanChunk(0, fileSize, filter, includeDeleted);
+        } else {
+            long long chunkSize = (fileSize + chunkCount - 1) / chunkCount;
+            vector<future<vector<ScanMatch>>> pending;
+            for (long long start = chunkSize; start < fileSize; start += chunkSize) {
+                long long end = min(fileSize, start + chunkSize);
+                pending.push_back(pool.submit([this, start, end, &filter, includeDeleted] {
+                    return scanChunk(start, end, filter, includeDeleted);
+                }));
+            }
+            matches = scanChunk(0, chunkSize, filter, includeDeleted);  // The calling thread takes the first chunk
+            for (auto &chunk : pending) {
+                vector<ScanMatch> chunkMatches = chunk.get();
+                matches.insert(matches.end(), make_move_iterator(chunkMatches.begin()),
+                               make_move_iterator(chunkMatches.end()));
+            }
+        }
+
+        // Records are stored in file order; return them in primary-key order like the index
+        sort(matches.begin(), matches.end(), [](const ScanMatch &a, const ScanMatch &b) {
+            return a.primaryKey < b.primaryKey;
+        });
+        return matches;
+    }
+};
+
+#endif //HEALTHCAREMANAGEMENTSYSTEM_PARALLELSCAN_H
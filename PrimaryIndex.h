@@ -1,11 +1,22 @@
 #ifndef HEALTHCAREMANAGEMENTSYSTEM_PRIMARYINDEX_H
 #define HEALTHCAREMANAGEMENTSYSTEM_PRIMARYINDEX_H
 
+#include <iostream>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <vector>
 #include <algorithm>
+#include <cctype>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include "EpochReclamation.h"
+#include "DurableFile.h"
+#include "BloomFilter.h"
+#include "StorageStats.h"
+#include "MemoryAccounting.h"
 
 using namespace std;
 
@@ -33,44 +44,267 @@ public:
     }
 };
 
-// Class representing the primary index for the system
+// Node of the copy-on-write B+ tree behind the primary index. Nodes are never modified once
+// published: a writer copies the nodes on the path to the change and shares everything else.
+class PrimaryIndexTreeNode {
+public:
+    bool leaf = true;                                        // Leaf (keys + offsets) or internal node
+    vector<string> keys;                                     // Leaf: sorted keys. Internal: smallest key of each child
+    vector<int> offsets;                                     // Leaf: record offset of each key
+    vector<shared_ptr<const PrimaryIndexTreeNode>> children; // Internal: child subtrees
+};
+
+// One immutable state of the primary index: a tree root, its number of keys and the filter that
+// rejects absent keys (shared by successive versions; keys are only ever added to it)
+class PrimaryIndexVersion {
+public:
+    shared_ptr<const PrimaryIndexTreeNode> root; // nullptr when the index is empty or evicted
+    size_t count = 0;                            // Number of keys
+    size_t treeBytes = 0;                        // Estimated heap bytes of the tree (0 when evicted)
+    shared_ptr<BloomFilter> filter;              // nullptr until the first key is indexed
+    bool evicted = false;                        // The tree was dropped to the index file; the
+                                                 // count and the filter are kept
+};
+
+// Visit the entries of a subtree in key order; stops when the visitor returns false
+static bool visitPrimaryIndexTree(const PrimaryIndexTreeNode *node, const function<bool(const string &, int)> &visitor) {
+    if (node == nullptr) return true;
+    if (node->leaf) {
+        for (size_t i = 0; i < node->keys.size(); ++i) {
+            if (!visitor(node->keys[i], node->offsets[i])) return false;
+        }
+        return true;
+    }
+    for (const shared_ptr<const PrimaryIndexTreeNode> &child : node->children) {
+        if (!visitPrimaryIndexTree(child.get(), visitor)) return false;
+    }
+    return true;
+}
+
+// A pinned version of a primary index. It owns a reference to the tree root, so it stays
+// readable for as long as it is held, independently of later writes and of epoch reclamation.
+class PrimaryIndexSnapshot {
+public:
+    shared_ptr<const PrimaryIndexTreeNode> root; // Root of the pinned tree (nullptr if empty)
+    size_t count = 0;                            // Number of keys in the pinned version
+
+    // Visit every key and offset of the pinned version in key order
+    void forEach(const function<bool(const string &primaryKey, int offset)> &visitor) const {
+        visitPrimaryIndexTree(root.get(), visitor);
+    }
+};
+
+// Class representing the primary index for the system.
+//
+// Readers are lock-free (RCU style): the current version is published through an atomic
+// pointer, and a lookup runs inside an EpochGuard on whatever version it loaded, so it never
+// blocks and never sees a half-updated array. Writers are serialized by writerMutex; each
+// change builds a new version that shares all untouched nodes with the old one (O(log n)
+// copied nodes), publishes it with a single atomic store, and retires the old version to the
+// epoch domain, which frees it once no reader can still be using it.
+//
+// To stay within the memory budget the tree can be evicted: a version without a tree is
+// published, and the first reader or writer that needs the tree reads it back from the file. A
+// reader does so without writerMutex: it builds the tree from the file and publishes it with a
+// compare-and-swap that only succeeds while the evicted version is still current.
 class PrimaryIndex {
+    using NodePointer = shared_ptr<const PrimaryIndexTreeNode>;
+    static const size_t maxNodeSize = 64;  // Entries per leaf / children per internal node before a split
+
     string primaryIndexFileName;       // Name of the primary index file
-    vector<PrimaryIndexNode> primaryIndex; // Vector to store primary index nodes
+    string dataFileName;               // Data file the offsets point into; synced before each write
+    mutable atomic<const PrimaryIndexVersion *> current{new PrimaryIndexVersion()}; // Published version
+    mutable mutex writerMutex;         // Serializes writers; readers never take it
+    bool autoPersist = true;           // Whether every change is written to the file immediately
+    bool dirty = false;                // Whether the in-memory index has unwritten changes
+    PersistSchedule persistSchedule;   // When changes are due to be written under the durability policy
+    bool grouping = false;             // Whether changes are collected into one change group
+    bool groupChanged = false;         // Whether the open change group changed the index
+    int largestId = 0;                 // Largest numeric primary key ever indexed, for getNewId
+    shared_ptr<BloomFilter> filter;    // Filter of the keys, published with every version
+    mutable atomic<unsigned long long> lastUsed{memoryBudget().tick.load()}; // Memory budget tick of the last use
 
-public:
-    // Set the primary index file name and load the index into memory
-    void setPrimaryIndexFileName(const string& fileName) {
-        this->primaryIndexFileName = fileName;
-        loadPrimaryIndexInMemory();
+    // Estimated bytes an entry adds to the tree: its key and offset, and its share of the nodes,
+    // which hold about maxNodeSize / 2 entries
+    static size_t entryBytes(const string &primaryKey) {
+        const size_t nodeBytes = sizeof(PrimaryIndexTreeNode) + 3 * allocationOverhead + 16;  // + shared_ptr control block
+        return sizeof(string) + sizeof(int) + stringHeapBytes(primaryKey) + nodeBytes / (maxNodeSize / 2) + 1;
     }
 
-    // Generate a new unique ID based on the last primary key in the index
-    string getNewId() {
-        if (primaryIndex.empty()) {
-            return "01";  // Start with a two-digit ID
+    // Record a change and write it out when the durability policy says so, unless persistence
+    // is deferred or a change group is open (writerMutex held)
+    void persistChange() {
+        dirty = true;
+        if (grouping) {
+            groupChanged = true;
+        } else if (autoPersist && persistSchedule.changeIsDue()) {
+            writeIndexFile();
+        }
+    }
+
+    // Remember the largest numeric key. Keys are ordered as strings ("100" < "99"), so the
+    // last key of the index is not necessarily the largest ID.
+    void trackLargestId(const string &primaryKey) {
+        if (!primaryKey.empty() && all_of(primaryKey.begin(), primaryKey.end(), ::isdigit) && primaryKey.size() < 10) {
+            largestId = max(largestId, stoi(primaryKey));
+        }
+    }
+
+    // Build a filter sized for the keys of `root` (writerMutex held). Published versions keep
+    // their old filter, which is not touched any more.
+    void rebuildFilter(const NodePointer &root, size_t count) {
+        filter = make_shared<BloomFilter>(count);
+        visitPrimaryIndexTree(root.get(), [this](const string &primaryKey, int) {
+            filter->add(primaryKey);
+            return true;
+        });
+    }
+
+    // Publish a new version and retire the old one (writerMutex held). The filter must already
+    // hold the new version's keys.
+    void publish(NodePointer root, size_t count, size_t treeBytes, bool evicted = false) {
+        PrimaryIndexVersion *version = new PrimaryIndexVersion();
+        version->root = std::move(root);
+        version->count = count;
+        version->treeBytes = treeBytes;
+        version->filter = filter;
+        version->evicted = evicted;
+        const PrimaryIndexVersion *old = current.exchange(version);
+        epochDomain().retire([old] { delete old; });
+    }
+
+    // Index of the child of an internal node whose key range contains `key`
+    static size_t childFor(const PrimaryIndexTreeNode &node, const string &key) {
+        size_t position = upper_bound(node.keys.begin(), node.keys.end(), key) - node.keys.begin();
+        return position == 0 ? 0 : position - 1;
+    }
+
+    // Split an overfull node into two halves
+    static vector<NodePointer> split(PrimaryIndexTreeNode &node) {
+        auto right = make_shared<PrimaryIndexTreeNode>();
+        right->leaf = node.leaf;
+        size_t half = node.keys.size() / 2;
+        right->keys.assign(node.keys.begin() + half, node.keys.end());
+        node.keys.resize(half);
+        if (node.leaf) {
+            right->offsets.assign(node.offsets.begin() + half, node.offsets.end());
+            node.offsets.resize(half);
         } else {
-            int newId = stoi(primaryIndex.back().primaryKey) + 1;
-            return (newId < 10) ? "0" + to_string(newId) : to_string(newId); // Ensure two-digit IDs
+            right->children.assign(node.children.begin() + half, node.children.end());
+            node.children.resize(half);
         }
+        return {make_shared<PrimaryIndexTreeNode>(std::move(node)), right};
     }
 
-    // Get all primary index nodes
-    vector<PrimaryIndexNode> getPrimaryIndexNodes() const {
-        return primaryIndex;
+    // Copy the path to `key` with the entry inserted; returns one node, or two after a split
+    static vector<NodePointer> insertInto(const PrimaryIndexTreeNode &node, const string &key, int offset) {
+        PrimaryIndexTreeNode copy = node;
+        if (node.leaf) {
+            size_t position = upper_bound(copy.keys.begin(), copy.keys.end(), key) - copy.keys.begin();
+            copy.keys.insert(copy.keys.begin() + position, key);
+            copy.offsets.insert(copy.offsets.begin() + position, offset);
+        } else {
+            size_t child = childFor(node, key);
+            vector<NodePointer> replaced = insertInto(*node.children[child], key, offset);
+            copy.children[child] = replaced[0];
+            copy.keys[child] = replaced[0]->keys.front();
+            if (replaced.size() == 2) {
+                copy.children.insert(copy.children.begin() + child + 1, replaced[1]);
+                copy.keys.insert(copy.keys.begin() + child + 1, replaced[1]->keys.front());
+            }
+        }
+        if (copy.keys.size() > maxNodeSize) return split(copy);
+        return {make_shared<PrimaryIndexTreeNode>(std::move(copy))};
     }
 
-    // Load the primary index from a file into memory
-    void loadPrimaryIndexInMemory() {
-        ifstream file(primaryIndexFileName, ios::in);
-        if (!file.is_open()) {
-            cerr << "Error opening file: PrimaryIndex.txt\n";
-            return;
+    // Copy the path to `key` with the entry removed. Returns the node itself if the key is
+    // absent, and nullptr if the node became empty.
+    static NodePointer removeFrom(const NodePointer &node, const string &key, bool &found) {
+        if (node->leaf) {
+            auto position = lower_bound(node->keys.begin(), node->keys.end(), key);
+            if (position == node->keys.end() || *position != key) return node;
+            found = true;
+            if (node->keys.size() == 1) return nullptr;
+            auto copy = make_shared<PrimaryIndexTreeNode>(*node);
+            size_t index = position - node->keys.begin();
+            copy->keys.erase(copy->keys.begin() + index);
+            copy->offsets.erase(copy->offsets.begin() + index);
+            return copy;
         }
-        if (isFileEmpty(primaryIndexFileName)) {
-            return;  // No data to load if the file is empty
+
+        size_t child = childFor(*node, key);
+        NodePointer replaced = removeFrom(node->children[child], key, found);
+        if (!found) return node;
+        if (replaced == nullptr && node->children.size() == 1) return nullptr;
+        auto copy = make_shared<PrimaryIndexTreeNode>(*node);
+        if (replaced == nullptr) {
+            copy->children.erase(copy->children.begin() + child);  // Empty subtrees are dropped
+            copy->keys.erase(copy->keys.begin() + child);
+        } else {
+            copy->children[child] = replaced;
+            copy->keys[child] = replaced->keys.front();
+        }
+        return copy;
+    }
+
+    // Copy the path to `key` with its offset replaced; returns nullptr if the key is absent
+    static NodePointer replaceOffsetIn(const NodePointer &node, const string &key, int offset) {
+        if (node->leaf) {
+            auto position = lower_bound(node->keys.begin(), node->keys.end(), key);
+            if (position == node->keys.end() || *position != key) return nullptr;
+            auto copy = make_shared<PrimaryIndexTreeNode>(*node);
+            copy->offsets[position - node->keys.begin()] = offset;
+            return copy;
+        }
+        size_t child = childFor(*node, key);
+        NodePointer replaced = replaceOffsetIn(node->children[child], key, offset);
+        if (replaced == nullptr) return nullptr;
+        auto copy = make_shared<PrimaryIndexTreeNode>(*node);
+        copy->children[child] = replaced;
+        return copy;
+    }
+
+    // Build a tree bottom-up from entries sorted by key
+    static NodePointer buildTree(vector<PrimaryIndexNode> &nodes) {
+        if (nodes.empty()) return nullptr;
+        const size_t fill = maxNodeSize * 3 / 4;  // Leave room so that early inserts do not split at once
+        vector<NodePointer> level;
+        for (size_t start = 0; start < nodes.size(); start += fill) {
+            auto leaf = make_shared<PrimaryIndexTreeNode>();
+            for (size_t i = start; i < min(nodes.size(), start + fill); ++i) {
+                leaf->keys.push_back(std::move(nodes[i].primaryKey));
+                leaf->offsets.push_back(nodes[i].offset);
+            }
+            level.push_back(leaf);
+        }
+        while (level.size() > 1) {
+            vector<NodePointer> parents;
+            for (size_t start = 0; start < level.size(); start += fill) {
+                auto parent = make_shared<PrimaryIndexTreeNode>();
+                parent->leaf = false;
+                for (size_t i = start; i < min(level.size(), start + fill); ++i) {
+                    parent->keys.push_back(level[i]->keys.front());
+                    parent->children.push_back(level[i]);
+                }
+                parents.push_back(parent);
+            }
+            level.swap(parents);
+        }
+        return level.front();
+    }
+
+    // Read the index file into entries sorted by key, and its contents for the filter's hash.
+    // Returns false if the file could not be opened. Touches no member, so readers may call it.
+    bool readIndexFile(vector<PrimaryIndexNode> &nodes, string &contents) const {
+        ifstream indexFile(primaryIndexFileName, ios::in);
+        if (!indexFile.is_open()) {
+            cerr << "Error opening file: PrimaryIndex.txt\n";
+            return false;
         }
+        contents.assign(istreambuf_iterator<char>(indexFile), istreambuf_iterator<char>());
+        indexFile.close();
 
+        istringstream file(contents);
         string line;
         while (getline(file, line)) {
             istringstream recordStream(line);
@@ -80,74 +314,362 @@ public:
             getline(recordStream, primaryKey, '|');
             getline(recordStream, offset, '|');
 
-            // Add the index node with the read primary key and offset
-            primaryIndex.emplace_back(primaryKey, stoi(offset));
+            // Add the index node with the read primary key and offset; a damaged line is skipped
+            // (an index rebuild from the data file restores the entry)
+            try {
+                nodes.emplace_back(primaryKey, stoi(offset));
+            } catch (const exception &) {
+                cerr << "Warning: skipping malformed line in " << primaryIndexFileName << ": " << line << "\n";
+            }
         }
 
-        file.close();
+        // The file is normally sorted already; a stable sort keeps it cheap and safe if not
+        stable_sort(nodes.begin(), nodes.end());
+        return true;
     }
 
-    // Update the primary index file with the in-memory data
-    void updatePrimaryIndexFile() {
-        fstream outFile(primaryIndexFileName, ios::out | ios::trunc);
-        if (!outFile.is_open()) {
-            cerr << "Error opening file: PrimaryIndex.txt\n";
-            return;
+    // Estimated heap bytes of a tree of sorted entries
+    static size_t treeBytesOf(const vector<PrimaryIndexNode> &nodes) {
+        size_t bytes = 0;
+        for (const PrimaryIndexNode &node : nodes) {
+            bytes += entryBytes(node.primaryKey);
         }
-        for (const auto &ele : primaryIndex) {
-            outFile << ele.primaryKey << '|' << ele.offset << '\n'; // Write each primary key and its offset
+        return bytes;
+    }
+
+    // Build the tree of sorted entries, counting its memory, and publish it (writerMutex held)
+    void publishEntries(vector<PrimaryIndexNode> &nodes) {
+        size_t count = nodes.size(), bytes = treeBytesOf(nodes);
+        NodePointer root = buildTree(nodes);
+        if (!filter) {
+            rebuildFilter(root, count);
         }
-        outFile.close();
+        publish(root, count, bytes);
+    }
+
+    // Read an evicted tree back from the index file (writerMutex held). The filter was kept, and
+    // the file holds exactly the evicted entries: they were written out at eviction and every
+    // change since paged the tree in first. Returns false if the tree is still not resident.
+    bool pageIn() {
+        if (!current.load()->evicted) return true;
+        vector<PrimaryIndexNode> nodes;
+        string contents;
+        if (!readIndexFile(nodes, contents)) return false;
+        publishEntries(nodes);
+        countStat(StatCounter::IndexPageIns);
+        return true;
+    }
+
+    // The current version with its tree resident; call inside an EpochGuard without writerMutex.
+    // An evicted tree is read back without any lock and published only if the evicted version is
+    // still current: the file holds exactly its entries (see pageIn), and any writer publishes a
+    // new version first. Readers that race each read the file; one publishes, the others use its
+    // version. The EpochGuard keeps the evicted version alive, so the compare cannot see it reused.
+    const PrimaryIndexVersion *residentVersion() const {
+        markUsed(lastUsed);
+        const PrimaryIndexVersion *version = current.load();
+        while (version->evicted) {
+            vector<PrimaryIndexNode> nodes;
+            string contents;
+            if (!readIndexFile(nodes, contents)) return version;  // Reads as empty until the file is back
+            auto *paged = new PrimaryIndexVersion();
+            paged->count = nodes.size();
+            paged->treeBytes = treeBytesOf(nodes);
+            paged->root = buildTree(nodes);
+            paged->filter = version->filter;
+            const PrimaryIndexVersion *expected = version;
+            if (current.compare_exchange_strong(expected, paged)) {
+                epochDomain().retire([version] { delete version; });
+                countStat(StatCounter::IndexPageIns);
+                return paged;
+            }
+            delete paged;
+            version = expected;  // Published meanwhile; evicted again only in a rare race
+        }
+        return version;
+    }
+
+    // Write the current version to the index file, replacing it atomically, and the filter with
+    // it (writerMutex held, tree resident)
+    void writeIndexFile() {
+        if (!syncDataFile(dataFileName)) return;  // Stays dirty; the next persist retries
+        ostringstream stream;
+        visitPrimaryIndexTree(current.load()->root.get(), [&stream](const string &primaryKey, int offset) {
+            stream << primaryKey << '|' << offset << '\n'; // Write each primary key and its offset
+            return true;
+        });
+        string contents = stream.str();
+        if (!replaceFileAtomically(primaryIndexFileName, contents)) {
+            return;  // Stays dirty; the next persist retries
+        }
+        countStat(StatCounter::IndexRewrites);
+        countStat(StatCounter::BytesWritten, contents.size());
+        if (filter) {
+            filter->save(filterFileName(primaryIndexFileName), fnv1aHash(contents));
+        }
+        dirty = false;
+        persistSchedule.persisted();
+    }
+
+public:
+    PrimaryIndex() = default;
+    PrimaryIndex(const PrimaryIndex &) = delete;
+    PrimaryIndex &operator=(const PrimaryIndex &) = delete;
+
+    ~PrimaryIndex() {
+        delete current.load();  // Older versions are owned by the epoch domain
+    }
+
+    // Generate a new unique ID, one past the largest ID in the index
+    string getNewId() {
+        lock_guard<mutex> lock(writerMutex);
+        int newId = largestId + 1;
+        return (newId < 10) ? "0" + to_string(newId) : to_string(newId); // Ensure two-digit IDs
+    }
+
+    // Largest numeric primary key ever indexed (0 if none)
+    int getLargestId() const {
+        lock_guard<mutex> lock(writerMutex);
+        return largestId;
+    }
+
+    // Set the primary index file name and load the index into memory
+    void setPrimaryIndexFileName(const string& fileName) {
+        this->primaryIndexFileName = fileName;
+        loadPrimaryIndexInMemory();
+    }
+
+    // Set the data file whose records the index points at
+    void setDataFileName(const string &fileName) {
+        lock_guard<mutex> lock(writerMutex);
+        dataFileName = fileName;
+    }
+
+    // Enable or disable writing the index file after every change; when disabled, call flush()
+    void setAutoPersist(bool enabled) {
+        lock_guard<mutex> lock(writerMutex);
+        autoPersist = enabled;
+    }
+
+    // Collect the following changes into one change group: they are persisted together, once,
+    // by endChangeGroup(), and count as a single change for the durability policy
+    void beginChangeGroup() {
+        lock_guard<mutex> lock(writerMutex);
+        grouping = true;
+    }
+
+    // Close the change group and persist its changes if the durability policy says so
+    void endChangeGroup() {
+        lock_guard<mutex> lock(writerMutex);
+        grouping = false;
+        if (groupChanged && autoPersist && persistSchedule.changeIsDue()) {
+            writeIndexFile();
+        }
+        groupChanged = false;
+    }
+
+    // Write pending changes to the index file
+    void flush() {
+        lock_guard<mutex> lock(writerMutex);
+        if (dirty) {
+            writeIndexFile();
+        }
+    }
+
+    // Number of keys in the index
+    size_t size() const {
+        EpochGuard guard;
+        return current.load()->count;
+    }
+
+    // Drop the tree from memory after writing pending changes to the file; the filter stays.
+    // Returns false if the tree is not resident, a change group is open or the write failed.
+    bool evict() {
+        lock_guard<mutex> lock(writerMutex);
+        const PrimaryIndexVersion *version = current.load();
+        if (version->evicted || version->root == nullptr || grouping) return false;
+        if (dirty) {
+            writeIndexFile();
+            if (dirty) return false;
+        }
+        publish(nullptr, version->count, 0, true);
+        countStat(StatCounter::IndexEvictions);
+        return true;
+    }
+
+    // Estimated heap bytes of the index: the tree while resident, and the filter
+    size_t memoryBytes() const {
+        lock_guard<mutex> lock(writerMutex);
+        EpochGuard guard;  // A reader may replace the version by paging the tree in
+        return current.load()->treeBytes + (filter ? filter->byteSize() : 0);
+    }
+
+    bool isResident() const {
+        EpochGuard guard;
+        return !current.load()->evicted;
+    }
+
+    // Memory budget tick of the last lookup or change
+    unsigned long long lastUsedTick() const {
+        return lastUsed.load(memory_order_relaxed);
+    }
+
+    // Visit every key and offset in key order on one consistent version, without locking;
+    // the visitor returns false to stop early
+    void forEach(const function<bool(const string &primaryKey, int offset)> &visitor) const {
+        EpochGuard guard;
+        visitPrimaryIndexTree(residentVersion()->root.get(), visitor);
+    }
+
+    // Pin the current version, e.g. for a long-running read that must see one point in time
+    PrimaryIndexSnapshot snapshot() const {
+        EpochGuard guard;
+        const PrimaryIndexVersion *version = residentVersion();
+        return {version->root, version->count};
+    }
+
+    // Get all primary index nodes
+    vector<PrimaryIndexNode> getPrimaryIndexNodes() const {
+        vector<PrimaryIndexNode> nodes;
+        forEach([&nodes](const string &primaryKey, int offset) {
+            nodes.emplace_back(primaryKey, offset);
+            return true;
+        });
+        return nodes;
+    }
+
+    // Load the primary index from a file into memory, with its saved filter if it still matches
+    void loadPrimaryIndexInMemory() {
+        lock_guard<mutex> lock(writerMutex);
+        vector<PrimaryIndexNode> nodes;
+        string contents;
+        if (!readIndexFile(nodes, contents) || contents.empty()) {
+            return;  // No data to load if the file is empty
+        }
+        for (const PrimaryIndexNode &node : nodes) {
+            trackLargestId(node.primaryKey);
+        }
+        filter = BloomFilter::load(filterFileName(primaryIndexFileName), fnv1aHash(contents));
+        publishEntries(nodes);
+    }
+
+    // Replace the whole index with `nodes` (e.g. rebuilt from the data file). The new contents are
+    // written by the next flush, or at once if changes are persisted immediately.
+    void replaceAll(vector<PrimaryIndexNode> nodes) {
+        lock_guard<mutex> lock(writerMutex);
+        for (const PrimaryIndexNode &node : nodes) {
+            trackLargestId(node.primaryKey);
+        }
+        stable_sort(nodes.begin(), nodes.end());
+        filter = nullptr;  // Rebuilt for the new keys
+        publishEntries(nodes);
+        dirty = true;
+        if (autoPersist) {
+            writeIndexFile();
+        }
+    }
+
+    // Update the primary index file with the in-memory data
+    void updatePrimaryIndexFile() {
+        lock_guard<mutex> lock(writerMutex);
+        if (!pageIn()) return;
+        writeIndexFile();
     }
 
     // Add a new primary key and offset to the index and update the file
     void addPrimaryNode(const string &primaryKey, int offset) {
-        primaryIndex.emplace_back(primaryKey, offset);  // Add the new node
-        sortPrimaryIndex();  // Sort the index nodes after addition
-        updatePrimaryIndexFile(); // Write the updated index to the file
+        lock_guard<mutex> lock(writerMutex);
+        markUsed(lastUsed);
+        if (!pageIn()) return;
+        trackLargestId(primaryKey);
+
+        // Copy the path to the new key and publish the result as the next version
+        const PrimaryIndexVersion *version = current.load();
+        NodePointer root;
+        if (version->root == nullptr) {
+            auto leaf = make_shared<PrimaryIndexTreeNode>();
+            leaf->keys.push_back(primaryKey);
+            leaf->offsets.push_back(offset);
+            root = leaf;
+        } else {
+            vector<NodePointer> replaced = insertInto(*version->root, primaryKey, offset);
+            if (replaced.size() == 1) {
+                root = replaced[0];
+            } else {
+                // The root split: grow the tree by one level
+                auto newRoot = make_shared<PrimaryIndexTreeNode>();
+                newRoot->leaf = false;
+                for (const NodePointer &child : replaced) {
+                    newRoot->keys.push_back(child->keys.front());
+                    newRoot->children.push_back(child);
+                }
+                root = newRoot;
+            }
+        }
+        // The key goes into the filter before the version that holds it is published
+        if (!filter || filter->needsRebuild()) {
+            rebuildFilter(root, version->count + 1);
+        } else {
+            filter->add(primaryKey);
+        }
+        publish(root, version->count + 1, version->treeBytes + entryBytes(primaryKey));
+        persistChange(); // Write the updated index to the file
     }
 
     // Remove a primary key node from the index and update the file
     void removePrimaryNode(const string &primaryKey) {
-        // Perform binary search to find the node
-        int left = 0, right = primaryIndex.size() - 1;
-        while (left <= right) {
-            int mid = left + (right - left) / 2;
-            if (primaryIndex[mid].primaryKey == primaryKey) {
-                // Node found, remove it
-                primaryIndex.erase(primaryIndex.begin() + mid);
-                sortPrimaryIndex();  // Re-sort the index after removal
-                updatePrimaryIndexFile();  // Update the index file
-                return;
-            } else if (primaryIndex[mid].primaryKey < primaryKey) {
-                left = mid + 1;
-            } else {
-                right = mid - 1;
-            }
+        lock_guard<mutex> lock(writerMutex);
+        markUsed(lastUsed);
+        if (!pageIn()) return;
+        const PrimaryIndexVersion *version = current.load();
+        bool found = false;
+        NodePointer root = version->root == nullptr ? nullptr : removeFrom(version->root, primaryKey, found);
+        if (!found) {
+            cerr << "Error: Primary key not found.\n";  // If the key is not found
+            return;
         }
-        cerr << "Error: Primary key not found.\n";  // If the key is not found
+
+        // Shrink the tree while the root has a single child
+        while (root != nullptr && !root->leaf && root->children.size() == 1) {
+            root = root->children.front();
+        }
+        publish(root, version->count - 1, version->treeBytes - min(version->treeBytes, entryBytes(primaryKey)));
+        persistChange();  // Update the index file
     }
 
-    // Sort the primary index by primary key
-    void sortPrimaryIndex() {
-        sort(primaryIndex.begin(), primaryIndex.end());  // Sort using the overloaded operator<
+    // Point a primary key at the new offset of its moved record and update the file. One version
+    // is published, so lock-free readers find the key before and after the move.
+    void updatePrimaryNodeOffset(const string &primaryKey, int offset) {
+        lock_guard<mutex> lock(writerMutex);
+        markUsed(lastUsed);
+        if (!pageIn()) return;
+        const PrimaryIndexVersion *version = current.load();
+        NodePointer root = version->root == nullptr ? nullptr : replaceOffsetIn(version->root, primaryKey, offset);
+        if (root == nullptr) {
+            cerr << "Error: Primary key not found.\n";
+            return;
+        }
+        publish(root, version->count, version->treeBytes);
+        persistChange();
     }
 
-    // Perform binary search to find the offset of a given primary key
-    int binarySearchPrimaryIndex(const string &primaryKey) {
-        int left = 0;
-        int right = primaryIndex.size() - 1;
-        while (left <= right) {
-            int mid = left + (right - left) / 2;
-            if (primaryIndex[mid].primaryKey == primaryKey) {
-                return primaryIndex[mid].offset;  // Return the offset if the key is found
-            } else if (primaryKey < primaryIndex[mid].primaryKey) {
-                right = mid - 1;
-            } else {
-                left = mid + 1;
-            }
+    // Find the offset of a given primary key, or -1 if it is not indexed. Lock-free; a key the
+    // filter rejects returns without searching.
+    int binarySearchPrimaryIndex(const string &primaryKey) const {
+        countStat(StatCounter::PrimaryIndexLookups);
+        EpochGuard guard;
+        const PrimaryIndexVersion *version = current.load();
+        if (version->filter && !version->filter->mayContain(primaryKey)) return -1;
+        const PrimaryIndexTreeNode *node = residentVersion()->root.get();
+        if (node == nullptr) return -1;
+        while (!node->leaf) {
+            node = node->children[childFor(*node, primaryKey)].get();
+        }
+        auto position = lower_bound(node->keys.begin(), node->keys.end(), primaryKey);
+        if (position == node->keys.end() || *position != primaryKey) {
+            return -1;  // Return -1 if the key is not found
         }
-        return -1;  // Return -1 if the key is not found
+        return node->offsets[position - node->keys.begin()];  // Return the offset if the key is found
     }
 };
 
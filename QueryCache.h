@@ -0,0 +1,166 @@
+#ifndef HEALTHCAREMANAGEMENTSYSTEM_QUERYCACHE_H
+#define HEALTHCAREMANAGEMENTSYSTEM_QUERYCACHE_H
+
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include "TableChange.h"
+
+using namespace std;
+
+// The records a cached result was computed from: a whole table, or only the rows of `table`
+// whose `column` equals `value` (the query's WHERE condition)
+class QueryDependency {
+public:
+    string table;   // Table the query reads
+    string column;  // Filter column, empty when the query reads the whole table
+    string value;   // Filter value
+
+    // Whether `change` can alter the result
+    bool affectedBy(const TableChange &change) const {
+        if (change.table != table) return false;
+        return column.empty() || change.touches(column, value);
+    }
+};
+
+// Counters describing how well the cache is doing
+class QueryCacheStats {
+public:
+    unsigned long long hits = 0;          // Lookups answered from the cache
+    unsigned long long misses = 0;        // Lookups that had to execute the query
+    unsigned long long invalidations = 0; // Entries dropped because a mutation touched their records
+    unsigned long long evictions = 0;     // Entries dropped to stay within the size bounds
+
+    // Fraction of lookups answered from the cache
+    double hitRate() const {
+        unsigned long long lookups = hits + misses;
+        return lookups == 0 ? 0.0 : static_cast<double>(hits) / lookups;
+    }
+};
+
+// Bounded LRU cache of formatted query results keyed by normalized query text.
+// Entries are invalidated by the mutation notifications of the management systems: a change
+// drops exactly the entries whose table, and filter column value if any, it touched.
+// Invalidations arrive on the writers' threads, so every operation takes the cache mutex.
+class QueryCache {
+private:
+    // A cached result and its position in the recency list
+    class Entry {
+    public:
+        string output;                    // Formatted result, replayed as is
+        QueryDependency dependency;       // Records the result was computed from
+        list<string>::iterator recency;   // Position in `recencyList`
+    };
+
+    size_t maxEntries;                    // Most results kept at once
+    size_t maxBytes;                      // Most output bytes kept at once
+    size_t bytes = 0;                     // Output bytes currently cached
+    list<string> recencyList;             // Keys from most to least recently used
+    unordered_map<string, Entry> entries; // Cached results by key
+    QueryCacheStats stats;                // Hit and invalidation counters
+    unsigned long long generation = 0;    // Number of invalidate() calls so far
+    mutable mutex cacheMutex;             // Protects everything above
+
+    // Remove an entry and release its bytes
+    void erase(unordered_map<string, Entry>::iterator entry) {
+        bytes -= entry->second.output.size();
+        recencyList.erase(entry->second.recency);
+        entries.erase(entry);
+    }
+
+public:
+    explicit QueryCache(size_t maxEntries = 256, size_t maxBytes = 16 << 20)
+            : maxEntries(maxEntries), maxBytes(maxBytes) {}
+
+    // Largest single result worth caching
+    size_t maxEntryBytes() const {
+        return maxBytes / 4;
+    }
+
+    // Look up a result and copy it into `output`; returns false on a miss
+    bool lookup(const string &key, string &output) {
+        lock_guard<mutex> lock(cacheMutex);
+        auto entry = entries.find(key);
+        if (entry == entries.end()) {
+            stats.misses++;
+            return false;
+        }
+        stats.hits++;
+        recencyList.splice(recencyList.begin(), recencyList, entry->second.recency);
+        output = entry->second.output;
+        return true;
+    }
+
+    // Current invalidation generation; read it before computing a result that will be stored
+    unsigned long long getGeneration() const {
+        lock_guard<mutex> lock(cacheMutex);
+        return generation;
+    }
+
+    // Store a result computed when the cache was at `resultGeneration`, evicting the least
+    // recently used entries to stay within the bounds. A result that raced with a mutation is
+    // not stored, since it may have been computed from records that changed meanwhile.
+    void store(const string &key, string output, const QueryDependency &dependency,
+               unsigned long long resultGeneration) {
+        if (output.size() > maxEntryBytes() || maxEntries == 0) return;
+        lock_guard<mutex> lock(cacheMutex);
+        if (resultGeneration != generation) return;
+        auto existing = entries.find(key);
+        if (existing != entries.end()) erase(existing);
+
+        while (!recencyList.empty() && (entries.size() >= maxEntries || bytes + output.size() > maxBytes)) {
+            erase(entries.find(recencyList.back()));
+            stats.evictions++;
+        }
+
+        recencyList.push_front(key);
+        bytes += output.size();
+        Entry &entry = entries[key];
+        entry.output = std::move(output);
+        entry.dependency = dependency;
+        entry.recency = recencyList.begin();
+    }
+
+    // Drop the entries whose result may be changed by `change`
+    void invalidate(const TableChange &change) {
+        lock_guard<mutex> lock(cacheMutex);
+        generation++;
+        for (auto entry = entries.begin(); entry != entries.end();) {
+            auto next = std::next(entry);
+            if (entry->second.dependency.affectedBy(change)) {
+                erase(entry);
+                stats.invalidations++;
+            }
+            entry = next;
+        }
+    }
+
+    // Drop every entry
+    void clear() {
+        lock_guard<mutex> lock(cacheMutex);
+        entries.clear();
+        recencyList.clear();
+        bytes = 0;
+    }
+
+    // Number of cached results
+    size_t size() const {
+        lock_guard<mutex> lock(cacheMutex);
+        return entries.size();
+    }
+
+    // Output bytes currently cached
+    size_t byteSize() const {
+        lock_guard<mutex> lock(cacheMutex);
+        return bytes;
+    }
+
+    // Snapshot of the hit, miss, invalidation and eviction counters
+    QueryCacheStats getStats() const {
+        lock_guard<mutex> lock(cacheMutex);
+        return stats;
+    }
+};
+
+#endif //HEALTHCAREMANAGEMENTSYSTEM_QUERYCACHE_H
@@ -9,22 +9,58 @@
 #include "DoctorManagementSystem.h"
 #include "AppointmentManagementSystem.h"
 #include "PrimaryIndex.h"
+#include "Aggregator.h"
+#include "SortOperator.h"
+#include "ResultSink.h"
+#include "QueryCache.h"
+#include "StorageStats.h"
+#include "LatencyHistograms.h"
+#include "MemoryGovernor.h"
 
 using namespace std;
 
+// Executes SQL-like queries. A QueryHandler runs one query at a time; threads that query
+// concurrently each use their own handler over the shared (thread-safe) management systems.
 class QueryHandler {
 public:
     // Constructor initializes the Doctor and Appointment Management Systems
     QueryHandler(DoctorManagementSystem &doctorSys, AppointmentManagementSystem &appointmentSys)
-            : doctorSystem(doctorSys), appointmentSystem(appointmentSys) {}
+            : doctorSystem(doctorSys), appointmentSystem(appointmentSys) {
+        // Drop cached results whose records are touched by a mutation
+        doctorListenerId = doctorSystem.addChangeListener([this](const TableChange &change) {
+            cache.invalidate(change);
+        });
+        appointmentListenerId = appointmentSystem.addChangeListener([this](const TableChange &change) {
+            cache.invalidate(change);
+        });
+    }
+
+    ~QueryHandler() {
+        doctorSystem.removeChangeListener(doctorListenerId);
+        appointmentSystem.removeChangeListener(appointmentListenerId);
+    }
+
+    QueryHandler(const QueryHandler &) = delete;
+    QueryHandler &operator=(const QueryHandler &) = delete;
 
-    // Handles user queries by parsing and executing SQL-like queries
+    // Handles user queries by reading a SQL-like query from the console and executing it
     void handleUserQuery() {
         cout << "Enter your query: ";
         cin.ignore();
         string query;
         getline(cin, query);
 
+        ResultSink sink(outputFormat);
+        executeQuery(query, sink);
+    }
+
+    // Parses and executes one SQL-like query, writing its rows and messages to `sink`. Returns
+    // false if the query failed while executing (its partial result is not cached).
+    bool executeQuery(string query, ResultSink &sink) {
+        out = &sink;
+        out->beginResult();
+        queryFailed = false;
+
         // Trim leading and trailing spaces from the query
         trim(query);
 
@@ -40,31 +76,140 @@ public:
             query.pop_back();
         }
 
+        // "SET FORMAT TABLE|CSV|JSON" selects the layout of the following results
+        if (query.substr(0, 10) == "set format") {
+            string format = query.substr(10);
+            trim(format);
+            if (format == "table") {
+                outputFormat = OutputFormat::Table;
+            } else if (format == "csv") {
+                outputFormat = OutputFormat::Csv;
+            } else if (format == "json") {
+                outputFormat = OutputFormat::JsonLines;
+            } else {
+                out->message("Invalid output format. Use: SET FORMAT TABLE|CSV|JSON;");
+                return true;
+            }
+            out->setFormat(outputFormat);
+            out->message("Output format set to " + format + ".");
+            return true;
+        }
+
+        // "SHOW CACHE" reports the result cache's size and hit rate
+        if (query == "show cache") {
+            showCacheStats();
+            return true;
+        }
+
+        // "STATS" reports the I/O and operation counters of every thread, summed
+        if (query == "stats" || query == "show stats") {
+            showStorageStats();
+            return true;
+        }
+
+        // "SHOW LATENCY" reports the latency percentiles of every operation; "RESET LATENCY"
+        // starts the histograms over
+        if (query == "show latency") {
+            writeLatencyHistograms(*out);
+            return true;
+        }
+        if (query == "reset latency") {
+            resetLatencyHistograms();
+            out->message("Latency histograms reset.");
+            return true;
+        }
+
+        // "SHOW MEMORY" reports the estimated memory of every index structure and of the cache
+        if (query == "show memory") {
+            showMemoryUsage();
+            return true;
+        }
+
         // Validate the query format (must start with 'select' and contain 'from')
         if (query.substr(0, 6) != "select" || query.find("from") == string::npos) {
-            cout << "Invalid query format. Please use: SELECT <fields> FROM <table> WHERE <condition>;\n";
-            return;
+            out->message("Invalid query format. Please use: SELECT <fields> FROM <table> WHERE <condition>;");
+            return true;
+        }
+
+        // Answer repeated queries from the result cache; the key includes the output format
+        unsigned long long start = LatencyClock::now();
+        string cacheKey = to_string(static_cast<int>(out->getFormat())) + '|' + normalizeSpaces(query);
+        string output;
+        if (cache.lookup(cacheKey, output)) {
+            out->write(output);
+            recordLatency(TimedOperation::QueryCached, start);
+            return true;
+        }
+
+        // A mutation that lands while the query runs makes its result unsafe to cache
+        QueryDependency dependency;
+        unsigned long long generation = cache.getGeneration();
+        out->beginCopy(output, cache.maxEntryBytes());
+        queryPath = TimedOperation::QueryOther;
+        executeSelect(query, dependency);
+        if (out->endCopy() && !queryFailed) {
+            cache.store(cacheKey, std::move(output), dependency, generation);
         }
+        recordLatency(queryPath, start);
+        return !queryFailed;
+    }
+
+private:
+    DoctorManagementSystem &doctorSystem;
+    AppointmentManagementSystem &appointmentSystem;
+    size_t sortMemoryRows = 100000;  // Rows an ORDER BY keeps in memory before spilling to temp files
+    OutputFormat outputFormat = OutputFormat::Table;  // Layout of query results
+    ResultSink *out = nullptr;       // Sink of the query being executed
+    TimedOperation queryPath = TimedOperation::QueryOther;  // Path taken by the query being executed
+    bool queryFailed = false;        // Whether the query being executed failed
+    QueryCache cache;                // Recent results, invalidated by the systems' change notifications
+    int doctorListenerId;            // Handles of the cache's change listeners
+    int appointmentListenerId;
+
+    // Reports that the query being executed failed
+    void failQuery(const string &text) {
+        out->message(text);
+        queryFailed = true;
+    }
 
-        // Extract parts of the query (fields, table, condition)
+    // Executes a validated SELECT query and reports which records its result depends on
+    void executeSelect(const string &query, QueryDependency &dependency) {
+        // Extract parts of the query (fields, table, and the optional clauses)
         size_t selectPos = query.find("select");
         size_t fromPos = query.find("from");
-        size_t wherePos = query.find("where");
+        size_t wherePos = findKeyword(query, "where", fromPos);
+        size_t groupByPos = findKeyword(query, "group by", fromPos);
+        size_t orderByPos = findKeyword(query, "order by", fromPos);
+        size_t limitPos = findKeyword(query, "limit", fromPos);
+        size_t offsetPos = findKeyword(query, "offset", fromPos);
+        vector<size_t> clauseStarts = {wherePos, groupByPos, orderByPos, limitPos, offsetPos};
 
         string fields = query.substr(selectPos + 6, fromPos - (selectPos + 6));
-        string table = query.substr(fromPos + 4, (wherePos == string::npos ? query.size() : wherePos) - (fromPos + 4));
-        string condition = (wherePos != string::npos) ? query.substr(wherePos + 5) : "";
+        string table = query.substr(fromPos + 4, clauseEnd(query, fromPos, clauseStarts) - (fromPos + 4));
+        string condition = clauseText(query, wherePos, 5, clauseStarts);
+        string groupBy = clauseText(query, groupByPos, 8, clauseStarts);
+        string orderBy = clauseText(query, orderByPos, 8, clauseStarts);
+        string limitText = clauseText(query, limitPos, 5, clauseStarts);
+        string offsetText = clauseText(query, offsetPos, 6, clauseStarts);
 
-        // Trim spaces around extracted fields, table, and condition
+        // Trim spaces around extracted fields and table
         trim(fields);
         trim(table);
-        trim(condition);
 
-        // Check if the condition is 'id' and apply padding for doctors or appointments
+        // LIMIT and OFFSET take non-negative integers
+        long long limit = -1, offset = 0;
+        if ((limitPos != string::npos && !parseCount(limitText, limit)) ||
+            (offsetPos != string::npos && !parseCount(offsetText, offset))) {
+            out->message("Invalid LIMIT or OFFSET. Use non-negative whole numbers.");
+            return;
+        }
+
+        // Check if the condition is on an ID and apply padding for doctors or appointments
+        dependency.table = table;
         if ((table == "doctors" || table == "appointments") && !condition.empty()) {
             string key, value;
             if (parseCondition(condition, key, value)) {
-                if (key == "id") {
+                if (key == "id" || key == "doctorid") {
                     // Apply 2-byte padding for the ID value
                     if (value.size() == 1) {
                         value = "0" + value;  // Pad with leading '0' if the value is a single digit
@@ -72,33 +217,134 @@ public:
                     // Update the condition with the padded value
                     condition = key + " = '" + value + "'";
                 }
+                // Only rows matching the condition can change the result, unless the table is empty
+                // (the "insert records first" message then depends on the whole table)
+                if (tableSize(table) > 0) {
+                    dependency.column = normalizeColumn(key);
+                    dependency.value = value;
+                }
             }
         }
 
+        // Aggregates and GROUP BY are executed by the streaming hash aggregate
+        if (fields.find('(') != string::npos || !groupBy.empty()) {
+            handleAggregateQuery(table, fields, condition, groupBy, orderBy, limit, offset);
+            return;
+        }
+
+        // Ordered or paged listings go through the sort operator
+        if (!orderBy.empty() || limitPos != string::npos || offsetPos != string::npos) {
+            handleSortedQuery(table, fields, condition, orderBy, limit, offset);
+            return;
+        }
+
         // Process the query based on table and condition
         if (table == "doctors") {
-            if (isFileEmpty("DoctorPrimaryIndex.txt")) {
-                cout << "doctors file is empty, insert records first.\n";
+            if (tableSize(table) == 0) {
+                out->message("doctors file is empty, insert records first.");
             }
             handleDoctorQuery(fields, condition);
         } else if (table == "appointments") {
-            if (isFileEmpty("AppointmentPrimaryIndex.txt")) {
-                cout << "appointments file is empty, insert records first.\n";
+            if (tableSize(table) == 0) {
+                out->message("appointments file is empty, insert records first.");
             }
             handleAppointmentQuery(fields, condition);
         } else {
-            cout << "Invalid table name. Only 'doctors' and 'appointments' are supported.\n";
+            out->message("Invalid table name. Only 'doctors' and 'appointments' are supported.");
         }
     }
 
-private:
-    DoctorManagementSystem &doctorSystem;
-    AppointmentManagementSystem &appointmentSystem;
+    // Number of records in a table, from its in-memory primary index
+    size_t tableSize(const string &table) {
+        if (table == "doctors") return doctorSystem.countDoctors();
+        if (table == "appointments") return appointmentSystem.countAppointments();
+        return 0;
+    }
 
-    // Checks if a file is empty by opening it in binary mode and checking its size
-    bool isFileEmpty(const string& fileName) {
-        ifstream file(fileName, std::ios::ate | std::ios::binary); // Open in binary mode at the end
-        return file.tellg() == 0; // If tellg() returns 0, the file is empty
+    // Removes insignificant spaces outside quoted values (repeated spaces and spaces around
+    // '=', ',' and parentheses), so that equivalent queries share a cache entry
+    static string normalizeSpaces(const string &query) {
+        auto isPunctuation = [](char ch) { return ch == '=' || ch == ',' || ch == '(' || ch == ')'; };
+        string normalized;
+        bool quoted = false, pendingSpace = false;
+        for (char ch : query) {
+            if (!quoted && (ch == ' ' || ch == '\t')) {
+                pendingSpace = true;
+                continue;
+            }
+            if (pendingSpace && !normalized.empty() && !isPunctuation(normalized.back()) && !isPunctuation(ch)) {
+                normalized += ' ';
+            }
+            pendingSpace = false;
+            if (ch == '\'') quoted = !quoted;
+            normalized += ch;
+        }
+        return normalized;
+    }
+
+    // Writes the result cache statistics as one row
+    void showCacheStats() {
+        QueryCacheStats stats = cache.getStats();
+        char hitRate[16];
+        snprintf(hitRate, sizeof(hitRate), "%.1f%%", stats.hitRate() * 100);
+        out->beginRow("Query cache:");
+        out->numberField("Entries", cache.size());
+        out->numberField("Bytes", cache.byteSize());
+        out->numberField("Hits", stats.hits);
+        out->numberField("Misses", stats.misses);
+        out->field("Hit rate", hitRate);
+        out->numberField("Invalidations", stats.invalidations);
+        out->numberField("Evictions", stats.evictions);
+        out->endRow();
+    }
+
+    void showStorageStats() {
+        array<unsigned long long, statCounterCount> totals = storageStats().totals();
+        for (size_t i = 0; i < statCounterCount; ++i) {
+            out->beginRow();
+            out->field("Counter", statCounterInfo[i].first);
+            out->numberField("Value", totals[i]);
+            out->endRow();
+        }
+    }
+
+    void showMemoryUsage() {
+        size_t totalEntries = 0, totalBytes = 0;
+        for (const IndexMemory &structure : MemoryGovernor(doctorSystem, appointmentSystem).usage()) {
+            out->beginRow();
+            out->field("Table", structure.table);
+            out->field("Shard", structure.shard);
+            out->field("Structure", indexStructureNames[static_cast<size_t>(structure.kind)]);
+            out->numberField("Entries", structure.entries);
+            out->numberField("Bytes", structure.bytes);
+            out->numberField("Bytes per entry", structure.entries == 0 ? 0 : structure.bytes / structure.entries);
+            out->field("Resident", structure.resident ? "yes" : "no");
+            out->endRow();
+            totalEntries += structure.entries;
+            totalBytes += structure.bytes;
+        }
+        size_t cachedResults = cache.size(), cacheBytes = cache.byteSize();
+        out->beginRow();
+        out->field("Table", "");
+        out->field("Shard", "");
+        out->field("Structure", "query cache");
+        out->numberField("Entries", cachedResults);
+        out->numberField("Bytes", cacheBytes);
+        out->numberField("Bytes per entry", cachedResults == 0 ? 0 : cacheBytes / cachedResults);
+        out->field("Resident", "yes");
+        out->endRow();
+        out->beginRow();
+        out->field("Table", "total");
+        out->field("Shard", "");
+        out->field("Structure", "indexes");
+        out->numberField("Entries", totalEntries);
+        out->numberField("Bytes", totalBytes);
+        out->numberField("Bytes per entry", totalEntries == 0 ? 0 : totalBytes / totalEntries);
+        out->field("Resident", "");
+        out->endRow();
+        if (size_t limit = memoryBudget().limitBytes.load()) {
+            out->message("Memory budget of the indexes: " + to_string(limit) + " bytes.");
+        }
     }
 
     // Trims leading and trailing spaces from a string
@@ -125,6 +371,43 @@ private:
         }
     }
 
+    // Finds a clause keyword at or after `from`, only where it stands as a separate word
+    size_t findKeyword(const string &query, const string &keyword, size_t from) {
+        size_t pos = query.find(keyword, from);
+        while (pos != string::npos) {
+            bool startsWord = pos == 0 || query[pos - 1] == ' ';
+            bool endsWord = pos + keyword.size() == query.size() || query[pos + keyword.size()] == ' ';
+            if (startsWord && endsWord) return pos;
+            pos = query.find(keyword, pos + 1);
+        }
+        return string::npos;
+    }
+
+    // Position where the clause starting at `start` ends: the next clause start or the end of the query
+    size_t clauseEnd(const string &query, size_t start, const vector<size_t> &clauseStarts) {
+        size_t end = query.size();
+        for (size_t other : clauseStarts) {
+            if (other != string::npos && other > start && other < end) end = other;
+        }
+        return end;
+    }
+
+    // Trimmed text of the clause starting at `start`, skipping its keyword of length `keywordLength`
+    string clauseText(const string &query, size_t start, size_t keywordLength, const vector<size_t> &clauseStarts) {
+        if (start == string::npos) return "";
+        size_t end = clauseEnd(query, start, clauseStarts);
+        string text = query.substr(start + keywordLength, end - (start + keywordLength));
+        trim(text);
+        return text;
+    }
+
+    // Parses the number of a LIMIT or OFFSET clause
+    bool parseCount(const string &text, long long &count) {
+        if (text.empty() || text.size() > 18 || !all_of(text.begin(), text.end(), ::isdigit)) return false;
+        count = stoll(text);
+        return true;
+    }
+
     // Parses a WHERE condition into key and value parts
     bool parseCondition(const string &condition, string &key, string &value) {
         size_t eqPos = condition.find('=');
@@ -141,6 +424,396 @@ private:
         return true;
     }
 
+    // Parses "<key> between '<from>' and '<to>'" into its parts; quotes around the bounds are optional
+    bool parseBetweenCondition(const string &condition, string &key, string &from, string &to) {
+        size_t betweenPos = condition.find(" between ");
+        size_t andPos = betweenPos == string::npos ? string::npos : condition.find(" and ", betweenPos + 9);
+        if (andPos == string::npos) return false;
+
+        key = condition.substr(0, betweenPos);
+        from = condition.substr(betweenPos + 9, andPos - betweenPos - 9);
+        to = condition.substr(andPos + 5);
+        for (string *part : {&key, &from, &to}) {
+            trim(*part);
+            if (part->size() >= 2 && part->front() == '\'' && part->back() == '\'') {
+                *part = part->substr(1, part->size() - 2);
+            }
+        }
+        return !key.empty();
+    }
+
+    // Column layout of the rows produced when scanning a table
+    vector<string> tableSchema(const string &table) {
+        if (table == "doctors") return {"id", "name", "address"};
+        if (table == "appointments") return {"id", "date", "doctorid"};
+        return {};
+    }
+
+    // Maps the accepted spellings of a column to its canonical name
+    string normalizeColumn(string column) {
+        trim(column);
+        if (column == "doctor_id" || column == "doctor id") return "doctorid";
+        return column;
+    }
+
+    // Splits a comma separated list into trimmed items
+    vector<string> splitList(const string &list) {
+        vector<string> items;
+        string item;
+        istringstream listStream(list);
+        while (getline(listStream, item, ',')) {
+            trim(item);
+            items.push_back(item);
+        }
+        return items;
+    }
+
+    // Parses a SELECT list item such as "count(*)", "min(date)" or "doctorid"
+    bool parseSelectItem(const string &text, SelectItem &item) {
+        size_t open = text.find('(');
+        if (open == string::npos) {
+            item = SelectItem(AggregateFunction::None, normalizeColumn(text));
+            return true;
+        }
+        if (text.back() != ')') return false;
+
+        string function = text.substr(0, open);
+        string column = normalizeColumn(text.substr(open + 1, text.size() - open - 2));
+        trim(function);
+
+        if (function == "count") {
+            item = SelectItem(AggregateFunction::Count, column);
+        } else if (function == "min" && column != "*") {
+            item = SelectItem(AggregateFunction::Min, column);
+        } else if (function == "max" && column != "*") {
+            item = SelectItem(AggregateFunction::Max, column);
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    // Parses "<field> [asc|desc]" from an ORDER BY clause
+    bool parseOrderBy(const string &orderBy, string &column, bool &descending) {
+        column = orderBy;
+        descending = false;
+        size_t space = orderBy.rfind(' ');
+        if (space != string::npos) {
+            string direction = orderBy.substr(space + 1);
+            if (direction == "asc" || direction == "desc") {
+                descending = direction == "desc";
+                column = orderBy.substr(0, space);
+            }
+        }
+        column = normalizeColumn(column);
+        return !column.empty();
+    }
+
+    // Whether an ORDER BY field names a SELECT list item, either by column or by aggregate label
+    bool itemMatches(const SelectItem &item, const string &text) {
+        if (item.function == AggregateFunction::None) {
+            return item.column == text;
+        }
+        // Compare with the lowercase label, ignoring spaces, e.g. "count(*)"
+        string label, compactText;
+        for (char ch : item.label()) label += static_cast<char>(tolower(ch));
+        for (char ch : text) {
+            if (ch != ' ') compactText += ch;
+        }
+        return label == compactText;
+    }
+
+    // Writes one result row to the query's sink, one field per SELECT item
+    void printResultRow(const vector<SelectItem> &items, const vector<string> &row) {
+        out->beginRow();
+        for (size_t i = 0; i < items.size(); ++i) {
+            bool isIdValue = items[i].function != AggregateFunction::Count &&
+                             (items[i].column == "id" || items[i].column == "doctorid");
+            if (items[i].function == AggregateFunction::Count) {
+                out->numberField(itemLabel(items[i]), stoll(row[i]));
+            } else if (isIdValue && !row[i].empty()) {
+                out->idField(itemLabel(items[i]), row[i]);
+            } else {
+                out->field(itemLabel(items[i]), displayValue(items[i], row[i]));
+            }
+        }
+        out->endRow();
+    }
+
+    // Heading printed in front of a result value
+    string itemLabel(const SelectItem &item) {
+        if (item.function != AggregateFunction::None) {
+            string label = item.label();
+            for (size_t i = 0; i < label.size() && label[i] != '('; ++i) {
+                label[i] = toupper(label[i]);
+            }
+            return label;
+        }
+        if (item.column == "id") return "ID";
+        if (item.column == "doctorid") return "Doctor ID";
+        if (item.column == "date") return "Date";
+        if (item.column == "name") return "Name";
+        if (item.column == "address") return "Address";
+        return item.column;
+    }
+
+    // Formats a result value, printing IDs without their padding like the rest of the system
+    string displayValue(const SelectItem &item, const string &value) {
+        if (item.function != AggregateFunction::Count && value.empty()) {
+            return "NULL";  // MIN/MAX over no rows
+        }
+        bool isIdColumn = item.column == "id" || item.column == "doctorid";
+        if (item.function != AggregateFunction::Count && isIdColumn &&
+            all_of(value.begin(), value.end(), ::isdigit)) {
+            return to_string(stoi(value));
+        }
+        return value;
+    }
+
+    // Answers COUNT(*) on an indexed key from the primary or secondary index without scanning the data file
+    bool countFromIndex(const string &table, const string &key, const string &value, long long &count) {
+        if (table == "appointments" && key == "doctorid") {
+            count = appointmentSystem.countAppointmentsByDoctorID(value);
+        } else if (table == "appointments" && key == "id") {
+            count = appointmentSystem.appointmentExists(value) ? 1 : 0;
+        } else if (table == "doctors" && key == "name") {
+            count = doctorSystem.countDoctorsByName(value);
+        } else if (table == "doctors" && key == "id") {
+            count = doctorSystem.doctorExists(value) ? 1 : 0;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    // Handles queries with COUNT/MIN/MAX and GROUP BY using a streaming hash aggregate over a table scan
+    void handleAggregateQuery(const string &table, const string &fields, const string &condition,
+                              const string &groupBy, const string &orderBy, long long limit, long long offset) {
+        queryPath = TimedOperation::QueryAggregate;
+        vector<string> schema = tableSchema(table);
+        if (schema.empty()) {
+            out->message("Invalid table name. Only 'doctors' and 'appointments' are supported.");
+            return;
+        }
+        auto inSchema = [&](const string &column) {
+            return find(schema.begin(), schema.end(), column) != schema.end();
+        };
+
+        // Parse and validate the GROUP BY columns
+        vector<string> groupColumns;
+        if (!groupBy.empty()) {
+            for (const string &column : splitList(groupBy)) {
+                groupColumns.push_back(normalizeColumn(column));
+                if (!inSchema(groupColumns.back())) {
+                    out->message("Invalid GROUP BY column: " + column + ".");
+                    return;
+                }
+            }
+        }
+
+        // Parse and validate the SELECT list
+        vector<SelectItem> items;
+        bool onlyCounts = true;
+        for (const string &text : splitList(fields)) {
+            SelectItem item(AggregateFunction::None, "");
+            if (!parseSelectItem(text, item)) {
+                out->message("Invalid aggregate: " + text + ". Use COUNT(*), MIN(<column>) or MAX(<column>).");
+                return;
+            }
+            if (!(item.column == "*" && item.function == AggregateFunction::Count) && !inSchema(item.column)) {
+                out->message("Invalid field for " + table + ": " + item.column + ".");
+                return;
+            }
+            if (item.function == AggregateFunction::None &&
+                find(groupColumns.begin(), groupColumns.end(), item.column) == groupColumns.end()) {
+                out->message("Field " + item.column + " must appear in GROUP BY or inside an aggregate.");
+                return;
+            }
+            onlyCounts = onlyCounts && item.function == AggregateFunction::Count;
+            items.push_back(item);
+        }
+
+        // Parse the optional WHERE condition, applied as a filter during the scan
+        string key, value;
+        int filterIndex = -1;
+        if (!condition.empty()) {
+            if (!parseCondition(condition, key, value)) {
+                out->message("Invalid WHERE condition. Use the format: <key>=<value>.");
+                return;
+            }
+            key = normalizeColumn(key);
+            if (!inSchema(key)) {
+                out->message("Invalid WHERE condition key: " + key + ".");
+                return;
+            }
+            filterIndex = static_cast<int>(find(schema.begin(), schema.end(), key) - schema.begin());
+        }
+
+        // COUNT(*) on an indexed key is answered from the posting list or primary index alone
+        vector<vector<string>> results;
+        long long count;
+        if (groupColumns.empty() && onlyCounts && filterIndex != -1 && countFromIndex(table, key, value, count)) {
+            results.emplace_back(items.size(), to_string(count));
+        } else {
+            // Stream every record through the aggregate, filtering on the condition
+            HashAggregate aggregate(schema, groupColumns, items);
+            vector<string> row(schema.size());
+            if (table == "doctors") {
+                doctorSystem.scanDoctors([&](const Doctor &doctor) {
+                    row[0] = doctor.id;
+                    row[1] = doctor.name;
+                    row[2] = doctor.address;
+                    if (filterIndex == -1 || row[filterIndex] == value) aggregate.consume(row);
+                    return true;
+                });
+            } else {
+                appointmentSystem.scanAppointments([&](const Appointment &appointment) {
+                    row[0] = appointment.id;
+                    row[1] = appointment.date;
+                    row[2] = appointment.doctorID;
+                    if (filterIndex == -1 || row[filterIndex] == value) aggregate.consume(row);
+                    return true;
+                });
+            }
+            results = aggregate.results();
+        }
+
+        if (results.empty()) {
+            out->message("No " + table + " matched the query.");
+            return;
+        }
+
+        // ORDER BY may name any item of the SELECT list, e.g. "ORDER BY COUNT(*) DESC"
+        string orderColumn;
+        bool descending = false;
+        int sortIndex = -1;
+        if (!orderBy.empty()) {
+            if (!parseOrderBy(orderBy, orderColumn, descending)) {
+                out->message("Invalid ORDER BY clause. Use: ORDER BY <field> [ASC|DESC].");
+                return;
+            }
+            for (size_t i = 0; i < items.size() && sortIndex == -1; ++i) {
+                if (itemMatches(items[i], orderColumn)) sortIndex = i;
+            }
+            if (sortIndex == -1) {
+                out->message("ORDER BY field " + orderColumn + " must appear in the SELECT list.");
+                return;
+            }
+        }
+
+        SortOperator sorter(sortIndex, descending, offset, limit, [&](const vector<string> &result) {
+            printResultRow(items, result);
+        }, sortMemoryRows);
+        for (const vector<string> &result : results) {
+            if (sorter.done()) break;
+            sorter.add(result);
+        }
+        if (!sorter.finish()) failQuery("Error: the sort could not write its temporary files; the query was aborted.");
+    }
+
+    // Handles listings with ORDER BY, LIMIT or OFFSET: candidate rows come from an index lookup
+    // when the WHERE key is indexed, or from a table scan otherwise, and go through the sort operator
+    void handleSortedQuery(const string &table, const string &fields, const string &condition,
+                           const string &orderBy, long long limit, long long offset) {
+        queryPath = TimedOperation::QuerySorted;
+        vector<string> schema = tableSchema(table);
+        if (schema.empty()) {
+            out->message("Invalid table name. Only 'doctors' and 'appointments' are supported.");
+            return;
+        }
+        auto schemaIndex = [&](const string &column) {
+            auto it = find(schema.begin(), schema.end(), column);
+            return it == schema.end() ? -1 : static_cast<int>(it - schema.begin());
+        };
+
+        // Parse the SELECT list, expanding '*' to every column
+        vector<SelectItem> items;
+        vector<int> itemIndexes;
+        vector<string> columns = (fields == "*" || fields == "all") ? schema : splitList(fields);
+        for (const string &text : columns) {
+            string column = normalizeColumn(text);
+            if (schemaIndex(column) == -1) {
+                out->message("Invalid field for " + table + ": " + text + ".");
+                return;
+            }
+            items.emplace_back(AggregateFunction::None, column);
+            itemIndexes.push_back(schemaIndex(column));
+        }
+
+        // Parse ORDER BY, which may use any column of the table
+        string orderColumn;
+        bool descending = false;
+        int sortIndex = -1;
+        if (!orderBy.empty()) {
+            if (!parseOrderBy(orderBy, orderColumn, descending) || schemaIndex(orderColumn) == -1) {
+                out->message("Invalid ORDER BY clause. Use: ORDER BY <field> [ASC|DESC].");
+                return;
+            }
+            sortIndex = schemaIndex(orderColumn);
+        }
+
+        // Parse the optional WHERE condition
+        string key, value;
+        int filterIndex = -1;
+        if (!condition.empty()) {
+            if (!parseCondition(condition, key, value) || schemaIndex(normalizeColumn(key)) == -1) {
+                out->message("Invalid WHERE condition. Use the format: <key>=<value>.");
+                return;
+            }
+            key = normalizeColumn(key);
+            filterIndex = schemaIndex(key);
+        }
+
+        vector<string> projected(items.size());
+        SortOperator sorter(sortIndex, descending, offset, limit, [&](const vector<string> &row) {
+            for (size_t i = 0; i < items.size(); ++i) {
+                projected[i] = row[itemIndexes[i]];
+            }
+            printResultRow(items, projected);
+        }, sortMemoryRows);
+
+        // Each producer stops as soon as the sort needs no more rows (LIMIT without ORDER BY)
+        vector<string> row(schema.size());
+        if (table == "doctors") {
+            auto addDoctor = [&](const Doctor &doctor) {
+                row[0] = doctor.id;
+                row[1] = doctor.name;
+                row[2] = doctor.address;
+                if (filterIndex == -1 || row[filterIndex] == value) sorter.add(row);
+                return !sorter.done();
+            };
+            Doctor doctor;
+            if (key == "id") {
+                if (doctorSystem.readDoctor(value, doctor)) addDoctor(doctor);
+            } else if (key == "name") {
+                for (const string &doctorId : doctorSystem.searchDoctorsByName(value)) {
+                    if (doctorSystem.readDoctor(doctorId, doctor) && !addDoctor(doctor)) break;
+                }
+            } else {
+                doctorSystem.scanDoctors(addDoctor);
+            }
+        } else {
+            auto addAppointment = [&](const Appointment &appointment) {
+                row[0] = appointment.id;
+                row[1] = appointment.date;
+                row[2] = appointment.doctorID;
+                if (filterIndex == -1 || row[filterIndex] == value) sorter.add(row);
+                return !sorter.done();
+            };
+            Appointment appointment;
+            if (key == "id") {
+                if (appointmentSystem.readAppointment(value, appointment)) addAppointment(appointment);
+            } else if (key == "doctorid") {
+                for (const string &appointmentId : appointmentSystem.searchAppointmentsByDoctorID(value)) {
+                    if (appointmentSystem.readAppointment(appointmentId, appointment) && !addAppointment(appointment)) break;
+                }
+            } else {
+                appointmentSystem.scanAppointments(addAppointment);
+            }
+        }
+        if (!sorter.finish()) failQuery("Error: the sort could not write its temporary files; the query was aborted.");
+    }
+
     // Handles doctor-related queries with or without conditions
     void handleDoctorQuery(const string &fields, const string &condition) {
         if (condition.empty()) {
@@ -150,7 +823,7 @@ private:
 
         string key, value;
         if (!parseCondition(condition, key, value)) {
-            cout << "Invalid WHERE condition. Use the format: <key>=<value>.\n";
+            out->message("Invalid WHERE condition. Use the format: <key>=<value>.");
             return;
         }
 
@@ -161,75 +834,80 @@ private:
         } else if (key == "address") {
             handleDoctorByAddress(fields, value);
         } else {
-            cout << "Invalid WHERE condition. Valid keys for Doctor are 'ID' or 'Name'.\n";
+            out->message("Invalid WHERE condition. Valid keys for Doctor are 'ID' or 'Name'.");
         }
     }
 
     // Handles doctor queries with no conditions
     void handleDoctorNoCondition(const string &fields) {
+        queryPath = TimedOperation::QueryDoctors;
         if (fields == "*" || fields == "all") {
-            doctorSystem.printAllDoctors(0);
+            doctorSystem.printAllDoctors(0, *out);
         } else if (fields == "id") {
-            doctorSystem.printAllDoctors(1);
+            doctorSystem.printAllDoctors(1, *out);
         } else if (fields == "name") {
-            doctorSystem.printAllDoctors(2);
+            doctorSystem.printAllDoctors(2, *out);
         } else if (fields == "address") {
-            doctorSystem.printAllDoctors(3);
+            doctorSystem.printAllDoctors(3, *out);
         } else {
-            cout << "Invalid field in SELECT query for Doctor.\n";
+            out->message("Invalid field in SELECT query for Doctor.");
         }
     }
 
     // Handles doctor queries filtered by ID
     void handleDoctorById(const string &fields, const string &id) {
+        queryPath = TimedOperation::QueryDoctorById;
         if (fields == "*" || fields == "all") {
-            doctorSystem.printDoctorById(id, 0);  // Assuming this prints all doctor info
+            doctorSystem.printDoctorById(id, 0, *out);  // Assuming this prints all doctor info
         } else if (fields == "id") {
-            doctorSystem.printDoctorById(id, 1);  // Print only ID
+            doctorSystem.printDoctorById(id, 1, *out);  // Print only ID
         } else if (fields == "name") {
-            doctorSystem.printDoctorById(id, 2);  // Print only Name
+            doctorSystem.printDoctorById(id, 2, *out);  // Print only Name
         } else if (fields == "address") {
-            doctorSystem.printDoctorById(id, 3);  // Print only Address
+            doctorSystem.printDoctorById(id, 3, *out);  // Print only Address
         } else {
-            cout << "Invalid field for Doctor: " << fields << ".\n";
+            out->message("Invalid field for Doctor: " + fields + ".");
         }
     }
 
     // Handles doctor queries filtered by Name
     void handleDoctorByName(const string &fields, const string &name) {
+        queryPath = TimedOperation::QueryDoctorByName;
         vector<string> doctorIds = doctorSystem.searchDoctorsByName(name);
         if (doctorIds.empty()) {
-            cout << "No doctors found with name: " << name << ".\n";
+            out->message("No doctors found with name: " + name + ".");
             return;
         }
 
-        for (const string &doctorId: doctorIds) {
-            if (fields == "*" || fields == "all") {
-                doctorSystem.printDoctorById(doctorId, 0);
-            } else if (fields == "id") {
-                doctorSystem.printDoctorById(doctorId, 1);
-            } else if (fields == "name") {
-                doctorSystem.printDoctorById(doctorId, 2);
-            } else if (fields == "address") {
-                doctorSystem.printDoctorById(doctorId, 3);
-            } else {
-                cout << "Invalid field for Doctor: " << fields << ".\n";
+        // Fetch every matching record in one batch
+        if (fields == "*" || fields == "all") {
+            doctorSystem.printDoctorsByIds(doctorIds, 0, *out);
+        } else if (fields == "id") {
+            doctorSystem.printDoctorsByIds(doctorIds, 1, *out);
+        } else if (fields == "name") {
+            doctorSystem.printDoctorsByIds(doctorIds, 2, *out);
+        } else if (fields == "address") {
+            doctorSystem.printDoctorsByIds(doctorIds, 3, *out);
+        } else {
+            for (size_t i = 0; i < doctorIds.size(); ++i) {
+                out->message("Invalid field for Doctor: " + fields + ".");
             }
         }
     }
 
     // Handles doctor queries filtered by Address
     void handleDoctorByAddress(const string &fields, const string &address) {
+        queryPath = TimedOperation::QueryDoctorByAddress;
         if (fields == "*" || fields == "all") {
-            doctorSystem.printDoctorByAddress(address, 0);
+            doctorSystem.printDoctorByAddress(address, 0, *out);
         } else if (fields == "id") {
-            doctorSystem.printDoctorByAddress(address, 1);
+            doctorSystem.printDoctorByAddress(address, 1, *out);
         } else if (fields == "name") {
-            doctorSystem.printDoctorByAddress(address, 2);
+            doctorSystem.printDoctorByAddress(address, 2, *out);
         } else if (fields == "address") {
-            doctorSystem.printDoctorByAddress(address, 3);
+            doctorSystem.printDoctorByAddress(address, 3, *out);
         } else {
-            cout << "Invalid field for Doctor: " << fields << ".\n";
+            out->message("Invalid field for Doctor: " + fields + ".");
         }
     }
 
@@ -240,9 +918,13 @@ private:
             return;
         }
 
-        string key, value;
+        string key, value, to;
+        if (parseBetweenCondition(condition, key, value, to) && key == "date") {
+            handleAppointmentByDateRange(fields, value, to);
+            return;
+        }
         if (!parseCondition(condition, key, value)) {
-            cout << "Invalid WHERE condition for Appointment.\n";
+            out->message("Invalid WHERE condition for Appointment.");
             return;
         }
 
@@ -253,83 +935,106 @@ private:
         } else if (key == "date") {
             handleAppointmentByDate(fields, value);
         } else {
-            cout << "Invalid WHERE condition. Valid keys for Appointment are 'id'.\n";
+            out->message("Invalid WHERE condition. Valid keys for Appointment are 'id'.");
         }
     }
 
     // Handles appointment queries with no conditions
     void handleAppointmentNoCondition(const string &fields) {
+        queryPath = TimedOperation::QueryAppointments;
         if (fields == "*" || fields == "all") {
-            appointmentSystem.printAllAppointments(0);
+            appointmentSystem.printAllAppointments(0, *out);
         } else if (fields == "id") {
-            appointmentSystem.printAllAppointments(1);
+            appointmentSystem.printAllAppointments(1, *out);
         } else if (fields == "date") {
-            appointmentSystem.printAllAppointments(2);
+            appointmentSystem.printAllAppointments(2, *out);
         } else if (fields == "doctor_id") {
-            appointmentSystem.printAllAppointments(3);
+            appointmentSystem.printAllAppointments(3, *out);
         } else {
-            cout << "Invalid field in SELECT query for Appointment.\n";
+            out->message("Invalid field in SELECT query for Appointment.");
         }
     }
 
     // Handles appointment queries filtered by ID
     void handleAppointmentById(const string &fields, const string &id) {
-        PrimaryIndex appointmentPrimaryIndex = appointmentSystem.getAppointmentPrimaryIndex();
-        int offset = appointmentPrimaryIndex.binarySearchPrimaryIndex(id);
-        if (offset == -1) {
-            cout << "Appointment with ID " << id << " not found.\n";
+        queryPath = TimedOperation::QueryAppointmentById;
+        if (!appointmentSystem.appointmentExists(id)) {
+            out->message("Appointment with ID " + id + " not found.");
             return;
         }
 
         if (fields == "*" || fields == "all") {
-            appointmentSystem.printAppointmentById(id, 0);
+            appointmentSystem.printAppointmentById(id, 0, *out);
         } else if (fields == "id") {
-            appointmentSystem.printAppointmentById(id, 1);
+            appointmentSystem.printAppointmentById(id, 1, *out);
         } else if (fields == "date") {
-            appointmentSystem.printAppointmentById(id, 2);
+            appointmentSystem.printAppointmentById(id, 2, *out);
         } else if (fields == "doctor id") {
-            appointmentSystem.printAppointmentById(id, 3);
+            appointmentSystem.printAppointmentById(id, 3, *out);
         } else {
-            cout << "Invalid field for Appointment: " << fields << ".\n";
+            out->message("Invalid field for Appointment: " + fields + ".");
         }
     }
 
     // Handles appointment queries filtered by Doctor ID
     void handleAppointmentByDoctorId(const string &fields, const string &doctorId) {
+        queryPath = TimedOperation::QueryAppointmentByDoctorId;
         vector<string> appointmentIds = appointmentSystem.searchAppointmentsByDoctorID(doctorId);
         if (appointmentIds.empty()) {
-            cout << "No appointments found for Doctor ID: " << doctorId << ".\n";
+            out->message("No appointments found for Doctor ID: " + doctorId + ".");
             return;
         }
 
-        for (const string &appointmentId: appointmentIds) {
-            if (fields == "*" || fields == "all") {
-                appointmentSystem.printAppointmentById(appointmentId, 0);
-            } else if (fields == "id") {
-                appointmentSystem.printAppointmentById(appointmentId, 1);
-            } else if (fields == "date") {
-                appointmentSystem.printAppointmentById(appointmentId, 2);
-            } else if (fields == "doctor_id") {
-                appointmentSystem.printAppointmentById(appointmentId, 3);
-            } else {
-                cout << "Invalid field for Appointment: " << fields << ".\n";
+        // Fetch every matching record in one batch
+        if (fields == "*" || fields == "all") {
+            appointmentSystem.printAppointmentsByIds(appointmentIds, 0, *out);
+        } else if (fields == "id") {
+            appointmentSystem.printAppointmentsByIds(appointmentIds, 1, *out);
+        } else if (fields == "date") {
+            appointmentSystem.printAppointmentsByIds(appointmentIds, 2, *out);
+        } else if (fields == "doctor_id") {
+            appointmentSystem.printAppointmentsByIds(appointmentIds, 3, *out);
+        } else {
+            for (size_t i = 0; i < appointmentIds.size(); ++i) {
+                out->message("Invalid field for Appointment: " + fields + ".");
             }
         }
     }
 
     // Handles appointment queries filtered by Date
     void handleAppointmentByDate(const string &fields, const string &date) {
+        queryPath = TimedOperation::QueryAppointmentByDate;
+        if (fields == "*" || fields == "all") {
+            appointmentSystem.printAppointmentByDate(date, 0, *out);
+        } else if (fields == "id") {
+            appointmentSystem.printAppointmentByDate(date, 1, *out);
+        } else if (fields == "date") {
+            appointmentSystem.printAppointmentByDate(date, 2, *out);
+        } else if (fields == "doctor_id") {
+            appointmentSystem.printAppointmentByDate(date, 3, *out);
+        } else {
+            out->message("Invalid field for Appointment: " + fields + ".");
+        }
+    }
+
+    // Handles appointment queries filtered by a range of dates ("date BETWEEN 'a' AND 'b'"); with
+    // month partitions only the partitions of the range are scanned
+    void handleAppointmentByDateRange(const string &fields, const string &from, const string &to) {
+        queryPath = TimedOperation::QueryAppointmentByDateRange;
+        int choice;
         if (fields == "*" || fields == "all") {
-            appointmentSystem.printAppointmentByDate(date, 0);
+            choice = 0;
         } else if (fields == "id") {
-            appointmentSystem.printAppointmentByDate(date, 1);
+            choice = 1;
         } else if (fields == "date") {
-            appointmentSystem.printAppointmentByDate(date, 2);
+            choice = 2;
         } else if (fields == "doctor_id") {
-            appointmentSystem.printAppointmentByDate(date, 3);
+            choice = 3;
         } else {
-            cout << "Invalid field for Appointment: " << fields << ".\n";
+            out->message("Invalid field for Appointment: " + fields + ".");
+            return;
         }
+        appointmentSystem.printAppointmentsByDateRange(from, to, choice, *out);
     }
 };
 
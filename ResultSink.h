@@ -0,0 +1,319 @@
+#ifndef HEALTHCAREMANAGEMENTSYSTEM_RESULTSINK_H
+#define HEALTHCAREMANAGEMENTSYSTEM_RESULTSINK_H
+
+#include <string>
+#include <string_view>
+#include <cstdio>
+#include <charconv>
+#include <iostream>
+
+using namespace std;
+
+// Layouts a result sink can produce
+enum class OutputFormat {
+    Table,     // "ID: 1 | Name: ali | Address: cairo" lines, as printed by the menu
+    Csv,       // Header line followed by comma separated values
+    JsonLines  // One JSON object per row
+};
+
+// Collects result rows into a large output buffer and writes them out in one call when the buffer
+// fills up or the sink is flushed. Rows are described field by field, so producers do not depend on
+// iostream or on the output format. Output goes to a FILE* (stdout by default) or into a string.
+class ResultSink {
+private:
+    FILE *out;               // Destination stream, or nullptr when capturing into a string
+    string *capture;         // Destination string when capturing
+    OutputFormat format;     // Layout of the rows
+    string buffer;           // Pending output
+    size_t bufferSize;       // Flush threshold for the buffer
+    int fieldCount = 0;      // Fields written in the current row
+    bool blockRow = false;   // Whether the current row uses the multi-line "title + fields" layout
+    bool headerDone = false; // Whether the CSV header has been written
+    string header;           // CSV header being collected from the first row's labels
+    size_t rowCount = 0;     // Rows written since the sink was created
+    size_t rowStart = 0;     // Position in the buffer where the current row starts
+    string *copy = nullptr;  // Receives a copy of the output while copying is active
+    size_t copyStart = 0;    // Position in the buffer where the copied output starts
+    size_t copyLimit = 0;    // Largest copy kept; a longer output abandons the copy
+    bool copyOverflow = false; // Whether the output outgrew copyLimit
+
+    // Append a label as a JSON key: lowercase with spaces turned into underscores
+    void appendJsonKey(string_view label) {
+        buffer += '"';
+        for (char ch : label) {
+            if (ch == ' ') buffer += '_';
+            else if (ch >= 'A' && ch <= 'Z') buffer += static_cast<char>(ch - 'A' + 'a');
+            else if (ch != '"' && ch != '\\') buffer += ch;
+        }
+        buffer += "\":";
+    }
+
+    // Append a value as a JSON string, escaping quotes, backslashes and control characters
+    void appendJsonString(string_view value) {
+        buffer += '"';
+        for (char ch : value) {
+            if (ch == '"' || ch == '\\') {
+                buffer += '\\';
+                buffer += ch;
+            } else if (static_cast<unsigned char>(ch) < 0x20) {
+                char escape[8];
+                snprintf(escape, sizeof(escape), "\\u%04x", ch);
+                buffer += escape;
+            } else {
+                buffer += ch;
+            }
+        }
+        buffer += '"';
+    }
+
+    // Append a CSV cell, quoting it when it contains a separator, quote or newline
+    static void appendCsvCell(string &target, string_view value) {
+        if (value.find_first_of(",\"\n") == string_view::npos) {
+            target += value;
+            return;
+        }
+        target += '"';
+        for (char ch : value) {
+            if (ch == '"') target += '"';
+            target += ch;
+        }
+        target += '"';
+    }
+
+    // Write a field whose value is already formatted; `quoted` tells JSON whether it is a string
+    void writeField(string_view label, string_view value, bool quoted) {
+        switch (format) {
+            case OutputFormat::Table:
+                if (blockRow) {
+                    buffer += "  ";
+                } else if (fieldCount > 0) {
+                    buffer += " | ";
+                }
+                buffer += label;
+                buffer += ": ";
+                buffer += value;
+                if (blockRow) buffer += '\n';
+                break;
+            case OutputFormat::Csv:
+                if (fieldCount > 0) buffer += ',';
+                appendCsvCell(buffer, value);
+                if (!headerDone) {
+                    if (fieldCount > 0) header += ',';
+                    appendCsvCell(header, label);
+                }
+                break;
+            case OutputFormat::JsonLines:
+                buffer += fieldCount > 0 ? ',' : '{';
+                appendJsonKey(label);
+                if (quoted) appendJsonString(value);
+                else buffer += value;
+                break;
+        }
+        fieldCount++;
+    }
+
+public:
+    // The buffer grows with what is written and a flush empties it without freeing it: a sink
+    // allocates no more than it writes, and a long-lived sink reuses its capacity.
+
+    // Sink writing to a stdio stream (stdout by default)
+    explicit ResultSink(OutputFormat format = OutputFormat::Table, FILE *out = stdout, size_t bufferSize = 1 << 20)
+            : out(out), capture(nullptr), format(format), bufferSize(bufferSize) {}
+
+    // Sink appending everything to a string, e.g. to cache or send a result
+    ResultSink(OutputFormat format, string &capture, size_t bufferSize = 1 << 16)
+            : out(nullptr), capture(&capture), format(format), bufferSize(bufferSize) {}
+
+    ~ResultSink() {
+        flush();
+    }
+
+    ResultSink(const ResultSink &) = delete;
+    ResultSink &operator=(const ResultSink &) = delete;
+
+    // Output format of the sink
+    OutputFormat getFormat() const {
+        return format;
+    }
+
+    // Switch the layout of the following rows; a CSV header is written again for the next row
+    void setFormat(OutputFormat newFormat) {
+        format = newFormat;
+        beginResult();
+    }
+
+    // Number of rows written so far
+    size_t getRowCount() const {
+        return rowCount;
+    }
+
+    // Start a row. A non-empty title switches the table layout to a multi-line block:
+    // the title on its own line followed by one indented "label: value" line per field.
+    void beginRow(string_view title = {}) {
+        fieldCount = 0;
+        rowStart = buffer.size();
+        blockRow = format == OutputFormat::Table && !title.empty();
+        if (blockRow) {
+            buffer += title;
+            buffer += '\n';
+        }
+    }
+
+    // Write a text field
+    void field(string_view label, string_view value) {
+        writeField(label, value, true);
+    }
+
+    // Write an integer field
+    void numberField(string_view label, long long value) {
+        char digits[24];
+        auto result = to_chars(digits, digits + sizeof(digits), value);
+        writeField(label, string_view(digits, result.ptr - digits), false);
+    }
+
+    // Write a zero-padded record ID ("07") as a plain number (7); non-numeric IDs are written as text
+    void idField(string_view label, string_view id) {
+        long long value;
+        auto result = from_chars(id.data(), id.data() + id.size(), value);
+        if (id.empty() || result.ec != errc() || result.ptr != id.data() + id.size()) {
+            field(label, id);
+            return;
+        }
+        numberField(label, value);
+    }
+
+    // Finish the current row
+    void endRow() {
+        switch (format) {
+            case OutputFormat::Table:
+                if (!blockRow) buffer += '\n';
+                break;
+            case OutputFormat::Csv:
+                if (!headerDone) {
+                    // The first row's labels become the header, written in front of the row
+                    header += '\n';
+                    buffer.insert(rowStart, header);
+                    headerDone = true;
+                }
+                buffer += '\n';
+                break;
+            case OutputFormat::JsonLines:
+                buffer += fieldCount > 0 ? "}\n" : "{}\n";
+                break;
+        }
+        rowCount++;
+        if (buffer.size() >= bufferSize) flush();
+    }
+
+    // Write an informational line such as "Doctor not found."; CSV output leaves it out
+    void message(string_view text) {
+        if (format == OutputFormat::Table) {
+            buffer += text;
+            if (text.empty() || text.back() != '\n') buffer += '\n';
+        } else if (format == OutputFormat::JsonLines) {
+            buffer += "{\"message\":";
+            while (!text.empty() && text.back() == '\n') text.remove_suffix(1);
+            appendJsonString(text);
+            buffer += "}\n";
+        }
+        if (buffer.size() >= bufferSize) flush();
+    }
+
+    // Write preformatted output as is, e.g. a result replayed from a cache
+    void write(string_view text) {
+        buffer += text;
+        if (buffer.size() >= bufferSize) flush();
+    }
+
+    // Start a new result set: in CSV its first row is preceded by a header line again
+    void beginResult() {
+        headerDone = false;
+        header.clear();
+    }
+
+    // Start copying everything written from now on into `target`, up to `maxBytes`
+    void beginCopy(string &target, size_t maxBytes) {
+        copy = &target;
+        copyStart = buffer.size();
+        copyLimit = maxBytes;
+        copyOverflow = false;
+    }
+
+    // Stop copying; returns false if the output was larger than the limit and the copy is incomplete
+    bool endCopy() {
+        appendCopy();
+        copy = nullptr;
+        return !copyOverflow;
+    }
+
+    // Write all pending output to the destination
+    void flush() {
+        if (buffer.empty()) return;
+        appendCopy();
+        if (capture != nullptr) {
+            capture->append(buffer);
+        } else if (out != nullptr) {
+            fwrite(buffer.data(), 1, buffer.size(), out);
+            fflush(out);
+        }
+        buffer.clear();
+        copyStart = 0;
+    }
+
+private:
+    // Move the output written since the last copy into the copy target, unless it grew too large
+    void appendCopy() {
+        if (copy == nullptr || copyOverflow) return;
+        size_t length = buffer.size() - copyStart;
+        if (copy->size() + length > copyLimit) {
+            copyOverflow = true;
+            copy->clear();
+        } else {
+            copy->append(buffer, copyStart, length);
+        }
+        copyStart = buffer.size();
+    }
+};
+
+// Where the management systems' confirmations ("Appointment date updated successfully.") go on
+// one thread: the console, or the sink of the statement the thread is executing, or nowhere
+// when the statement reports its outcome itself. Kept per thread, so statements executed
+// concurrently never share a stream.
+class ConfirmationTarget {
+public:
+    ResultSink *sink = nullptr;  // Sink of the statement being executed, if any
+    bool quiet = false;          // Drop the confirmations
+};
+
+inline thread_local ConfirmationTarget confirmationTarget;
+
+// Write a confirmation of a change to this thread's confirmation target
+inline void confirm(const string &text) {
+    if (confirmationTarget.quiet) return;
+    if (confirmationTarget.sink != nullptr) {
+        confirmationTarget.sink->message(text);
+    } else {
+        cout << text << "\n";
+    }
+}
+
+// Sends this thread's confirmations to `sink` (or drops them if `quiet`) for its lifetime
+class ConfirmationRedirect {
+private:
+    ConfirmationTarget previous;  // Target restored on destruction
+
+public:
+    ConfirmationRedirect(ResultSink *sink, bool quiet) : previous(confirmationTarget) {
+        confirmationTarget.sink = sink;
+        confirmationTarget.quiet = quiet;
+    }
+
+    ~ConfirmationRedirect() {
+        confirmationTarget = previous;
+    }
+
+    ConfirmationRedirect(const ConfirmationRedirect &) = delete;
+    ConfirmationRedirect &operator=(const ConfirmationRedirect &) = delete;
+};
+
+#endif //HEALTHCAREMANAGEMENTSYSTEM_RESULTSINK_H
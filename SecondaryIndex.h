@@ -2,6 +2,10 @@
 #define HEALTHCAREMANAGEMENTSYSTEM_SECONDARYINDEX_H
 
 #include <bits/stdc++.h>
+#include "DurableFile.h"
+#include "BloomFilter.h"
+#include "StorageStats.h"
+#include "MemoryAccounting.h"
 
 using namespace std;
 
@@ -15,60 +19,76 @@ public:
     PrimaryKeyNode(const string& pk, const string& next) : primaryKey(pk), nextIndex(next) {}
 };
 
+// Secondary index: secondary key -> head of a linked list of primary keys in primaryKeyList.
+//
+// To stay within the memory budget the map and the list can be evicted (the filter stays) and
+// are read back from their files on the next use. Eviction needs the table lock exclusively;
+// readers holding it shared may page the index in concurrently, one of them loading it.
 class SecondaryIndex {
 private:
     string secondaryIndexFileName;       // Name of the secondary index file
     string labelIdListFileName;          // Name of the label ID list file
+    string dataFileName;                 // Data file of the indexed records; synced before each write
     map<string, int> secondaryIndexMap;  // Maps secondary key to the index of the head of the linked list
     vector<PrimaryKeyNode> primaryKeyList; // List of PrimaryKeyNodes representing the linked list
+    vector<int> freeLabels;              // Indexes of free ("##") labels available for reuse
+    bool autoPersist = true;             // Whether every change is written to the files immediately
+    bool dirty = false;                  // Whether the in-memory index has unwritten changes
+    PersistSchedule persistSchedule;     // When changes are due to be written under the durability policy
+    bool grouping = false;               // Whether changes are collected into one change group
+    bool groupChanged = false;           // Whether the open change group changed the index
+    unique_ptr<BloomFilter> filter = make_unique<BloomFilter>(0); // Filter of the secondary keys,
+                                                                  // checked before every search
+    size_t keyBytes = 0;                 // Estimated heap bytes of the map's entries
+    atomic<bool> resident{true};         // Whether the map and the list are in memory
+    mutable mutex pageInMutex;           // Serializes readers paging the index in
+    mutable atomic<unsigned long long> lastUsed{memoryBudget().tick.load()}; // Memory budget tick of the last use
 
-public:
-    // Get the index of a free label for adding a new PrimaryKeyNode
-    int getFreeLabelIndex() {
-        for (int index = 0; index < primaryKeyList.size(); ++index) {
-            if (primaryKeyList[index].nextIndex == "##") {
-                return index;  // Return the first free index (marked as "##")
-            }
-        }
-        primaryKeyList.emplace_back("##", "##");  // If no free label found, add a new one
-        return primaryKeyList.size() - 1; // Return the new index
-    }
-
-    // Release a label ID to mark it as free
-    void releaseLabelId(int index) {
-        if (index >= 0 && index < primaryKeyList.size()) {
-            primaryKeyList[index].primaryKey = "##";
-            primaryKeyList[index].nextIndex = "##";  // Mark it as free
-        }
+    // Estimated bytes of a map entry: tree node links and colour, the key and the head
+    static size_t mapEntryBytes(const string &secondaryKey) {
+        return 4 * sizeof(void *) + sizeof(pair<const string, int>) + stringHeapBytes(secondaryKey) + allocationOverhead;
     }
 
-    // Set the filenames for the secondary index and label ID list, and load the data
-    void setSecondaryIndexAndLabelIdListFileNames(const string& secondaryIndex, const string& labelIdFileName) {
-        this->secondaryIndexFileName = secondaryIndex;
-        this->labelIdListFileName = labelIdFileName;
-        loadSecondaryIndexAndLabelIdList();  // Load the secondary index and label list data
+    // Add a secondary key to the map with `head` if it is absent; returns whether it was added
+    bool insertSecondaryKey(const string &secondaryKey, int head) {
+        if (!secondaryIndexMap.emplace(secondaryKey, head).second) return false;
+        keyBytes += mapEntryBytes(secondaryKey);
+        return true;
     }
 
-    // Load secondary index and label list data from files
-    void loadSecondaryIndexAndLabelIdList() {
-        // Load Secondary Index (secondary key -> head pointer)
+    // Read the secondary keys from the index file; `contents` receives the file's contents.
+    // Returns false if the file could not be opened.
+    bool readSecondaryKeys(string &contents) {
         ifstream secFile(secondaryIndexFileName);
         if (!secFile.is_open()) {
             cerr << "Error opening file: " << secondaryIndexFileName << "\n";
-            return;
+            return false;
         }
 
+        contents.assign(istreambuf_iterator<char>(secFile), istreambuf_iterator<char>());
+        secFile.close();
+        istringstream secStream(contents);
         string line;
-        while (getline(secFile, line)) {
+        while (getline(secStream, line)) {
             istringstream recordStream(line);
             string secondaryKey, headIndex;
             getline(recordStream, secondaryKey, '|');  // Parse secondary key
             getline(recordStream, headIndex, '|');  // Parse head pointer (index)
-            secondaryIndexMap[secondaryKey] = stoi(headIndex);  // Store the head index for the secondary key
+            try {
+                int head = stoi(headIndex);
+                if (!insertSecondaryKey(secondaryKey, head)) {
+                    secondaryIndexMap[secondaryKey] = head;  // Store the head index for the secondary key
+                }
+            } catch (const exception &) {
+                // A damaged line is skipped; an index rebuild from the data file restores the entry
+                cerr << "Warning: skipping malformed line in " << secondaryIndexFileName << ": " << line << "\n";
+            }
         }
-        secFile.close();
+        return true;
+    }
 
-        // Load Label Id List (linked list of primary keys)
+    // Read the linked lists of primary keys from the label ID list file
+    void readLabelIdList() {
         ifstream labelFile(labelIdListFileName);
         if (!labelFile.is_open()) {
             cerr << "Error opening file: " << labelIdListFileName << "\n";
@@ -77,7 +97,7 @@ public:
 
         primaryKeyList.clear();  // Clear the list to prepare for loading new data
 
-        string recNoStr, id, nextPtrStr;
+        string line, recNoStr, id, nextPtrStr;
         while (getline(labelFile, line)) {
             istringstream recordStream(line);
             getline(recordStream, recNoStr, '|');  // Extract recNo (record number)
@@ -87,27 +107,184 @@ public:
             primaryKeyList.emplace_back(id, nextPtrStr);  // Add the node to the linked list
         }
         labelFile.close();
-    }
 
-    // Update secondary index and label ID list in their respective files
-    void updateSecondaryIndexAndLabelIdList() {
-        // Update Secondary Index (secondary key -> head pointer)
-        ofstream secFile(secondaryIndexFileName);
-        if (!secFile.is_open()) {
-            cerr << "Error opening file: " << secondaryIndexFileName << "\n";
-            return;
+        // Collect the free labels, lowest index on top so they are reused in order
+        freeLabels.clear();
+        for (int index = primaryKeyList.size() - 1; index >= 0; --index) {
+            if (primaryKeyList[index].nextIndex == "##") {
+                freeLabels.push_back(index);
+            }
         }
+    }
+
+    // Read an evicted index back from its files; the files hold exactly the evicted contents
+    void pageIn() {
+        string contents;
+        readSecondaryKeys(contents);
+        readLabelIdList();
+        resident.store(true, memory_order_release);
+        countStat(StatCounter::IndexPageIns);
+    }
+
+    // Make sure the map and the list are in memory before using them. Paging in leaves the
+    // entries as they are, so readers may do it under a shared table lock.
+    void ensureResident() const {
+        markUsed(lastUsed);
+        if (resident.load(memory_order_acquire)) return;
+        lock_guard<mutex> lock(pageInMutex);
+        if (resident.load(memory_order_relaxed)) return;
+        const_cast<SecondaryIndex *>(this)->pageIn();
+    }
+
+    // Build a filter sized for the current secondary keys
+    void rebuildFilter() {
+        filter = make_unique<BloomFilter>(secondaryIndexMap.size());
         for (const auto &entry : secondaryIndexMap) {
-            secFile << entry.first << "|" << setw(2) << setfill('0') << entry.second << '\n';  // Format secondary key and head index
+            filter->add(entry.first);
         }
-        secFile.close();
+    }
 
-        // Update Label Id List (linked list of primary keys and next pointers)
-        ofstream labelFile(labelIdListFileName);
-        if (!labelFile.is_open()) {
-            cerr << "Error opening file: " << labelIdListFileName << "\n";
+    // Record a change and write it out when the durability policy says so, unless persistence
+    // is deferred or a change group is open
+    void persistChange() {
+        dirty = true;
+        if (grouping) {
+            groupChanged = true;
+        } else if (autoPersist && persistSchedule.changeIsDue()) {
+            updateSecondaryIndexAndLabelIdList();
+        }
+    }
+
+public:
+    // Get the index of a free label for adding a new PrimaryKeyNode
+    int getFreeLabelIndex() {
+        while (!freeLabels.empty()) {
+            int index = freeLabels.back();  // Reuse the most recently freed label (marked as "##")
+            freeLabels.pop_back();
+            if (index < primaryKeyList.size() && primaryKeyList[index].nextIndex == "##") {
+                return index;
+            }
+        }
+        primaryKeyList.emplace_back("##", "##");  // If no free label found, add a new one
+        return primaryKeyList.size() - 1; // Return the new index
+    }
+
+    // Release a label ID to mark it as free
+    void releaseLabelId(int index) {
+        if (index >= 0 && index < primaryKeyList.size()) {
+            primaryKeyList[index].primaryKey = "##";
+            primaryKeyList[index].nextIndex = "##";  // Mark it as free
+            freeLabels.push_back(index);
+        }
+    }
+
+    // Enable or disable writing the index files after every change; when disabled, call flush()
+    void setAutoPersist(bool enabled) {
+        autoPersist = enabled;
+    }
+
+    // Collect the following changes into one change group: they are persisted together, once,
+    // by endChangeGroup(), and count as a single change for the durability policy
+    void beginChangeGroup() {
+        grouping = true;
+    }
+
+    // Close the change group and persist its changes if the durability policy says so
+    void endChangeGroup() {
+        grouping = false;
+        if (groupChanged && autoPersist && persistSchedule.changeIsDue()) {
+            updateSecondaryIndexAndLabelIdList();
+        }
+        groupChanged = false;
+    }
+
+    // Write pending changes to the index files
+    void flush() {
+        if (dirty) {
+            updateSecondaryIndexAndLabelIdList();
+        }
+    }
+
+    // Drop the map and the list from memory after writing pending changes to the files; the
+    // filter stays. The caller holds the table lock exclusively. Returns false if the index is
+    // not resident, a change group is open or the write failed.
+    bool evict() {
+        if (!resident.load(memory_order_relaxed) || grouping || secondaryIndexMap.empty()) return false;
+        if (dirty) {
+            updateSecondaryIndexAndLabelIdList();
+            if (dirty) return false;
+        }
+        map<string, int>().swap(secondaryIndexMap);
+        vector<PrimaryKeyNode>().swap(primaryKeyList);
+        vector<int>().swap(freeLabels);
+        keyBytes = 0;
+        resident.store(false, memory_order_release);
+        countStat(StatCounter::IndexEvictions);
+        return true;
+    }
+
+    // Estimated heap bytes of the index: the map and the list while resident, and the filter.
+    // The list's keys and links fit in the strings themselves.
+    size_t memoryBytes() const {
+        size_t bytes = filter ? filter->byteSize() : 0;
+        if (resident.load(memory_order_acquire)) {
+            bytes += keyBytes + primaryKeyList.capacity() * sizeof(PrimaryKeyNode) +
+                     freeLabels.capacity() * sizeof(int);
+        }
+        return bytes;
+    }
+
+    bool isResident() const {
+        return resident.load(memory_order_acquire);
+    }
+
+    // Memory budget tick of the last lookup or change
+    unsigned long long lastUsedTick() const {
+        return lastUsed.load(memory_order_relaxed);
+    }
+
+    // Number of (secondary key, primary key) entries while resident
+    size_t entryCount() const {
+        return resident.load(memory_order_acquire) ? primaryKeyList.size() - freeLabels.size() : 0;
+    }
+
+    // Set the filenames for the secondary index and label ID list, and load the data
+    void setSecondaryIndexAndLabelIdListFileNames(const string& secondaryIndex, const string& labelIdFileName) {
+        this->secondaryIndexFileName = secondaryIndex;
+        this->labelIdListFileName = labelIdFileName;
+        loadSecondaryIndexAndLabelIdList();  // Load the secondary index and label list data
+    }
+
+    // Set the data file of the indexed records
+    void setDataFileName(const string &fileName) {
+        dataFileName = fileName;
+    }
+
+    // Load secondary index and label list data from files
+    void loadSecondaryIndexAndLabelIdList() {
+        // Load Secondary Index (secondary key -> head pointer)
+        string contents;
+        if (!readSecondaryKeys(contents)) {
             return;
         }
+        filter = BloomFilter::load(filterFileName(secondaryIndexFileName), fnv1aHash(contents));
+        if (!filter) {
+            rebuildFilter();
+        }
+
+        // Load Label Id List (linked list of primary keys)
+        readLabelIdList();
+    }
+
+    // Update secondary index and label ID list in their respective files. Each file is replaced
+    // atomically. The label list goes first: it only ever grows, so even after a crash between the
+    // two replacements no head on disk points past the end of the list on disk.
+    void updateSecondaryIndexAndLabelIdList() {
+        ensureResident();
+        if (!syncDataFile(dataFileName)) return;  // Stays dirty; the next persist retries
+
+        // Update Label Id List (linked list of primary keys and next pointers)
+        ostringstream labelFile;
         int recNo = 0;
         for (const auto &node : primaryKeyList) {
             // Format record number, primary key, and next pointer for writing to file
@@ -116,16 +293,42 @@ public:
                       << setw(2) << setfill('0') << node.nextIndex << '\n';
             recNo++;
         }
-        labelFile.close();
+        string labels = labelFile.str();
+        if (!replaceFileAtomically(labelIdListFileName, labels)) {
+            return;  // Stays dirty; the next persist retries
+        }
+        countStat(StatCounter::IndexRewrites);
+        countStat(StatCounter::BytesWritten, labels.size());
+
+        // Update Secondary Index (secondary key -> head pointer)
+        ostringstream secFile;
+        for (const auto &entry : secondaryIndexMap) {
+            secFile << entry.first << "|" << setw(2) << setfill('0') << entry.second << '\n';  // Format secondary key and head index
+        }
+        string contents = secFile.str();
+        if (!replaceFileAtomically(secondaryIndexFileName, contents)) {
+            return;
+        }
+        countStat(StatCounter::IndexRewrites);
+        countStat(StatCounter::BytesWritten, contents.size());
+        filter->save(filterFileName(secondaryIndexFileName), fnv1aHash(contents));
+        dirty = false;
+        persistSchedule.persisted();
     }
 
     // Add a primary key to a secondary index node (linked list of primary keys)
     void addPrimaryKeyToSecondaryNode(const string &secondaryKey, const string &primaryKey) {
+        ensureResident();
         int freeLabelId = getFreeLabelIndex();  // Get a free label ID for the new node
         if (secondaryIndexMap.find(secondaryKey) == secondaryIndexMap.end()) {
             // If the secondary key doesn't exist, create a new head node for the linked list
             primaryKeyList[freeLabelId] = PrimaryKeyNode(primaryKey, "-1");  // Set next pointer to -1
-            secondaryIndexMap[secondaryKey] = freeLabelId;  // Set head pointer to the new node
+            insertSecondaryKey(secondaryKey, freeLabelId);  // Set head pointer to the new node
+            if (filter->needsRebuild()) {
+                rebuildFilter();
+            } else {
+                filter->add(secondaryKey);
+            }
         } else {
             // If the secondary key exists, add to the linked list
             int currentIndex = secondaryIndexMap[secondaryKey];
@@ -139,11 +342,12 @@ public:
             }
             primaryKeyList[freeLabelId] = PrimaryKeyNode(primaryKey, "-1");  // Set next pointer to -1 for the new node
         }
-        updateSecondaryIndexAndLabelIdList();  // Update the index and label ID list files
+        persistChange();  // Update the index and label ID list files
     }
 
     // Remove a primary key from a secondary index node (linked list of primary keys)
     void removePrimaryKeyFromSecondaryNode(const string &secondaryKey, const string &primaryKey) {
+        ensureResident();
         if (secondaryIndexMap.find(secondaryKey) == secondaryIndexMap.end()) {
             cerr << "Error: Secondary key not found.\n";
             return;
@@ -169,13 +373,87 @@ public:
             cerr << "Error: Primary key not found.\n";
         }
 
-        updateSecondaryIndexAndLabelIdList();  // Update the index and label ID list files
+        persistChange();  // Update the index and label ID list files
+    }
+
+    // Count the primary keys associated with a secondary key by walking its linked list,
+    // without materializing the keys or touching the data file
+    int countPrimaryKeysBySecondaryKey(const string &secondaryKey) const {
+        countStat(StatCounter::SecondaryIndexLookups);
+        if (!filter->mayContain(secondaryKey)) return 0;  // Never indexed
+        ensureResident();
+        auto it = secondaryIndexMap.find(secondaryKey);
+        if (it == secondaryIndexMap.end()) {
+            return 0;  // Unknown secondary key has an empty list
+        }
+        int count = 0;
+        int index = it->second;
+        while (index != -1) {
+            count++;
+            index = stoi(primaryKeyList[index].nextIndex);  // Move to the next node
+        }
+        return count;
+    }
+
+    // Replace the whole index with `entries` (secondary key, primary key), e.g. rebuilt from the
+    // data file. Every list is laid out in consecutive labels in ID order (shorter keys first), the
+    // order lists grow in as IDs are handed out, and there are no free labels afterwards.
+    // Written by the next flush, or at once if persisting immediately.
+    void replaceAll(vector<pair<string, string>> entries) {
+        sort(entries.begin(), entries.end(), [](const pair<string, string> &a, const pair<string, string> &b) {
+            if (a.first != b.first) return a.first < b.first;
+            if (a.second.size() != b.second.size()) return a.second.size() < b.second.size();
+            return a.second < b.second;
+        });
+        secondaryIndexMap.clear();
+        primaryKeyList.clear();
+        freeLabels.clear();
+        keyBytes = 0;
+        for (size_t i = 0; i < entries.size(); ++i) {
+            bool last = i + 1 == entries.size() || entries[i + 1].first != entries[i].first;
+            primaryKeyList.emplace_back(entries[i].second, last ? "-1" : to_string(i + 1));
+            insertSecondaryKey(entries[i].first, static_cast<int>(i));  // Keeps the first label as head
+        }
+        resident.store(true, memory_order_release);
+        rebuildFilter();
+        dirty = true;
+        if (autoPersist) {
+            updateSecondaryIndexAndLabelIdList();
+        }
+    }
+
+    // Visit every (secondary key, primary key) pair. Lists damaged on disk are followed only as far
+    // as they stay valid: a link out of range, malformed or revisited ends the walk.
+    void forEachEntry(const function<void(const string &secondaryKey, const string &primaryKey)> &visitor) const {
+        ensureResident();
+        vector<bool> visited(primaryKeyList.size(), false);
+        for (const auto &entry : secondaryIndexMap) {
+            int index = entry.second;
+            while (index >= 0 && index < static_cast<int>(primaryKeyList.size()) && !visited[index]) {
+                visited[index] = true;
+                visitor(entry.first, primaryKeyList[index].primaryKey);
+                try {
+                    index = stoi(primaryKeyList[index].nextIndex);  // Move to the next node
+                } catch (const exception &) {
+                    break;
+                }
+            }
+        }
     }
 
     // Get all primary keys associated with a secondary key
-    vector<string> getPrimaryKeysBySecondaryKey(const string &secondaryKey) {
+    vector<string> getPrimaryKeysBySecondaryKey(const string &secondaryKey) const {
+        countStat(StatCounter::SecondaryIndexLookups);
         vector<string> primaryKeys;
-        int index = secondaryIndexMap[secondaryKey];
+        if (!filter->mayContain(secondaryKey)) {
+            return primaryKeys;  // Never indexed; rejected without searching the map
+        }
+        ensureResident();
+        auto it = secondaryIndexMap.find(secondaryKey);
+        if (it == secondaryIndexMap.end()) {
+            return primaryKeys;  // Look up without inserting, so that concurrent readers do not modify the map
+        }
+        int index = it->second;
         while (index != -1) {
             primaryKeys.push_back(primaryKeyList[index].primaryKey);  // Add primary key to the list
             index = stoi(primaryKeyList[index].nextIndex);  // Move to the next node
@@ -0,0 +1,430 @@
+#ifndef HEALTHCAREMANAGEMENTSYSTEM_SHARDLAYOUT_H
+#define HEALTHCAREMANAGEMENTSYSTEM_SHARDLAYOUT_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <queue>
+#include <deque>
+#include <thread>
+#include <future>
+#include <condition_variable>
+#include <functional>
+#include <shared_mutex>
+#include <mutex>
+#include <atomic>
+#include <filesystem>
+#include <cstdint>
+#include "PrimaryIndex.h"
+#include "SecondaryIndex.h"
+#include "AvailList.h"
+#include "BloomFilter.h"
+#include "VersionStore.h"
+#include "ParallelScan.h"
+#include "BatchReader.h"
+
+using namespace std;
+
+// Hash-partitioned storage layout.
+//
+// A data directory holds either the classic single layout (doctors.txt, DoctorPrimaryIndex.txt,
+// ... in the working directory) or N shard directories shard-0 ... shard-(N-1), each with a
+// full set of data, index and avail list files for both tables. The shard count is recorded in
+// shards.conf and created once with --init-shards. A record lives in the shard selected by a
+// hash of its primary key, so writes to different shards use different files and locks, and
+// rebuilding or rewriting an index only touches one shard.
+
+const char *const shardConfigFileName = "shards.conf"; // Holds the shard count of a sharded layout
+
+// File names of one table inside a shard directory
+class TableFileNames {
+public:
+    string data;           // Records
+    string primaryIndex;   // key|offset
+    string secondaryIndex; // secondary key|head label
+    string labelIdList;    // Posting lists of the secondary index
+    string availList;      // Free record slots
+};
+
+static const TableFileNames doctorFileNames{"doctors.txt", "DoctorPrimaryIndex.txt", "DoctorSecondaryIndex.txt",
+                                            "DoctorLabelIdList.txt", "DoctorAvailList.txt"};
+static const TableFileNames appointmentFileNames{"appointments.txt", "AppointmentPrimaryIndex.txt",
+                                                 "AppointmentSecondaryIndex.txt", "AppointmentLabelIdList.txt",
+                                                 "AppointmentAvailList.txt"};
+
+// Shard of a primary key. FNV-1a over the key bytes: the placement is stored on disk, so the hash
+// must not depend on the standard library implementation.
+static size_t shardOfKey(string_view primaryKey, size_t shardCount) {
+    return shardCount <= 1 ? 0 : fnv1aHash(primaryKey) % shardCount;
+}
+
+// Directory prefix of shard `index` ("" for the single layout)
+static string shardDirectory(size_t index, size_t shardCount) {
+    return shardCount <= 1 ? "" : "shard-" + to_string(index) + "/";
+}
+
+// Shard count of the data directory: the value in shards.conf, or 1 for the single layout
+static size_t loadShardCount() {
+    ifstream config(shardConfigFileName);
+    size_t count = 0;
+    if (!(config >> count) || count == 0) return 1;
+    return count;
+}
+
+// Create an empty layout of `shardCount` shards in the working directory. Refuses to run over an
+// existing sharded layout or over records in the single layout, which would become invisible.
+inline bool initializeShards(size_t shardCount) {
+    if (shardCount < 2) {
+        cerr << "Error: a sharded layout needs at least 2 shards.\n";
+        return false;
+    }
+    if (filesystem::exists(shardConfigFileName)) {
+        cerr << "Error: " << shardConfigFileName << " already exists.\n";
+        return false;
+    }
+    for (const TableFileNames *names : {&doctorFileNames, &appointmentFileNames}) {
+        error_code error;
+        if (filesystem::exists(names->data) && filesystem::file_size(names->data, error) > 0) {
+            cerr << "Error: " << names->data << " holds records; shard an empty data directory.\n";
+            return false;
+        }
+    }
+
+    for (size_t index = 0; index < shardCount; ++index) {
+        string directory = shardDirectory(index, shardCount);
+        error_code error;
+        filesystem::create_directories(directory, error);
+        if (error) {
+            cerr << "Error creating directory: " << directory << "\n";
+            return false;
+        }
+        for (const TableFileNames *names : {&doctorFileNames, &appointmentFileNames}) {
+            for (const string *fileName : {&names->data, &names->primaryIndex, &names->secondaryIndex,
+                                           &names->labelIdList, &names->availList}) {
+                ofstream(directory + *fileName, ios::app).close();  // Create without truncating
+            }
+        }
+    }
+    // Written last: a crash before this point leaves the single layout in effect
+    ofstream config(shardConfigFileName, ios::trunc);
+    config << shardCount << "\n";
+    return static_cast<bool>(config);
+}
+
+// One partition of a table: its data file, indexes, versions and lock. Readers hold tableMutex
+// shared, writers exclusively; shards never share a lock, so they are written in parallel.
+class TableShard {
+public:
+    string dataFileName;              // Path of the shard's data file
+    PrimaryIndex primaryIndex;
+    SecondaryIndex secondaryIndex;
+    AvailList availList;
+    VersionStore versions;            // Old record images kept for open snapshots
+    mutable shared_mutex tableMutex;
+
+    // Month partitions only (MonthPartitions.h)
+    string partition;                 // "YYYY-MM" or "undated"; empty for hash shards
+    atomic<bool> sealed{false};       // Read-only: its records are neither added, changed nor deleted
+    atomic<bool> archived{false};     // The data file is kept compressed until a read needs it
+    once_flag thawOnce;               // Decompresses an archived data file once
+
+    // Point the shard at its files in `directory` and load its indexes
+    TableShard(const string &directory, const TableFileNames &names) : dataFileName(directory + names.data) {
+        primaryIndex.setPrimaryIndexFileName(directory + names.primaryIndex);
+        secondaryIndex.setSecondaryIndexAndLabelIdListFileNames(directory + names.secondaryIndex,
+                                                                directory + names.labelIdList);
+        availList.setAvailListFileName(directory + names.availList);
+        primaryIndex.setDataFileName(dataFileName);
+        secondaryIndex.setDataFileName(dataFileName);
+        availList.setDataFileName(dataFileName);
+    }
+
+    // Consistent point-in-time view of the shard; reads through it take no lock
+    unique_ptr<TableSnapshot> openSnapshot() {
+        shared_lock<shared_mutex> lock(tableMutex);
+        return make_unique<TableSnapshot>(versions, primaryIndex);
+    }
+
+    // Collect the following index and free list changes into one change group per structure, so
+    // an operation that changes a structure several times persists it once (tableMutex held)
+    void beginChangeGroup() {
+        primaryIndex.beginChangeGroup();
+        secondaryIndex.beginChangeGroup();
+        availList.beginChangeGroup();
+    }
+
+    // Close the change groups, persisting each changed structure once (tableMutex held)
+    void endChangeGroup() {
+        primaryIndex.endChangeGroup();
+        secondaryIndex.endChangeGroup();
+        availList.endChangeGroup();
+    }
+};
+
+// Shards are shared so that a layout that grows (month partitions) can publish a new vector while
+// operations that started earlier keep using theirs
+using TableShards = vector<shared_ptr<TableShard>>;
+
+// Change group of one shard for the lifetime of the object. Declare it after the lock of the
+// shard, so the group is closed (and persisted) before the lock is released.
+class ShardChangeGroup {
+private:
+    TableShard &shard;
+
+public:
+    explicit ShardChangeGroup(TableShard &shard) : shard(shard) {
+        shard.beginChangeGroup();
+    }
+
+    ShardChangeGroup(const ShardChangeGroup &) = delete;
+    ShardChangeGroup &operator=(const ShardChangeGroup &) = delete;
+
+    ~ShardChangeGroup() {
+        shard.endChangeGroup();
+    }
+};
+
+// Exclusive locks on every shard of a table, taken in shard order, with a change group open on
+// each. Used by transactions: everything applied while it is held is persisted once per changed
+// structure when it is destroyed, and then the locks are released.
+class TableWriteLock {
+private:
+    vector<unique_lock<shared_mutex>> locks;        // Destroyed last
+    vector<unique_ptr<ShardChangeGroup>> groups;
+
+public:
+    explicit TableWriteLock(TableShards &shards) {
+        for (auto &shard : shards) {
+            locks.emplace_back(shard->tableMutex);
+        }
+        for (auto &shard : shards) {
+            groups.push_back(make_unique<ShardChangeGroup>(*shard));
+        }
+    }
+
+    ~TableWriteLock() {
+        groups.clear();  // Persist before unlocking
+    }
+};
+
+// Open every shard of a table in the current layout
+static TableShards openTableShards(const TableFileNames &names) {
+    TableShards shards;
+    size_t shardCount = loadShardCount();
+    for (size_t index = 0; index < shardCount; ++index) {
+        shards.push_back(make_unique<TableShard>(shardDirectory(index, shardCount), names));
+    }
+    return shards;
+}
+
+// Threads that read the shards of a table at the same time: one per shard, up to one per core
+static size_t shardReaderCount(size_t shardCount) {
+    return min<size_t>(shardCount, max(thread::hardware_concurrency(), 1u));
+}
+
+// One shard's records in primary-key order for the merge in forEachShardRecord. With `prefetch`
+// a thread of its own reads them ahead, keeping at most maxBatches batches of batchSize lines
+// ready, so the shards are read in parallel while the merge takes one line at a time; without
+// it the records are read on demand by the merging thread.
+class ShardRecordPrefetch {
+private:
+    static constexpr size_t batchSize = 256;
+    static constexpr size_t maxBatches = 4;
+
+    TableSnapshotCursor cursor;
+    vector<pair<string, string>> batch;     // Primary keys and lines being merged
+    size_t position = 0;                    // Next entry of batch
+    mutex queueMutex;                       // Protects ready, finished and stopped
+    condition_variable changed;             // Signalled when ready, finished or stopped changes
+    deque<vector<pair<string, string>>> ready;
+    bool finished = false;                  // The reader has queued every record
+    bool stopped = false;                   // The merge stopped early; the reader should too
+    thread reader;                          // Reads ahead; not started without prefetch
+
+    // Reader thread: queue the records batch by batch, waiting while maxBatches are queued
+    void readAhead() {
+        vector<pair<string, string>> records;
+        bool more = true;
+        while (more) {
+            records.clear();
+            while (records.size() < batchSize && (more = cursor.next())) {
+                records.emplace_back(std::move(cursor.primaryKey), std::move(cursor.line));
+            }
+            unique_lock<mutex> lock(queueMutex);
+            changed.wait(lock, [this] { return ready.size() < maxBatches || stopped; });
+            if (stopped) return;
+            if (!records.empty()) ready.push_back(std::move(records));
+            finished = !more;
+            lock.unlock();
+            changed.notify_all();
+        }
+    }
+
+public:
+    string primaryKey;  // Key of the current record
+    string line;        // Line of the current record
+
+    ShardRecordPrefetch(const TableSnapshot &snapshot, const string &fileName, bool prefetch)
+            : cursor(snapshot, fileName) {
+        if (prefetch) reader = thread([this] { readAhead(); });
+    }
+
+    ShardRecordPrefetch(const ShardRecordPrefetch &) = delete;
+    ShardRecordPrefetch &operator=(const ShardRecordPrefetch &) = delete;
+
+    ~ShardRecordPrefetch() {
+        if (!reader.joinable()) return;
+        {
+            lock_guard<mutex> lock(queueMutex);
+            stopped = true;
+        }
+        changed.notify_all();
+        reader.join();
+    }
+
+    // Move to the next record of the shard. Returns false once all records were read.
+    bool next() {
+        if (!reader.joinable()) {
+            if (!cursor.next()) return false;
+            primaryKey = std::move(cursor.primaryKey);
+            line = std::move(cursor.line);
+            return true;
+        }
+        if (position == batch.size()) {
+            unique_lock<mutex> lock(queueMutex);
+            changed.wait(lock, [this] { return !ready.empty() || finished; });
+            if (ready.empty()) return false;
+            batch = std::move(ready.front());
+            ready.pop_front();
+            position = 0;
+            lock.unlock();
+            changed.notify_all();
+        }
+        primaryKey = std::move(batch[position].first);
+        line = std::move(batch[position].second);
+        ++position;
+        return true;
+    }
+};
+
+// Visit the record lines of a whole table as of one snapshot per shard. With a single shard the
+// lines come in file order (or primary-key order if `inFileOrder` is false). With several shards,
+// all snapshots are opened first and the shards, each read in primary-key order, are merged
+// into primary-key order one line at a time; up to shardReaderCount shards are read ahead in
+// parallel, a few batches each. Each shard is consistent in itself; shards are snapshotted one
+// after the other, so a change committed in between may be seen in one shard and not in
+// another. Stops when the visitor returns false.
+static void forEachShardRecord(TableShards &shards, const function<bool(const string &line)> &visitor,
+                               bool inFileOrder = true) {
+    if (shards.size() == 1) {
+        unique_ptr<TableSnapshot> snapshot = shards.front()->openSnapshot();
+        snapshot->forEachRecord(shards.front()->dataFileName, visitor, inFileOrder);
+        return;
+    }
+
+    vector<unique_ptr<TableSnapshot>> snapshots;
+    for (auto &shard : shards) {
+        snapshots.push_back(shard->openSnapshot());
+    }
+    // K-way merge: every shard yields its records in primary-key order, and the queue holds the
+    // shards that have a record left, the one with the smallest current key on top. The cursors
+    // are destroyed before the snapshots they read.
+    size_t readers = shardReaderCount(shards.size());
+    vector<unique_ptr<ShardRecordPrefetch>> cursors;
+    auto laterKey = [&cursors](size_t a, size_t b) { return cursors[a]->primaryKey > cursors[b]->primaryKey; };
+    priority_queue<size_t, vector<size_t>, decltype(laterKey)> nextShards(laterKey);
+    for (size_t index = 0; index < shards.size(); ++index) {
+        cursors.push_back(make_unique<ShardRecordPrefetch>(*snapshots[index], shards[index]->dataFileName,
+                                                           index < readers));
+    }
+    for (size_t index = 0; index < shards.size(); ++index) {
+        if (cursors[index]->next()) nextShards.push(index);
+    }
+    while (!nextShards.empty()) {
+        size_t index = nextShards.top();
+        nextShards.pop();
+        if (!visitor(cursors[index]->line)) return;
+        if (cursors[index]->next()) nextShards.push(index);
+    }
+}
+
+// Run a ParallelScan over every shard's data file and merge the matches into primary-key order.
+// Up to shardReaderCount shards are scanned at the same time, each under its shard's shared lock,
+// by the calling thread and threads of their own: a shard's ParallelScan waits on
+// sharedThreadPool, so it must not run on a pool worker itself.
+static vector<ScanMatch> scanShards(TableShards &shards, const function<bool(string_view *fields, int fieldCount)> &filter) {
+    vector<vector<ScanMatch>> shardMatches(shards.size());
+    atomic<size_t> nextShard{0};
+    auto scanRemaining = [&] {
+        for (size_t index = nextShard++; index < shards.size(); index = nextShard++) {
+            shared_lock<shared_mutex> lock(shards[index]->tableMutex);
+            shardMatches[index] = ParallelScan(shards[index]->dataFileName).run(filter);
+        }
+    };
+    vector<future<void>> helpers;
+    for (size_t reader = 1; reader < shardReaderCount(shards.size()); ++reader) {
+        helpers.push_back(async(launch::async, scanRemaining));
+    }
+    scanRemaining();
+    for (auto &helper : helpers) {
+        helper.get();
+    }
+
+    vector<ScanMatch> matches;
+    for (auto &shard : shardMatches) {
+        matches.insert(matches.end(), make_move_iterator(shard.begin()), make_move_iterator(shard.end()));
+    }
+    if (shards.size() > 1) {
+        sort(matches.begin(), matches.end(), [](const ScanMatch &a, const ScanMatch &b) {
+            return a.primaryKey < b.primaryKey;
+        });
+    }
+    return matches;
+}
+
+// Read the record lines of `ids` (lines[i] for ids[i]) with one batch per shard, each under its
+// shard's shared lock. offsets[i] is -1 and lines[i] empty for IDs that are not indexed.
+// `shardIndexOf` places an ID in `shards` (by default the hash of the ID).
+// Returns false if a data file could not be opened.
+static bool readShardRecordLines(TableShards &shards, const vector<string> &ids, vector<int> &offsets,
+                                 vector<string> &lines,
+                                 const function<size_t(const string &id)> &shardIndexOf = nullptr) {
+    offsets.assign(ids.size(), -1);
+    lines.assign(ids.size(), "");
+    vector<vector<size_t>> positionsByShard(shards.size());
+    for (size_t i = 0; i < ids.size(); ++i) {
+        positionsByShard[shardIndexOf ? shardIndexOf(ids[i]) : shardOfKey(ids[i], shards.size())].push_back(i);
+    }
+
+    bool opened = true;
+    for (size_t index = 0; index < shards.size(); ++index) {
+        const vector<size_t> &positions = positionsByShard[index];
+        if (positions.empty()) continue;
+        TableShard &shard = *shards[index];
+        shared_lock<shared_mutex> lock(shard.tableMutex);
+
+        vector<int> found;
+        vector<size_t> foundPositions;
+        for (size_t position : positions) {
+            offsets[position] = shard.primaryIndex.binarySearchPrimaryIndex(ids[position]);
+            if (offsets[position] == -1) continue;
+            found.push_back(offsets[position]);
+            foundPositions.push_back(position);
+        }
+        vector<string> shardLines;
+        if (!BatchReader::readLines(shard.dataFileName, found, shardLines)) {
+            opened = false;
+            continue;
+        }
+        for (size_t i = 0; i < shardLines.size(); ++i) {
+            lines[foundPositions[i]] = std::move(shardLines[i]);
+        }
+    }
+    return opened;
+}
+
+#endif //HEALTHCAREMANAGEMENTSYSTEM_SHARDLAYOUT_H
@@ -0,0 +1,89 @@
+#ifndef HEALTHCAREMANAGEMENTSYSTEM_SOCKETCLIENT_H
+#define HEALTHCAREMANAGEMENTSYSTEM_SOCKETCLIENT_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include "SocketProtocol.h"
+
+using namespace std;
+
+// Command line client of the socket server: sends statements and prints the responses.
+class SocketClient {
+private:
+    string socketPath; // Server socket
+    int fd = -1;       // Connected socket
+
+public:
+    explicit SocketClient(const string &socketPath = defaultSocketPath) : socketPath(socketPath) {}
+
+    ~SocketClient() {
+        if (fd != -1) close(fd);
+    }
+
+    SocketClient(const SocketClient &) = delete;
+    SocketClient &operator=(const SocketClient &) = delete;
+
+    // Connect to the server; returns false (with a message) if it is not running
+    bool connectToServer() {
+        sockaddr_un address;
+        if (!makeSocketAddress(socketPath, address)) {
+            cerr << "Error: invalid socket path: " << socketPath << "\n";
+            return false;
+        }
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd == -1 || connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == -1) {
+            cerr << "Error: cannot connect to " << socketPath << ": " << strerror(errno) << "\n";
+            return false;
+        }
+        return true;
+    }
+
+    // Send one statement and wait for its response. Returns false if the connection failed;
+    // `ok` tells whether the statement succeeded and `output` receives its formatted result.
+    bool execute(const string &statement, string &output, bool &ok) {
+        string frame;
+        appendFrame(frame, statement);
+        string response;
+        if (!writeAll(fd, frame.data(), frame.size()) || !readFrame(fd, response) || response.empty()) {
+            cerr << "Error: connection to the server was lost.\n";
+            return false;
+        }
+        ok = response[0] == '0';
+        output.assign(response, 1, string::npos);
+        return true;
+    }
+
+    // Send the given statements, or one statement per input line when there are none, printing
+    // each response. Returns the number of failed statements, or -1 if the connection failed.
+    int run(const vector<string> &statements, istream &input) {
+        int failures = 0;
+        auto send = [&](const string &statement) {
+            string output;
+            bool ok;
+            if (!execute(statement, output, ok)) return false;
+            fwrite(output.data(), 1, output.size(), stdout);
+            fflush(stdout);
+            if (!ok) failures++;
+            return true;
+        };
+
+        if (!statements.empty()) {
+            for (const string &statement : statements) {
+                if (!send(statement)) return -1;
+            }
+            return failures;
+        }
+
+        string line;
+        while (getline(input, line)) {
+            size_t first = line.find_first_not_of(" \t\r");
+            if (first == string::npos || line[first] == '#') continue;  // Blank line or comment
+            if (!send(line.substr(first))) return -1;
+        }
+        return failures;
+    }
+};
+
+#endif //HEALTHCAREMANAGEMENTSYSTEM_SOCKETCLIENT_H
@@ -0,0 +1,89 @@
+#ifndef HEALTHCAREMANAGEMENTSYSTEM_SOCKETPROTOCOL_H
+#define HEALTHCAREMANAGEMENTSYSTEM_SOCKETPROTOCOL_H
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+using namespace std;
+
+// Wire format shared by the socket server and client. Every message is a frame:
+//   4-byte big-endian payload length, followed by the payload.
+// A request payload is one statement (see StatementExecutor). A response payload is one
+// status byte ('0' = ok, '1' = failed) followed by the statement's formatted output.
+
+const char *const defaultSocketPath = "hcms.sock";   // Socket created in the working directory
+const uint32_t maxFrameSize = 64u << 20;               // Larger frames are rejected
+
+// Append a frame holding `payload` to `out`
+static void appendFrame(string &out, string_view payload) {
+    uint32_t length = payload.size();
+    char header[4] = {static_cast<char>(length >> 24), static_cast<char>(length >> 16),
+                      static_cast<char>(length >> 8), static_cast<char>(length)};
+    out.append(header, 4);
+    out.append(payload);
+}
+
+// Take the frame starting at `consumed` in `buffer` into `payload` and advance `consumed` past it.
+// Returns 1 when a frame was taken, 0 when more bytes are needed and -1 for an oversized frame.
+static int takeFrame(string &buffer, size_t &consumed, string &payload) {
+    if (buffer.size() - consumed < 4) return 0;
+    const unsigned char *header = reinterpret_cast<const unsigned char *>(buffer.data() + consumed);
+    uint32_t length = (uint32_t(header[0]) << 24) | (uint32_t(header[1]) << 16) |
+                      (uint32_t(header[2]) << 8) | uint32_t(header[3]);
+    if (length > maxFrameSize) return -1;
+    if (buffer.size() - consumed - 4 < length) return 0;
+    payload.assign(buffer, consumed + 4, length);
+    consumed += 4 + length;
+    return 1;
+}
+
+// Write all of `data` to a blocking descriptor
+static bool writeAll(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return false;
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+// Read one frame from a blocking descriptor; returns false on end of stream or error
+static bool readFrame(int fd, string &payload) {
+    string buffer;
+    size_t consumed = 0;
+    char chunk[1 << 16];
+    while (true) {
+        int result = takeFrame(buffer, consumed, payload);
+        if (result != 0) return result == 1;
+        // Read only what the current frame still needs so that the next frame stays in the socket
+        size_t needed = buffer.size() < 4 ? 4 - buffer.size() : 0;
+        if (needed == 0) {
+            const unsigned char *header = reinterpret_cast<const unsigned char *>(buffer.data());
+            uint32_t length = (uint32_t(header[0]) << 24) | (uint32_t(header[1]) << 16) |
+                              (uint32_t(header[2]) << 8) | uint32_t(header[3]);
+            needed = 4 + length - buffer.size();
+        }
+        ssize_t received = ::read(fd, chunk, min(needed, sizeof(chunk)));
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) return false;
+        buffer.append(chunk, received);
+    }
+}
+
+// Fill a Unix domain socket address; returns false if the path is too long
+static bool makeSocketAddress(const string &path, sockaddr_un &address) {
+    address = {};
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) return false;
+    path.copy(address.sun_path, path.size());
+    return true;
+}
+
+#endif //HEALTHCAREMANAGEMENTSYSTEM_SOCKETPROTOCOL_H
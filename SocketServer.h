@@ -0,0 +1,428 @@
+#ifndef HEALTHCAREMANAGEMENTSYSTEM_SOCKETSERVER_H
+#define HEALTHCAREMANAGEMENTSYSTEM_SOCKETSERVER_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <unordered_map>
+#include <csignal>
+#include <cstring>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include "DoctorManagementSystem.h"
+#include "AppointmentManagementSystem.h"
+#include "QueryHandler.h"
+#include "StatementExecutor.h"
+#include "ThreadPool.h"
+#include "AsyncStorage.h"
+#include "SocketProtocol.h"
+
+using namespace std;
+
+// Event descriptor the signal handler uses to wake the server's event loop
+static atomic<int> serverWakeDescriptor{-1};
+static atomic<bool> serverStopRequested{false};
+
+// SIGINT/SIGTERM handler: ask the server to stop (eventfd writes are async-signal-safe)
+static void requestServerStop(int) {
+    serverStopRequested = true;
+    int fd = serverWakeDescriptor.load();
+    if (fd != -1) {
+        uint64_t one = 1;
+        ssize_t ignored = ::write(fd, &one, sizeof(one));
+        (void) ignored;
+    }
+}
+
+// State of one client connection. Only the event loop thread touches it.
+class ServerConnection {
+public:
+    int fd;                           // Connected socket
+    string input;                     // Bytes received and not yet decoded
+    size_t inputConsumed = 0;         // Bytes of `input` already decoded into requests
+    deque<string> requests;           // Decoded statements waiting for their turn
+    bool busy = false;                // Whether a statement of this connection is executing
+    string output;                    // Encoded responses not yet sent
+    size_t outputSent = 0;            // Bytes of `output` already sent
+    bool peerClosed = false;          // Client finished sending; close once every response is out
+    bool closed = false;              // Descriptor closed; late responses are dropped
+    OutputFormat format = OutputFormat::Table; // Layout chosen by the client with SET FORMAT
+    unique_ptr<Transaction> transaction; // Open transaction (BEGIN ... COMMIT); aborted on disconnect
+
+    explicit ServerConnection(int fd) : fd(fd) {}
+};
+
+// A statement that finished on a worker, handed back to the event loop
+class ServerCompletion {
+public:
+    shared_ptr<ServerConnection> connection; // Connection the response belongs to
+    string frame;                            // Encoded response
+    OutputFormat format;                     // Output format after the statement (SET FORMAT changes it)
+};
+
+// Serves statements over a Unix domain socket so that several clients share one loaded set of
+// indexes. A single epoll event loop accepts connections and reads and writes frames without
+// blocking; statements run on a pool of worker threads, each with its own QueryHandler over the
+// shared, thread-safe management systems. Statements of one connection run one at a time and
+// are answered in order; different connections run in parallel. Point lookups (PRINT DOCTOR <id>,
+// PRINT APPOINTMENT <id>) go through AsyncStorage instead: their coroutine waits for the read on
+// the storage I/O pool, so a burst of lookups never occupies the statement workers.
+class SocketServer {
+private:
+    DoctorManagementSystem &doctorSystem;
+    AppointmentManagementSystem &appointmentSystem;
+    string socketPath;                                  // File system path of the listening socket
+    size_t workerCount;                                 // Statements executed in parallel
+    int listenFd = -1;                                  // Listening socket
+    int epollFd = -1;                                   // Event loop descriptor
+    int wakeFd = -1;                                    // eventfd signalled by workers and signals
+    unordered_map<int, shared_ptr<ServerConnection>> connections; // Open connections by descriptor
+
+    vector<unique_ptr<QueryHandler>> queryHandlers;     // One handler per worker
+    vector<unique_ptr<StatementExecutor>> executors;    // Executors over those handlers
+    vector<int> freeExecutors;                          // Executors not in use
+    mutex executorMutex;                                // Protects freeExecutors
+
+    mutex completionMutex;                              // Protects completions
+    vector<ServerCompletion> completions;               // Finished statements for the event loop
+
+    AsyncStorage storage;                               // Coroutine API that answers point lookups
+    mutex lookupMutex;                                  // Protects runningLookups
+    condition_variable lookupsDone;                     // Signalled when the last lookup finishes
+    size_t runningLookups = 0;                          // Point lookups not yet answered
+
+    unique_ptr<ThreadPool> workers;                     // Declared last: joined before the handlers go
+
+    // Create, bind and listen on the socket; refuses to replace a socket a live server answers on
+    bool openListener() {
+        sockaddr_un address;
+        if (!makeSocketAddress(socketPath, address)) {
+            cerr << "Error: invalid socket path: " << socketPath << "\n";
+            return false;
+        }
+
+        // A leftover socket file from a crashed server is removed; a live one is left alone
+        int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (probe != -1 && connect(probe, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0) {
+            close(probe);
+            cerr << "Error: a server is already listening on " << socketPath << "\n";
+            return false;
+        }
+        if (probe != -1) close(probe);
+        unlink(socketPath.c_str());
+
+        listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listenFd == -1 || bind(listenFd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == -1 ||
+            listen(listenFd, 128) == -1) {
+            cerr << "Error: cannot listen on " << socketPath << ": " << strerror(errno) << "\n";
+            return false;
+        }
+        return true;
+    }
+
+    // Register a descriptor with the event loop
+    bool watch(int fd, uint32_t events, int operation = EPOLL_CTL_ADD) {
+        epoll_event event{};
+        event.events = events;
+        event.data.fd = fd;
+        return epoll_ctl(epollFd, operation, fd, &event) == 0;
+    }
+
+    // Accept every pending connection
+    void acceptConnections() {
+        while (true) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd == -1) {
+                if (errno == EINTR) continue;
+                return;  // EAGAIN: no more pending connections
+            }
+            connections[fd] = make_shared<ServerConnection>(fd);
+            watch(fd, EPOLLIN | EPOLLRDHUP);
+        }
+    }
+
+    // Close a connection and forget it
+    void closeConnection(const shared_ptr<ServerConnection> &connection) {
+        if (connection->closed) return;
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, connection->fd, nullptr);
+        close(connection->fd);
+        connection->closed = true;
+        connections.erase(connection->fd);
+    }
+
+    // Queue an error response and stop reading from the connection
+    void rejectConnection(const shared_ptr<ServerConnection> &connection, const string &message) {
+        appendFrame(connection->output, "1" + message + "\n");
+        connection->input.clear();
+        connection->inputConsumed = 0;
+        connection->peerClosed = true;
+    }
+
+    // Read everything available and decode complete frames into requests
+    void readRequests(const shared_ptr<ServerConnection> &connection) {
+        char chunk[1 << 16];
+        while (!connection->peerClosed) {
+            ssize_t received = ::read(connection->fd, chunk, sizeof(chunk));
+            if (received > 0) {
+                connection->input.append(chunk, received);
+                continue;
+            }
+            if (received == 0) {
+                connection->peerClosed = true;
+            } else if (errno == EINTR) {
+                continue;
+            } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                closeConnection(connection);
+                return;
+            }
+            break;
+        }
+
+        string payload;
+        int result;
+        while ((result = takeFrame(connection->input, connection->inputConsumed, payload)) == 1) {
+            connection->requests.push_back(std::move(payload));
+        }
+        if (result == -1) {
+            rejectConnection(connection, "Request too large.");
+            return;
+        }
+        // Drop the decoded prefix once it dominates the buffer
+        if (connection->inputConsumed > 0 && connection->inputConsumed * 2 >= connection->input.size()) {
+            connection->input.erase(0, connection->inputConsumed);
+            connection->inputConsumed = 0;
+        }
+    }
+
+    // Watch for input until the client finishes sending, and for writability while output is pending
+    void updateInterest(const shared_ptr<ServerConnection> &connection) {
+        uint32_t events = connection->peerClosed ? 0 : EPOLLIN | EPOLLRDHUP;
+        if (connection->outputSent < connection->output.size()) events |= EPOLLOUT;
+        watch(connection->fd, events, EPOLL_CTL_MOD);
+    }
+
+    // Send as much pending output as the socket takes; closes finished connections
+    void writeResponses(const shared_ptr<ServerConnection> &connection) {
+        while (connection->outputSent < connection->output.size()) {
+            ssize_t sent = ::send(connection->fd, connection->output.data() + connection->outputSent,
+                                  connection->output.size() - connection->outputSent, MSG_NOSIGNAL);
+            if (sent > 0) {
+                connection->outputSent += sent;
+            } else if (sent == -1 && errno == EINTR) {
+                continue;
+            } else if (sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                updateInterest(connection);  // Wait until writable
+                return;
+            } else {
+                closeConnection(connection);
+                return;
+            }
+        }
+        connection->output.clear();
+        connection->outputSent = 0;
+
+        if (connection->peerClosed && !connection->busy && connection->requests.empty()) {
+            closeConnection(connection);
+            return;
+        }
+        updateInterest(connection);
+    }
+
+    // Start the connection's next statement on a worker if none is running
+    void dispatch(const shared_ptr<ServerConnection> &connection) {
+        if (connection->closed || connection->busy || connection->requests.empty()) return;
+        connection->busy = true;
+        string statement = std::move(connection->requests.front());
+        connection->requests.pop_front();
+        OutputFormat format = connection->format;
+
+        string object, id;
+        if (StatementExecutor::parsePointLookup(statement, object, id)) {
+            lookUp(connection, object == "doctor", std::move(id), format);
+            return;
+        }
+
+        workers->submit([this, connection, statement = std::move(statement), format] {
+            int slot;
+            {
+                lock_guard<mutex> lock(executorMutex);
+                slot = freeExecutors.back();
+                freeExecutors.pop_back();
+            }
+
+            string output, kind;
+            bool ok;
+            OutputFormat newFormat;
+            {
+                ResultSink sink(format, output);
+                ok = executors[slot]->execute(statement, sink, kind, connection->transaction);
+                newFormat = sink.getFormat();
+            }
+            {
+                lock_guard<mutex> lock(executorMutex);
+                freeExecutors.push_back(slot);
+            }
+            complete(connection, ok, output, newFormat);
+        });
+    }
+
+    // Answer a point lookup through AsyncStorage; runs until its first suspension on the event
+    // loop thread, then on the storage I/O pool
+    DetachedTask lookUp(shared_ptr<ServerConnection> connection, bool doctor, string id, OutputFormat format) {
+        {
+            lock_guard<mutex> lock(lookupMutex);
+            ++runningLookups;
+        }
+        string output;
+        {
+            ResultSink sink(format, output);
+            if (doctor) co_await storage.printDoctorById(id, 0, sink);
+            else co_await storage.printAppointmentById(id, 0, sink);
+        }
+        complete(connection, true, output, format);
+
+        lock_guard<mutex> lock(lookupMutex);
+        if (--runningLookups == 0) lookupsDone.notify_all();
+    }
+
+    // Hand a finished statement's response to the event loop (from any thread)
+    void complete(const shared_ptr<ServerConnection> &connection, bool ok, const string &output,
+                  OutputFormat format) {
+        string frame;
+        frame.reserve(output.size() + 5);
+        appendFrame(frame, (ok ? "0" : "1") + output);
+        {
+            lock_guard<mutex> lock(completionMutex);
+            completions.push_back({connection, std::move(frame), format});
+        }
+        uint64_t one = 1;
+        ssize_t ignored = ::write(wakeFd, &one, sizeof(one));
+        (void) ignored;
+    }
+
+    // Hand finished statements back to their connections
+    void collectCompletions() {
+        vector<ServerCompletion> finished;
+        {
+            lock_guard<mutex> lock(completionMutex);
+            finished.swap(completions);
+        }
+        for (ServerCompletion &completion : finished) {
+            const shared_ptr<ServerConnection> &connection = completion.connection;
+            connection->busy = false;
+            if (connection->closed) continue;
+            connection->format = completion.format;
+            connection->output += completion.frame;
+            dispatch(connection);
+            writeResponses(connection);
+        }
+    }
+
+public:
+    SocketServer(DoctorManagementSystem &doctorSys, AppointmentManagementSystem &appointmentSys,
+                 const string &socketPath = defaultSocketPath,
+                 size_t workerCount = thread::hardware_concurrency())
+            : doctorSystem(doctorSys), appointmentSystem(appointmentSys), socketPath(socketPath),
+              workerCount(max<size_t>(workerCount, 1)), storage(doctorSys, appointmentSys) {}
+
+    ~SocketServer() {
+        workers.reset();
+        if (listenFd != -1) {
+            close(listenFd);
+            unlink(socketPath.c_str());
+        }
+        if (epollFd != -1) close(epollFd);
+        if (wakeFd != -1) {
+            serverWakeDescriptor = -1;
+            close(wakeFd);
+        }
+    }
+
+    SocketServer(const SocketServer &) = delete;
+    SocketServer &operator=(const SocketServer &) = delete;
+
+    // Serve clients until SIGINT or SIGTERM; returns false if the server could not start
+    bool run() {
+        if (!openListener()) return false;
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epollFd == -1 || wakeFd == -1 || !watch(listenFd, EPOLLIN) || !watch(wakeFd, EPOLLIN)) {
+            cerr << "Error: cannot set up the event loop: " << strerror(errno) << "\n";
+            return false;
+        }
+
+        for (size_t i = 0; i < workerCount; ++i) {
+            queryHandlers.push_back(make_unique<QueryHandler>(doctorSystem, appointmentSystem));
+            executors.push_back(make_unique<StatementExecutor>(doctorSystem, appointmentSystem,
+                                                               *queryHandlers.back(), true));
+            freeExecutors.push_back(i);
+        }
+        workers = make_unique<ThreadPool>(workerCount);
+
+        serverStopRequested = false;
+        serverWakeDescriptor = wakeFd;
+        signal(SIGINT, requestServerStop);
+        signal(SIGTERM, requestServerStop);
+        signal(SIGPIPE, SIG_IGN);
+
+        // Statement output, confirmations included, goes to each statement's own sink (see
+        // StatementExecutor), so the console stays quiet without touching cout
+        cerr << "Serving on " << socketPath << " with " << workerCount << " workers (Ctrl+C to stop)\n";
+
+        vector<epoll_event> events(256);
+        while (!serverStopRequested) {
+            int ready = epoll_wait(epollFd, events.data(), events.size(), -1);
+            if (ready == -1) {
+                if (errno == EINTR) continue;
+                cerr << "Error: epoll_wait failed: " << strerror(errno) << "\n";
+                break;
+            }
+            for (int i = 0; i < ready; ++i) {
+                int fd = events[i].data.fd;
+                if (fd == listenFd) {
+                    acceptConnections();
+                } else if (fd == wakeFd) {
+                    uint64_t count;
+                    ssize_t ignored = ::read(wakeFd, &count, sizeof(count));
+                    (void) ignored;
+                    collectCompletions();
+                } else {
+                    auto found = connections.find(fd);
+                    if (found == connections.end()) continue;
+                    shared_ptr<ServerConnection> connection = found->second;
+                    if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                        closeConnection(connection);  // Client is gone; nobody can read the responses
+                        continue;
+                    }
+                    if (events[i].events & (EPOLLIN | EPOLLRDHUP)) readRequests(connection);
+                    if (connection->closed) continue;
+                    dispatch(connection);
+                    writeResponses(connection);
+                }
+            }
+        }
+
+        // Let running statements and lookups finish, then write the indexes out
+        workers.reset();
+        {
+            unique_lock<mutex> lock(lookupMutex);
+            lookupsDone.wait(lock, [this] { return runningLookups == 0; });
+        }
+        doctorSystem.flush();
+        appointmentSystem.flush();
+        while (!connections.empty()) {
+            closeConnection(connections.begin()->second);
+        }
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+        cerr << "Server stopped.\n";
+        return true;
+    }
+};
+
+#endif //HEALTHCAREMANAGEMENTSYSTEM_SOCKETSERVER_H
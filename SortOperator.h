@@ -0,0 +1,287 @@
+#ifndef HEALTHCAREMANAGEMENTSYSTEM_SORTOPERATOR_H
+#define HEALTHCAREMANAGEMENTSYSTEM_SORTOPERATOR_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <queue>
+#include <memory>
+#include <cstdio>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include "Aggregator.h"
+
+using namespace std;
+
+// A row waiting to be sorted, tagged with its arrival order so that equal keys keep input order
+class SortedRow {
+public:
+    vector<string> values;   // Column values of the row
+    uint64_t sequence = 0;   // Position of the row in the input stream
+};
+
+// Reads back a sorted run that was spilled to a temporary file
+class SortRunReader {
+private:
+    FILE *file;          // Open run file
+    SortedRow current;   // Row at the head of the run
+    bool hasRow;         // Whether `current` holds a valid row
+
+    // Read a 32-bit length or count from the run file
+    bool readUint32(uint32_t &value) {
+        return fread(&value, sizeof(value), 1, file) == 1;
+    }
+
+public:
+    // Open a run file and position it on its first row
+    explicit SortRunReader(const string &fileName) : hasRow(false) {
+        file = fopen(fileName.c_str(), "rb");
+        if (file == nullptr) {
+            cerr << "Error opening sort run file: " << fileName << "\n";
+            return;
+        }
+        advance();
+    }
+
+    ~SortRunReader() {
+        if (file != nullptr) fclose(file);
+    }
+
+    SortRunReader(const SortRunReader &) = delete;
+    SortRunReader &operator=(const SortRunReader &) = delete;
+
+    // Whether the run still has rows to merge
+    bool valid() const {
+        return hasRow;
+    }
+
+    // Row at the head of the run
+    const SortedRow &row() const {
+        return current;
+    }
+
+    // Move to the next row of the run
+    void advance() {
+        hasRow = false;
+        uint32_t fieldCount;
+        if (file == nullptr || fread(&current.sequence, sizeof(current.sequence), 1, file) != 1 ||
+            !readUint32(fieldCount)) {
+            return;  // End of run
+        }
+        current.values.resize(fieldCount);
+        for (string &value : current.values) {
+            uint32_t length;
+            if (!readUint32(length)) return;
+            value.resize(length);
+            if (length > 0 && fread(value.data(), 1, length, file) != length) return;
+        }
+        hasRow = true;
+    }
+};
+
+// Implements ORDER BY, LIMIT and OFFSET over a stream of rows.
+// - Without a sort column rows are passed through in input order, applying OFFSET/LIMIT on the fly.
+// - When OFFSET + LIMIT fits in memory only the best k rows are kept, in a bounded max-heap.
+// - Otherwise rows are sorted in memory-sized runs that are spilled to temporary files and
+//   combined with a k-way merge, so result sets larger than memory can still be ordered.
+class SortOperator {
+private:
+    int sortColumn;                                 // Column to order by, or -1 to keep input order
+    bool descending;                                // Whether to order from largest to smallest
+    long long offset;                               // Number of leading rows to skip
+    long long limit;                                // Maximum number of rows to emit, or -1 for all
+    size_t memoryRows;                              // Rows kept in memory before spilling a run
+    function<void(const vector<string> &)> emit;    // Receives the output rows in order
+    bool useHeap;                                   // Whether the bounded top-k heap is used
+    vector<SortedRow> buffer;                       // Heap or current run, depending on the mode
+    vector<string> runFiles;                        // Spilled runs waiting to be merged
+    uint64_t sequence = 0;                          // Arrival counter for stable ordering
+    long long skipped = 0;                          // Rows skipped so far because of OFFSET
+    long long emitted = 0;                          // Rows emitted so far, checked against LIMIT
+    bool spillFailed = false;                       // Whether a run could not be written; no output then
+
+    // Strict weak ordering on the sort column, breaking ties by arrival order
+    bool less(const SortedRow &a, const SortedRow &b) const {
+        int result = compareColumnValues(a.values[sortColumn], b.values[sortColumn]);
+        if (descending) result = -result;
+        if (result != 0) return result < 0;
+        return a.sequence < b.sequence;
+    }
+
+    // Emit a row if it falls inside the OFFSET/LIMIT window; returns false once the window is full
+    bool output(const vector<string> &values) {
+        if (limit >= 0 && emitted >= limit) return false;
+        if (skipped < offset) {
+            skipped++;
+            return true;
+        }
+        emit(values);
+        emitted++;
+        return limit < 0 || emitted < limit;
+    }
+
+    // Generate a unique temporary file name for a spilled run
+    static string newRunFileName() {
+        static atomic<unsigned long long> runCounter{0};
+        auto now = chrono::steady_clock::now().time_since_epoch().count();
+        filesystem::path path = filesystem::temp_directory_path() /
+                                ("hcms-sort-" + to_string(now) + "-" + to_string(runCounter++) + ".run");
+        return path.string();
+    }
+
+    // Sort the in-memory buffer and write it to a temporary run file. If the run cannot be
+    // written its rows are lost, so the sort fails: the remaining input is ignored and finish()
+    // emits nothing.
+    void spillRun() {
+        sort(buffer.begin(), buffer.end(), [this](const SortedRow &a, const SortedRow &b) { return less(a, b); });
+
+        string fileName = newRunFileName();
+        FILE *file = fopen(fileName.c_str(), "wb");
+        if (file == nullptr) {
+            cerr << "Error creating sort run file: " << fileName << "\n";
+            spillFailed = true;
+            buffer.clear();
+            return;
+        }
+        for (const SortedRow &row : buffer) {
+            uint32_t fieldCount = row.values.size();
+            fwrite(&row.sequence, sizeof(row.sequence), 1, file);
+            fwrite(&fieldCount, sizeof(fieldCount), 1, file);
+            for (const string &value : row.values) {
+                uint32_t length = value.size();
+                fwrite(&length, sizeof(length), 1, file);
+                fwrite(value.data(), 1, length, file);
+            }
+        }
+        bool written = !ferror(file);
+        written = fclose(file) == 0 && written;
+
+        runFiles.push_back(fileName);  // Removed with the others, even if incomplete
+        buffer.clear();
+        if (!written) {
+            cerr << "Error writing sort run file: " << fileName << "\n";
+            spillFailed = true;
+        }
+    }
+
+    // Merge all spilled runs into the output, stopping as soon as LIMIT is reached
+    void mergeRuns() {
+        vector<unique_ptr<SortRunReader>> readers;
+        for (const string &fileName : runFiles) {
+            readers.push_back(make_unique<SortRunReader>(fileName));
+        }
+
+        // Min-heap of run indexes ordered by the row at the head of each run
+        auto greater = [&](int a, int b) { return less(readers[b]->row(), readers[a]->row()); };
+        priority_queue<int, vector<int>, decltype(greater)> heads(greater);
+        for (size_t i = 0; i < readers.size(); ++i) {
+            if (readers[i]->valid()) heads.push(i);
+        }
+
+        while (!heads.empty()) {
+            int run = heads.top();
+            heads.pop();
+            if (!output(readers[run]->row().values)) break;
+            readers[run]->advance();
+            if (readers[run]->valid()) heads.push(run);
+        }
+    }
+
+    // Delete the temporary run files
+    void removeRuns() {
+        for (const string &fileName : runFiles) {
+            remove(fileName.c_str());
+        }
+        runFiles.clear();
+    }
+
+public:
+    // Create a sort over rows ordered by `sortColumn` (-1 for input order), emitting at most
+    // `limit` rows (-1 for no limit) after skipping `offset` rows.
+    SortOperator(int sortColumn, bool descending, long long offset, long long limit,
+                 function<void(const vector<string> &)> emit, size_t memoryRows = 100000)
+            : sortColumn(sortColumn), descending(descending), offset(offset), limit(limit),
+              memoryRows(max<size_t>(memoryRows, 1)), emit(std::move(emit)) {
+        useHeap = sortColumn != -1 && limit >= 0 && static_cast<size_t>(offset + limit) <= this->memoryRows;
+    }
+
+    ~SortOperator() {
+        removeRuns();
+    }
+
+    SortOperator(const SortOperator &) = delete;
+    SortOperator &operator=(const SortOperator &) = delete;
+
+    // Feed one row into the operator
+    void add(const vector<string> &values) {
+        if (spillFailed) return;
+        if (sortColumn == -1) {
+            output(values);  // Input order: apply OFFSET/LIMIT immediately
+            return;
+        }
+
+        SortedRow row;
+        row.values = values;
+        row.sequence = sequence++;
+        auto heapLess = [this](const SortedRow &a, const SortedRow &b) { return less(a, b); };
+
+        if (useHeap) {
+            // Keep only the best OFFSET + LIMIT rows; the heap top is the worst row kept
+            size_t keep = offset + limit;
+            if (keep == 0) return;
+            if (buffer.size() < keep) {
+                buffer.push_back(std::move(row));
+                push_heap(buffer.begin(), buffer.end(), heapLess);
+            } else if (less(row, buffer.front())) {
+                pop_heap(buffer.begin(), buffer.end(), heapLess);
+                buffer.back() = std::move(row);
+                push_heap(buffer.begin(), buffer.end(), heapLess);
+            }
+            return;
+        }
+
+        buffer.push_back(std::move(row));
+        if (buffer.size() >= memoryRows) {
+            spillRun();  // Buffer is full, write it out as a sorted run
+        }
+    }
+
+    // Whether no more input can change the output (LIMIT reached while streaming in input order,
+    // or the sort failed); the producer can stop feeding rows
+    bool done() const {
+        return spillFailed || (sortColumn == -1 && limit >= 0 && emitted >= limit);
+    }
+
+    // Flush the remaining rows to the output in order. Returns false, without emitting, if a
+    // spilled run could not be written.
+    bool finish() {
+        if (spillFailed) {
+            removeRuns();
+            return false;
+        }
+        if (sortColumn == -1) return true;  // Already emitted while streaming
+
+        auto heapLess = [this](const SortedRow &a, const SortedRow &b) { return less(a, b); };
+        if (useHeap) {
+            sort_heap(buffer.begin(), buffer.end(), heapLess);
+        } else if (!runFiles.empty()) {
+            if (!buffer.empty()) spillRun();
+            if (!spillFailed) mergeRuns();
+            removeRuns();
+            return !spillFailed;
+        } else {
+            sort(buffer.begin(), buffer.end(), heapLess);
+        }
+
+        for (const SortedRow &row : buffer) {
+            if (!output(row.values)) break;
+        }
+        buffer.clear();
+        return true;
+    }
+};
+
+#endif //HEALTHCAREMANAGEMENTSYSTEM_SORTOPERATOR_H
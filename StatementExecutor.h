@@ -0,0 +1,286 @@
+#ifndef HEALTHCAREMANAGEMENTSYSTEM_STATEMENTEXECUTOR_H
+#define HEALTHCAREMANAGEMENTSYSTEM_STATEMENTEXECUTOR_H
+
+#include <string>
+#include <sstream>
+#include <algorithm>
+#include "DoctorManagementSystem.h"
+#include "AppointmentManagementSystem.h"
+#include "QueryHandler.h"
+#include "ResultSink.h"
+#include "TextAndStats.h"
+#include "Transaction.h"
+
+using namespace std;
+
+// Executes one textual statement: a command on the doctors or appointments, or a SQL-like query.
+// Shared by the batch runner and the socket server. One statement per call:
+//   ADD DOCTOR <name> | <address>          UPDATE DOCTOR <id> | <new name>
+//   ADD APPOINTMENT <date> | <doctor id>   UPDATE APPOINTMENT <id> | <new date>
+//   DELETE DOCTOR <id>                     DELETE APPOINTMENT <id>
+//   PRINT DOCTOR <id>                      PRINT APPOINTMENT <id>
+//   PRINT DOCTORS                          PRINT APPOINTMENTS
+//   SELECT ... ;                           SET FORMAT TABLE|CSV|JSON
+//   SHOW CACHE                             FLUSH
+//   STATS                                  REBUILD INDEXES
+//   SHOW LATENCY                           RESET LATENCY
+//   SHOW MEMORY
+//   BEGIN                                  COMMIT | ABORT
+//   FREE SLOTS <doctor id> | <yyyy-mm-dd> [<hh:mm>-<hh:mm>]
+// Between BEGIN and COMMIT, the ADD, UPDATE and DELETE commands are staged in a transaction and
+// applied together at COMMIT (see Transaction.h); queries read the committed tables.
+// An appointment date "YYYY-MM-DD HH:MM-HH:MM" is a booking and is rejected if it overlaps another
+// appointment of the doctor; FREE SLOTS lists the gaps between a doctor's bookings on a day.
+class StatementExecutor {
+private:
+    DoctorManagementSystem &doctorSystem;
+    AppointmentManagementSystem &appointmentSystem;
+    QueryHandler &queryHandler;
+    bool reportSuccess; // Whether successful commands also write a confirmation to the sink
+    unique_ptr<Transaction> ownTransaction; // Open transaction of callers without one of their own
+
+    // Converts a string to lowercase
+    static string toLower(string str) {
+        for (char &ch : str) {
+            if (ch >= 'A' && ch <= 'Z') ch = static_cast<char>(tolower(ch));
+        }
+        return str;
+    }
+
+    // Pads a numeric ID to the two-character form used by the indexes ("7" -> "07")
+    static bool padId(string id, string &paddedId) {
+        trimBlanks(id);
+        if (id.empty() || id.size() > 9 || !all_of(id.begin(), id.end(), ::isdigit)) return false;
+        int value = stoi(id);
+        paddedId = (value < 10 ? "0" : "") + to_string(value);
+        return true;
+    }
+
+    // Splits a command, "<verb> <object> <arguments>", given also in lowercase; the verb and
+    // object come out lowercase, the arguments trimmed but as written
+    static void splitCommand(const string &statement, const string &lower, string &verb, string &object,
+                             string &arguments) {
+        istringstream words(lower);
+        words >> verb >> object;
+        size_t argumentsStart = lower.find(object, verb.size()) + object.size();
+        arguments = argumentsStart <= statement.size() ? statement.substr(argumentsStart) : "";
+        trimBlanks(arguments);
+    }
+
+    // Splits "<first> | <second>" into two trimmed, lowercase parts
+    static bool splitPair(const string &arguments, string &first, string &second) {
+        size_t bar = arguments.find('|');
+        if (bar == string::npos) return false;
+        first = toLower(arguments.substr(0, bar));
+        second = toLower(arguments.substr(bar + 1));
+        trimBlanks(first);
+        trimBlanks(second);
+        return !first.empty() && !second.empty();
+    }
+
+    // Writes a confirmation if enabled; returns true
+    bool succeeded(ResultSink &sink, const string &text) {
+        if (reportSuccess) sink.message(text);
+        return true;
+    }
+
+    // Writes an error message; returns false
+    static bool failed(ResultSink &sink, const string &text) {
+        sink.message(text);
+        return false;
+    }
+
+    // Writes the gaps between a doctor's bookings on a day ("yyyy-mm-dd"), or within a time range
+    // of a day ("yyyy-mm-dd hh:mm-hh:mm"), one "hh:mm-hh:mm" line per gap
+    bool writeFreeSlots(const string &doctorId, const string &when, ResultSink &sink) {
+        if (!doctorSystem.doctorExists(doctorId)) return failed(sink, "Doctor with ID " + doctorId + " not found.");
+        TimeInterval window;
+        long long day;
+        if (parseDay(when, day)) {
+            window = {day * 24 * 60, (day + 1) * 24 * 60};
+        } else if (!parseAppointmentTime(when, window)) {
+            return failed(sink, "Invalid day \"" + when + "\" (use yyyy-mm-dd or yyyy-mm-dd hh:mm-hh:mm).");
+        }
+        vector<TimeInterval> slots = appointmentSystem.freeSlots(doctorId, window);
+        sink.message("Free slots of doctor " + to_string(stoi(doctorId)) + " on " + when.substr(0, 10) + ":");
+        for (const TimeInterval &slot : slots) {
+            sink.message(formatTimeRange(slot));
+        }
+        if (slots.empty()) sink.message("None.");
+        return true;
+    }
+
+    // Stages a command in the open transaction
+    bool stage(Transaction &transaction, const string &verb, const string &object, const string &arguments,
+               const string &statement, ResultSink &sink, string &kind) {
+        string first, second, id;
+        bool staged;
+        if (verb == "add" && object == "doctor" && splitPair(arguments, first, second)) {
+            Doctor doctor("", first, second);
+            staged = transaction.addDoctor(doctor);
+            if (staged) return succeeded(sink, "Doctor " + doctor.name + " will be added with ID " +
+                                               to_string(stoi(doctor.id)) + ".");
+        } else if (verb == "add" && object == "appointment" && splitPair(arguments, first, second) &&
+                   padId(second, id)) {
+            Appointment appointment;
+            appointment.date = first;
+            appointment.doctorID = id;
+            staged = transaction.addAppointment(appointment);
+            if (staged) return succeeded(sink, "Appointment will be added with ID " +
+                                               to_string(stoi(appointment.id)) + ".");
+        } else if (verb == "update" && object == "doctor" && splitPair(arguments, first, second) &&
+                   padId(first, id)) {
+            staged = transaction.updateDoctorName(id, second);
+        } else if (verb == "update" && object == "appointment" && splitPair(arguments, first, second) &&
+                   padId(first, id)) {
+            staged = transaction.updateAppointmentDate(id, second);
+        } else if (verb == "delete" && object == "doctor" && padId(arguments, id)) {
+            staged = transaction.deleteDoctor(id);
+        } else if (verb == "delete" && object == "appointment" && padId(arguments, id)) {
+            staged = transaction.deleteAppointment(id);
+        } else {
+            kind = "INVALID";
+            return failed(sink, "Invalid statement: " + statement);
+        }
+        if (!staged) return failed(sink, transaction.lastError());
+        return succeeded(sink, "Staged.");
+    }
+
+public:
+    // The management systems' own confirmations of a statement go to its sink. With
+    // `reportSuccess` they are dropped and the executor writes one confirmation line per command
+    // instead, in the same words whatever the system prints (e.g. for socket clients).
+    StatementExecutor(DoctorManagementSystem &doctorSys, AppointmentManagementSystem &appointmentSys,
+                      QueryHandler &queryHandler, bool reportSuccess = false)
+            : doctorSystem(doctorSys), appointmentSystem(appointmentSys), queryHandler(queryHandler),
+              reportSuccess(reportSuccess) {}
+
+    // Whether `statement` is a point lookup, "PRINT DOCTOR <id>" or "PRINT APPOINTMENT <id>".
+    // It needs no executor state (inside a transaction too it reads the committed record), so
+    // callers may answer it through AsyncStorage instead of execute(), with the same output.
+    // Sets `object` to "doctor" or "appointment" and `id` to the padded ID.
+    static bool parsePointLookup(const string &statement, string &object, string &id) {
+        string verb, arguments;
+        splitCommand(statement, toLower(statement), verb, object, arguments);
+        return verb == "print" && (object == "doctor" || object == "appointment") && padId(arguments, id);
+    }
+
+    // Executes one statement, writing results to `sink`. Returns false if the statement is invalid
+    // or could not be executed. `kind` receives the statement kind, e.g. "ADD DOCTOR" or "INVALID".
+    bool execute(const string &statement, ResultSink &sink, string &kind) {
+        return execute(statement, sink, kind, ownTransaction);
+    }
+
+    // Executes one statement within the statement stream that owns `transaction` (e.g. one socket
+    // connection, whose statements may run on different executors)
+    bool execute(const string &statement, ResultSink &sink, string &kind, unique_ptr<Transaction> &transaction) {
+        ConfirmationRedirect confirmations(&sink, reportSuccess);
+        string lower = toLower(statement);
+        kind = "INVALID";
+
+        if (lower.rfind("select", 0) == 0 || lower.rfind("set format", 0) == 0 || lower.rfind("show", 0) == 0 ||
+            lower.rfind("stats", 0) == 0 || lower.rfind("reset latency", 0) == 0) {
+            kind = lower.rfind("select", 0) == 0 ? "SELECT" : lower.rfind("show", 0) == 0 ? "SHOW" :
+                   lower.rfind("stats", 0) == 0 ? "STATS" : lower.rfind("reset", 0) == 0 ? "RESET LATENCY" :
+                   "SET FORMAT";
+            return queryHandler.executeQuery(statement, sink);
+        }
+        if (lower == "flush") {
+            kind = "FLUSH";
+            doctorSystem.flush();
+            appointmentSystem.flush();
+            return succeeded(sink, "Index files written.");
+        }
+        if (lower == "rebuild indexes") {
+            kind = "REBUILD INDEXES";
+            for (const RebuildReport &report : {doctorSystem.rebuildIndexes(), appointmentSystem.rebuildIndexes()}) {
+                for (const string &line : report.lines()) {
+                    sink.message(line);
+                }
+            }
+            return true;
+        }
+
+        if (lower == "begin") {
+            kind = "BEGIN";
+            if (transaction) return failed(sink, "A transaction is already open.");
+            transaction = make_unique<Transaction>(doctorSystem, appointmentSystem);
+            return succeeded(sink, "Transaction started.");
+        }
+        if (lower == "commit") {
+            kind = "COMMIT";
+            if (!transaction) return failed(sink, "No transaction is open.");
+            size_t changes = transaction->size();
+            bool committed = transaction->commit();
+            string error = transaction->lastError();
+            transaction.reset();
+            if (!committed) return failed(sink, error + " The transaction was rolled back.");
+            return succeeded(sink, "Transaction committed (" + to_string(changes) + " changes).");
+        }
+        if (lower == "abort" || lower == "rollback") {
+            kind = "ABORT";
+            if (!transaction) return failed(sink, "No transaction is open.");
+            transaction.reset();
+            return succeeded(sink, "Transaction aborted.");
+        }
+
+        string verb, object, arguments;
+        splitCommand(statement, lower, verb, object, arguments);
+        kind = verb + " " + object;
+        for (char &ch : kind) ch = static_cast<char>(toupper(ch));
+
+        string first, second, id;
+        if (transaction && (verb == "add" || verb == "update" || verb == "delete")) {
+            return stage(*transaction, verb, object, arguments, statement, sink, kind);
+        }
+        if (verb == "add" && object == "doctor" && splitPair(arguments, first, second)) {
+            Doctor doctor("", first, second);
+            doctorSystem.addDoctor(doctor);
+            return succeeded(sink, "Doctor " + doctor.name + " is added with ID " + to_string(stoi(doctor.id)) + ".");
+        } else if (verb == "add" && object == "appointment" && splitPair(arguments, first, second) &&
+                   padId(second, id)) {
+            // The systems check the doctor, the booking and sealed partitions under their locks
+            Appointment appointment;
+            appointment.date = first;
+            appointment.doctorID = id;
+            string error;
+            if (!appointmentSystem.addAppointment(appointment, &error)) return failed(sink, error);
+            return succeeded(sink, "Appointment with ID " + to_string(stoi(appointment.id)) + " has been added.");
+        } else if (verb == "update" && object == "doctor" && splitPair(arguments, first, second) &&
+                   padId(first, id)) {
+            string error;
+            if (!doctorSystem.updateDoctorName(id, second, &error)) return failed(sink, error);
+            return succeeded(sink, "Doctor's name updated successfully.");
+        } else if (verb == "update" && object == "appointment" && splitPair(arguments, first, second) &&
+                   padId(first, id)) {
+            string error;
+            if (!appointmentSystem.updateAppointmentDate(id, second, &error)) return failed(sink, error);
+            return succeeded(sink, "Appointment date updated successfully.");
+        } else if (verb == "delete" && object == "doctor" && padId(arguments, id)) {
+            // The doctor may be missing or, with ON DELETE RESTRICT, still have appointments
+            string error;
+            if (!doctorSystem.deleteDoctor(id, &error)) return failed(sink, error);
+            return succeeded(sink, "Doctor with ID " + to_string(stoi(id)) + " has been marked as deleted.");
+        } else if (verb == "delete" && object == "appointment" && padId(arguments, id)) {
+            string error;
+            if (!appointmentSystem.deleteAppointment(id, &error)) return failed(sink, error);
+            return succeeded(sink, "Appointment with ID " + to_string(stoi(id)) + " has been marked as deleted.");
+        } else if (verb == "free" && object == "slots" && splitPair(arguments, first, second) && padId(first, id)) {
+            return writeFreeSlots(id, second, sink);
+        } else if (verb == "print" && object == "doctor" && padId(arguments, id)) {
+            doctorSystem.printDoctorById(id, 0, sink);
+        } else if (verb == "print" && object == "appointment" && padId(arguments, id)) {
+            appointmentSystem.printAppointmentById(id, 0, sink);
+        } else if (verb == "print" && object == "doctors" && arguments.empty()) {
+            doctorSystem.printAllDoctors(0, sink);
+        } else if (verb == "print" && object == "appointments" && arguments.empty()) {
+            appointmentSystem.printAllAppointments(0, sink);
+        } else {
+            kind = "INVALID";
+            return failed(sink, "Invalid statement: " + statement);
+        }
+        return true;
+    }
+};
+
+#endif //HEALTHCAREMANAGEMENTSYSTEM_STATEMENTEXECUTOR_H
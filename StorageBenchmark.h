@@ -0,0 +1,342 @@
+#ifndef HEALTHCAREMANAGEMENTSYSTEM_STORAGEBENCHMARK_H
+#define HEALTHCAREMANAGEMENTSYSTEM_STORAGEBENCHMARK_H
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <fstream>
+#include <filesystem>
+#include <functional>
+#include <algorithm>
+#include <unordered_set>
+#include "DoctorManagementSystem.h"
+#include "AppointmentManagementSystem.h"
+#include "ResultSink.h"
+#include "TextAndStats.h"
+
+using namespace std;
+
+// Zero-padded ID as stored in the indexes
+static string benchmarkId(size_t id) {
+    return (id < 10 ? "0" : "") + to_string(id);
+}
+
+// A fresh temporary data directory, made the working directory for the benchmark's lifetime
+// (the data and index file names are relative to it) and removed afterwards
+class BenchmarkDirectory {
+private:
+    filesystem::path originalDirectory;  // Working directory to return to
+    filesystem::path directory;          // The temporary directory
+    bool created = false;
+
+public:
+    explicit BenchmarkDirectory(const string &prefix) : originalDirectory(filesystem::current_path()) {
+        directory = filesystem::temp_directory_path() /
+                    (prefix + to_string(chrono::steady_clock::now().time_since_epoch().count()));
+        error_code error;
+        filesystem::create_directories(directory, error);
+        if (error) {
+            cerr << "Error creating benchmark directory: " << directory << "\n";
+            return;
+        }
+        filesystem::current_path(directory);
+        for (const char *fileName : {"doctors.txt", "appointments.txt", "DoctorPrimaryIndex.txt",
+                                     "DoctorSecondaryIndex.txt", "DoctorLabelIdList.txt", "DoctorAvailList.txt",
+                                     "AppointmentPrimaryIndex.txt", "AppointmentSecondaryIndex.txt",
+                                     "AppointmentLabelIdList.txt", "AppointmentAvailList.txt"}) {
+            ofstream(fileName).close();
+        }
+        created = true;
+    }
+
+    ~BenchmarkDirectory() {
+        if (!created) return;
+        filesystem::current_path(originalDirectory);
+        error_code error;
+        filesystem::remove_all(directory, error);
+    }
+
+    BenchmarkDirectory(const BenchmarkDirectory &) = delete;
+    BenchmarkDirectory &operator=(const BenchmarkDirectory &) = delete;
+
+    // Whether the directory was created and entered
+    bool ready() const {
+        return created;
+    }
+};
+
+// Latency and throughput of the storage and index operations at one data set size.
+//
+// Every run builds its data set in a fresh temporary directory (the data and index file names are
+// relative to the working directory): `recordCount` appointments spread over recordCount / 10
+// doctors. It then times, operation by operation, the loading adds, reopening the tables
+// (startup), point lookups, secondary-index lookups, full scans, updates and deletes. Each
+// operation gives one result row with its throughput and p50/p99/max latency, written to a
+// result sink so the rows can be CSV or JSON lines.
+//
+// By default the index files are persisted once at the end of each write phase (deferred
+// persistence, the flush counted in the phase's time); with a durability policy set they are
+// persisted as the policy says, which at millions of records makes writes far slower.
+class StorageBenchmark {
+private:
+    size_t recordCount;      // Appointments in the data set
+    size_t doctorCount;      // Doctors in the data set
+    size_t sampleCount;      // Operations timed per lookup, update and delete phase
+    bool deferred;           // Persist the indexes once per write phase instead of per the policy
+    ResultSink &sink;        // Receives one row per operation
+
+    // Doctor name of a popularity class; all names have one length, so renames stay in place
+    static string doctorName(size_t n) {
+        string digits = to_string(n % 1000);
+        return "doctor" + string(3 - digits.size(), '0') + digits;
+    }
+
+    // Run `operation` `count` times, timing each call, then `finish` (counted in the total only),
+    // and write the result row
+    void measure(const string &name, size_t count, const function<void(size_t i)> &operation,
+                 const function<void()> &finish = nullptr) {
+        cerr << "  " << name << " x " << count << "\n";
+        vector<long long> latencies;
+        latencies.reserve(count);
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < count; ++i) {
+            auto before = chrono::steady_clock::now();
+            operation(i);
+            latencies.push_back(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - before).count());
+        }
+        if (finish) finish();
+        long long elapsedNs = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+
+        sink.beginRow();
+        sink.numberField("Records", recordCount);
+        sink.field("Operation", name);
+        sink.numberField("Ops", count);
+        sink.numberField("Elapsed us", elapsedNs / 1000);
+        sink.numberField("Ops per s", elapsedNs > 0 ? static_cast<long long>(count * 1e9 / elapsedNs) : 0);
+        sink.numberField("P50 ns", latencyPercentile(latencies, 50));
+        sink.numberField("P99 ns", latencyPercentile(latencies, 99));
+        sink.numberField("Max ns", latencies.empty() ? 0 : *max_element(latencies.begin(), latencies.end()));
+        sink.endRow();
+        sink.flush();
+    }
+
+    // The timed phases, run inside the benchmark directory
+    void runPhases() {
+        auto doctorSystem = make_unique<DoctorManagementSystem>();
+        auto appointmentSystem = make_unique<AppointmentManagementSystem>(*doctorSystem);
+        auto flush = [&] {
+            if (!deferred) return;
+            doctorSystem->flush();
+            appointmentSystem->flush();
+        };
+        doctorSystem->setAutoPersist(!deferred);
+        appointmentSystem->setAutoPersist(!deferred);
+
+        measure("addDoctor", doctorCount, [&](size_t i) {
+            Doctor doctor("", doctorName(i % 997), "city" + to_string(i % 13));
+            doctorSystem->addDoctor(doctor);
+        }, flush);
+        measure("addAppointment", recordCount, [&](size_t i) {
+            Appointment appointment;
+            appointment.date = "2024-01-" + benchmarkId(i % 28 + 1);
+            appointment.doctorID = benchmarkId(i % doctorCount + 1);
+            appointmentSystem->addAppointment(appointment);
+        }, flush);
+
+        // Startup: open the tables and load every index from its files
+        appointmentSystem.reset();
+        doctorSystem.reset();
+        measure("startup", 1, [&](size_t) {
+            doctorSystem = make_unique<DoctorManagementSystem>();
+            appointmentSystem = make_unique<AppointmentManagementSystem>(*doctorSystem);
+        });
+        doctorSystem->setAutoPersist(!deferred);
+        appointmentSystem->setAutoPersist(!deferred);
+
+        mt19937_64 random(42);
+        size_t samples = min(sampleCount, recordCount);
+        Doctor doctor;
+        Appointment appointment;
+        measure("readDoctor", samples, [&](size_t) {
+            doctorSystem->readDoctor(benchmarkId(random() % doctorCount + 1), doctor);
+        });
+        measure("readAppointment", samples, [&](size_t) {
+            appointmentSystem->readAppointment(benchmarkId(random() % recordCount + 1), appointment);
+        });
+        measure("searchAppointmentsByDoctorID", samples, [&](size_t) {
+            appointmentSystem->searchAppointmentsByDoctorID(benchmarkId(random() % doctorCount + 1));
+        });
+        measure("searchDoctorsByName", samples, [&](size_t) {
+            doctorSystem->searchDoctorsByName(doctorName(random() % 997));
+        });
+
+        size_t scanned = 0;
+        measure("scanDoctors", 3, [&](size_t) {
+            doctorSystem->scanDoctors([&](const Doctor &) { ++scanned; return true; });
+        });
+        measure("scanAppointments", 3, [&](size_t) {
+            appointmentSystem->scanAppointments([&](const Appointment &) { ++scanned; return true; });
+        });
+
+        measure("updateDoctorName", min(samples, doctorCount), [&](size_t) {
+            string name = doctorName(random() % 997);
+            doctorSystem->updateDoctorName(benchmarkId(random() % doctorCount + 1), name);
+        }, flush);
+        measure("updateAppointmentDate", samples, [&](size_t) {
+            // Same length as the loaded dates, so the record is updated in place
+            appointmentSystem->updateAppointmentDate(benchmarkId(random() % recordCount + 1),
+                                                     "2024-02-" + benchmarkId(random() % 28 + 1));
+        }, flush);
+
+        // Deletes take distinct appointments, so every call finds its record
+        unordered_set<size_t> picked;
+        vector<string> deletedIds;
+        while (deletedIds.size() < samples) {
+            size_t id = random() % recordCount + 1;
+            if (picked.insert(id).second) deletedIds.push_back(benchmarkId(id));
+        }
+        measure("deleteAppointment", samples, [&](size_t i) {
+            appointmentSystem->deleteAppointment(deletedIds[i]);
+        }, flush);
+    }
+
+public:
+    StorageBenchmark(size_t recordCount, size_t sampleCount, bool deferred, ResultSink &sink)
+            : recordCount(max<size_t>(recordCount, 1)), doctorCount(max<size_t>(recordCount / 10, 1)),
+              sampleCount(max<size_t>(sampleCount, 1)), deferred(deferred), sink(sink) {}
+
+    // Build the data set in a temporary directory, run every phase and write the results; the
+    // directory is removed afterwards. Returns false if it could not be created.
+    bool run() {
+        BenchmarkDirectory directory("hcms-storage-bench-");
+        if (!directory.ready()) return false;
+
+        // Silence the per-operation confirmation messages
+        cerr << "Storage benchmark: " << recordCount << " appointments, " << doctorCount << " doctors\n";
+        ConfirmationRedirect quiet(nullptr, true);
+        runPhases();
+        return true;
+    }
+};
+
+// Measures how read throughput scales with the number of reader threads.
+// The benchmark builds its own data set in a temporary directory, then runs a read-only mix of
+// lookups (readDoctor, readAppointment, searchAppointmentsByDoctorID, countAppointmentsByDoctorID)
+// on 1, 2, 4, ... threads, and finally the same mix next to a thread updating appointments.
+class ReadBenchmark {
+private:
+    size_t doctorCount;                      // Doctors in the data set
+    size_t appointmentCount;                 // Appointments in the data set
+    unsigned maxThreads;                     // Largest number of reader threads
+    chrono::milliseconds stepDuration;       // How long each thread count is measured
+
+    // Run `readers` threads (plus an optional writer) for stepDuration; returns read operations per second
+    double measure(DoctorManagementSystem &doctorSystem, AppointmentManagementSystem &appointmentSystem,
+                   unsigned readers, bool withWriter) {
+        atomic<bool> stop{false};
+        atomic<unsigned long long> totalOps{0};
+        vector<thread> threads;
+        for (unsigned t = 0; t < readers; ++t) {
+            threads.emplace_back([&, t] {
+                mt19937_64 random(t + 1);
+                unsigned long long ops = 0;
+                Doctor doctor;
+                Appointment appointment;
+                while (!stop.load(memory_order_relaxed)) {
+                    string doctorId = benchmarkId(random() % doctorCount + 1);
+                    switch (ops % 4) {
+                        case 0: doctorSystem.readDoctor(doctorId, doctor); break;
+                        case 1: appointmentSystem.readAppointment(benchmarkId(random() % appointmentCount + 1), appointment); break;
+                        case 2: appointmentSystem.searchAppointmentsByDoctorID(doctorId); break;
+                        case 3: appointmentSystem.countAppointmentsByDoctorID(doctorId); break;
+                    }
+                    ops++;
+                }
+                totalOps += ops;
+            });
+        }
+        if (withWriter) {
+            threads.emplace_back([&] {
+                ConfirmationRedirect quiet(nullptr, true);
+                mt19937_64 random(12345);
+                while (!stop.load(memory_order_relaxed)) {
+                    string date = "2024-02-" + benchmarkId(random() % 28 + 1);  // Same length, updated in place
+                    appointmentSystem.updateAppointmentDate(benchmarkId(random() % appointmentCount + 1), date);
+                }
+            });
+        }
+
+        auto start = chrono::steady_clock::now();
+        this_thread::sleep_for(stepDuration);
+        stop = true;
+        for (thread &worker : threads) {
+            worker.join();
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        return totalOps / seconds;
+    }
+
+public:
+    ReadBenchmark(size_t doctorCount = 1000, size_t appointmentCount = 10000,
+                  unsigned maxThreads = thread::hardware_concurrency(), chrono::milliseconds stepDuration = chrono::milliseconds(1000))
+            : doctorCount(max<size_t>(doctorCount, 1)), appointmentCount(max<size_t>(appointmentCount, 1)),
+              maxThreads(max(maxThreads, 1u)), stepDuration(stepDuration) {}
+
+    // Build the data set, run every step and print the results; returns false if setup failed
+    bool run() {
+        BenchmarkDirectory directory("hcms-read-bench-");
+        if (!directory.ready()) return false;
+
+        {
+            DoctorManagementSystem doctorSystem;
+            AppointmentManagementSystem appointmentSystem(doctorSystem);
+            doctorSystem.setAutoPersist(false);
+            appointmentSystem.setAutoPersist(false);
+            {
+                // Silence the per-operation confirmation messages while seeding (the writer
+                // thread silences its own)
+                ConfirmationRedirect quiet(nullptr, true);
+                for (size_t i = 1; i <= doctorCount; ++i) {
+                    Doctor doctor("", "doctor" + to_string(i % 97), "city" + to_string(i % 13));
+                    doctorSystem.addDoctor(doctor);
+                }
+                for (size_t i = 1; i <= appointmentCount; ++i) {
+                    Appointment appointment;
+                    appointment.date = "2024-01-" + benchmarkId(i % 28 + 1);
+                    appointment.doctorID = benchmarkId(i % doctorCount + 1);
+                    appointmentSystem.addAppointment(appointment);
+                }
+            }
+
+            cout << "Read benchmark: " << doctorCount << " doctors, " << appointmentCount << " appointments, "
+                 << stepDuration.count() << " ms per step\n";
+            cout << left << setw(24) << "Readers" << right << setw(16) << "Reads/s" << setw(10) << "Speedup" << "\n";
+            // Powers of two up to maxThreads, and maxThreads itself
+            vector<unsigned> steps;
+            for (unsigned readers = 1; readers < maxThreads; readers *= 2) steps.push_back(readers);
+            steps.push_back(maxThreads);
+
+            double baseline = 0;
+            for (unsigned readers : steps) {
+                double throughput = measure(doctorSystem, appointmentSystem, readers, false);
+                if (readers == 1) baseline = throughput;
+                cout << left << setw(24) << readers << right << setw(16) << fixed << setprecision(0) << throughput
+                     << setw(9) << setprecision(2) << throughput / baseline << "x\n";
+            }
+
+            double mixed = measure(doctorSystem, appointmentSystem, maxThreads, true);
+            cout << left << setw(24) << (to_string(maxThreads) + " + 1 writer") << right << setw(16) << setprecision(0)
+                 << mixed << setw(9) << setprecision(2) << mixed / baseline << "x\n";
+            cout.unsetf(ios::floatfield);
+            cout << setprecision(6);
+        }
+        return true;
+    }
+};
+
+#endif //HEALTHCAREMANAGEMENTSYSTEM_STORAGEBENCHMARK_H
@@ -0,0 +1,161 @@
+#ifndef HEALTHCAREMANAGEMENTSYSTEM_STORAGESTATS_H
+#define HEALTHCAREMANAGEMENTSYSTEM_STORAGESTATS_H
+
+#include <string>
+#include <vector>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include "DurableFile.h"
+
+using namespace std;
+
+// Process-wide I/O and operation counters.
+//
+// Every thread counts into its own block of counters, so counting is a plain load and store on a
+// cache line no other thread writes: no lock, no atomic read-modify-write. The blocks are summed
+// on demand (STATS, the Prometheus text file); the counts of threads that exited are kept in a
+// retired total. A sum taken while other threads count is not a consistent snapshot across
+// counters, but every counter in it is exact up to that moment.
+//
+// The storage classes count file opens, seeks, bytes read and written, index file rewrites and
+// avail list steps; the management systems count record-level operations (a rename or redate
+// that does not fit in place counts as a delete and an add).
+
+// What is counted
+enum class StatCounter {
+    FileOpens,              // Data files opened to read or write records
+    Seeks,                  // Seeks in data files
+    BytesRead,              // Bytes read from data files
+    BytesWritten,           // Bytes written to data and index files
+    IndexRewrites,          // Index and avail list files rewritten
+    AvailListSteps,         // Avail list nodes visited when searching or inserting
+    PrimaryIndexLookups,    // Primary index searches
+    SecondaryIndexLookups,  // Secondary index posting list lookups
+    IndexEvictions,         // Index structures evicted to stay within the memory budget
+    IndexPageIns,           // Evicted index structures read back from their files
+    DoctorAdds,
+    DoctorUpdates,
+    DoctorDeletes,
+    DoctorReads,
+    AppointmentAdds,
+    AppointmentUpdates,
+    AppointmentDeletes,
+    AppointmentReads,
+    Count                   // Number of counters
+};
+
+const size_t statCounterCount = static_cast<size_t>(StatCounter::Count);
+
+// Name (as in STATS and, with an "hcms_" prefix and "_total" suffix, in Prometheus) and help text
+// of each counter, in enum order
+static const array<pair<const char *, const char *>, statCounterCount> statCounterInfo = {{
+    {"file_opens", "Data files opened to read or write records"},
+    {"seeks", "Seeks in data files"},
+    {"bytes_read", "Bytes read from data files"},
+    {"bytes_written", "Bytes written to data and index files"},
+    {"index_rewrites", "Index and avail list files rewritten"},
+    {"avail_list_steps", "Avail list nodes visited when searching or inserting"},
+    {"primary_index_lookups", "Primary index searches"},
+    {"secondary_index_lookups", "Secondary index posting list lookups"},
+    {"index_evictions", "Index structures evicted to stay within the memory budget"},
+    {"index_page_ins", "Evicted index structures read back from their files"},
+    {"doctor_adds", "Doctor records added"},
+    {"doctor_updates", "Doctor records renamed in place"},
+    {"doctor_deletes", "Doctor records deleted"},
+    {"doctor_reads", "Doctor records read by ID"},
+    {"appointment_adds", "Appointment records added"},
+    {"appointment_updates", "Appointment records redated in place"},
+    {"appointment_deletes", "Appointment records deleted"},
+    {"appointment_reads", "Appointment records read by ID"},
+}};
+
+// The counters of one thread; only that thread writes them
+class alignas(64) ThreadStatCounters {
+public:
+    atomic<unsigned long long> values[statCounterCount] = {};
+};
+
+// Registry of the threads' counter blocks
+class StorageStats {
+private:
+    mutable mutex registryMutex;
+    vector<ThreadStatCounters *> threads;                   // Blocks of running threads
+    array<unsigned long long, statCounterCount> retired{}; // Counts of threads that exited
+
+public:
+    void registerThread(ThreadStatCounters *counters) {
+        lock_guard<mutex> lock(registryMutex);
+        threads.push_back(counters);
+    }
+
+    // Fold an exiting thread's counts into the retired total
+    void retireThread(ThreadStatCounters *counters) {
+        lock_guard<mutex> lock(registryMutex);
+        for (size_t i = 0; i < statCounterCount; ++i) {
+            retired[i] += counters->values[i].load(memory_order_relaxed);
+        }
+        threads.erase(remove(threads.begin(), threads.end(), counters), threads.end());
+    }
+
+    // Sum of every thread's counters
+    array<unsigned long long, statCounterCount> totals() const {
+        lock_guard<mutex> lock(registryMutex);
+        array<unsigned long long, statCounterCount> sums = retired;
+        for (const ThreadStatCounters *counters : threads) {
+            for (size_t i = 0; i < statCounterCount; ++i) {
+                sums[i] += counters->values[i].load(memory_order_relaxed);
+            }
+        }
+        return sums;
+    }
+};
+
+// Process-wide counter registry
+static StorageStats &storageStats() {
+    static StorageStats stats;
+    return stats;
+}
+
+// Registers the calling thread's counters on first use and retires them when the thread exits
+class ThreadStatRegistration {
+public:
+    ThreadStatCounters counters;
+
+    ThreadStatRegistration() {
+        storageStats().registerThread(&counters);
+    }
+
+    ~ThreadStatRegistration() {
+        storageStats().retireThread(&counters);
+    }
+};
+
+// Add `amount` to a counter of the calling thread
+static inline void countStat(StatCounter counter, unsigned long long amount = 1) {
+    thread_local ThreadStatRegistration registration;
+    atomic<unsigned long long> &value = registration.counters.values[static_cast<size_t>(counter)];
+    value.store(value.load(memory_order_relaxed) + amount, memory_order_relaxed);
+}
+
+// The counters in Prometheus text exposition format
+static string prometheusStats() {
+    array<unsigned long long, statCounterCount> totals = storageStats().totals();
+    string text;
+    for (size_t i = 0; i < statCounterCount; ++i) {
+        string metric = string("hcms_") + statCounterInfo[i].first + "_total";
+        text += "# HELP " + metric + " " + statCounterInfo[i].second + "\n";
+        text += "# TYPE " + metric + " counter\n";
+        text += metric + " " + to_string(totals[i]) + "\n";
+    }
+    return text;
+}
+
+// Write the counters to a Prometheus text file (for the node exporter's textfile collector),
+// replacing it atomically so a scrape never sees a partial file
+inline bool writePrometheusStats(const string &fileName) {
+    return replaceFileAtomically(fileName, prometheusStats(), false);
+}
+
+#endif //HEALTHCAREMANAGEMENTSYSTEM_STORAGESTATS_H
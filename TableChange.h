@@ -0,0 +1,32 @@
+#ifndef HEALTHCAREMANAGEMENTSYSTEM_TABLECHANGE_H
+#define HEALTHCAREMANAGEMENTSYSTEM_TABLECHANGE_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <functional>
+
+using namespace std;
+
+// Describes a mutation of one record: the table it belongs to and the column values it touched.
+// An update lists both the old and the new value of a changed column.
+class TableChange {
+public:
+    string table;                         // "doctors" or "appointments"
+    vector<pair<string, string>> values;  // (column, value) pairs of the touched record
+    bool wholeTable = false;              // Whether any record may have changed (e.g. an index rebuild)
+
+    // Whether the change touched `column` with value `value`
+    bool touches(const string &column, const string &value) const {
+        if (wholeTable) return true;
+        for (const auto &entry : values) {
+            if (entry.first == column && entry.second == value) return true;
+        }
+        return false;
+    }
+};
+
+// Callback registered with a management system to observe its mutations
+using TableChangeListener = function<void(const TableChange &)>;
+
+#endif //HEALTHCAREMANAGEMENTSYSTEM_TABLECHANGE_H
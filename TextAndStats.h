@@ -0,0 +1,28 @@
+#ifndef HEALTHCAREMANAGEMENTSYSTEM_TEXTANDSTATS_H
+#define HEALTHCAREMANAGEMENTSYSTEM_TEXTANDSTATS_H
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+// Small helpers shared by the statement runners (StatementExecutor, BatchRunner,
+// WorkloadReplayer) and the benchmarks.
+
+// Trims leading and trailing blanks (spaces, tabs, carriage returns) from a string
+inline void trimBlanks(string &str) {
+    size_t first = str.find_first_not_of(" \t\r");
+    size_t last = str.find_last_not_of(" \t\r");
+    str = (first == string::npos) ? "" : str.substr(first, last - first + 1);
+}
+
+// The p-th percentile (0-100) of the latencies; reorders them
+inline long long latencyPercentile(vector<long long> &latencies, double p) {
+    if (latencies.empty()) return 0;
+    size_t rank = min(latencies.size() - 1, static_cast<size_t>(p / 100 * latencies.size()));
+    nth_element(latencies.begin(), latencies.begin() + rank, latencies.end());
+    return latencies[rank];
+}
+
+#endif //HEALTHCAREMANAGEMENTSYSTEM_TEXTANDSTATS_H
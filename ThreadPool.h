@@ -0,0 +1,99 @@
+#ifndef HEALTHCAREMANAGEMENTSYSTEM_THREADPOOL_H
+#define HEALTHCAREMANAGEMENTSYSTEM_THREADPOOL_H
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <type_traits>
+
+using namespace std;
+
+// Fixed-size pool of worker threads executing submitted tasks in FIFO order
+class ThreadPool {
+private:
+    vector<thread> workers;          // Worker threads
+    queue<function<void()>> tasks;   // Tasks waiting for a worker
+    mutex queueMutex;                // Protects tasks and stopping
+    condition_variable taskReady;    // Signalled when a task is queued or the pool stops
+    bool stopping = false;           // Set when the pool is being destroyed
+
+    // Loop run by each worker: take the next task and execute it until the pool stops
+    void workerLoop() {
+        while (true) {
+            function<void()> task;
+            {
+                unique_lock<mutex> lock(queueMutex);
+                taskReady.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (stopping && tasks.empty()) return;
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+            task();
+        }
+    }
+
+public:
+    // Start `threadCount` workers (at least one; defaults to the number of hardware threads)
+    explicit ThreadPool(size_t threadCount = thread::hardware_concurrency()) {
+        threadCount = max<size_t>(threadCount, 1);
+        for (size_t i = 0; i < threadCount; ++i) {
+            workers.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    // Finish the queued tasks and join the workers
+    ~ThreadPool() {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            stopping = true;
+        }
+        taskReady.notify_all();
+        for (thread &worker : workers) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // Number of worker threads
+    size_t size() const {
+        return workers.size();
+    }
+
+    // Queue a fire-and-forget task (no future), e.g. resuming a coroutine
+    void post(function<void()> task) {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            tasks.emplace(std::move(task));
+        }
+        taskReady.notify_one();
+    }
+
+    // Queue a task and return a future for its result
+    template<typename Task>
+    auto submit(Task &&task) -> future<invoke_result_t<Task>> {
+        using Result = invoke_result_t<Task>;
+        auto packaged = make_shared<packaged_task<Result()>>(std::forward<Task>(task));
+        future<Result> result = packaged->get_future();
+        {
+            lock_guard<mutex> lock(queueMutex);
+            tasks.emplace([packaged] { (*packaged)(); });
+        }
+        taskReady.notify_one();
+        return result;
+    }
+};
+
+// Process-wide pool shared by the parallel operators
+static ThreadPool &sharedThreadPool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+#endif //HEALTHCAREMANAGEMENTSYSTEM_THREADPOOL_H
@@ -0,0 +1,428 @@
+#ifndef HEALTHCAREMANAGEMENTSYSTEM_TRANSACTION_H
+#define HEALTHCAREMANAGEMENTSYSTEM_TRANSACTION_H
+
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <memory>
+#include <functional>
+#include <algorithm>
+#include "DoctorManagementSystem.h"
+#include "AppointmentManagementSystem.h"
+
+using namespace std;
+
+// Multi-operation transactions over the doctor and appointment tables.
+//
+// A transaction starts when it is created. Adds, renames, date changes and deletes are staged in
+// memory and checked against the tables as they would be after the earlier staged changes; no
+// file is touched. commit() locks every shard of the touched tables (doctors before appointments,
+// the order every other writer respects), checks the staged changes again against the current
+// tables, and applies all of them or none. If applying one fails (a data file cannot be written),
+// the changes applied before it are taken back in reverse order, from what each one replaced, and
+// the commit fails. While applying, each index structure collects its changes into one change
+// group, so it is persisted once per commit instead of once or twice per operation. abort() (or
+// destroying an uncommitted transaction) discards the staged changes.
+//
+// Timed appointments ("YYYY-MM-DD HH:MM-HH:MM") added or moved by a transaction must not overlap
+// another appointment of their doctor, committed or staged; commit() also holds those doctors'
+// booking stripes, so no booking outside the transaction can slip in between the check and the apply.
+//
+// Deleting a doctor applies the doctor system's ON DELETE action: with RESTRICT the delete is
+// rejected while the doctor has appointments (committed or staged), with CASCADE the doctor's
+// appointments are deleted in the same commit.
+//
+// Records are written in place as during normal operation, so a crash in the middle of a commit
+// leaves some of its records written; --rebuild-indexes brings the indexes back in line with them.
+
+class Transaction {
+private:
+    // One staged change
+    class StagedChange {
+    public:
+        enum Kind { AddDoctor, RenameDoctor, DeleteDoctor, AddAppointment, RedateAppointment, DeleteAppointment };
+        Kind kind;
+        string id = "";         // Record the change applies to (the reserved ID for adds)
+        string value = "";      // Name or date
+        string secondary = "";  // Address of an added doctor, doctor ID of an added or redated appointment
+    };
+
+    DoctorManagementSystem &doctorSystem;
+    AppointmentManagementSystem &appointmentSystem;
+    vector<StagedChange> changes;
+    bool active = true;
+    string error;  // Why the last staging call or commit failed
+
+    // What the staged changes add and delete, for checking the changes that follow them
+    class StagedState {
+    public:
+        set<string> addedDoctors, deletedDoctors, deletedAppointments;
+        map<string, string> addedAppointments;  // Appointment ID -> doctor ID
+        map<string, pair<string, TimeInterval>> bookings;  // Staged times: appointment ID -> (doctor ID, time)
+        set<string> rebooked;  // Committed appointments whose scheduled time a staged date change replaces
+    };
+    StagedState staged;
+
+    // What one applied change replaced, for taking it back if a later change fails
+    class AppliedChange {
+    public:
+        const StagedChange *change;
+        bool done = false;                        // The change's own record was written
+        string previous = "";                     // Name or date before a rename or date change
+        Doctor deletedDoctor;
+        vector<Appointment> deletedAppointments;  // The deleted appointment, or a deleted doctor's
+
+        explicit AppliedChange(const StagedChange *change) : change(change) {}
+    };
+
+    bool doctorVisible(const StagedState &state, const string &id) const {
+        if (state.deletedDoctors.count(id)) return false;
+        return state.addedDoctors.count(id) || doctorSystem.doctorExists(id);
+    }
+
+    bool appointmentVisible(const StagedState &state, const string &id) const {
+        if (state.deletedAppointments.count(id)) return false;
+        return state.addedAppointments.count(id) || appointmentSystem.appointmentExists(id);
+    }
+
+    // The appointments a doctor has in the tables plus `state`. `locked` says the commit holds
+    // the appointment tables' locks.
+    vector<string> appointmentsOf(const string &doctorId, const StagedState &state, bool locked) const {
+        vector<string> appointmentIds;
+        for (const string &id : locked ? appointmentSystem.appointmentsOfDoctorLocked(doctorId)
+                                       : appointmentSystem.searchAppointmentsByDoctorID(doctorId)) {
+            if (!state.deletedAppointments.count(id)) appointmentIds.push_back(id);
+        }
+        for (const auto &added : state.addedAppointments) {
+            if (added.second == doctorId && !state.deletedAppointments.count(added.first)) {
+                appointmentIds.push_back(added.first);
+            }
+        }
+        return appointmentIds;
+    }
+
+    // Why a time cannot be booked for appointment `id` of a doctor given the schedule plus `state`,
+    // or an empty string; records the booking in `state` if it can
+    string book(const string &id, const string &doctorId, const string &date, StagedState &state) const {
+        TimeInterval interval;
+        if (!parseAppointmentTime(date, interval)) {
+            state.bookings.erase(id);
+            return "";
+        }
+        for (const auto &booked : appointmentSystem.conflictingAppointments(doctorId, interval, id)) {
+            if (!state.deletedAppointments.count(booked.first) && !state.rebooked.count(booked.first)) {
+                return bookingConflictMessage(doctorId, booked.first, booked.second);
+            }
+        }
+        for (const auto &booked : state.bookings) {
+            if (booked.first != id && booked.second.first == doctorId && booked.second.second.overlaps(interval) &&
+                !state.deletedAppointments.count(booked.first)) {
+                return bookingConflictMessage(doctorId, booked.first, booked.second.second);
+            }
+        }
+        state.bookings[id] = {doctorId, interval};
+        return "";
+    }
+
+    // Check one change against the tables plus `state` and record its effect in `state`;
+    // returns an empty string or the reason the change cannot be applied
+    string check(const StagedChange &change, StagedState &state, bool locked = false) const {
+        switch (change.kind) {
+            case StagedChange::AddDoctor:
+                state.addedDoctors.insert(change.id);
+                return "";
+            case StagedChange::RenameDoctor:
+                return doctorVisible(state, change.id) ? "" : "Doctor with ID " + change.id + " not found.";
+            case StagedChange::DeleteDoctor: {
+                if (!doctorVisible(state, change.id)) return "Doctor with ID " + change.id + " not found.";
+                ReferentialAction action = doctorSystem.onDeleteAction();
+                if (action != ReferentialAction::NoAction) {
+                    vector<string> dependents = appointmentsOf(change.id, state, locked);
+                    if (action == ReferentialAction::Restrict && !dependents.empty()) {
+                        return "Doctor with ID " + change.id + " has " + to_string(dependents.size()) +
+                               " appointment(s) and cannot be deleted.";
+                    }
+                    size_t sealed = action == ReferentialAction::Cascade
+                                    ? appointmentSystem.countSealedAppointmentsOfDoctor(change.id, locked) : 0;
+                    if (sealed > 0) {
+                        return "Doctor with ID " + change.id + " has " + to_string(sealed) +
+                               " appointment(s) in sealed partitions and cannot be deleted.";
+                    }
+                    state.deletedAppointments.insert(dependents.begin(), dependents.end());
+                }
+                state.deletedDoctors.insert(change.id);
+                return "";
+            }
+            case StagedChange::AddAppointment:
+                if (!doctorVisible(state, change.secondary)) {
+                    return "Doctor ID " + change.secondary + " does not exist. Cannot add appointment.";
+                }
+                if (string sealed = appointmentSystem.sealedError("", change.value); !sealed.empty()) return sealed;
+                if (string conflict = book(change.id, change.secondary, change.value, state); !conflict.empty()) {
+                    return conflict;
+                }
+                state.addedAppointments[change.id] = change.secondary;
+                return "";
+            case StagedChange::RedateAppointment: {
+                if (!appointmentVisible(state, change.id)) return "Appointment with ID " + change.id + " not found.";
+                auto added = state.addedAppointments.find(change.id);
+                string doctorId = added != state.addedAppointments.end() ? added->second : change.secondary;
+                if (string sealed = appointmentSystem.sealedError(change.id, change.value); !sealed.empty()) {
+                    return sealed;
+                }
+                if (string conflict = book(change.id, doctorId, change.value, state); !conflict.empty()) {
+                    return conflict;
+                }
+                state.rebooked.insert(change.id);
+                return "";
+            }
+            case StagedChange::DeleteAppointment:
+                if (!appointmentVisible(state, change.id)) return "Appointment with ID " + change.id + " not found.";
+                if (string sealed = appointmentSystem.sealedError(change.id, ""); !sealed.empty()) return sealed;
+                state.deletedAppointments.insert(change.id);
+                return "";
+        }
+        return "";
+    }
+
+    // Returns whether the transaction is still active, setting the error if not
+    bool ensureActive() {
+        error = active ? "" : "The transaction is no longer active.";
+        return active;
+    }
+
+    // Stage a change if it passes the check; sets the error otherwise. An add is checked before
+    // its ID is reserved, so a rejected add uses up no ID.
+    bool stage(StagedChange change, const function<string()> &reserveId = nullptr) {
+        if (!ensureActive()) return false;
+        StagedState state = staged;
+        error = check(change, state);
+        if (!error.empty()) return false;
+        if (reserveId) {
+            change.id = reserveId();
+            state = staged;
+            check(change, state);
+        }
+        staged = std::move(state);
+        changes.push_back(std::move(change));
+        return true;
+    }
+
+    // Apply one change, recording in `applied` what it replaced; returns false if it (or part of
+    // a cascade) could not be applied
+    bool apply(AppliedChange &applied) {
+        const StagedChange &change = *applied.change;
+        switch (change.kind) {
+            case StagedChange::AddDoctor: {
+                Doctor doctor(change.id, change.value, change.secondary);
+                return applied.done = doctorSystem.addDoctorLocked(doctor);
+            }
+            case StagedChange::RenameDoctor:
+                return applied.done = doctorSystem.updateDoctorNameLocked(change.id, change.value, &applied.previous);
+            case StagedChange::DeleteDoctor:
+                if (!(applied.done = doctorSystem.deleteDoctorLocked(change.id, &applied.deletedDoctor))) return false;
+                if (doctorSystem.onDeleteAction() == ReferentialAction::Cascade) {
+                    return appointmentSystem.deleteAppointmentsOfDoctorLocked(change.id, &applied.deletedAppointments);
+                }
+                return true;
+            case StagedChange::AddAppointment: {
+                Appointment appointment;
+                appointment.id = change.id;
+                appointment.date = change.value;
+                appointment.doctorID = change.secondary;
+                return applied.done = appointmentSystem.addAppointmentLocked(appointment);
+            }
+            case StagedChange::RedateAppointment:
+                return applied.done = appointmentSystem.updateAppointmentDateLocked(change.id, change.value,
+                                                                                    &applied.previous);
+            case StagedChange::DeleteAppointment: {
+                Appointment deleted;
+                if (!(applied.done = appointmentSystem.deleteAppointmentLocked(change.id, &deleted))) return false;
+                applied.deletedAppointments.push_back(deleted);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Take back an applied change: delete what it added, restore what it replaced and re-add
+    // what it deleted under the same IDs. Returns false if a record could not be restored.
+    bool revert(const AppliedChange &applied) {
+        const StagedChange &change = *applied.change;
+        bool restored = true;
+        // Appointments go back after their doctor, and their doctor IDs lose any record padding
+        if (applied.done) {
+            switch (change.kind) {
+                case StagedChange::AddDoctor:
+                    restored = doctorSystem.deleteDoctorLocked(change.id);
+                    break;
+                case StagedChange::RenameDoctor:
+                    restored = doctorSystem.updateDoctorNameLocked(change.id, applied.previous);
+                    break;
+                case StagedChange::DeleteDoctor: {
+                    Doctor doctor = applied.deletedDoctor;
+                    restored = doctorSystem.addDoctorLocked(doctor);
+                    break;
+                }
+                case StagedChange::AddAppointment:
+                    restored = appointmentSystem.deleteAppointmentLocked(change.id);
+                    break;
+                case StagedChange::RedateAppointment:
+                    restored = appointmentSystem.updateAppointmentDateLocked(change.id, applied.previous);
+                    break;
+                case StagedChange::DeleteAppointment:
+                    break;
+            }
+        }
+        for (Appointment appointment : applied.deletedAppointments) {
+            string &doctorId = appointment.doctorID;
+            doctorId.erase(remove(doctorId.begin(), doctorId.end(), '-'), doctorId.end());
+            restored = appointmentSystem.addAppointmentLocked(appointment) && restored;
+        }
+        return restored;
+    }
+
+public:
+    // Begin a transaction over both tables
+    Transaction(DoctorManagementSystem &doctorSystem, AppointmentManagementSystem &appointmentSystem)
+            : doctorSystem(doctorSystem), appointmentSystem(appointmentSystem) {}
+
+    Transaction(const Transaction &) = delete;
+    Transaction &operator=(const Transaction &) = delete;
+
+    ~Transaction() {
+        if (active) abort();
+    }
+
+    // Whether the transaction can still stage changes (neither committed nor aborted)
+    bool isActive() const {
+        return active;
+    }
+
+    // Number of staged changes
+    size_t size() const {
+        return changes.size();
+    }
+
+    // Why the last staging call or commit returned false
+    const string &lastError() const {
+        return error;
+    }
+
+    // Stage adding a doctor; its ID is assigned now and stored in doctor.id
+    bool addDoctor(Doctor &doctor) {
+        return stage({StagedChange::AddDoctor, "", doctor.name, doctor.address}, [&] {
+            return doctor.id = doctorSystem.reserveDoctorId();
+        });
+    }
+
+    // Stage renaming a doctor; the doctor keeps its ID, so later changes may still refer to it
+    bool updateDoctorName(const string &id, const string &newName) {
+        return stage({StagedChange::RenameDoctor, id, newName});
+    }
+
+    // Stage deleting a doctor
+    bool deleteDoctor(const string &id) {
+        return stage({StagedChange::DeleteDoctor, id});
+    }
+
+    // Stage adding an appointment; its ID is assigned now and stored in appointment.id
+    bool addAppointment(Appointment &appointment) {
+        return stage({StagedChange::AddAppointment, "", appointment.date, appointment.doctorID}, [&] {
+            return appointment.id = appointmentSystem.reserveAppointmentId();
+        });
+    }
+
+    // Stage changing an appointment's date. Its doctor, which the new time is checked against, is
+    // looked up now; an appointment never changes doctors.
+    bool updateAppointmentDate(const string &id, const string &newDate) {
+        Appointment current;
+        appointmentSystem.readAppointment(id, current);
+        return stage({StagedChange::RedateAppointment, id, newDate, current.doctorID});
+    }
+
+    // Stage deleting an appointment
+    bool deleteAppointment(const string &id) {
+        return stage({StagedChange::DeleteAppointment, id});
+    }
+
+    // Apply every staged change, or none if one of them no longer applies to the current tables
+    // (see lastError); returns whether the changes were applied. Ends the transaction either way.
+    bool commit() {
+        if (!ensureActive()) return false;
+        active = false;
+
+        bool touchesDoctors = false, touchesAppointments = false;
+        set<string> bookedDoctors;  // Doctors whose schedules the changes are checked against
+        vector<string> bookedDates; // Dates the changes add or move appointments to
+        for (const StagedChange &change : changes) {
+            if (change.kind <= StagedChange::DeleteDoctor) touchesDoctors = true;
+            else touchesAppointments = true;
+            // Appointments are checked against the doctors, which must not change meanwhile, and
+            // deleting a doctor checks or deletes its appointments
+            if (change.kind == StagedChange::AddAppointment) touchesDoctors = true;
+            // (a redate of a staged add has no doctor of its own; the add's doctor is in the set)
+            if ((change.kind == StagedChange::AddAppointment || change.kind == StagedChange::RedateAppointment) &&
+                !change.secondary.empty()) {
+                bookedDoctors.insert(change.secondary);
+            }
+            if (change.kind == StagedChange::AddAppointment || change.kind == StagedChange::RedateAppointment) {
+                bookedDates.push_back(change.value);
+            }
+            if (change.kind == StagedChange::DeleteDoctor &&
+                doctorSystem.onDeleteAction() != ReferentialAction::NoAction) touchesAppointments = true;
+        }
+
+        // Released in reverse order: the appointment indexes are persisted and unlocked first
+        unique_ptr<TableWriteLock> doctorLock, appointmentLock;
+        vector<unique_lock<mutex>> bookingLocks;
+        if (touchesDoctors) doctorLock = doctorSystem.lockForWrite();
+        if (!bookedDoctors.empty()) bookingLocks = appointmentSystem.lockBookings(bookedDoctors);
+        // The appointments' month partitions must exist to be locked with the others
+        appointmentSystem.preparePartitions(bookedDates);
+        if (touchesAppointments) appointmentLock = appointmentSystem.lockForWrite();
+
+        StagedState state;
+        for (const StagedChange &change : changes) {
+            error = check(change, state, appointmentLock != nullptr);
+            if (!error.empty()) {
+                changes.clear();
+                return false;
+            }
+        }
+
+        // Every change passed its check against the changes before it, so only a failed write
+        // stops the apply; the changes applied so far are then taken back, newest first
+        vector<AppliedChange> applied;
+        applied.reserve(changes.size());
+        for (const StagedChange &change : changes) {
+            applied.emplace_back(&change);
+            if (apply(applied.back())) continue;
+
+            error = "A change could not be written to the tables.";
+            ConfirmationRedirect quiet(nullptr, true);
+            bool restored = true;
+            for (auto undo = applied.rbegin(); undo != applied.rend(); ++undo) {
+                restored = revert(*undo) && restored;
+            }
+            if (!restored) {
+                cerr << "Error: a failed commit could not be fully rolled back; run --rebuild-indexes.\n";
+            }
+            changes.clear();
+            return false;
+        }
+        changes.clear();
+        return true;
+    }
+
+    // Discard the staged changes and end the transaction. IDs reserved for staged adds are not
+    // handed out again.
+    void abort() {
+        changes.clear();
+        staged = StagedState();
+        active = false;
+    }
+};
+
+#endif //HEALTHCAREMANAGEMENTSYSTEM_TRANSACTION_H
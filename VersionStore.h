@@ -0,0 +1,228 @@
+#ifndef HEALTHCAREMANAGEMENTSYSTEM_VERSIONSTORE_H
+#define HEALTHCAREMANAGEMENTSYSTEM_VERSIONSTORE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <set>
+#include <unordered_map>
+#include <mutex>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <functional>
+#include <cstdint>
+#include "PrimaryIndex.h"
+
+using namespace std;
+
+// Multi-version concurrency control for the data files.
+//
+// Writers change records in place (status byte, updated fields), so a long report that reads
+// the file while bookings continue could see a torn record or a mix of old and new rows.
+// Instead of keeping whole files, every table keeps the older versions of only the records
+// changed while a snapshot is open:
+//   - every in-place change or delete commits a new sequence number, and before the record is
+//     overwritten its previous image is saved, tagged with that sequence;
+//   - a snapshot remembers the sequence it was opened at plus a pinned primary index version,
+//     so records added later are invisible to it;
+//   - reading a record through a snapshot returns the first saved image whose sequence is
+//     newer than the snapshot (the record as it was at that point), or the file contents;
+//   - images are dropped as soon as no open snapshot can need them any more.
+
+// A previous image of a record, replaced by the change committed at `commitSequence`
+class RecordVersion {
+public:
+    uint64_t commitSequence; // Sequence of the change that replaced this image
+    string image;            // Record line as it was before that change
+};
+
+// Commit sequence, open snapshots and saved record images of one table
+class VersionStore {
+private:
+    mutable mutex storeMutex;                              // Protects all members below
+    uint64_t commitSequence = 0;                           // Sequence of the latest committed change
+    multiset<uint64_t> openSnapshots;                      // Sequences of the snapshots still open
+    unordered_map<string, vector<RecordVersion>> versions; // Saved images by primary key, oldest first
+    size_t versionCount = 0;                               // Total number of saved images
+
+    // Drop the images no open snapshot can read (storeMutex held)
+    void collectGarbage() {
+        if (openSnapshots.empty()) {
+            versions.clear();
+            versionCount = 0;
+            return;
+        }
+        // A snapshot at S only reads images replaced after S, so anything replaced at or
+        // before the oldest open snapshot is unreachable
+        uint64_t oldest = *openSnapshots.begin();
+        for (auto entry = versions.begin(); entry != versions.end();) {
+            vector<RecordVersion> &chain = entry->second;
+            auto firstNeeded = find_if(chain.begin(), chain.end(),
+                                       [oldest](const RecordVersion &version) { return version.commitSequence > oldest; });
+            versionCount -= firstNeeded - chain.begin();
+            chain.erase(chain.begin(), firstNeeded);
+            entry = chain.empty() ? versions.erase(entry) : next(entry);
+        }
+    }
+
+public:
+    // Register a snapshot of the committed state; the caller holds the table lock (shared is
+    // enough) so that no change is half applied. Returns the snapshot's sequence.
+    uint64_t openSnapshot() {
+        lock_guard<mutex> lock(storeMutex);
+        openSnapshots.insert(commitSequence);
+        return commitSequence;
+    }
+
+    // Release a snapshot opened with openSnapshot
+    void closeSnapshot(uint64_t sequence) {
+        lock_guard<mutex> lock(storeMutex);
+        auto position = openSnapshots.find(sequence);
+        if (position != openSnapshots.end()) openSnapshots.erase(position);
+        collectGarbage();
+    }
+
+    // Commit a change to a record. Must be called with the record's current image before the
+    // file is overwritten; the image is only kept if a snapshot is open.
+    void preserve(const string &primaryKey, const string &image) {
+        lock_guard<mutex> lock(storeMutex);
+        ++commitSequence;
+        if (!openSnapshots.empty()) {
+            versions[primaryKey].push_back({commitSequence, image});
+            versionCount++;
+        }
+    }
+
+    // Image of a record as of snapshot `sequence`, if the record has changed since then
+    bool imageAt(const string &primaryKey, uint64_t sequence, string &image) const {
+        lock_guard<mutex> lock(storeMutex);
+        auto entry = versions.find(primaryKey);
+        if (entry == versions.end()) return false;
+        for (const RecordVersion &version : entry->second) {
+            if (version.commitSequence > sequence) {
+                image = version.image;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Number of saved images (old record versions still referenced by open snapshots)
+    size_t savedVersions() const {
+        lock_guard<mutex> lock(storeMutex);
+        return versionCount;
+    }
+
+    // Number of open snapshots
+    size_t openSnapshotCount() const {
+        lock_guard<mutex> lock(storeMutex);
+        return openSnapshots.size();
+    }
+};
+
+// A consistent point-in-time view of one table, released when it goes out of scope. Open it
+// under the table lock; reads through it need no lock and never block writers.
+class TableSnapshot {
+private:
+    VersionStore &store;         // Versions of the table
+    uint64_t sequence;           // Commit sequence the snapshot sees
+    PrimaryIndexSnapshot index;  // Records that existed at that point and their offsets
+
+public:
+    TableSnapshot(VersionStore &store, const PrimaryIndex &primaryIndex)
+            : store(store), sequence(store.openSnapshot()), index(primaryIndex.snapshot()) {}
+
+    ~TableSnapshot() {
+        store.closeSnapshot(sequence);
+    }
+
+    TableSnapshot(const TableSnapshot &) = delete;
+    TableSnapshot &operator=(const TableSnapshot &) = delete;
+
+    // Number of records in the snapshot
+    size_t size() const {
+        return index.count;
+    }
+
+    // Visit the record line of every record in the snapshot, in file order (read sequentially,
+    // as a plain scan would) or in primary-key order; stops when the visitor returns false
+    void forEachRecord(const string &fileName, const function<bool(const string &line)> &visitor,
+                       bool inFileOrder = true) const {
+        vector<pair<int, string>> records;
+        records.reserve(index.count);
+        index.forEach([&records](const string &primaryKey, int offset) {
+            records.emplace_back(offset, primaryKey);
+            return true;
+        });
+        if (inFileOrder) sort(records.begin(), records.end());
+
+        ifstream file(fileName, ios::in | ios::binary);
+        if (!file.is_open()) {
+            cerr << "Error opening file: " << fileName << "\n";
+            return;
+        }
+        string line;
+        for (const auto &record : records) {
+            if (readRecordLine(file, record.second, record.first, line) && !visitor(line)) return;
+        }
+    }
+
+    // Visit every primary key and record offset of the snapshot in key order
+    void forEachKey(const function<void(const string &primaryKey, int offset)> &visitor) const {
+        index.forEach([&visitor](const string &primaryKey, int offset) {
+            visitor(primaryKey, offset);
+            return true;
+        });
+    }
+
+    // Read the line of the record `primaryKey` at `offset` of `file` as of the snapshot.
+    // Returns false if the record did not exist at that point.
+    bool readRecordLine(ifstream &file, const string &primaryKey, int offset, string &line) const {
+        file.clear();
+        file.seekg(offset, ios::beg);
+        getline(file, line);
+        // Checked after reading: a writer saves the image before touching the file, so a
+        // line that was (being) changed since the snapshot is always replaced here
+        if (store.imageAt(primaryKey, sequence, line)) return true;
+        return !line.empty() && line[0] != '*';
+    }
+};
+
+// Reads the records of a snapshot one at a time in primary-key order, so that the records of
+// several snapshots can be merged without holding all their lines in memory
+class TableSnapshotCursor {
+private:
+    const TableSnapshot &snapshot;
+    vector<pair<string, int>> records;  // Primary keys and offsets in key order
+    size_t position = 0;                // Next entry of records
+    ifstream file;
+
+public:
+    string primaryKey;                  // Key of the current record
+    string line;                        // Line of the current record
+
+    TableSnapshotCursor(const TableSnapshot &snapshot, const string &fileName)
+            : snapshot(snapshot), file(fileName, ios::in | ios::binary) {
+        if (!file.is_open()) {
+            cerr << "Error opening file: " << fileName << "\n";
+            return;
+        }
+        records.reserve(snapshot.size());
+        snapshot.forEachKey([this](const string &key, int offset) { records.emplace_back(key, offset); });
+    }
+
+    // Move to the next record of the snapshot. Returns false once all records were read.
+    bool next() {
+        while (position < records.size()) {
+            const pair<string, int> &record = records[position++];
+            if (snapshot.readRecordLine(file, record.first, record.second, line)) {
+                primaryKey = record.first;
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+#endif //HEALTHCAREMANAGEMENTSYSTEM_VERSIONSTORE_H
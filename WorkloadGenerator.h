@@ -0,0 +1,195 @@
+#ifndef HEALTHCAREMANAGEMENTSYSTEM_WORKLOADGENERATOR_H
+#define HEALTHCAREMANAGEMENTSYSTEM_WORKLOADGENERATOR_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include "AppointmentSchedule.h"
+
+using namespace std;
+
+// Synthetic workloads for load tests and hardware sizing.
+//
+// The generator writes a trace: a batch script (see StatementExecutor for the statements) that
+// first loads doctors and appointments ("#phase load") and then runs a mix of operations on them
+// ("#phase run"). The trace can be run with --batch or replayed at a target rate with --replay
+// (WorkloadReplayer.h), starting from an empty data directory of the hash-sharded layout: the
+// statements refer to the IDs the system hands out in that case.
+//
+// Run phase: a `readFraction` of the operations are reads (appointment by ID, a doctor's
+// appointments, doctor by ID, appointments of a day); the rest are writes, of which a
+// `churnFraction` delete appointments, and the others add appointments (70%), move appointments
+// to another day (20%), or add and rename doctors (10%). Doctors are picked with Zipfian
+// popularity (`doctorSkew`; 0 is uniform) and appointment days with Zipfian skew towards the
+// first days of the booking window (`dateSkew`). Dates and names keep one length, so updates are
+// done in place and keep their IDs.
+
+// Parameters of a generated workload
+class WorkloadProfile {
+public:
+    size_t doctors = 1000;          // Doctors loaded before the run
+    size_t appointments = 10000;    // Appointments loaded before the run
+    size_t operations = 100000;     // Operations of the run phase
+    double readFraction = 0.8;      // Share of reads among the operations
+    double churnFraction = 0.3;     // Share of appointment deletes among the writes
+    double doctorSkew = 1.0;        // Zipf exponent of doctor popularity
+    double dateSkew = 0.5;          // Zipf exponent of appointment days over the booking window
+    int bookingDays = 90;           // Days of the booking window
+    string firstDay = "2025-01-01"; // First day of the booking window
+    unsigned long long seed = 1;    // Random seed; one profile always gives the same trace
+};
+
+// Ranks 1..n drawn with probability proportional to 1 / rank^exponent, by binary search on the
+// cumulative distribution (O(log n) per draw)
+class ZipfDistribution {
+private:
+    vector<double> cumulative;
+
+public:
+    ZipfDistribution(size_t n, double exponent) {
+        cumulative.reserve(max<size_t>(n, 1));
+        double total = 0;
+        for (size_t rank = 1; rank <= max<size_t>(n, 1); ++rank) {
+            total += 1.0 / pow(static_cast<double>(rank), exponent);
+            cumulative.push_back(total);
+        }
+        for (double &value : cumulative) {
+            value /= total;
+        }
+    }
+
+    // A rank in [0, n), 0 being the most popular
+    template<typename Random>
+    size_t operator()(Random &random) {
+        double u = uniform_real_distribution<double>(0, 1)(random);
+        size_t rank = upper_bound(cumulative.begin(), cumulative.end(), u) - cumulative.begin();
+        return min(rank, cumulative.size() - 1);
+    }
+};
+
+// Writes the trace of a workload profile
+class WorkloadGenerator {
+private:
+    WorkloadProfile profile;
+    mt19937_64 random;
+    ZipfDistribution doctorPopularity;
+    ZipfDistribution dayPopularity;
+    vector<size_t> doctorByRank;     // Doctor ID of each popularity rank, shuffled
+    vector<size_t> liveAppointments; // Appointment IDs that exist at this point of the trace
+    size_t doctorCount = 0;          // Doctor IDs handed out so far
+    size_t appointmentCount = 0;     // Appointment IDs handed out so far
+    long long firstDay = 0;          // Days since 1970-01-01 of the booking window's first day
+
+    double chance() {
+        return uniform_real_distribution<double>(0, 1)(random);
+    }
+
+    size_t popularDoctor() {
+        return doctorByRank[doctorPopularity(random)];
+    }
+
+    string skewedDay() {
+        return formatDay(firstDay + static_cast<long long>(dayPopularity(random)));
+    }
+
+    // Name of doctor `id`; all names have one length
+    static string doctorName(size_t id) {
+        string digits = to_string(id % 1000000);
+        return "doctor" + string(6 - digits.size(), '0') + digits;
+    }
+
+    // Any live appointment, and its position in liveAppointments
+    size_t liveAppointment(size_t &position) {
+        position = random() % liveAppointments.size();
+        return liveAppointments[position];
+    }
+
+    void addAppointment(ostream &out) {
+        out << "ADD APPOINTMENT " << skewedDay() << " | " << popularDoctor() << "\n";
+        liveAppointments.push_back(++appointmentCount);
+    }
+
+    void writeRead(ostream &out) {
+        double kind = chance();
+        size_t position;
+        if (kind < 0.4 && !liveAppointments.empty()) {
+            out << "PRINT APPOINTMENT " << liveAppointment(position) << "\n";
+        } else if (kind < 0.7) {
+            out << "SELECT * FROM appointments WHERE doctorid = '" << popularDoctor() << "';\n";
+        } else if (kind < 0.9 || liveAppointments.empty()) {
+            out << "PRINT DOCTOR " << popularDoctor() << "\n";
+        } else {
+            out << "SELECT * FROM appointments WHERE date = '" << skewedDay() << "';\n";
+        }
+    }
+
+    void writeWrite(ostream &out) {
+        size_t position;
+        if (chance() < profile.churnFraction && !liveAppointments.empty()) {
+            out << "DELETE APPOINTMENT " << liveAppointment(position) << "\n";
+            liveAppointments[position] = liveAppointments.back();
+            liveAppointments.pop_back();
+            return;
+        }
+        double kind = chance();
+        if (kind < 0.7 || liveAppointments.empty()) {
+            addAppointment(out);
+        } else if (kind < 0.9) {
+            out << "UPDATE APPOINTMENT " << liveAppointment(position) << " | " << skewedDay() << "\n";
+        } else if (kind < 0.95) {
+            ++doctorCount;
+            out << "ADD DOCTOR " << doctorName(doctorCount) << " | city" << doctorCount % 13 << "\n";
+        } else {
+            size_t id = popularDoctor();
+            out << "UPDATE DOCTOR " << id << " | " << doctorName(id + random() % 1000) << "\n";
+        }
+    }
+
+public:
+    explicit WorkloadGenerator(const WorkloadProfile &profile)
+            : profile(profile), random(profile.seed),
+              doctorPopularity(max<size_t>(profile.doctors, 1), profile.doctorSkew),
+              dayPopularity(max(profile.bookingDays, 1), profile.dateSkew) {}
+
+    // Write the whole trace; returns false if the profile is invalid
+    bool write(ostream &out) {
+        if (!parseDay(profile.firstDay, firstDay) || profile.doctors == 0 || profile.readFraction < 0 ||
+            profile.readFraction > 1 || profile.churnFraction < 0 || profile.churnFraction > 1) {
+            cerr << "Error: invalid workload profile.\n";
+            return false;
+        }
+        doctorByRank.resize(profile.doctors);
+        for (size_t rank = 0; rank < profile.doctors; ++rank) {
+            doctorByRank[rank] = rank + 1;
+        }
+        shuffle(doctorByRank.begin(), doctorByRank.end(), random);
+
+        out << "# workload doctors=" << profile.doctors << " appointments=" << profile.appointments
+            << " operations=" << profile.operations << " read=" << profile.readFraction
+            << " churn=" << profile.churnFraction << " zipf=" << profile.doctorSkew
+            << " date-skew=" << profile.dateSkew << " days=" << profile.bookingDays
+            << " first-day=" << profile.firstDay << " seed=" << profile.seed << "\n";
+        out << "#phase load\n";
+        for (size_t i = 0; i < profile.doctors; ++i) {
+            ++doctorCount;
+            out << "ADD DOCTOR " << doctorName(doctorCount) << " | city" << doctorCount % 13 << "\n";
+        }
+        for (size_t i = 0; i < profile.appointments; ++i) {
+            addAppointment(out);
+        }
+        out << "#phase run\n";
+        for (size_t i = 0; i < profile.operations; ++i) {
+            if (chance() < profile.readFraction) {
+                writeRead(out);
+            } else {
+                writeWrite(out);
+            }
+        }
+        return static_cast<bool>(out);
+    }
+};
+
+#endif //HEALTHCAREMANAGEMENTSYSTEM_WORKLOADGENERATOR_H
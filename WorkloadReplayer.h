@@ -0,0 +1,137 @@
+#ifndef HEALTHCAREMANAGEMENTSYSTEM_WORKLOADREPLAYER_H
+#define HEALTHCAREMANAGEMENTSYSTEM_WORKLOADREPLAYER_H
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include "DoctorManagementSystem.h"
+#include "AppointmentManagementSystem.h"
+#include "QueryHandler.h"
+#include "ResultSink.h"
+#include "TextAndStats.h"
+#include "StatementExecutor.h"
+
+using namespace std;
+
+// Replays a trace (a batch script, e.g. from WorkloadGenerator) against the management systems at
+// a target rate and reports the latency distribution of every statement kind.
+//
+// "#phase <name>" comment lines split the trace into phases that are reported separately. The
+// "load" phase runs as fast as possible with index persistence deferred to its end, like a batch;
+// the other phases run at `rate` statements per second (0 for as fast as possible) with the
+// indexes persisted per the durability policy. Statements are scheduled open-loop: a statement's
+// latency is measured from the time it was due, so time spent waiting behind a slow statement
+// counts, as it would for a client sending at that rate. Statement results are discarded.
+class WorkloadReplayer {
+private:
+    DoctorManagementSystem &doctorSystem;
+    AppointmentManagementSystem &appointmentSystem;
+    StatementExecutor executor;
+    double rate;                                      // Statements per second; 0 for unthrottled
+    map<pair<string, string>, vector<long long>> latencies; // (phase, statement kind) -> ns
+    map<pair<string, string>, size_t> failures;       // (phase, statement kind) -> failed statements
+
+    // Switch persistence for a phase: deferred for "load", per the durability policy otherwise
+    void beginPhase(const string &phase) {
+        bool load = phase == "load";
+        doctorSystem.setAutoPersist(!load);
+        appointmentSystem.setAutoPersist(!load);
+    }
+
+    void endPhase(const string &phase) {
+        if (phase != "load") return;
+        doctorSystem.flush();
+        appointmentSystem.flush();
+    }
+
+public:
+    WorkloadReplayer(DoctorManagementSystem &doctorSys, AppointmentManagementSystem &appointmentSys,
+                     QueryHandler &queryHandler, double rate = 0)
+            : doctorSystem(doctorSys), appointmentSystem(appointmentSys),
+              executor(doctorSys, appointmentSys, queryHandler), rate(max(rate, 0.0)) {}
+
+    // Replays every statement of `trace`; returns the number of failed statements. The latency
+    // report is written to `report`, a summary per phase to stderr.
+    size_t run(istream &trace, ResultSink &report) {
+        string results;
+        ResultSink sink(OutputFormat::Table, results);  // Output and confirmations, discarded
+
+        string phase = "run", line, kind;
+        beginPhase(phase);
+        size_t failed = 0, phaseStatements = 0;
+        auto phaseStart = chrono::steady_clock::now();
+        auto summarize = [&] {
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - phaseStart).count();
+            cerr << "Phase " << phase << ": " << phaseStatements << " statements in " << fixed << setprecision(3)
+                 << seconds << " s (" << setprecision(0) << (seconds > 0 ? phaseStatements / seconds : 0.0)
+                 << " statements/s)\n";
+            cerr.unsetf(ios::floatfield);
+            cerr << setprecision(6);
+        };
+
+        while (getline(trace, line)) {
+            trimBlanks(line);
+            if (line.rfind("#phase ", 0) == 0) {
+                endPhase(phase);
+                if (phaseStatements > 0) summarize();
+                phase = line.substr(7);
+                trimBlanks(phase);
+                beginPhase(phase);
+                phaseStatements = 0;
+                phaseStart = chrono::steady_clock::now();
+                continue;
+            }
+            if (line.empty() || line[0] == '#') continue;
+
+            // Open-loop schedule: statement n of a throttled phase is due n / rate after its start
+            auto due = chrono::steady_clock::now();
+            if (rate > 0 && phase != "load") {
+                due = phaseStart + chrono::duration_cast<chrono::steady_clock::duration>(
+                        chrono::duration<double>(phaseStatements / rate));
+                // Sleep most of the wait and spin the rest: a sleep overshoots by tens of
+                // microseconds, which would show up as latency
+                this_thread::sleep_until(due - chrono::microseconds(200));
+                while (chrono::steady_clock::now() < due) this_thread::yield();
+            }
+            bool ok = executor.execute(line, sink, kind);
+            sink.flush();
+            long long elapsed = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - due).count();
+            results.clear();
+
+            latencies[{phase, kind}].push_back(elapsed);
+            if (!ok) {
+                failures[{phase, kind}]++;
+                failed++;
+            }
+            phaseStatements++;
+        }
+        endPhase(phase);
+        if (phaseStatements > 0) summarize();
+        doctorSystem.setAutoPersist(true);
+        appointmentSystem.setAutoPersist(true);
+
+        for (auto &entry : latencies) {
+            vector<long long> &values = entry.second;
+            report.beginRow();
+            report.field("Phase", entry.first.first);
+            report.field("Statement", entry.first.second);
+            report.numberField("Count", values.size());
+            report.numberField("Failed", failures[entry.first]);
+            report.numberField("P50 ns", latencyPercentile(values, 50));
+            report.numberField("P90 ns", latencyPercentile(values, 90));
+            report.numberField("P99 ns", latencyPercentile(values, 99));
+            report.numberField("P999 ns", latencyPercentile(values, 99.9));
+            report.numberField("Max ns", *max_element(values.begin(), values.end()));
+            report.endRow();
+        }
+        report.flush();
+        return failed;
+    }
+};
+
+#endif //HEALTHCAREMANAGEMENTSYSTEM_WORKLOADREPLAYER_H
@@ -0,0 +1,62 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <exception>
+#include "StorageBenchmark.h"
+
+using namespace std;
+
+// Storage benchmark: times the storage and index operations at several data set sizes and
+// writes one row per operation and size.
+//
+//   HealthCareManagementSystemBenchmark [--records 10000,1000000,10000000] [--ops <count>]
+//                                       [--format json|csv] [--durability op|ops:<N>|ms:<T>]
+//
+// --records  data set sizes (appointments) to run, in order
+// --ops      operations timed per lookup, update and delete phase (default 10000)
+// --format   JSON lines (default) or CSV on stdout; progress goes to stderr
+// --durability  persist the indexes per this policy instead of once per write phase
+int main(int argc, char *argv[]) {
+    vector<size_t> recordCounts = {10000, 1000000, 10000000};
+    size_t sampleCount = 10000;
+    OutputFormat format = OutputFormat::JsonLines;
+    bool deferred = true;
+
+    for (int i = 1; i < argc; ++i) {
+        string argument = argv[i];
+        if (i + 1 >= argc) {
+            cerr << "Error: missing value for " << argument << ".\n";
+            return 1;
+        }
+        string value = argv[++i];
+        try {
+            if (argument == "--records") {
+                recordCounts.clear();
+                stringstream list(value);
+                string count;
+                while (getline(list, count, ',')) {
+                    recordCounts.push_back(stoul(count));
+                }
+            } else if (argument == "--ops") {
+                sampleCount = stoul(value);
+            } else if (argument == "--format" && (value == "json" || value == "csv")) {
+                format = value == "json" ? OutputFormat::JsonLines : OutputFormat::Csv;
+            } else if (argument == "--durability" && DurabilityPolicy::parse(value, durabilityPolicy())) {
+                deferred = false;
+            } else {
+                cerr << "Error: invalid option " << argument << " " << value << ".\n";
+                return 1;
+            }
+        } catch (const exception &) {
+            cerr << "Error: invalid number \"" << value << "\" for " << argument << ".\n";
+            return 1;
+        }
+    }
+
+    ResultSink sink(format);
+    for (size_t recordCount : recordCounts) {
+        if (!StorageBenchmark(recordCount, sampleCount, deferred, sink).run()) return 1;
+    }
+    return 0;
+}
@@ -2,6 +2,13 @@
 #include "DoctorManagementSystem.h"
 #include "AppointmentManagementSystem.h"
 #include "QueryHandler.h"
+#include "BatchRunner.h"
+#include "StorageBenchmark.h"
+#include "WorkloadGenerator.h"
+#include "WorkloadReplayer.h"
+#include "SocketServer.h"
+#include "SocketClient.h"
+#include "MemoryGovernor.h"
 
 using namespace std;
 
@@ -48,19 +55,282 @@ string padInt(int x) {
     return paddedInt;
 }
 
-int main() {
-    cout << "Welcome to Your Health Care Management System\n";
-    int choice = -1;
+// Parses a whole command line argument as an integer of at least `minimum`; false if it is not one
+bool parseIntegerArgument(const string &text, long long minimum, long long &value) {
+    try {
+        size_t used;
+        long long parsed = stoll(text, &used);
+        if (used != text.size() || parsed < minimum) return false;
+        value = parsed;
+        return true;
+    } catch (const exception &) {
+        return false;
+    }
+}
+
+// Parses a whole command line argument as a finite, non-negative number; false if it is not one
+bool parseRateArgument(const string &text, double &value) {
+    try {
+        size_t used;
+        double parsed = stod(text, &used);
+        if (used != text.size() || !isfinite(parsed) || parsed < 0) return false;
+        value = parsed;
+        return true;
+    } catch (const exception &) {
+        return false;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    // Read scalability benchmark on a generated data set: --bench-read [threads] [doctors] [appointments]
+    if (argc >= 2 && string(argv[1]) == "--bench-read") {
+        long long threads = thread::hardware_concurrency(), doctors = 1000, appointments = 10000;
+        if ((argc >= 3 && !parseIntegerArgument(argv[2], 1, threads)) ||
+            (argc >= 4 && !parseIntegerArgument(argv[3], 1, doctors)) ||
+            (argc >= 5 && !parseIntegerArgument(argv[4], 0, appointments))) {
+            cerr << "Usage: --bench-read [threads >= 1] [doctors >= 1] [appointments >= 0]\n";
+            return 1;
+        }
+        return ReadBenchmark(doctors, appointments, threads).run() ? 0 : 1;
+    }
+
+    // Create an empty hash-partitioned layout in the working directory: --init-shards <count>
+    if (argc >= 2 && string(argv[1]) == "--init-shards") {
+        long long shardCount;
+        if (argc < 3 || !parseIntegerArgument(argv[2], 1, shardCount)) {
+            cerr << "Usage: --init-shards <count >= 2>\n";
+            return 1;
+        }
+        if (!initializeShards(shardCount)) return 1;
+        cout << "Initialized " << shardCount << " shards.\n";
+        return 0;
+    }
+
+    // Write a synthetic workload trace to stdout: --generate-workload [--doctors N] [--appointments N]
+    // [--operations N] [--read F] [--churn F] [--zipf S] [--date-skew S] [--days N] [--first-day D] [--seed N]
+    if (argc >= 2 && string(argv[1]) == "--generate-workload") {
+        WorkloadProfile profile;
+        for (int i = 2; i + 1 < argc; i += 2) {
+            string option = argv[i], value = argv[i + 1];
+            try {
+                if (option == "--doctors") profile.doctors = stoul(value);
+                else if (option == "--appointments") profile.appointments = stoul(value);
+                else if (option == "--operations") profile.operations = stoul(value);
+                else if (option == "--read") profile.readFraction = stod(value);
+                else if (option == "--churn") profile.churnFraction = stod(value);
+                else if (option == "--zipf") profile.doctorSkew = stod(value);
+                else if (option == "--date-skew") profile.dateSkew = stod(value);
+                else if (option == "--days") profile.bookingDays = stoi(value);
+                else if (option == "--first-day") profile.firstDay = value;
+                else if (option == "--seed") profile.seed = stoull(value);
+                else {
+                    cerr << "Error: unknown workload option " << option << ".\n";
+                    return 1;
+                }
+            } catch (const exception &) {
+                cerr << "Error: invalid value \"" << value << "\" for " << option << ".\n";
+                return 1;
+            }
+        }
+        return WorkloadGenerator(profile).write(cout) ? 0 : 1;
+    }
+
+    // Switch an empty working directory to month-partitioned appointments: --init-partitions
+    if (argc >= 2 && string(argv[1]) == "--init-partitions") {
+        if (!initializeMonthPartitions()) return 1;
+        cout << "Initialized month partitions.\n";
+        return 0;
+    }
+
+    // Durability of the index files, for every mode: --durability op | ops:<N> | ms:<T>
+    // (persist after every change, after every N changes, or at most every T milliseconds)
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (string(argv[i]) == "--durability" && !DurabilityPolicy::parse(argv[i + 1], durabilityPolicy())) {
+            cerr << "Error: invalid durability policy \"" << argv[i + 1] << "\" (use op, ops:<N> or ms:<T>).\n";
+            return 1;
+        }
+    }
+
+    // Budget of the in-memory indexes, enforced every T milliseconds (default 1000) by evicting the
+    // least recently used ones: --memory-budget <bytes[k|m|g]> [--memory-interval <T>]
+    long long memoryIntervalMs = 1000;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (string(argv[i]) == "--memory-budget") {
+            size_t limit;
+            if (!MemoryBudget::parse(argv[i + 1], limit) || limit == 0) {
+                cerr << "Error: invalid memory budget \"" << argv[i + 1] << "\" (use a size such as 64m).\n";
+                return 1;
+            }
+            memoryBudget().limitBytes = limit;
+        }
+        if (string(argv[i]) == "--memory-interval" && !parseIntegerArgument(argv[i + 1], 1, memoryIntervalMs)) {
+            cerr << "Error: invalid memory interval \"" << argv[i + 1] << "\" (use milliseconds, at least 1).\n";
+            return 1;
+        }
+    }
+
+    // What deleting a doctor does to its appointments: --on-delete-doctor no-action | restrict | cascade
+    ReferentialAction onDoctorDelete = ReferentialAction::NoAction;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (string(argv[i]) == "--on-delete-doctor" && !parseReferentialAction(argv[i + 1], onDoctorDelete)) {
+            cerr << "Error: invalid ON DELETE action \"" << argv[i + 1] << "\" (use no-action, restrict or cascade).\n";
+            return 1;
+        }
+    }
+
+    // Options of the socket modes: --socket <path> and --workers <count>; the remaining arguments are kept
+    string socketPath = defaultSocketPath;
+    size_t workers = thread::hardware_concurrency();
+    vector<string> arguments;
+    for (int i = 2; i < argc; ++i) {
+        string argument = argv[i];
+        if (argument == "--socket" && i + 1 < argc) socketPath = argv[++i];
+        else if (argument == "--workers" && i + 1 < argc) {
+            long long count;
+            if (!parseIntegerArgument(argv[++i], 1, count)) {
+                cerr << "Error: invalid worker count \"" << argv[i] << "\" (use a number of at least 1).\n";
+                return 1;
+            }
+            workers = count;
+        }
+        else if ((argument == "--durability" || argument == "--on-delete-doctor" || argument == "--stats-file" ||
+                  argument == "--stats-interval" || argument == "--memory-budget" ||
+                  argument == "--memory-interval") && i + 1 < argc) ++i;
+        else arguments.push_back(argument);
+    }
+
+    // Client of a running server: --client [--socket path] [statement ...] (statements from stdin if none)
+    if (argc >= 2 && string(argv[1]) == "--client") {
+        SocketClient client(socketPath);
+        if (!client.connectToServer()) return 1;
+        return client.run(arguments, cin) == 0 ? 0 : 1;
+    }
 
     // Initialize the doctor management system
     DoctorManagementSystem doctorSystem;
+    doctorSystem.setOnDelete(onDoctorDelete);
 
     // Initialize the appointment system, linking it with the doctor system
-    AppointmentManagementSystem appointmentSystem(doctorSystem.getDoctorPrimaryIndex());
+    AppointmentManagementSystem appointmentSystem(doctorSystem);
+
+    // With an interval policy, also persist changes that no later change comes to write out
+    unique_ptr<PeriodicFlusher> flusher;
+    if (durabilityPolicy().mode == DurabilityPolicy::EveryInterval) {
+        flusher = make_unique<PeriodicFlusher>(chrono::milliseconds(durabilityPolicy().intervalMs), [&] {
+            doctorSystem.flush();
+            appointmentSystem.flush();
+        });
+    }
+
+    // With a memory budget, evict cold indexes whenever the resident ones exceed it
+    MemoryGovernor memoryGovernor(doctorSystem, appointmentSystem);
+    unique_ptr<PeriodicFlusher> memoryEnforcer;
+    if (memoryBudget().limitBytes > 0) {
+        memoryEnforcer = make_unique<PeriodicFlusher>(chrono::milliseconds(memoryIntervalMs), [&] {
+            memoryGovernor.enforce();
+        });
+    }
+
+    // Counters in Prometheus text format for the node exporter's textfile collector, rewritten
+    // every T milliseconds (default 15000) and at exit: --stats-file <path> [--stats-interval <T>]
+    string statsFile;
+    long long statsIntervalMs = 15000;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (string(argv[i]) == "--stats-file") statsFile = argv[i + 1];
+        if (string(argv[i]) == "--stats-interval" && !parseIntegerArgument(argv[i + 1], 1, statsIntervalMs)) {
+            cerr << "Error: invalid stats interval \"" << argv[i + 1] << "\" (use milliseconds, at least 1).\n";
+            return 1;
+        }
+    }
+    unique_ptr<PeriodicFlusher> statsWriter;
+    if (!statsFile.empty()) {
+        statsWriter = make_unique<PeriodicFlusher>(chrono::milliseconds(statsIntervalMs), [&] {
+            writePrometheusStats(statsFile);
+        });
+    }
+    struct StatsFileAtExit {
+        const string &fileName;
+        ~StatsFileAtExit() {
+            if (!fileName.empty()) writePrometheusStats(fileName);
+        }
+    } statsFileAtExit{statsFile};
+
+    // Recovery: rebuild every index and free list from the data files and report what differed: --rebuild-indexes
+    if (argc >= 2 && string(argv[1]) == "--rebuild-indexes") {
+        for (const RebuildReport &report : {doctorSystem.rebuildIndexes(), appointmentSystem.rebuildIndexes()}) {
+            for (const string &line : report.lines()) {
+                cout << line << "\n";
+            }
+        }
+        return 0;
+    }
+
+    // Make the month partitions older than the last N months read-only, compressing their data
+    // files with --archive: --seal-months <N> [--archive]. Run it while no server is running.
+    if (argc >= 2 && string(argv[1]) == "--seal-months") {
+        long long monthsKept;
+        if (argc < 3 || !parseIntegerArgument(argv[2], 0, monthsKept) || monthsKept > 12 * 1000) {
+            cerr << "Usage: --seal-months <months kept, >= 0> [--archive]\n";
+            return 1;
+        }
+        bool archive = find(arguments.begin(), arguments.end(), "--archive") != arguments.end();
+        string before = monthsBeforeNow(monthsKept);
+        size_t sealed = appointmentSystem.sealPartitionsBefore(before, archive);
+        cout << (archive ? "Archived " : "Sealed ") << sealed << " month partition(s) before " << before << ".\n";
+        return 0;
+    }
+
+    // Server mode: share the loaded indexes with socket clients: --serve [--socket path] [--workers count]
+    if (argc >= 2 && string(argv[1]) == "--serve") {
+        SocketServer server(doctorSystem, appointmentSystem, socketPath, workers);
+        return server.run() ? 0 : 1;
+    }
 
     // Initialize the query handler with both systems
     QueryHandler queryHandler(doctorSystem, appointmentSystem);
 
+    // Replay a workload trace at a target rate and report latency percentiles per statement kind:
+    // --replay <trace> [--rate statements/s] [--format table|csv|json]
+    if (argc >= 2 && string(argv[1]) == "--replay") {
+        double rate = 0;
+        OutputFormat format = OutputFormat::Table;
+        for (size_t i = 1; i + 1 < arguments.size(); ++i) {
+            if (arguments[i] == "--rate" && !parseRateArgument(arguments[i + 1], rate)) {
+                cerr << "Error: invalid rate \"" << arguments[i + 1]
+                     << "\" (use statements per second, 0 for unthrottled).\n";
+                return 1;
+            }
+            if (arguments[i] == "--format" && arguments[i + 1] == "csv") format = OutputFormat::Csv;
+            if (arguments[i] == "--format" && arguments[i + 1] == "json") format = OutputFormat::JsonLines;
+        }
+        ifstream trace(arguments.empty() ? "" : arguments.front());
+        if (!trace.is_open()) {
+            cerr << "Error opening trace file: " << (arguments.empty() ? "" : arguments.front()) << "\n";
+            return 1;
+        }
+        ResultSink report(format);
+        WorkloadReplayer replayer(doctorSystem, appointmentSystem, queryHandler, rate);
+        return replayer.run(trace, report) == 0 ? 0 : 1;
+    }
+
+    // Batch mode: run a script of commands and queries without prompts ("-" reads stdin)
+    if (argc >= 2 && string(argv[1]) == "--batch") {
+        string scriptName = argc >= 3 ? argv[2] : "-";
+        BatchRunner batchRunner(doctorSystem, appointmentSystem, queryHandler);
+        if (scriptName == "-") {
+            return batchRunner.run(cin) == 0 ? 0 : 1;
+        }
+        ifstream script(scriptName);
+        if (!script.is_open()) {
+            cerr << "Error opening batch file: " << scriptName << "\n";
+            return 1;
+        }
+        return batchRunner.run(script) == 0 ? 0 : 1;
+    }
+
+    cout << "Welcome to Your Health Care Management System\n";
+    int choice = -1;
+
     // Main menu loop
     while (choice != 0) {
         // Display menu options
@@ -76,6 +346,10 @@ int main() {
              "9) Write Query\n"
              "10) Print all doctors\n"
              "11) Print all appointments\n"
+             "12) Free Slots (Doctor ID, Day)\n"
+             "13) Print I/O Statistics\n"
+             "14) Print Latency Percentiles\n"
+             "15) Print Memory Usage\n"
              "0) Exit\n"
              "Enter a choice: ";
         cin >> choice;
@@ -108,7 +382,7 @@ int main() {
             string date;
             int doctorID;
 
-            cout << "Enter the date: ";
+            cout << "Enter the date (yyyy-mm-dd hh:mm-hh:mm books a time): ";
             cin.ignore();
             getline(cin, date); // Read the date
             toLower(date);
@@ -214,12 +488,62 @@ int main() {
             appointmentSystem.printAllAppointments(0); // Print list of all appointments
             checkContinue();
         }
+        else if (choice == 12) {
+            // Print the gaps between a doctor's booked appointments on a day
+            int id;
+            cout << "Please enter the Doctor's ID: ";
+            cin >> id;
+
+            string day;
+            cout << "Please enter the day (yyyy-mm-dd): ";
+            cin >> day;
+
+            string paddedId = padInt(id);
+            TimeInterval window;
+            long long dayNumber;
+            if (!doctorSystem.doctorExists(paddedId)) {
+                cout << "Doctor with ID " << paddedId << " not found.\n";
+            } else if (!parseDay(day, dayNumber)) {
+                cout << "Invalid day \"" << day << "\".\n";
+            } else {
+                window = {dayNumber * 24 * 60, (dayNumber + 1) * 24 * 60};
+                for (const TimeInterval &slot : appointmentSystem.freeSlots(paddedId, window)) {
+                    cout << formatTimeRange(slot) << "\n";
+                }
+            }
+            checkContinue();
+        }
+        else if (choice == 13) {
+            // Print the I/O and operation counters since startup
+            ResultSink sink(OutputFormat::Table);
+            queryHandler.executeQuery("STATS", sink);
+            sink.flush();
+            checkContinue();
+        }
+        else if (choice == 14) {
+            // Print the latency percentiles of every operation since startup
+            ResultSink sink(OutputFormat::Table);
+            queryHandler.executeQuery("SHOW LATENCY", sink);
+            sink.flush();
+            checkContinue();
+        }
+        else if (choice == 15) {
+            // Print the estimated memory of every index structure and of the query cache
+            ResultSink sink(OutputFormat::Table);
+            queryHandler.executeQuery("SHOW MEMORY", sink);
+            sink.flush();
+            checkContinue();
+        }
         else {
             // Handle invalid choice
             cout << "Enter a valid choice\n";
         }
     }
 
+    // Write out changes the durability policy has not persisted yet
+    doctorSystem.flush();
+    appointmentSystem.flush();
+
     // End of program
     cout << "End of program\n";
     return 0;